@@ -0,0 +1,172 @@
+#!/bin/sh
+# Minimal stand-in for the SLURM commands that runs the jobs on the local computer.
+# Use it to test distributed processing with the SLURM distributor without a cluster,
+# by setting
+#
+#   sbatch_command = /path/to/fake-slurm.sh sbatch
+#   squeue_command = /path/to/fake-slurm.sh squeue
+#   scancel_command = /path/to/fake-slurm.sh scancel
+#   sinfo_command = /path/to/fake-slurm.sh sinfo
+#
+# in slurm_config.txt. Only the options used by pi2 are supported. Jobs start immediately
+# unless they wait for the job given in --dependency=afterany:<id> or for a free slot within
+# the task limit of their array (--array=...%N).
+# The state of the jobs is stored in the folder given by FAKE_SLURM_DIR environment variable,
+# ./fake-slurm by default. FAKE_SLURM_MEMORY sets the per node memory reported by sinfo in
+# megabytes. The largest count of jobs that have been running at the same time is written
+# to max-running file in the state folder.
+
+state=${FAKE_SLURM_DIR:-./fake-slurm}
+mkdir -p "$state"
+
+command=$1
+shift
+
+# Starts a job in the background.
+# Arguments: job id, array job id, array task id, output file, error file, command line,
+# task limit of the array (0 for no limit), id of the job this job depends on (may be empty).
+start_job() {
+	job=$1
+	out=$(echo "$4" | sed "s/%A/$2/g; s/%a/$3/g; s/%j/$job/g")
+	err=$(echo "$5" | sed "s/%A/$2/g; s/%a/$3/g; s/%j/$job/g")
+
+	echo "$err" > "$state/$job.running"
+	SLURM_JOB_ID=$job SLURM_ARRAY_JOB_ID=$2 SLURM_ARRAY_TASK_ID=$3 \
+		setsid "$0" run "$job" "$2" "$7" "$8" "$6" < /dev/null > "$out" 2> "$err" &
+	echo $! > "$state/$job.pid"
+}
+
+lock() {
+	until mkdir "$state/lock" 2> /dev/null; do
+		sleep 0.1
+	done
+}
+
+unlock() {
+	rmdir "$state/lock"
+}
+
+# Prints ids of running jobs that match the given job id.
+# Job id of an array job matches all the tasks of the array.
+matching_jobs() {
+	for f in "$state/$1.running" "$state/$1"_*.running; do
+		if [ -f "$f" ]; then
+			basename "$f" .running
+		fi
+	done
+}
+
+case "$command" in
+sbatch)
+	output=slurm-%j.out
+	error=slurm-%j.err
+	array=
+	dependency=
+	wrap=
+	for arg in "$@"; do
+		case "$arg" in
+		--output=*) output=${arg#--output=} ;;
+		--error=*) error=${arg#--error=} ;;
+		--array=*) array=${arg#--array=} ;;
+		--dependency=afterany:*) dependency=${arg#--dependency=afterany:} ;;
+		--wrap=*) wrap=${arg#--wrap=} ;;
+		esac
+	done
+
+	if [ -z "$wrap" ]; then
+		echo "sbatch: error: only --wrap jobs are supported" >&2
+		exit 1
+	fi
+
+	lock
+	id=$(cat "$state/next-id" 2> /dev/null || echo 1000)
+	echo $((id + 1)) > "$state/next-id"
+	unlock
+
+	if [ -z "$array" ]; then
+		start_job "$id" "$id" "" "$output" "$error" "$wrap" 0 "$dependency"
+	else
+		# Task list and optional limit of concurrent tasks, e.g. 0-3,7,9-10%4.
+		limit=0
+		case "$array" in
+		*%*) limit=${array#*%} ;;
+		esac
+		for part in $(echo "${array%%\%*}" | tr ',' ' '); do
+			first=${part%-*}
+			last=${part#*-}
+			for task in $(seq "$first" "$last"); do
+				start_job "${id}_$task" "$id" "$task" "$output" "$error" "$wrap" "$limit" "$dependency"
+			done
+		done
+	fi
+
+	echo "Submitted batch job $id"
+	;;
+
+squeue)
+	jobs=
+	for arg in "$@"; do
+		case "$arg" in
+		--jobs=*) jobs=${arg#--jobs=} ;;
+		esac
+	done
+
+	for id in $(echo "$jobs" | tr ',' ' '); do
+		matching_jobs "$id"
+	done
+	;;
+
+scancel)
+	for id in "$@"; do
+		for job in $(matching_jobs "$id"); do
+			kill -TERM -- "-$(cat "$state/$job.pid")" 2> /dev/null
+			echo "slurmstepd: error: *** JOB $job CANCELLED ***" >> "$(cat "$state/$job.running")"
+			rm -f "$state/$job.running" "$state/$job.active"
+		done
+	done
+	;;
+
+run)
+	# Runs a job started by start_job.
+	# Arguments: job id, array job id, task limit of the array, dependency, command line.
+	job=$1
+	array_job=$2
+	limit=$3
+	dependency=$4
+
+	# Wait until the dependency has finished and the array has a free slot.
+	while :; do
+		if [ -z "$dependency" ] || [ -z "$(matching_jobs "$dependency")" ]; then
+			lock
+			active=$(ls "$state" | grep -c "^${array_job}_.*\.active\$")
+			if [ "$limit" -eq 0 ] || [ "$active" -lt "$limit" ]; then
+				touch "$state/$job.active"
+				total=$(ls "$state" | grep -c '\.active$')
+				peak=$(cat "$state/max-running" 2> /dev/null || echo 0)
+				if [ "$total" -gt "$peak" ]; then
+					echo "$total" > "$state/max-running"
+				fi
+				unlock
+				break
+			fi
+			unlock
+		fi
+		sleep 1
+	done
+
+	sh -c "$5"
+	status=$?
+	rm -f "$state/$job.active" "$state/$job.running"
+	exit $status
+	;;
+
+sinfo)
+	echo "MEMORY"
+	echo "${FAKE_SLURM_MEMORY:-16000}"
+	;;
+
+*)
+	echo "Usage: $0 sbatch|squeue|scancel|sinfo [arguments]" >&2
+	exit 1
+	;;
+esac
@@ -17,6 +17,7 @@
 #include "ellipsoid.h"
 
 #include "convexhull.h"
+#include "particleruns.h"
 //#include "sphere.h"
 
 
@@ -46,6 +47,56 @@ namespace itl2
 		*/
 		virtual std::vector<double> analyze(const std::vector<POINT>& points) const = 0;
 
+		/**
+		Analyze the particle given as runs of pixels in the x-direction and return the result.
+		The default implementation converts the runs to a list of points. Analyzers that can accumulate
+		their results directly from the runs override this method.
+		*/
+		virtual std::vector<double> analyze(const ParticleRuns& runs) const
+		{
+			std::vector<POINT> points;
+			runs.toPoints(points);
+			return analyze(points);
+		}
+
+		/**
+		Tests if this analyzer can process a particle in parts.
+		Such analyzers calculate a small partial state for each part of the particle.
+		The partial states can be merged, and the final results can be calculated from the merged state
+		without access to the points of the particle.
+		*/
+		virtual bool isMergeable() const
+		{
+			return false;
+		}
+
+		/**
+		Calculates partial state of the given part of a particle.
+		Only called if isMergeable returns true.
+		*/
+		virtual std::vector<double> partialState(const ParticleRuns& runs) const
+		{
+			throw ITLException(name() + " analyzer does not support partial analysis.");
+		}
+
+		/**
+		Merges partial state of another part of the same particle to the given state.
+		Only called if isMergeable returns true.
+		*/
+		virtual void mergeState(std::vector<double>& state, const std::vector<double>& other) const
+		{
+			throw ITLException(name() + " analyzer does not support partial analysis.");
+		}
+
+		/**
+		Calculates the results from the partial state of the whole particle.
+		Only called if isMergeable returns true.
+		*/
+		virtual std::vector<double> finalize(const std::vector<double>& state) const
+		{
+			throw ITLException(name() + " analyzer does not support partial analysis.");
+		}
+
 		/**
 		Gets name of this analyzers.
 		*/
@@ -121,6 +172,78 @@ namespace itl2
 					resultLine.push_back(currentResults[m]);
 			}
 		}
+
+		/**
+		Perform analysis using all the analyzers in this vector.
+		@param particleRuns Runs of pixels in the particle.
+		@param resultLine Results will be added to this array.
+		*/
+		virtual void analyze(const ParticleRuns& particleRuns, std::vector<double>& resultLine) const
+		{
+			size_t s = std::vector<std::shared_ptr<Analyzer<POINT, pixel_t> > >::size();
+
+			if (particleRuns.empty())
+				throw ITLException("Particle analyzer received no input points.");
+
+			resultLine.reserve(s);
+			for (size_t n = 0; n < s; n++)
+			{
+				std::vector<double> currentResults = (*this)[n]->analyze(particleRuns);
+				for (size_t m = 0; m < currentResults.size(); m++)
+					resultLine.push_back(currentResults[m]);
+			}
+		}
+
+		/**
+		Tests if all the analyzers in this set can process particles in parts.
+		*/
+		bool isMergeable() const
+		{
+			for (size_t n = 0; n < this->size(); n++)
+			{
+				if (!(*this)[n]->isMergeable())
+					return false;
+			}
+			return true;
+		}
+
+		/**
+		Calculates partial states of the given part of a particle using all the analyzers in this set.
+		@param particleRuns Runs of pixels in the part of the particle.
+		@param state The partial states will be placed to this array, one array per analyzer.
+		*/
+		void partialState(const ParticleRuns& particleRuns, std::vector<std::vector<double> >& state) const
+		{
+			if (particleRuns.empty())
+				throw ITLException("Particle analyzer received no input points.");
+
+			state.resize(this->size());
+			for (size_t n = 0; n < this->size(); n++)
+				state[n] = (*this)[n]->partialState(particleRuns);
+		}
+
+		/**
+		Merges partial states of another part of the same particle to the given state.
+		*/
+		void mergeState(std::vector<std::vector<double> >& state, const std::vector<std::vector<double> >& other) const
+		{
+			for (size_t n = 0; n < this->size(); n++)
+				(*this)[n]->mergeState(state[n], other[n]);
+		}
+
+		/**
+		Calculates results of all the analyzers in this set from partial states of the whole particle.
+		@param state Partial states of the particle.
+		@param resultLine Results will be added to this array.
+		*/
+		void finalize(const std::vector<std::vector<double> >& state, std::vector<double>& resultLine) const
+		{
+			for (size_t n = 0; n < this->size(); n++)
+			{
+				std::vector<double> currentResults = (*this)[n]->finalize(state[n]);
+				resultLine.insert(resultLine.end(), currentResults.begin(), currentResults.end());
+			}
+		}
 	};
 
 
@@ -246,6 +369,46 @@ namespace itl2
 				return results;
 			}
 
+			virtual std::vector<double> analyze(const ParticleRuns& runs) const override
+			{
+				// The first point of each run is the smallest point of the run in the order defined by vecComparer.
+				Vec3sc p = runs[0].start;
+				for (const ParticleRun& run : runs)
+				{
+					if (vecComparer(run.start, p))
+						p = run.start;
+				}
+
+				std::vector<double> results;
+				results.push_back((double)p.x);
+				results.push_back((double)p.y);
+				results.push_back((double)p.z);
+				return results;
+			}
+
+			virtual bool isMergeable() const override
+			{
+				return true;
+			}
+
+			virtual std::vector<double> partialState(const ParticleRuns& runs) const override
+			{
+				return analyze(runs);
+			}
+
+			virtual void mergeState(std::vector<double>& state, const std::vector<double>& other) const override
+			{
+				Vec3d p(state[0], state[1], state[2]);
+				Vec3d q(other[0], other[1], other[2]);
+				if (vecComparer(q, p))
+					state = other;
+			}
+
+			virtual std::vector<double> finalize(const std::vector<double>& state) const override
+			{
+				return state;
+			}
+
 			virtual std::string name() const override
 			{
 				return "coordinates";
@@ -317,6 +480,33 @@ namespace itl2
 				return results;
 			}
 
+			virtual std::vector<double> analyze(const ParticleRuns& runs) const override
+			{
+				std::vector<double> results;
+				results.push_back((double)runs.pointCount());
+				return results;
+			}
+
+			virtual bool isMergeable() const override
+			{
+				return true;
+			}
+
+			virtual std::vector<double> partialState(const ParticleRuns& runs) const override
+			{
+				return analyze(runs);
+			}
+
+			virtual void mergeState(std::vector<double>& state, const std::vector<double>& other) const override
+			{
+				state[0] += other[0];
+			}
+
+			virtual std::vector<double> finalize(const std::vector<double>& state) const override
+			{
+				return state;
+			}
+
 			virtual std::string name() const override
 			{
 				return "volume";
@@ -539,6 +729,47 @@ namespace itl2
 				return results;
 			}
 
+			virtual std::vector<double> analyze(const ParticleRuns& runs) const override
+			{
+				std::vector<double> results;
+				results.push_back(0.0);
+
+				// Only the end points of the runs may touch the edges in the x-direction.
+				for (const ParticleRun& run : runs)
+				{
+					Vec3sc e = run.end();
+					if (run.start.x <= 0 || e.x >= dimensions.x - 1 ||
+						run.start.y <= 0 || run.start.y >= dimensions.y - 1 ||
+						run.start.z <= 0 || run.start.z >= dimensions.z - 1)
+					{
+						results[0] = 1.0;
+						break;
+					}
+				}
+
+				return results;
+			}
+
+			virtual bool isMergeable() const override
+			{
+				return true;
+			}
+
+			virtual std::vector<double> partialState(const ParticleRuns& runs) const override
+			{
+				return analyze(runs);
+			}
+
+			virtual void mergeState(std::vector<double>& state, const std::vector<double>& other) const override
+			{
+				state[0] = std::max(state[0], other[0]);
+			}
+
+			virtual std::vector<double> finalize(const std::vector<double>& state) const override
+			{
+				return state;
+			}
+
 			virtual std::string name() const override
 			{
 				return "isonedge";
@@ -601,9 +832,6 @@ namespace itl2
 
 			virtual std::vector<double> analyze(const std::vector<POINT>& points) const override
 			{
-				std::vector<double> results;
-
-
 				Vec3d centroid = mean<POINT, Vec3d, double>(points);
 
 				Matrix3x3d CI;
@@ -614,6 +842,67 @@ namespace itl2
 				}
 				CI /= (double)points.size();
 
+				return calculateResults(centroid, CI, [&](auto f)
+					{
+						for (size_t n = 0; n < points.size(); n++)
+							f(Vec3d(points[n]));
+					});
+			}
+
+			virtual std::vector<double> analyze(const ParticleRuns& runs) const override
+			{
+				// Calculate centroid and second moments of each run analytically.
+				Vec3d sum;
+				for (const ParticleRun& run : runs)
+				{
+					double n = run.length;
+					sum.x += n * run.start.x + n * (n - 1) / 2;
+					sum.y += n * run.start.y;
+					sum.z += n * run.start.z;
+				}
+				Vec3d centroid = sum / (double)runs.pointCount();
+
+				double xx = 0, xy = 0, xz = 0, yy = 0, yz = 0, zz = 0;
+				for (const ParticleRun& run : runs)
+				{
+					double n = run.length;
+					double dx = run.start.x + (n - 1) / 2 - centroid.x;
+					double dy = run.start.y - centroid.y;
+					double dz = run.start.z - centroid.z;
+					xx += n * dx * dx + n * (n * n - 1) / 12;
+					xy += n * dx * dy;
+					xz += n * dx * dz;
+					yy += n * dy * dy;
+					yz += n * dy * dz;
+					zz += n * dz * dz;
+				}
+				Matrix3x3d CI(xx, xy, xz,
+							  xy, yy, yz,
+							  xz, yz, zz);
+				CI /= (double)runs.pointCount();
+
+				// All the remaining quantities are maxima or minima of convex or linear functions of the points,
+				// so they are attained at the end points of the runs.
+				return calculateResults(centroid, CI, [&](auto f)
+					{
+						for (const ParticleRun& run : runs)
+						{
+							f(Vec3d(run.start));
+							if (run.length > 1)
+								f(Vec3d(run.end()));
+						}
+					});
+			}
+
+		private:
+			/**
+			Calculates the results given centroid and covariance matrix of the particle points.
+			@param forEachExtremePoint Function that calls its argument for each point where the maxima and minima of projections etc. may be attained.
+			*/
+			template<typename F> std::vector<double> calculateResults(const Vec3d& centroid, const Matrix3x3d& CI, F forEachExtremePoint) const
+			{
+				std::vector<double> results;
+
 				Vec3d t1, t2, t3;
 				double lambda1, lambda2, lambda3;
 				CI.eigsym(t1, t2, t3, lambda1, lambda2, lambda3);
@@ -670,9 +959,9 @@ namespace itl2
 				double maxd3 = 0;
 				double mind3 = 0;
 				double boundingScale = 0;
-				for(size_t n = 0; n < points.size(); n++)
+				forEachExtremePoint([&](const Vec3d& point)
 				{
-					Vec3d p = Vec3d(points[n]) - centroid;
+					Vec3d p = point - centroid;
 					double r = p.norm();
 					maxr = std::max(maxr, r);
 
@@ -695,7 +984,7 @@ namespace itl2
                         mind3 = r;
 
 
-					double f = getEllipsoidFunctionValue(Vec3d(points[n]),
+					double f = getEllipsoidFunctionValue(point,
 								centroid,
 								l1, l2, l3,
 								phi1, theta1,
@@ -704,7 +993,7 @@ namespace itl2
 					double scale = sqrt(f);
 					if(!std::isnan(scale) && !std::isinf(scale))
 						boundingScale = std::max(boundingScale, scale);
-				}
+				});
 				results.push_back(maxr);
 				results.push_back(maxd1 - mind1);
 				results.push_back(maxd2 - mind2);
@@ -976,6 +1265,50 @@ namespace itl2
 				return results;
 			}
 
+			virtual std::vector<double> analyze(const ParticleRuns& runs) const override
+			{
+				Vec3sc min = runs[0].start;
+				Vec3sc max = runs[0].end();
+				for (const ParticleRun& run : runs)
+				{
+					min = itl2::min(min, run.start);
+					max = itl2::max(max, run.end());
+				}
+
+				std::vector<double> results;
+				results.push_back((double)min.x);
+				results.push_back((double)max.x);
+				results.push_back((double)min.y);
+				results.push_back((double)max.y);
+				results.push_back((double)min.z);
+				results.push_back((double)max.z);
+				return results;
+			}
+
+			virtual bool isMergeable() const override
+			{
+				return true;
+			}
+
+			virtual std::vector<double> partialState(const ParticleRuns& runs) const override
+			{
+				return analyze(runs);
+			}
+
+			virtual void mergeState(std::vector<double>& state, const std::vector<double>& other) const override
+			{
+				for (size_t n = 0; n < state.size(); n += 2)
+				{
+					state[n] = std::min(state[n], other[n]);
+					state[n + 1] = std::max(state[n + 1], other[n + 1]);
+				}
+			}
+
+			virtual std::vector<double> finalize(const std::vector<double>& state) const override
+			{
+				return state;
+			}
+
 			virtual std::string name() const override
 			{
 				return "bounds";
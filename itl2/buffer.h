@@ -25,5 +25,14 @@ namespace itl2
 		Start and end are given as pixel indices relative to buffer start.
 		*/
 		virtual void prefetch(size_t start, size_t end) const = 0;
+
+		/**
+		Returns true if the pixels in the buffer are constructed and destructed by the image that uses the buffer.
+		Returns false if the memory is owned by someone else.
+		*/
+		virtual bool ownsData() const
+		{
+			return true;
+		}
 	};
 }
@@ -235,6 +235,8 @@ namespace itl2
 		if(img.width() != shiftMap.width() || img.height() != shiftMap.height())
 			throw ITLException("Shift map width and height do not correspond to the geometry image width and height.");
 
+		using real_t = typename NumberUtils<pixel_t>::RealFloatType;
+
 		float32_t extraShift = 0;
 		if (subtractMean)
 		{
@@ -253,10 +255,7 @@ namespace itl2
 					float32_t shift = shiftMap(x, y) + extraShift;
 
 					// Get shifted values into a buffer
-					for (coord_t z = 0; z < img.depth(); z++)
-					{
-						buffer(z) = interpolate(img, (float32_t)x, (float32_t)y, (float32_t)z - shift);
-					}
+					interpolate.interpolateRow(img, Vec3<real_t>((real_t)x, (real_t)y, -(real_t)shift), Vec3<real_t>(0, 0, 1), img.depth(), buffer.getData());
 
 					// Write back to image
 					for (coord_t z = 0; z < img.depth(); z++)
@@ -0,0 +1,111 @@
+
+#include "connectedcomponents.h"
+#include "particleanalysis.h"
+#include "floodfill.h"
+#include "conversions.h"
+#include "projections.h"
+#include "noise.h"
+#include "testutils.h"
+
+using namespace std;
+
+namespace itl2
+{
+	namespace tests
+	{
+		/**
+		Labels particles by filling them one by one in the scan order.
+		*/
+		template<typename pixel_t> void labelByFloodfill(Image<pixel_t>& image, Connectivity connectivity)
+		{
+			const pixel_t particleColor = std::numeric_limits<pixel_t>::max();
+			for (coord_t n = 0; n < image.pixelCount(); n++)
+			{
+				if (image(n) != 0)
+					image(n) = particleColor;
+			}
+
+			pixel_t particleNumber = 1;
+			for (coord_t z = 0; z < image.depth(); z++)
+			{
+				for (coord_t y = 0; y < image.height(); y++)
+				{
+					for (coord_t x = 0; x < image.width(); x++)
+					{
+						if (image(x, y, z) == particleColor)
+						{
+							floodfillSingleThreaded<pixel_t>(image, Vec3c(x, y, z), particleNumber, particleNumber, connectivity, nullptr, (std::vector<Vec3sc>*)nullptr, 0, nullptr, false);
+							particleNumber++;
+						}
+					}
+				}
+			}
+		}
+
+		void labelConnectedComponents(const Image<uint8_t>& img, Connectivity connectivity, const string& name)
+		{
+			Image<uint32_t> reference;
+			convert(img, reference);
+			labelByFloodfill(reference, connectivity);
+
+			Image<uint32_t> labels32;
+			itl2::labelConnectedComponents(img, labels32, (uint8_t)0, (uint32_t)1, connectivity, false);
+			testAssert(equals(labels32, reference), name + ", 32-bit labels, " + toString(connectivity));
+
+			Image<uint64_t> labels64;
+			itl2::labelConnectedComponents(img, labels64, (uint8_t)0, (uint64_t)1, connectivity, false);
+			testAssert(equals(labels64, reference), name + ", 64-bit labels, " + toString(connectivity));
+
+			Image<uint32_t> particles;
+			convert(img, particles);
+			labelParticles(particles, (uint32_t)0, (uint32_t)1, connectivity, false);
+			testAssert(equals(particles, reference), name + ", labelParticles, " + toString(connectivity));
+
+			// Labels are written directly into the input image when it is not 32-bit.
+			if (max(reference) < 65000)
+			{
+				Image<uint16_t> particles16;
+				convert(img, particles16);
+				labelParticles(particles16, (uint16_t)0, (uint16_t)1, connectivity, false);
+				convert(particles16, particles);
+				testAssert(equals(particles, reference), name + ", labelParticles uint16, " + toString(connectivity));
+			}
+		}
+
+		void labelConnectedComponents()
+		{
+			// Random structure near percolation threshold contains particles that cross many slab boundaries.
+			Image<uint8_t> img(80, 70, 60);
+			noise(img, 128, 40, 1);
+			for (coord_t n = 0; n < img.pixelCount(); n++)
+				img(n) = img(n) > 140 ? 1 : 0;
+
+			Image<uint8_t> img2D(300, 200);
+			noise(img2D, 128, 40, 2);
+			for (coord_t n = 0; n < img2D.pixelCount(); n++)
+				img2D(n) = img2D(n) > 128 ? 1 : 0;
+
+			// Different thread counts divide the image into different slabs.
+			int origThreads = omp_get_max_threads();
+			for (int threads : { 1, 3, 7, 16 })
+			{
+				omp_set_num_threads(threads);
+				for (Connectivity connectivity : { Connectivity::NearestNeighbours, Connectivity::AllNeighbours })
+				{
+					labelConnectedComponents(img, connectivity, "3D, " + toString(threads) + " threads");
+					labelConnectedComponents(img2D, connectivity, "2D, " + toString(threads) + " threads");
+				}
+			}
+			omp_set_num_threads(origThreads);
+
+			// Label value that equals the particle color must be skipped.
+			Image<uint8_t> small(10, 1, 1);
+			small(1) = 5;
+			small(3) = 5;
+			small(5) = 9;
+			small(7) = 5;
+			uint8_t maxLabel = labelParticles(small, (uint8_t)5, (uint8_t)4, Connectivity::NearestNeighbours, false);
+			testAssert(small(1) == 4 && small(3) == 6 && small(5) == 9 && small(7) == 7 && maxLabel == 7, "particle color is skipped in labels");
+		}
+	}
+}
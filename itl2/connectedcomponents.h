@@ -0,0 +1,488 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include "image.h"
+#include "connectivity.h"
+#include "indexforest.h"
+#include "utilities.h"
+
+namespace itl2
+{
+	namespace internals
+	{
+		/**
+		Finds root of local label in a disjoint-set forest where each root is the smallest label in its set.
+		*/
+		template<typename label_t> label_t findLocalRoot(std::vector<label_t>& parents, label_t l)
+		{
+			while (parents[l] != l)
+			{
+				parents[l] = parents[parents[l]];
+				l = parents[l];
+			}
+			return l;
+		}
+
+		/**
+		Merges sets containing local labels a and b so that the smaller root becomes the root of the merged set.
+		*/
+		template<typename label_t> void unionLocal(std::vector<label_t>& parents, label_t a, label_t b)
+		{
+			a = findLocalRoot(parents, a);
+			b = findLocalRoot(parents, b);
+			if (a < b)
+				parents[b] = a;
+			else if (b < a)
+				parents[a] = b;
+		}
+
+		/**
+		Creates list of neighbour offsets that precede the current pixel in the scan order.
+		*/
+		inline std::vector<Vec3c> backwardNeighbours(Connectivity connectivity)
+		{
+			std::vector<Vec3c> nbs;
+			if (connectivity == Connectivity::NearestNeighbours)
+			{
+				nbs.push_back(Vec3c(-1, 0, 0));
+				nbs.push_back(Vec3c(0, -1, 0));
+				nbs.push_back(Vec3c(0, 0, -1));
+			}
+			else
+			{
+				for (coord_t dz = -1; dz <= 0; dz++)
+				{
+					for (coord_t dy = -1; dy <= 1; dy++)
+					{
+						for (coord_t dx = -1; dx <= 1; dx++)
+						{
+							if (dz < 0 || (dz == 0 && dy < 0) || (dz == 0 && dy == 0 && dx < 0))
+								nbs.push_back(Vec3c(dx, dy, dz));
+						}
+					}
+				}
+			}
+			return nbs;
+		}
+
+		/**
+		Labels connected components in slab [minZ, maxZ[ of the image using a single raster scan.
+		Each foreground pixel is given the label of its first already labeled neighbour in the slab, or a new label if there are no
+		such neighbours. Equivalences between labels are recorded in the parents list.
+		Labels are stored as local label + 1, i.e. background is zero.
+		Label of pixel (x, y, z) is stored to labels(x, y, z - labelsZ).
+		*/
+		template<typename pixel_t, typename label_t> void labelSlab(const Image<pixel_t>& image, Image<label_t>& labels, coord_t labelsZ, pixel_t particleColor, const std::vector<Vec3c>& nbs, coord_t minZ, coord_t maxZ, std::vector<label_t>& parents, size_t& counter, size_t progressMax, bool showProgress)
+		{
+			const coord_t w = image.width();
+			const coord_t h = image.height();
+
+			for (coord_t z = minZ; z < maxZ; z++)
+			{
+				for (coord_t y = 0; y < h; y++)
+				{
+					for (coord_t x = 0; x < w; x++)
+					{
+						pixel_t p = image(x, y, z);
+						bool isParticle = particleColor == 0 ? p != 0 : p == particleColor;
+
+						if (!isParticle)
+						{
+							labels(x, y, z - labelsZ) = 0;
+							continue;
+						}
+
+						label_t current = 0;
+						for (const Vec3c& nb : nbs)
+						{
+							coord_t nx = x + nb.x;
+							coord_t ny = y + nb.y;
+							coord_t nz = z + nb.z;
+							if (nx >= 0 && ny >= 0 && nz >= minZ && nx < w && ny < h)
+							{
+								label_t l = labels(nx, ny, nz - labelsZ);
+								if (l != 0)
+								{
+									if (current == 0)
+										current = l;
+									else if (l != current)
+										unionLocal<label_t>(parents, current - 1, l - 1);
+								}
+							}
+						}
+
+						if (current == 0)
+						{
+							if (parents.size() >= (size_t)std::numeric_limits<label_t>::max())
+								throw ITLException("Unable to label because the label data type does not support large enough values. Consider using 64-bit labels.");
+
+							parents.push_back((label_t)parents.size());
+							current = (label_t)parents.size();
+						}
+
+						labels(x, y, z - labelsZ) = current;
+					}
+				}
+
+				showThreadProgress(counter, progressMax, showProgress);
+			}
+		}
+
+		/**
+		Converts local labels of one plane of a slab to local roots + 1 (background stays zero).
+		*/
+		template<typename label_t> void planeRoots(const Image<label_t>& labels, coord_t z, const std::vector<label_t>& parents, std::vector<label_t>& roots)
+		{
+			roots.resize(labels.width() * labels.height());
+			for (coord_t y = 0; y < labels.height(); y++)
+			{
+				for (coord_t x = 0; x < labels.width(); x++)
+				{
+					label_t l = labels(x, y, z);
+					roots[y * labels.width() + x] = l == 0 ? 0 : parents[l - 1] + 1;
+				}
+			}
+		}
+
+		/**
+		Labels connected components like labelConnectedComponents, but without storing labels for the whole image.
+		Each slab is labelled twice: first to find the label equivalences inside the slab and across the slab boundaries,
+		and then again to output the final labels. Only the labels of the slabs being processed and of the slab boundary planes are stored.
+		The output function may overwrite pixels of the image in the slab whose labels it receives.
+		@param checkCount Function checkCount(size_t count) that is called with the count of particles before any labels are output.
+		@param output Function output(x, y, z, label) that is called for each particle pixel. Labels are 1, 2, 3, ... in the same order than in labelConnectedComponents.
+		@returns Count of particles found.
+		*/
+		template<typename label_t, typename pixel_t, typename check_t, typename output_t> size_t labelConnectedComponentsInSlabs(const Image<pixel_t>& image, pixel_t particleColor, Connectivity connectivity, bool showProgress, check_t checkCount, output_t output)
+		{
+			const coord_t w = image.width();
+			const coord_t h = image.height();
+			const coord_t d = image.depth();
+
+			coord_t threadCount = 1;
+			if (!omp_in_parallel() && image.pixelCount() > PARALLELIZATION_THRESHOLD)
+				threadCount = omp_get_max_threads();
+
+			// The labels take about (threadCount / slabCount + 2 * slabCount / depth) * pixel count elements.
+			// Choose the slab count that minimizes that, but use at least one slab per thread.
+			coord_t slabCount = std::max(threadCount, (coord_t)::round(std::sqrt(threadCount * d / 2.0)));
+			slabCount = std::min(slabCount, d);
+
+			std::vector<coord_t> slabStart(slabCount + 1);
+			coord_t maxSlabDepth = 0;
+			for (coord_t t = 0; t <= slabCount; t++)
+			{
+				slabStart[t] = t * d / slabCount;
+				if (t > 0)
+					maxSlabDepth = std::max(maxSlabDepth, slabStart[t] - slabStart[t - 1]);
+			}
+
+			std::vector<Vec3c> nbs = backwardNeighbours(connectivity);
+
+			// Label each slab, and store local roots of its first and last planes.
+			std::vector<std::vector<label_t> > parents(slabCount);
+			std::vector<std::vector<label_t> > firstPlanes(slabCount);
+			std::vector<std::vector<label_t> > lastPlanes(slabCount);
+			size_t counter = 0;
+			bool failed = false;
+			std::string errorMessage;
+			#pragma omp parallel if(threadCount > 1)
+			{
+				Image<label_t> labels(w, h, maxSlabDepth);
+
+				#pragma omp for schedule(dynamic)
+				for (coord_t t = 0; t < slabCount; t++)
+				{
+					try
+					{
+						labelSlab(image, labels, slabStart[t], particleColor, nbs, slabStart[t], slabStart[t + 1], parents[t], counter, 2 * d, showProgress);
+
+						// Local labels are created in increasing order and each root is the smallest label in its set,
+						// so a single pass points every label to its root.
+						std::vector<label_t>& p = parents[t];
+						for (size_t n = 0; n < p.size(); n++)
+							p[n] = p[p[n]];
+
+						if (t > 0)
+							planeRoots(labels, 0, p, firstPlanes[t]);
+						if (t < slabCount - 1)
+							planeRoots(labels, slabStart[t + 1] - 1 - slabStart[t], p, lastPlanes[t]);
+					}
+					catch (ITLException& e)
+					{
+						#pragma omp critical(labelConnectedComponents)
+						{
+							failed = true;
+							errorMessage = e.message();
+						}
+					}
+				}
+			}
+
+			if (failed)
+				throw ITLException(errorMessage);
+
+			std::vector<size_t> offsets(slabCount + 1, 0);
+			for (coord_t t = 0; t < slabCount; t++)
+				offsets[t + 1] = offsets[t] + parents[t].size();
+
+			// Merge labels across slab boundaries.
+			IndexForest forest(offsets[slabCount]);
+			for (coord_t t = 1; t < slabCount; t++)
+			{
+				for (coord_t y = 0; y < h; y++)
+				{
+					for (coord_t x = 0; x < w; x++)
+					{
+						label_t l = firstPlanes[t][y * w + x];
+						if (l == 0)
+							continue;
+
+						for (const Vec3c& nb : nbs)
+						{
+							if (nb.z >= 0)
+								continue;
+
+							coord_t nx = x + nb.x;
+							coord_t ny = y + nb.y;
+							if (nx >= 0 && ny >= 0 && nx < w && ny < h)
+							{
+								label_t l2 = lastPlanes[t - 1][ny * w + nx];
+								if (l2 != 0)
+									forest.union_sets(offsets[t] + l - 1, offsets[t - 1] + l2 - 1);
+							}
+						}
+					}
+				}
+
+				firstPlanes[t] = std::vector<label_t>();
+				lastPlanes[t - 1] = std::vector<label_t>();
+			}
+
+			// Assign final labels in the order the local roots were created, see labelConnectedComponents.
+			std::vector<label_t> finalLabels(offsets[slabCount], 0);
+			std::vector<label_t> rootLabels(offsets[slabCount], 0);
+			size_t count = 0;
+			for (coord_t t = 0; t < slabCount; t++)
+			{
+				const std::vector<label_t>& p = parents[t];
+				for (size_t n = 0; n < p.size(); n++)
+				{
+					size_t root = forest.find_set(offsets[t] + p[n]);
+					if (rootLabels[root] == 0)
+					{
+						if (count + 1 > (size_t)std::numeric_limits<label_t>::max())
+							throw ITLException("Unable to label because the label data type does not support large enough values. Consider using 64-bit labels.");
+
+						rootLabels[root] = (label_t)(count + 1);
+						count++;
+					}
+					finalLabels[offsets[t] + n] = rootLabels[root];
+				}
+			}
+			rootLabels = std::vector<label_t>();
+
+			checkCount(count);
+
+			// Label each slab again and output the final labels.
+			// The labelling is deterministic, so the local labels are the same than in the first pass.
+			#pragma omp parallel if(threadCount > 1)
+			{
+				Image<label_t> labels(w, h, maxSlabDepth);
+				std::vector<label_t> localParents;
+
+				#pragma omp for schedule(dynamic)
+				for (coord_t t = 0; t < slabCount; t++)
+				{
+					localParents.clear();
+					labelSlab(image, labels, slabStart[t], particleColor, nbs, slabStart[t], slabStart[t + 1], localParents, counter, 2 * d, showProgress);
+
+					for (coord_t z = slabStart[t]; z < slabStart[t + 1]; z++)
+					{
+						for (coord_t y = 0; y < h; y++)
+						{
+							for (coord_t x = 0; x < w; x++)
+							{
+								label_t l = labels(x, y, z - slabStart[t]);
+								if (l != 0)
+									output(x, y, z, finalLabels[offsets[t] + l - 1]);
+							}
+						}
+					}
+				}
+			}
+
+			return count;
+		}
+	}
+
+	/**
+	Labels connected components (particles) in the image with consecutive labels.
+	The image is divided into slabs in the z-direction, and each thread labels its own slab with a raster scan and union-find.
+	Labels are then merged across slab boundaries using IndexForest.
+	The labels are numbered in the order in which the first pixel of each particle is encountered in a raster scan of the image,
+	i.e. the numbering is the same as when filling the particles one by one in the scan order.
+	If the label data type does not support large enough values to label all particles, an exception is thrown.
+	@param image Image containing the particles.
+	@param labels Image where the labels are placed. Background pixels are set to zero. Use 32- or 64-bit data type.
+	@param particleColor Color of particles. Pass zero to label all non-zero regions.
+	@param firstLabelValue Label value for the first particle encountered.
+	@param connectivity Connectivity of the particles.
+	@param showProgress Set to true to show progress information.
+	@returns Count of particles found.
+	*/
+	template<typename pixel_t, typename label_t> size_t labelConnectedComponents(const Image<pixel_t>& image, Image<label_t>& labels, pixel_t particleColor = 0, label_t firstLabelValue = 1, Connectivity connectivity = Connectivity::NearestNeighbours, bool showProgress = true)
+	{
+		static_assert(std::is_integral_v<label_t> && std::is_unsigned_v<label_t>, "Labels must be stored in unsigned integer image.");
+
+		if (firstLabelValue == 0)
+			throw ITLException("The first label value must be positive.");
+
+		labels.mustNotBe(image);
+		labels.ensureSize(image.dimensions());
+
+		const coord_t w = image.width();
+		const coord_t h = image.height();
+		const coord_t d = image.depth();
+
+		coord_t slabCount = 1;
+		if (!omp_in_parallel() && image.pixelCount() > PARALLELIZATION_THRESHOLD)
+			slabCount = std::min<coord_t>(omp_get_max_threads(), d);
+
+		std::vector<coord_t> slabStart(slabCount + 1);
+		for (coord_t t = 0; t <= slabCount; t++)
+			slabStart[t] = t * d / slabCount;
+
+		std::vector<Vec3c> nbs = internals::backwardNeighbours(connectivity);
+
+		// Label each slab separately.
+		std::vector<std::vector<label_t> > parents(slabCount);
+		size_t counter = 0;
+		bool failed = false;
+		std::string errorMessage;
+		#pragma omp parallel for if(slabCount > 1) schedule(static, 1)
+		for (coord_t t = 0; t < slabCount; t++)
+		{
+			try
+			{
+				internals::labelSlab(image, labels, 0, particleColor, nbs, slabStart[t], slabStart[t + 1], parents[t], counter, d, showProgress);
+			}
+			catch (ITLException& e)
+			{
+				#pragma omp critical(labelConnectedComponents)
+				{
+					failed = true;
+					errorMessage = e.message();
+				}
+			}
+		}
+
+		if (failed)
+			throw ITLException(errorMessage);
+
+		// Flatten local forests and calculate offset of each slab in the global label list.
+		std::vector<size_t> offsets(slabCount + 1, 0);
+		for (coord_t t = 0; t < slabCount; t++)
+		{
+			std::vector<label_t>& p = parents[t];
+			for (size_t n = 0; n < p.size(); n++)
+				p[n] = p[p[n]];
+			offsets[t + 1] = offsets[t] + p.size();
+		}
+
+		// Merge labels across slab boundaries.
+		IndexForest forest(offsets[slabCount]);
+		for (coord_t t = 1; t < slabCount; t++)
+		{
+			coord_t z = slabStart[t];
+			if (z >= slabStart[t + 1])
+				continue;
+
+			for (coord_t y = 0; y < h; y++)
+			{
+				for (coord_t x = 0; x < w; x++)
+				{
+					label_t l = labels(x, y, z);
+					if (l == 0)
+						continue;
+
+					size_t current = offsets[t] + parents[t][l - 1];
+
+					for (const Vec3c& nb : nbs)
+					{
+						if (nb.z >= 0)
+							continue;
+
+						coord_t nx = x + nb.x;
+						coord_t ny = y + nb.y;
+						coord_t nz = z + nb.z;
+						if (nx >= 0 && ny >= 0 && nx < w && ny < h)
+						{
+							label_t l2 = labels(nx, ny, nz);
+							if (l2 != 0)
+							{
+								// Slab of the neighbour, skipping empty slabs.
+								coord_t t2 = t - 1;
+								while (slabStart[t2] > nz)
+									t2--;
+								forest.union_sets(current, offsets[t2] + parents[t2][l2 - 1]);
+							}
+						}
+					}
+				}
+			}
+		}
+
+		// Assign final labels in the order the local roots were created.
+		// Local labels are created in raster scan order, so the first root encountered for each particle
+		// belongs to the first pixel of the particle.
+		std::vector<label_t> finalLabels(offsets[slabCount], 0);
+		std::vector<label_t> rootLabels(offsets[slabCount], 0);
+		size_t count = 0;
+		for (coord_t t = 0; t < slabCount; t++)
+		{
+			const std::vector<label_t>& p = parents[t];
+			for (size_t n = 0; n < p.size(); n++)
+			{
+				size_t root = forest.find_set(offsets[t] + p[n]);
+				if (rootLabels[root] == 0)
+				{
+					if ((size_t)firstLabelValue + count > (size_t)std::numeric_limits<label_t>::max() || (size_t)firstLabelValue + count < (size_t)firstLabelValue)
+						throw ITLException("Unable to label because the label data type does not support large enough values. Consider using 64-bit labels.");
+
+					rootLabels[root] = (label_t)(firstLabelValue + count);
+					count++;
+				}
+				finalLabels[offsets[t] + n] = rootLabels[root];
+			}
+		}
+
+		// Relabel.
+		#pragma omp parallel for if(slabCount > 1) schedule(static, 1)
+		for (coord_t t = 0; t < slabCount; t++)
+		{
+			for (coord_t z = slabStart[t]; z < slabStart[t + 1]; z++)
+			{
+				for (coord_t y = 0; y < h; y++)
+				{
+					for (coord_t x = 0; x < w; x++)
+					{
+						label_t& l = labels(x, y, z);
+						if (l != 0)
+							l = finalLabels[offsets[t] + l - 1];
+					}
+				}
+			}
+		}
+
+		return count;
+	}
+
+	namespace tests
+	{
+		void labelConnectedComponents();
+	}
+}
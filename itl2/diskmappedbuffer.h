@@ -5,6 +5,7 @@
 #include "buffer.h"
 #include "itlexception.h"
 #include "io/fileutils.h"
+#include "io/writebehind.h"
 #include "utilities.h"
 
 #if defined(__linux__)
@@ -106,6 +107,9 @@ namespace itl2
 			pDummy(0),
 			mappedSize(size * sizeof(T))
 		{
+			// Make sure that data written in the background by this process is in the file.
+			waitForWrites(filename);
+
     		int fd;
 		    if(!readOnly)
 		    {
@@ -257,6 +261,9 @@ namespace itl2
 			fileMappingHandle(INVALID_HANDLE_VALUE),
 			pDummy(0)
 		{
+			// Make sure that data written in the background by this process is in the file.
+			waitForWrites(filename);
+
 			try
 			{
 				// TODO: Add GetLastError messages to exception text.
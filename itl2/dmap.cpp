@@ -6,6 +6,8 @@
 #include "pointprocess.h"
 #include "projections.h"
 #include "neighbourhood.h"
+#include "noise.h"
+#include "timer.h"
 #include "testutils.h"
 
 using namespace std;
@@ -50,7 +52,95 @@ namespace itl2
 			dmap<uint32_t>("./input_data/test_piece_bin_256x256x256.raw", "./dmap/test_piece_result", "./input_data/test_piece_dmap_GT_256x256x256.raw", 0.5);
 			dmap<uint32_t>("./input_data/test_piece_bin_512x512x512.raw", "./dmap/test_piece_result", "./input_data/test_piece_dmap_GT_512x512x512.raw", 0.5);
 		}
-		
+
+		/**
+		Calculates squared distance map using the row-wise reference implementation.
+		*/
+		template<typename dmap_t> void distanceTransform2Rows(Image<dmap_t>& img, Image<Vec3c>* nearestObjectPoint)
+		{
+			if (nearestObjectPoint)
+				internals::prepareNearestObjectPoint(img, *nearestObjectPoint);
+
+			for (size_t n = 0; n < img.dimensionality(); n++)
+				internals::processDimensionRows(img, n, nearestObjectPoint);
+		}
+
+		template<typename dmap_t> void dmapTiled(const Image<uint8_t>& geom, const string& name)
+		{
+			Image<dmap_t> ref, tiled;
+			Image<Vec3c> refPoints, tiledPoints;
+
+			prepareDistanceTransform(geom, ref);
+			distanceTransform2Rows(ref, &refPoints);
+
+			distanceTransform2(geom, tiled, &tiledPoints);
+
+			testAssert(equals(ref, tiled), "tiled distance map, " + name + ", " + toString(imageDataType<dmap_t>()));
+			testAssert(equals(refPoints, tiledPoints), "tiled nearest object points, " + name + ", " + toString(imageDataType<dmap_t>()));
+
+			prepareDistanceTransform(geom, ref);
+			distanceTransform2Rows(ref, nullptr);
+
+			distanceTransform2(geom, tiled);
+
+			testAssert(equals(ref, tiled), "tiled distance map without nearest points, " + name + ", " + toString(imageDataType<dmap_t>()));
+		}
+
+		void dmapTiled()
+		{
+			// Width is not a multiple of tile width.
+			Image<uint8_t> geom(77, 65, 43);
+			noise(geom, 128, 40, 1);
+			threshold(geom, 60);
+
+			Image<uint8_t> geom2D(150, 101);
+			noise(geom2D, 128, 40, 2);
+			threshold(geom2D, 60);
+
+			dmapTiled<float32_t>(geom, "3D");
+			dmapTiled<uint32_t>(geom, "3D");
+			dmapTiled<int32_t>(geom, "3D");
+			dmapTiled<float32_t>(geom2D, "2D");
+			dmapTiled<uint32_t>(geom2D, "2D");
+		}
+
+		void dmapTiledSpeed(const Image<uint8_t>& geom, bool nearest)
+		{
+			Image<float32_t> ref, tiled;
+			Image<Vec3c> refPoints, tiledPoints;
+			Timer timer;
+
+			prepareDistanceTransform(geom, ref);
+			timer.start();
+			distanceTransform2Rows(ref, nearest ? &refPoints : nullptr);
+			timer.stop();
+			cout << "Row-wise distance map of " << geom.dimensions() << " image" << (nearest ? " with nearest points" : "") << " takes " << timer.getSeconds() << " s" << endl;
+
+			prepareDistanceTransform(geom, tiled);
+			timer.start();
+			distanceTransform2(tiled, nearest ? &tiledPoints : nullptr);
+			timer.stop();
+			cout << "Tiled distance map of " << geom.dimensions() << " image" << (nearest ? " with nearest points" : "") << " takes " << timer.getSeconds() << " s" << endl;
+
+			testAssert(equals(ref, tiled), "tiled and row-wise distance maps");
+			if (nearest)
+				testAssert(equals(refPoints, tiledPoints), "tiled and row-wise nearest object points");
+		}
+
+		void dmapTiledSpeed()
+		{
+			Image<uint8_t> geom(512, 512, 512);
+			noise(geom, 128, 40, 1);
+			threshold(geom, 30);
+			dmapTiledSpeed(geom, false);
+
+			// Nearest object point images are big, so use smaller image.
+			Image<uint8_t> geomSmall(256, 256, 256);
+			noise(geomSmall, 128, 40, 2);
+			threshold(geomSmall, 30);
+			dmapTiledSpeed(geomSmall, true);
+		}
+
 	}
 
 }
\ No newline at end of file
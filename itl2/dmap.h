@@ -236,7 +236,12 @@ namespace itl2
 		}
 
 
-		template<typename pixel_t>  void processDimension(Image<pixel_t>& output, size_t currentDimension, Image<Vec3c>* nearestObjectPoint, bool showProgressInfo = false)
+		/*
+		Reference implementation of distance map processing in one dimension.
+		Processes each row directly in the image, so rows in y- and z-directions are accessed with large stride.
+		See also processDimension.
+		*/
+		template<typename pixel_t>  void processDimensionRows(Image<pixel_t>& output, size_t currentDimension, Image<Vec3c>* nearestObjectPoint, bool showProgressInfo = false)
 		{
 			// Determine count of pixels to process
 			Vec3c reducedDimensions = output.dimensions();
@@ -290,6 +295,278 @@ namespace itl2
 				throw error;
 		}
 
+		/*
+		Helper for distance map calculation.
+		Processes one contiguous row of nd pixels.
+		Optimized version that does not store nearest object point for each dmap point.
+		g and h are temporary buffers whose size must be nd.
+		*/
+		template<typename pixel_t> void voronoiRow(pixel_t* row, coord_t nd, pixel_t* g, pixel_t* h)
+		{
+			using signed_t = typename NumberUtils<pixel_t>::SignedType;
+
+			coord_t l = -1;
+
+			for (coord_t i = 0; i < nd; i++)
+			{
+				pixel_t di = row[i];
+				pixel_t iw = static_cast<pixel_t>(i);
+
+				if (di < std::numeric_limits<pixel_t>::max())
+				{
+					while ((l >= 1) && remove(g[l - 1], g[l], di, h[l - 1], h[l], iw))
+						l--;
+					l++;
+					g[l] = di;
+					h[l] = iw;
+				}
+			}
+
+			if (l == -1)
+				return;
+
+			coord_t ns = l;
+
+			l = 0;
+
+			for (coord_t i = 0; i < nd; i++)
+			{
+				pixel_t iw = static_cast<pixel_t>(i);
+
+				pixel_t d1 = calcD<pixel_t, signed_t>(g[l], h[l], iw);
+
+				while (l < ns)
+				{
+					// be sure to compute d2 *only* if l < ns
+					pixel_t d2 = calcD<pixel_t, signed_t>(g[l + 1], h[l + 1], iw);
+
+					// then compare d1 and d2
+					if (d1 <= d2)
+						break;
+
+					l++;
+					d1 = d2;
+				}
+
+				row[i] = d1;
+			}
+		}
+
+		/*
+		Helper for distance map calculation.
+		Processes one contiguous row of nd pixels.
+		Fills also nearest row by locations of nearest object point for each dmap point.
+		g, P, and h are temporary buffers whose size must be nd.
+		*/
+		template<typename pixel_t> void voronoiRow(pixel_t* row, Vec3c* nearest, coord_t nd, pixel_t* g, Vec3c* P, pixel_t* h)
+		{
+			using signed_t = typename NumberUtils<pixel_t>::SignedType;
+
+			coord_t l = -1;
+
+			for (coord_t i = 0; i < nd; i++)
+			{
+				pixel_t di = row[i];
+				pixel_t iw = static_cast<pixel_t>(i);
+
+				if (di < std::numeric_limits<pixel_t>::max())
+				{
+					while ((l >= 1) && remove(g[l - 1], g[l], di, h[l - 1], h[l], iw))
+						l--;
+					l++;
+					g[l] = di;
+					h[l] = iw;
+					P[l] = nearest[i];
+				}
+			}
+
+			if (l == -1)
+				return;
+
+			coord_t ns = l;
+
+			l = 0;
+
+			for (coord_t i = 0; i < nd; i++)
+			{
+				pixel_t iw = static_cast<pixel_t>(i);
+
+				pixel_t d1 = calcD<pixel_t, signed_t>(g[l], h[l], iw);
+				Vec3c Pc = P[l];
+
+				while (l < ns)
+				{
+					// be sure to compute d2 *only* if l < ns
+					pixel_t d2 = calcD<pixel_t, signed_t>(g[l + 1], h[l + 1], iw);
+
+					// then compare d1 and d2
+					if (d1 <= d2)
+						break;
+
+					l++;
+					d1 = d2;
+					Pc = P[l];
+				}
+
+				row[i] = d1;
+				nearest[i] = Pc;
+			}
+		}
+
+		/*
+		Count of adjacent rows that are processed together in y- and z-directions in processDimension.
+		*/
+		constexpr coord_t DISTANCE_MAP_TILE_WIDTH = 32;
+
+		/*
+		Copies a bundle of count rows, starting from adjacent x-positions, from strided image data to a contiguous tile,
+		where row b occupies elements [b * nd, (b + 1) * nd[.
+		*/
+		template<typename T> void gatherTile(const T* src, coord_t stride, coord_t nd, coord_t count, T* tile)
+		{
+			for (coord_t i = 0; i < nd; i++)
+			{
+				const T* line = src + i * stride;
+				for (coord_t b = 0; b < count; b++)
+					tile[b * nd + i] = line[b];
+			}
+		}
+
+		/*
+		Inverse of gatherTile.
+		*/
+		template<typename T> void scatterTile(const T* tile, coord_t stride, coord_t nd, coord_t count, T* dst)
+		{
+			for (coord_t i = 0; i < nd; i++)
+			{
+				T* line = dst + i * stride;
+				for (coord_t b = 0; b < count; b++)
+					line[b] = tile[b * nd + i];
+			}
+		}
+
+		/*
+		Processes one dimension of the distance map calculation.
+		Rows in the x-direction are contiguous in memory and they are processed in-place.
+		In y- and z-directions, bundles of DISTANCE_MAP_TILE_WIDTH rows starting from adjacent x-positions are
+		copied to a contiguous tile, processed there, and copied back. This way each cache line of the image
+		is read and written only once per bundle instead of once per row.
+		The result is the same as that of processDimensionRows.
+		*/
+		template<typename pixel_t>  void processDimension(Image<pixel_t>& output, size_t currentDimension, Image<Vec3c>* nearestObjectPoint, bool showProgressInfo = false)
+		{
+			coord_t nd = output.dimension(currentDimension);
+			coord_t stride = currentDimension == 0 ? 1 : (currentDimension == 1 ? output.width() : output.width() * output.height());
+			coord_t tileWidth = currentDimension == 0 ? 1 : DISTANCE_MAP_TILE_WIDTH;
+
+			// Tiles are indexed by (x-bundle, y, z), where the coordinate in the current dimension is dropped.
+			Vec3c tileDimensions = output.dimensions();
+			tileDimensions[currentDimension] = 1;
+			if (currentDimension != 0)
+				tileDimensions.x = (output.width() + tileWidth - 1) / tileWidth;
+			coord_t tileCount = tileDimensions.x * tileDimensions.y * tileDimensions.z;
+
+			pixel_t* data = output.getData();
+			Vec3c* nearestData = nearestObjectPoint ? nearestObjectPoint->getData() : nullptr;
+
+			bool failed = false;
+			ITLException error("");
+			size_t counter = 0;
+			#pragma omp parallel if(!omp_in_parallel() && output.pixelCount() > PARALLELIZATION_THRESHOLD)
+			{
+				// Temporary buffers
+				std::vector<pixel_t> g(nd);
+				std::vector<pixel_t> h(nd);
+				std::vector<Vec3c> P;
+				std::vector<pixel_t> tile;
+				std::vector<Vec3c> nearestTile;
+				if (nearestObjectPoint)
+					P.resize(nd);
+				if (currentDimension != 0)
+				{
+					tile.resize(nd * tileWidth);
+					if (nearestObjectPoint)
+						nearestTile.resize(nd * tileWidth);
+				}
+
+				#pragma omp for schedule(dynamic)
+				for (coord_t n = 0; n < tileCount; n++)
+				{
+					if (!failed)
+					{
+						try
+						{
+							Vec3c t = indexToCoords(n, tileDimensions);
+							Vec3c start(t.x * tileWidth, t.y, t.z);
+							size_t startIndex = output.getLinearIndex(start);
+
+							if (currentDimension == 0)
+							{
+								if (!nearestObjectPoint)
+									voronoiRow(data + startIndex, nd, g.data(), h.data());
+								else
+									voronoiRow(data + startIndex, nearestData + startIndex, nd, g.data(), P.data(), h.data());
+							}
+							else
+							{
+								coord_t count = std::min(tileWidth, output.width() - start.x);
+
+								gatherTile(data + startIndex, stride, nd, count, tile.data());
+								if (nearestObjectPoint)
+									gatherTile(nearestData + startIndex, stride, nd, count, nearestTile.data());
+
+								for (coord_t b = 0; b < count; b++)
+								{
+									if (!nearestObjectPoint)
+										voronoiRow(tile.data() + b * nd, nd, g.data(), h.data());
+									else
+										voronoiRow(tile.data() + b * nd, nearestTile.data() + b * nd, nd, g.data(), P.data(), h.data());
+								}
+
+								scatterTile(tile.data(), stride, nd, count, data + startIndex);
+								if (nearestObjectPoint)
+									scatterTile(nearestTile.data(), stride, nd, count, nearestData + startIndex);
+							}
+						}
+						catch (ITLException ex)
+						{
+							#pragma omp critical(processDimensionError)
+							{
+								error = ex;
+								failed = true;
+							}
+						}
+					}
+					showThreadProgress(counter, tileCount, showProgressInfo);
+				}
+			}
+
+			if (failed)
+				throw error;
+		}
+
+		/*
+		Initializes nearest object point image for distance map calculation.
+		*/
+		template<typename pixel_t> void prepareNearestObjectPoint(const Image<pixel_t>& img, Image<Vec3c>& nearestObjectPoint)
+		{
+			nearestObjectPoint.ensureSize(img);
+
+			// Init each nearest point to point to itself if the point is in zero-distance set,
+			// and to point to nothing if the point is outside the zero-distance set.
+			for (coord_t z = 0; z < img.depth(); z++)
+			{
+				for (coord_t y = 0; y < img.height(); y++)
+				{
+					for (coord_t x = 0; x < img.width(); x++)
+					{
+						if(img(x, y, z) == 0)
+							nearestObjectPoint(x, y, z) = Vec3c(x, y, z);
+					}
+				}
+			}
+		}
+
 	//	inline void processDimension(Image<float32_t>& output, size_t currentDimension, Image<Vec3c>* nearestObjectPoint)
 	//	{
 	//		// compute the number of rows first, so we can setup a progress reporter
@@ -372,23 +649,7 @@ namespace itl2
 	template<typename pixel_t> void distanceTransform2(Image<pixel_t>& img, Image<Vec3c>* nearestObjectPoint = 0)
 	{
 		if (nearestObjectPoint)
-		{
-			nearestObjectPoint->ensureSize(img);
-
-			// Init each nearest point to point to itself if the point is in zero-distance set,
-			// and to point to nothing if the point is outside the zero-distance set.
-			for (coord_t z = 0; z < img.depth(); z++)
-			{
-				for (coord_t y = 0; y < img.height(); y++)
-				{
-					for (coord_t x = 0; x < img.width(); x++)
-					{
-						if(img(x, y, z) == 0)
-							(*nearestObjectPoint)(x, y, z) = Vec3c(x, y, z);
-					}
-				}
-			}
-		}
+			internals::prepareNearestObjectPoint(img, *nearestObjectPoint);
 
 		for (size_t n = 0; n < img.dimensionality(); n++)
 		{
@@ -457,6 +718,8 @@ namespace itl2
 	namespace tests
 	{
 		void dmap1();
+		void dmapTiled();
+		void dmapTiledSpeed();
 	}
 
 }
@@ -7,6 +7,7 @@
 #include "image.h"
 #include "exprtk/exprtk.hpp"
 #include "iteration.h"
+#include "evalplan.h"
 
 namespace itl2
 {
@@ -42,6 +43,64 @@ namespace itl2
 		}
 	}
 
+	namespace internals
+	{
+		/**
+		Evaluates expression separately for each pixel using exprtk.
+		*/
+		template<typename target_t> void evalExprtk(const std::string& expression, Image<target_t>& target, const std::vector<ImageBase*>& params)
+		{
+			#pragma omp parallel if(target.pixelCount() > PARALLELIZATION_THRESHOLD)
+			{
+				// Parse again to make separate expression object for each thread.
+				std::vector<double> varValues;
+				auto [symbols, expr] = internals::parse(expression, params, varValues);
+
+				#pragma omp for
+				for (coord_t n = 0; n < target.pixelCount(); n++)
+				{
+					for (size_t m = 0; m < params.size(); m++)
+						varValues[m] = params[m]->getf(n);
+
+					double result = expr.value();
+					target(n) = pixelRound<target_t>(result);
+				}
+			}
+		}
+
+		/**
+		Evaluates expression using the given evaluation plan.
+		*/
+		template<typename value_t, typename target_t> void evalPlan(const EvalPlan& plan, Image<target_t>& target)
+		{
+			coord_t chunkCount = (target.pixelCount() + EVAL_CHUNK_SIZE - 1) / EVAL_CHUNK_SIZE;
+
+			#pragma omp parallel if(target.pixelCount() > PARALLELIZATION_THRESHOLD)
+			{
+				std::vector<std::vector<value_t> > registers = plan.createRegisters<value_t>();
+
+				#pragma omp for
+				for (coord_t chunk = 0; chunk < chunkCount; chunk++)
+				{
+					coord_t start = chunk * EVAL_CHUNK_SIZE;
+					coord_t count = std::min(EVAL_CHUNK_SIZE, target.pixelCount() - start);
+
+					const value_t* result = plan.evaluate<value_t>(start, count, registers);
+
+					target_t* out = target.getData() + start;
+					for (coord_t i = 0; i < count; i++)
+					{
+						// Integer values can be converted directly as the result is the same than through double.
+						if constexpr (std::is_integral_v<value_t>)
+							out[i] = pixelRound<target_t>(result[i]);
+						else
+							out[i] = pixelRound<target_t>((double)result[i]);
+					}
+				}
+			}
+		}
+	}
+
 	/**
 	Evaluates mathematical expression, given as a string, on each pixel of the target and the argument images.
 	The result is assigned into the corresponding pixel of the target image.
@@ -59,22 +118,20 @@ namespace itl2
 			target.checkSize(*params[n]);
 		}
 
-		#pragma omp parallel if(target.pixelCount() > PARALLELIZATION_THRESHOLD)
+		// Use typed, vectorized evaluation if the expression permits; otherwise evaluate each pixel with exprtk.
+		std::unique_ptr<internals::EvalPlan> plan = internals::EvalPlan::compile(expression, params);
+		if (plan)
 		{
-			// Parse again to make separate expression object for each thread.
-			std::vector<double> varValues;
-			auto [symbols, expr] = internals::parse(expression, params, varValues);
-
-			#pragma omp for
-			for (coord_t n = 0; n < target.pixelCount(); n++)
+			switch (plan->valueType())
 			{
-				for (size_t m = 0; m < params.size(); m++)
-					varValues[m] = params[m]->getf(n);
-
-				double result = expr.value();
-				target(n) = pixelRound<target_t>(result);
+			case internals::EvalValueType::Int32: internals::evalPlan<int32_t>(*plan, target); break;
+			case internals::EvalValueType::Float32: internals::evalPlan<float32_t>(*plan, target); break;
+			case internals::EvalValueType::Float64: internals::evalPlan<double>(*plan, target); break;
 			}
+			return;
 		}
+
+		internals::evalExprtk(expression, target, params);
 	}
 
 	namespace tests
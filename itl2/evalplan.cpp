@@ -0,0 +1,1094 @@
+
+#include "evalplan.h"
+#include "eval.h"
+#include "timer.h"
+#include "testutils.h"
+
+#include <cmath>
+#include <limits>
+#include <cctype>
+#include <random>
+
+using namespace std;
+
+namespace itl2
+{
+	namespace internals
+	{
+		/**
+		Operations supported by EvalPlan.
+		*/
+		enum class EvalOp
+		{
+			Constant,
+			Variable,
+			Negate,
+			Not,
+			Abs,
+			Floor,
+			Ceil,
+			Sqrt,
+			Add,
+			Subtract,
+			Multiply,
+			Divide,
+			Modulus,
+			Less,
+			LessEqual,
+			Greater,
+			GreaterEqual,
+			Equal,
+			NotEqual,
+			And,
+			Or,
+			Min,
+			Max,
+			If
+		};
+
+		struct EvalNode
+		{
+			EvalOp op = EvalOp::Constant;
+
+			/**
+			Indices of argument nodes.
+			*/
+			vector<size_t> args;
+
+			/**
+			Parameter image index for Variable nodes.
+			*/
+			size_t variable = 0;
+
+			/**
+			Location of the node in the expression string.
+			*/
+			size_t begin = 0;
+			size_t end = 0;
+
+			/**
+			Indicates if the value of this node does not depend on the pixel values.
+			*/
+			bool isConstant = false;
+
+			/**
+			Value of constant nodes.
+			*/
+			double value = 0;
+
+			/**
+			All possible values of this node are in range [minValue, maxValue].
+			*/
+			double minValue = -numeric_limits<double>::infinity();
+			double maxValue = numeric_limits<double>::infinity();
+
+			/**
+			Indicates if all possible values of this node are integers.
+			*/
+			bool isInteger = false;
+
+			/**
+			Indicates if all possible values of this node are exactly representable as float32_t.
+			*/
+			bool isFloatExact = false;
+
+			/**
+			Index of the register where the value of this node is stored.
+			*/
+			size_t reg = 0;
+		};
+
+		/**
+		Recursive descent parser that builds EvalNode tree from an expression string.
+		The operator precedence levels are the same than in exprtk.
+		All parse functions return INVALID_NODE if the expression contains something that is not supported.
+		*/
+		class EvalParser
+		{
+		private:
+			static constexpr size_t INVALID_NODE = numeric_limits<size_t>::max();
+
+			enum class TokenType
+			{
+				Number,
+				Identifier,
+				Operator,
+				End
+			};
+
+			struct Token
+			{
+				TokenType type;
+				string text;
+				size_t begin;
+				size_t end;
+			};
+
+			const string& expression;
+			size_t paramCount;
+			vector<Token> tokens;
+			size_t pos = 0;
+
+		public:
+			vector<EvalNode> nodes;
+
+			EvalParser(const string& expression, size_t paramCount) : expression(expression), paramCount(paramCount)
+			{
+			}
+
+			/**
+			Splits the expression into tokens.
+			@return False if the expression contains unsupported characters.
+			*/
+			bool tokenize()
+			{
+				size_t i = 0;
+				while (i < expression.length())
+				{
+					char c = expression[i];
+					if (isspace((unsigned char)c))
+					{
+						i++;
+					}
+					else if (isdigit((unsigned char)c) || c == '.')
+					{
+						size_t start = i;
+						while (i < expression.length() && (isdigit((unsigned char)expression[i]) || expression[i] == '.'))
+							i++;
+						if (i < expression.length() && (expression[i] == 'e' || expression[i] == 'E'))
+						{
+							i++;
+							if (i < expression.length() && (expression[i] == '+' || expression[i] == '-'))
+								i++;
+							while (i < expression.length() && isdigit((unsigned char)expression[i]))
+								i++;
+						}
+
+						// Implicit multiplication, e.g. 2x0, is not supported.
+						if (i < expression.length() && (isalnum((unsigned char)expression[i]) || expression[i] == '_' || expression[i] == '.' || expression[i] == '('))
+							return false;
+
+						tokens.push_back({ TokenType::Number, expression.substr(start, i - start), start, i });
+					}
+					else if (isalpha((unsigned char)c) || c == '_')
+					{
+						size_t start = i;
+						while (i < expression.length() && (isalnum((unsigned char)expression[i]) || expression[i] == '_'))
+							i++;
+						string name = expression.substr(start, i - start);
+						toLower(name);
+						tokens.push_back({ TokenType::Identifier, name, start, i });
+					}
+					else
+					{
+						static const vector<string> operators = { "<=", ">=", "==", "!=", "<>", "+", "-", "*", "/", "%", "<", ">", "=", "(", ")", "," };
+						bool found = false;
+						for (const string& op : operators)
+						{
+							if (expression.compare(i, op.length(), op) == 0)
+							{
+								tokens.push_back({ TokenType::Operator, op, i, i + op.length() });
+								i += op.length();
+								found = true;
+								break;
+							}
+						}
+
+						if (!found)
+							return false;
+					}
+				}
+
+				tokens.push_back({ TokenType::End, "", expression.length(), expression.length() });
+				return true;
+			}
+
+			/**
+			Parses the whole expression.
+			*/
+			size_t parse()
+			{
+				size_t root = parseExpression(0);
+				if (root == INVALID_NODE || tokens[pos].type != TokenType::End)
+					return INVALID_NODE;
+				return root;
+			}
+
+		private:
+			size_t addNode(EvalOp op, const vector<size_t>& args, size_t begin, size_t end)
+			{
+				EvalNode node;
+				node.op = op;
+				node.args = args;
+				node.begin = begin;
+				node.end = end;
+				nodes.push_back(node);
+				return nodes.size() - 1;
+			}
+
+			/**
+			Gets the binary operation corresponding to the current token, and its left and right precedence levels.
+			@return False if the current token is not a binary operator.
+			*/
+			bool binaryOperation(EvalOp& op, int& left, int& right) const
+			{
+				const Token& t = tokens[pos];
+				if (t.type == TokenType::Identifier)
+				{
+					if (t.text == "or") { op = EvalOp::Or; left = 1; right = 2; return true; }
+					if (t.text == "and") { op = EvalOp::And; left = 3; right = 4; return true; }
+					return false;
+				}
+
+				if (t.type != TokenType::Operator)
+					return false;
+
+				if (t.text == "<") { op = EvalOp::Less; left = 5; right = 6; return true; }
+				if (t.text == "<=") { op = EvalOp::LessEqual; left = 5; right = 6; return true; }
+				if (t.text == ">") { op = EvalOp::Greater; left = 5; right = 6; return true; }
+				if (t.text == ">=") { op = EvalOp::GreaterEqual; left = 5; right = 6; return true; }
+				if (t.text == "==" || t.text == "=") { op = EvalOp::Equal; left = 5; right = 6; return true; }
+				if (t.text == "!=" || t.text == "<>") { op = EvalOp::NotEqual; left = 5; right = 6; return true; }
+				if (t.text == "+") { op = EvalOp::Add; left = 7; right = 8; return true; }
+				if (t.text == "-") { op = EvalOp::Subtract; left = 7; right = 8; return true; }
+				if (t.text == "*") { op = EvalOp::Multiply; left = 10; right = 11; return true; }
+				if (t.text == "/") { op = EvalOp::Divide; left = 10; right = 11; return true; }
+				if (t.text == "%") { op = EvalOp::Modulus; left = 10; right = 11; return true; }
+				return false;
+			}
+
+			size_t parseExpression(int precedence)
+			{
+				size_t left = parseBranch();
+				if (left == INVALID_NODE)
+					return INVALID_NODE;
+
+				while (true)
+				{
+					EvalOp op;
+					int leftPrecedence, rightPrecedence;
+					if (!binaryOperation(op, leftPrecedence, rightPrecedence) || leftPrecedence < precedence)
+						break;
+
+					pos++;
+					size_t right = parseExpression(rightPrecedence);
+					if (right == INVALID_NODE)
+						return INVALID_NODE;
+
+					left = addNode(op, { left, right }, nodes[left].begin, nodes[right].end);
+				}
+
+				return left;
+			}
+
+			bool isOperator(const string& op) const
+			{
+				return tokens[pos].type == TokenType::Operator && tokens[pos].text == op;
+			}
+
+			size_t parseBranch()
+			{
+				const Token t = tokens[pos];
+
+				if (t.type == TokenType::Number)
+				{
+					pos++;
+					size_t node = addNode(EvalOp::Constant, {}, t.begin, t.end);
+					nodes[node].isConstant = true;
+					return node;
+				}
+
+				if (isOperator("("))
+				{
+					pos++;
+					size_t node = parseExpression(0);
+					if (node == INVALID_NODE || !isOperator(")"))
+						return INVALID_NODE;
+
+					// Include the parentheses so that the location can be used to evaluate the node separately.
+					nodes[node].begin = t.begin;
+					nodes[node].end = tokens[pos].end;
+					pos++;
+					return node;
+				}
+
+				if (isOperator("-"))
+				{
+					pos++;
+					size_t arg = parseExpression(11);
+					if (arg == INVALID_NODE)
+						return INVALID_NODE;
+					return addNode(EvalOp::Negate, { arg }, t.begin, nodes[arg].end);
+				}
+
+				if (isOperator("+"))
+				{
+					pos++;
+					return parseExpression(13);
+				}
+
+				if (t.type == TokenType::Identifier)
+				{
+					pos++;
+
+					if (t.text == "pi" || t.text == "epsilon" || t.text == "inf")
+					{
+						size_t node = addNode(EvalOp::Constant, {}, t.begin, t.end);
+						nodes[node].isConstant = true;
+						return node;
+					}
+
+					if (t.text.length() > 1 && t.text[0] == 'x')
+					{
+						for (size_t n = 0; n < paramCount; n++)
+						{
+							if (t.text == "x" + itl2::toString(n))
+							{
+								size_t node = addNode(EvalOp::Variable, {}, t.begin, t.end);
+								nodes[node].variable = n;
+								return node;
+							}
+						}
+						return INVALID_NODE;
+					}
+
+					EvalOp op;
+					size_t argCount;
+					if (t.text == "min") { op = EvalOp::Min; argCount = 2; }
+					else if (t.text == "max") { op = EvalOp::Max; argCount = 2; }
+					else if (t.text == "if") { op = EvalOp::If; argCount = 3; }
+					else if (t.text == "abs") { op = EvalOp::Abs; argCount = 1; }
+					else if (t.text == "floor") { op = EvalOp::Floor; argCount = 1; }
+					else if (t.text == "ceil") { op = EvalOp::Ceil; argCount = 1; }
+					else if (t.text == "sqrt") { op = EvalOp::Sqrt; argCount = 1; }
+					else if (t.text == "not") { op = EvalOp::Not; argCount = 1; }
+					else return INVALID_NODE;
+
+					if (!isOperator("("))
+						return INVALID_NODE;
+					pos++;
+
+					vector<size_t> args;
+					while (true)
+					{
+						size_t arg = parseExpression(0);
+						if (arg == INVALID_NODE)
+							return INVALID_NODE;
+						args.push_back(arg);
+
+						if (isOperator(","))
+						{
+							pos++;
+						}
+						else if (isOperator(")"))
+						{
+							break;
+						}
+						else
+						{
+							return INVALID_NODE;
+						}
+					}
+
+					if (args.size() != argCount)
+						return INVALID_NODE;
+
+					size_t end = tokens[pos].end;
+					pos++;
+					return addNode(op, args, t.begin, end);
+				}
+
+				return INVALID_NODE;
+			}
+		};
+
+		/**
+		Evaluates constant expression using exprtk.
+		*/
+		static double evaluateConstant(const string& expression)
+		{
+			symbol_table_t symbols;
+			symbols.add_constants();
+			expression_t expr;
+			expr.register_symbol_table(symbols);
+			parser_t parser;
+			if (!parser.compile(expression, expr))
+				throw ITLException(string("Unable to parse expression: ") + parser.error());
+			return expr.value();
+		}
+
+		static bool isIntegral(double v)
+		{
+			return std::isfinite(v) && std::floor(v) == v;
+		}
+
+		static bool isFloatExact(double v)
+		{
+			return std::isnan(v) || (double)(float32_t)v == v;
+		}
+
+		/**
+		Determines range and exactness of the values of the given non-constant node from its arguments.
+		*/
+		static void analyze(EvalNode& node, const vector<EvalNode>& nodes, const vector<ImageBase*>& params)
+		{
+			const double inf = numeric_limits<double>::infinity();
+
+			auto setRange = [&](double minValue, double maxValue, bool isInteger, bool isFloatExact)
+			{
+				node.minValue = minValue;
+				node.maxValue = maxValue;
+				node.isInteger = isInteger;
+				node.isFloatExact = isFloatExact;
+			};
+
+			auto arg = [&](size_t n) -> const EvalNode&
+			{
+				return nodes[node.args[n]];
+			};
+
+			switch (node.op)
+			{
+			case EvalOp::Variable:
+				switch (params[node.variable]->dataType())
+				{
+				case ImageDataType::UInt8: setRange(0, numeric_limits<uint8_t>::max(), true, true); break;
+				case ImageDataType::UInt16: setRange(0, numeric_limits<uint16_t>::max(), true, true); break;
+				case ImageDataType::UInt32: setRange(0, numeric_limits<uint32_t>::max(), true, false); break;
+				case ImageDataType::UInt64: setRange(0, (double)numeric_limits<uint64_t>::max(), true, false); break;
+				case ImageDataType::Int8: setRange(numeric_limits<int8_t>::lowest(), numeric_limits<int8_t>::max(), true, true); break;
+				case ImageDataType::Int16: setRange(numeric_limits<int16_t>::lowest(), numeric_limits<int16_t>::max(), true, true); break;
+				case ImageDataType::Int32: setRange(numeric_limits<int32_t>::lowest(), numeric_limits<int32_t>::max(), true, false); break;
+				case ImageDataType::Int64: setRange((double)numeric_limits<int64_t>::lowest(), (double)numeric_limits<int64_t>::max(), true, false); break;
+				case ImageDataType::Float32: setRange(-inf, inf, false, true); break;
+				default: throw logic_error("Unsupported parameter image data type in eval plan.");
+				}
+				break;
+			case EvalOp::Negate:
+				setRange(-arg(0).maxValue, -arg(0).minValue, arg(0).isInteger, arg(0).isFloatExact);
+				break;
+			case EvalOp::Abs:
+				setRange(arg(0).minValue >= 0 ? arg(0).minValue : 0, std::max(std::abs(arg(0).minValue), std::abs(arg(0).maxValue)), arg(0).isInteger, arg(0).isFloatExact);
+				break;
+			case EvalOp::Floor:
+			case EvalOp::Ceil:
+				if (arg(0).isInteger)
+					setRange(arg(0).minValue, arg(0).maxValue, true, arg(0).isFloatExact);
+				else
+					setRange(-inf, inf, false, arg(0).isFloatExact);
+				break;
+			case EvalOp::Sqrt:
+			case EvalOp::Divide:
+			case EvalOp::Modulus:
+				setRange(-inf, inf, false, false);
+				break;
+			case EvalOp::Add:
+			case EvalOp::Subtract:
+			case EvalOp::Multiply:
+				if (arg(0).isInteger && arg(1).isInteger)
+				{
+					double a0 = arg(0).minValue, a1 = arg(0).maxValue;
+					double b0 = arg(1).minValue, b1 = arg(1).maxValue;
+					if (node.op == EvalOp::Add)
+					{
+						setRange(a0 + b0, a1 + b1, true, false);
+					}
+					else if (node.op == EvalOp::Subtract)
+					{
+						setRange(a0 - b1, a1 - b0, true, false);
+					}
+					else
+					{
+						double p[] = { a0 * b0, a0 * b1, a1 * b0, a1 * b1 };
+						setRange(*std::min_element(p, p + 4), *std::max_element(p, p + 4), true, false);
+					}
+				}
+				else
+				{
+					setRange(-inf, inf, false, false);
+				}
+				break;
+			case EvalOp::Less:
+			case EvalOp::LessEqual:
+			case EvalOp::Greater:
+			case EvalOp::GreaterEqual:
+			case EvalOp::Equal:
+			case EvalOp::NotEqual:
+			case EvalOp::And:
+			case EvalOp::Or:
+			case EvalOp::Not:
+				setRange(0, 1, true, true);
+				break;
+			case EvalOp::Min:
+			case EvalOp::Max:
+				setRange(std::min(arg(0).minValue, arg(1).minValue), std::max(arg(0).maxValue, arg(1).maxValue), arg(0).isInteger && arg(1).isInteger, arg(0).isFloatExact && arg(1).isFloatExact);
+				break;
+			case EvalOp::If:
+				setRange(std::min(arg(1).minValue, arg(2).minValue), std::max(arg(1).maxValue, arg(2).maxValue), arg(1).isInteger && arg(2).isInteger, arg(1).isFloatExact && arg(2).isFloatExact);
+				break;
+			case EvalOp::Constant:
+				throw logic_error("Constant nodes are not analyzed.");
+			}
+		}
+
+		/**
+		Tests if the given node can be evaluated in int32_t arithmetic with the same result than in double arithmetic.
+		*/
+		static bool isInt32Compatible(const EvalNode& node)
+		{
+			if (node.op == EvalOp::Sqrt || node.op == EvalOp::Divide || node.op == EvalOp::Modulus)
+				return false;
+
+			// All the values are integers, so double arithmetic is exact.
+			return node.isInteger && node.minValue >= -(double)numeric_limits<int32_t>::max() && node.maxValue <= (double)numeric_limits<int32_t>::max();
+		}
+
+		/**
+		Tests if the given node can be evaluated in float32_t arithmetic with the same result than in double arithmetic.
+		*/
+		static bool isFloat32Compatible(const EvalNode& node)
+		{
+			switch (node.op)
+			{
+			case EvalOp::Constant:
+			case EvalOp::Variable:
+			case EvalOp::Negate:
+			case EvalOp::Abs:
+			case EvalOp::Not:
+			case EvalOp::Floor:
+			case EvalOp::Ceil:
+			case EvalOp::Less:
+			case EvalOp::LessEqual:
+			case EvalOp::Greater:
+			case EvalOp::GreaterEqual:
+			case EvalOp::Equal:
+			case EvalOp::NotEqual:
+			case EvalOp::And:
+			case EvalOp::Or:
+			case EvalOp::Min:
+			case EvalOp::Max:
+			case EvalOp::If:
+				// These operations do not round, so if the inputs are exact, the result is exact, too.
+				return node.isFloatExact;
+			default:
+				return false;
+			}
+		}
+
+		static bool isAdditive(EvalOp op)
+		{
+			return op == EvalOp::Add || op == EvalOp::Subtract;
+		}
+
+		/**
+		Tests if the given node is a non-constant arithmetic operation with a constant argument.
+		*/
+		static bool hasConstantArgument(const EvalNode& node, const vector<EvalNode>& nodes)
+		{
+			if (node.isConstant ||
+				(node.op != EvalOp::Add && node.op != EvalOp::Subtract && node.op != EvalOp::Multiply && node.op != EvalOp::Divide))
+				return false;
+
+			for (size_t arg : node.args)
+			{
+				if (nodes[arg].isConstant)
+					return true;
+			}
+			return false;
+		}
+
+		template<typename value_t> void evaluateOperation(EvalOp op, const value_t* a, const value_t* b, const value_t* c, value_t* out, coord_t count);
+
+		EvalPlan::EvalPlan()
+		{
+		}
+
+		EvalPlan::~EvalPlan()
+		{
+		}
+
+		unique_ptr<EvalPlan> EvalPlan::compile(const string& expression, const vector<ImageBase*>& params)
+		{
+			for (ImageBase* param : params)
+			{
+				if (param->dataType() == ImageDataType::Complex32 || param->dataType() == ImageDataType::Unknown || param->getRawData() == nullptr)
+					return nullptr;
+			}
+
+			EvalParser parser(expression, params.size());
+			if (!parser.tokenize())
+				return nullptr;
+
+			size_t root = parser.parse();
+			if (root == numeric_limits<size_t>::max())
+				return nullptr;
+
+			unique_ptr<EvalPlan> plan(new EvalPlan());
+			plan->nodes = parser.nodes;
+			plan->params = params;
+			plan->root = root;
+			vector<EvalNode>& nodes = plan->nodes;
+
+			bool reassociated = false;
+
+			// Arguments are always created before the nodes that use them, so the nodes can be analyzed in order.
+			for (EvalNode& node : nodes)
+			{
+				// exprtk removes the branch that is never taken if the condition is constant.
+				if (node.op == EvalOp::If && nodes[node.args[0]].isConstant)
+					node = nodes[nodes[node.args[0]].value != 0 ? node.args[1] : node.args[2]];
+
+				if (node.op != EvalOp::Constant && node.op != EvalOp::Variable)
+				{
+					node.isConstant = true;
+					for (size_t arg : node.args)
+						node.isConstant = node.isConstant && nodes[arg].isConstant;
+				}
+
+				if (node.isConstant)
+				{
+					if (node.op == EvalOp::Constant)
+					{
+						node.value = evaluateConstant(expression.substr(node.begin, node.end - node.begin));
+					}
+					else
+					{
+						// Fold constant operations using the same arithmetic than in the evaluation.
+						double a = nodes[node.args[0]].value;
+						double b = node.args.size() > 1 ? nodes[node.args[1]].value : 0.0;
+						double c = node.args.size() > 2 ? nodes[node.args[2]].value : 0.0;
+						evaluateOperation<double>(node.op, &a, &b, &c, &node.value, 1);
+					}
+					node.minValue = node.value;
+					node.maxValue = node.value;
+					node.isInteger = isIntegral(node.value);
+					node.isFloatExact = isFloatExact(node.value);
+				}
+				else
+				{
+					analyze(node, nodes, params);
+
+					// exprtk simplifies multiplication and division by constant zero such that
+					// e.g. 0 * inf and x / 0 give different results than the corresponding floating point operations.
+					if (node.op == EvalOp::Multiply || node.op == EvalOp::Divide)
+					{
+						for (size_t arg : node.args)
+						{
+							if (nodes[arg].isConstant && nodes[arg].value == 0)
+								return nullptr;
+						}
+					}
+
+					// exprtk combines constants in nested additions and multiplications like 1 + (2 + x) to 3 + x.
+					// That changes rounding in floating point arithmetic, but not in exact integer arithmetic.
+					if (hasConstantArgument(node, nodes))
+					{
+						for (size_t arg : node.args)
+						{
+							if (hasConstantArgument(nodes[arg], nodes) && isAdditive(node.op) == isAdditive(nodes[arg].op))
+								reassociated = true;
+						}
+					}
+				}
+			}
+
+			// Collect nodes that must be evaluated, and assign registers.
+			plan->paramRegisters.assign(params.size(), -1);
+			vector<size_t> stack;
+			vector<bool> visited(nodes.size(), false);
+			stack.push_back(root);
+			while (!stack.empty())
+			{
+				size_t n = stack.back();
+				EvalNode& node = nodes[n];
+
+				if (visited[n])
+				{
+					stack.pop_back();
+					continue;
+				}
+
+				if (node.isConstant)
+				{
+					node.reg = plan->registerCount++;
+					plan->constants.push_back(n);
+					visited[n] = true;
+					stack.pop_back();
+				}
+				else if (node.op == EvalOp::Variable)
+				{
+					int& reg = plan->paramRegisters[node.variable];
+					if (reg < 0)
+						reg = (int)plan->registerCount++;
+					node.reg = reg;
+					visited[n] = true;
+					stack.pop_back();
+				}
+				else
+				{
+					bool argsReady = true;
+					for (size_t arg : node.args)
+					{
+						if (!visited[arg])
+						{
+							stack.push_back(arg);
+							argsReady = false;
+						}
+					}
+
+					if (argsReady)
+					{
+						node.reg = plan->registerCount++;
+						plan->schedule.push_back(n);
+						visited[n] = true;
+						stack.pop_back();
+					}
+				}
+			}
+
+			// Select the arithmetic.
+			bool int32 = true;
+			bool float32 = true;
+			for (size_t n = 0; n < nodes.size(); n++)
+			{
+				if (visited[n])
+				{
+					int32 = int32 && isInt32Compatible(nodes[n]);
+					float32 = float32 && isFloat32Compatible(nodes[n]);
+				}
+			}
+
+			if (int32)
+				plan->type = EvalValueType::Int32;
+			else if (float32)
+				plan->type = EvalValueType::Float32;
+			else if (!reassociated)
+				plan->type = EvalValueType::Float64;
+			else
+				return nullptr;
+
+			return plan;
+		}
+
+		template<typename value_t> vector<vector<value_t> > EvalPlan::createRegisters() const
+		{
+			vector<vector<value_t> > registers(registerCount, vector<value_t>(EVAL_CHUNK_SIZE));
+			for (size_t n : constants)
+				std::fill(registers[nodes[n].reg].begin(), registers[nodes[n].reg].end(), (value_t)nodes[n].value);
+			return registers;
+		}
+
+		/**
+		Converts count pixels starting from start to value_t.
+		*/
+		template<typename pixel_t, typename value_t> void loadTypedPixels(ImageBase* img, coord_t start, coord_t count, value_t* out)
+		{
+			const pixel_t* in = (const pixel_t*)img->getRawData() + start;
+
+			#pragma omp simd
+			for (coord_t i = 0; i < count; i++)
+				out[i] = (value_t)in[i];
+		}
+
+		template<typename value_t> void loadPixels(ImageBase* img, coord_t start, coord_t count, value_t* out)
+		{
+			switch (img->dataType())
+			{
+			case ImageDataType::UInt8: loadTypedPixels<uint8_t>(img, start, count, out); break;
+			case ImageDataType::UInt16: loadTypedPixels<uint16_t>(img, start, count, out); break;
+			case ImageDataType::UInt32: loadTypedPixels<uint32_t>(img, start, count, out); break;
+			case ImageDataType::UInt64: loadTypedPixels<uint64_t>(img, start, count, out); break;
+			case ImageDataType::Int8: loadTypedPixels<int8_t>(img, start, count, out); break;
+			case ImageDataType::Int16: loadTypedPixels<int16_t>(img, start, count, out); break;
+			case ImageDataType::Int32: loadTypedPixels<int32_t>(img, start, count, out); break;
+			case ImageDataType::Int64: loadTypedPixels<int64_t>(img, start, count, out); break;
+			case ImageDataType::Float32: loadTypedPixels<float32_t>(img, start, count, out); break;
+			default: throw logic_error("Unsupported parameter image data type in eval plan.");
+			}
+		}
+
+		/**
+		Evaluates one operation for count values.
+		The operations are implemented exactly like in exprtk.
+		*/
+		template<typename value_t> void evaluateOperation(EvalOp op, const value_t* a, const value_t* b, const value_t* c, value_t* out, coord_t count)
+		{
+			switch (op)
+			{
+			case EvalOp::Negate:
+				#pragma omp simd
+				for (coord_t i = 0; i < count; i++)
+					out[i] = -a[i];
+				break;
+			case EvalOp::Not:
+				#pragma omp simd
+				for (coord_t i = 0; i < count; i++)
+					out[i] = a[i] != 0 ? (value_t)0 : (value_t)1;
+				break;
+			case EvalOp::Abs:
+				#pragma omp simd
+				for (coord_t i = 0; i < count; i++)
+					out[i] = a[i] < 0 ? -a[i] : a[i];
+				break;
+			case EvalOp::Floor:
+				if constexpr (std::is_floating_point_v<value_t>)
+				{
+					#pragma omp simd
+					for (coord_t i = 0; i < count; i++)
+						out[i] = std::floor(a[i]);
+				}
+				else
+				{
+					std::copy(a, a + count, out);
+				}
+				break;
+			case EvalOp::Ceil:
+				if constexpr (std::is_floating_point_v<value_t>)
+				{
+					#pragma omp simd
+					for (coord_t i = 0; i < count; i++)
+						out[i] = std::ceil(a[i]);
+				}
+				else
+				{
+					std::copy(a, a + count, out);
+				}
+				break;
+			case EvalOp::Add:
+				#pragma omp simd
+				for (coord_t i = 0; i < count; i++)
+					out[i] = a[i] + b[i];
+				break;
+			case EvalOp::Subtract:
+				#pragma omp simd
+				for (coord_t i = 0; i < count; i++)
+					out[i] = a[i] - b[i];
+				break;
+			case EvalOp::Multiply:
+				#pragma omp simd
+				for (coord_t i = 0; i < count; i++)
+					out[i] = a[i] * b[i];
+				break;
+			case EvalOp::Sqrt:
+			case EvalOp::Divide:
+			case EvalOp::Modulus:
+				if constexpr (std::is_same_v<value_t, double>)
+				{
+					if (op == EvalOp::Sqrt)
+					{
+						#pragma omp simd
+						for (coord_t i = 0; i < count; i++)
+							out[i] = std::sqrt(a[i]);
+					}
+					else if (op == EvalOp::Divide)
+					{
+						#pragma omp simd
+						for (coord_t i = 0; i < count; i++)
+							out[i] = a[i] / b[i];
+					}
+					else
+					{
+						for (coord_t i = 0; i < count; i++)
+							out[i] = std::fmod(a[i], b[i]);
+					}
+				}
+				else
+				{
+					throw logic_error("Operation is supported only in double arithmetic.");
+				}
+				break;
+			case EvalOp::Less:
+				#pragma omp simd
+				for (coord_t i = 0; i < count; i++)
+					out[i] = a[i] < b[i] ? (value_t)1 : (value_t)0;
+				break;
+			case EvalOp::LessEqual:
+				#pragma omp simd
+				for (coord_t i = 0; i < count; i++)
+					out[i] = a[i] <= b[i] ? (value_t)1 : (value_t)0;
+				break;
+			case EvalOp::Greater:
+				#pragma omp simd
+				for (coord_t i = 0; i < count; i++)
+					out[i] = a[i] > b[i] ? (value_t)1 : (value_t)0;
+				break;
+			case EvalOp::GreaterEqual:
+				#pragma omp simd
+				for (coord_t i = 0; i < count; i++)
+					out[i] = a[i] >= b[i] ? (value_t)1 : (value_t)0;
+				break;
+			case EvalOp::Equal:
+				#pragma omp simd
+				for (coord_t i = 0; i < count; i++)
+					out[i] = a[i] == b[i] ? (value_t)1 : (value_t)0;
+				break;
+			case EvalOp::NotEqual:
+				#pragma omp simd
+				for (coord_t i = 0; i < count; i++)
+					out[i] = a[i] != b[i] ? (value_t)1 : (value_t)0;
+				break;
+			case EvalOp::And:
+				#pragma omp simd
+				for (coord_t i = 0; i < count; i++)
+					out[i] = (a[i] != 0) & (b[i] != 0) ? (value_t)1 : (value_t)0;
+				break;
+			case EvalOp::Or:
+				#pragma omp simd
+				for (coord_t i = 0; i < count; i++)
+					out[i] = (a[i] != 0) | (b[i] != 0) ? (value_t)1 : (value_t)0;
+				break;
+			case EvalOp::Min:
+				#pragma omp simd
+				for (coord_t i = 0; i < count; i++)
+					out[i] = b[i] < a[i] ? b[i] : a[i];
+				break;
+			case EvalOp::Max:
+				#pragma omp simd
+				for (coord_t i = 0; i < count; i++)
+					out[i] = a[i] < b[i] ? b[i] : a[i];
+				break;
+			case EvalOp::If:
+				#pragma omp simd
+				for (coord_t i = 0; i < count; i++)
+					out[i] = a[i] != 0 ? b[i] : c[i];
+				break;
+			case EvalOp::Constant:
+			case EvalOp::Variable:
+				throw logic_error("Constants and variables are not evaluated.");
+			}
+		}
+
+		template<typename value_t> const value_t* EvalPlan::evaluate(coord_t start, coord_t count, vector<vector<value_t> >& registers) const
+		{
+			for (size_t n = 0; n < params.size(); n++)
+			{
+				if (paramRegisters[n] >= 0)
+					loadPixels<value_t>(params[n], start, count, registers[paramRegisters[n]].data());
+			}
+
+			for (size_t n : schedule)
+			{
+				const EvalNode& node = nodes[n];
+				const value_t* a = registers[nodes[node.args[0]].reg].data();
+				const value_t* b = node.args.size() > 1 ? registers[nodes[node.args[1]].reg].data() : nullptr;
+				const value_t* c = node.args.size() > 2 ? registers[nodes[node.args[2]].reg].data() : nullptr;
+				evaluateOperation(node.op, a, b, c, registers[node.reg].data(), count);
+			}
+
+			return registers[nodes[root].reg].data();
+		}
+
+		template vector<vector<int32_t> > EvalPlan::createRegisters<int32_t>() const;
+		template vector<vector<float32_t> > EvalPlan::createRegisters<float32_t>() const;
+		template vector<vector<double> > EvalPlan::createRegisters<double>() const;
+		template const int32_t* EvalPlan::evaluate<int32_t>(coord_t start, coord_t count, vector<vector<int32_t> >& registers) const;
+		template const float32_t* EvalPlan::evaluate<float32_t>(coord_t start, coord_t count, vector<vector<float32_t> >& registers) const;
+		template const double* EvalPlan::evaluate<double>(coord_t start, coord_t count, vector<vector<double> >& registers) const;
+	}
+
+	namespace tests
+	{
+		/**
+		Evaluates expression with and without evaluation plan and checks that the results are the same.
+		*/
+		template<typename target_t> void checkEvalPlan(const string& expression, const vector<ImageBase*>& params, const string& expectedType)
+		{
+			unique_ptr<internals::EvalPlan> plan = internals::EvalPlan::compile(expression, params);
+			string type = "exprtk";
+			if (plan)
+			{
+				switch (plan->valueType())
+				{
+				case internals::EvalValueType::Int32: type = "int32"; break;
+				case internals::EvalValueType::Float32: type = "float32"; break;
+				case internals::EvalValueType::Float64: type = "float64"; break;
+				}
+			}
+			testAssert(type == expectedType, string("evaluation type of ") + expression + ", got " + type + ", expected " + expectedType);
+
+			Image<target_t> result(params[0]->dimensions());
+			Image<target_t> expected(params[0]->dimensions());
+			itl2::eval(expression, result, params);
+			internals::evalExprtk(expression, expected, params);
+
+			coord_t errors = 0;
+			for (coord_t n = 0; n < result.pixelCount(); n++)
+			{
+				if (!(result(n) == expected(n) || (std::isnan((double)result(n)) && std::isnan((double)expected(n)))))
+					errors++;
+			}
+			testAssert(errors == 0, string("evaluation plan result of ") + expression);
+		}
+
+		void evalPlan()
+		{
+			mt19937 gen(1);
+			uniform_int_distribution<int> dist(-1000, 1000);
+
+			Vec3c dims(50, 40, 30);
+			Image<uint8_t> i8(dims);
+			Image<uint16_t> i16(dims);
+			Image<int16_t> s16(dims);
+			Image<float32_t> f32(dims);
+			Image<uint64_t> i64(dims);
+			for (coord_t n = 0; n < i8.pixelCount(); n++)
+			{
+				i8(n) = (uint8_t)(dist(gen) & 0xff);
+				i16(n) = (uint16_t)(dist(gen) + 1000);
+				s16(n) = (int16_t)dist(gen);
+				f32(n) = dist(gen) * 0.37f;
+				i64(n) = (uint64_t)(dist(gen) + 1000) * 10000000000;
+			}
+
+			vector<ImageBase*> params = { &i8, &i16, &s16, &f32, &i64 };
+
+			checkEvalPlan<uint8_t>("x0 * 2 + x1 > 100", params, "int32");
+			checkEvalPlan<float32_t>("-x0 + 3 * min(x1, x2) - abs(x2)", params, "int32");
+			checkEvalPlan<uint16_t>("if(x0 > 10 and x2 <= 0, floor(x1), max(x2, 7))", params, "int32");
+			checkEvalPlan<float32_t>("x0 == x1 or not(x2 != -5)", params, "int32");
+			checkEvalPlan<float32_t>("x0 * x1 * x2", params, "float64");
+			checkEvalPlan<float32_t>("if(x3 < 0, x3, min(x0, 2.5))", params, "float32");
+			checkEvalPlan<float32_t>("x3 >= -3.5 and x3 <> 0.25", params, "float32");
+			checkEvalPlan<float32_t>("x3 * 0.5 - (x2 + x0) / 3", params, "float64");
+			checkEvalPlan<float32_t>("sqrt(abs(x3)) % 3 + ceil(x3 / 7)", params, "float64");
+			checkEvalPlan<float32_t>("x4 / 1e10 - pi", params, "float64");
+			checkEvalPlan<int16_t>("(x2 - x0) / x1", params, "float64");
+			checkEvalPlan<float32_t>("x3 / (x0 - x0)", params, "float64");
+			checkEvalPlan<float32_t>("2 * (3 * x0) - (2 + 3) * (1 - x1)", params, "int32");
+			checkEvalPlan<float32_t>("if(1 < 2, x0 * 0.1, x1) + 1", params, "float64");
+
+			// These are not supported and are evaluated by exprtk.
+			checkEvalPlan<float32_t>("0.1 * (0.3 * x3)", params, "exprtk");
+			checkEvalPlan<float32_t>("x3 * 0", params, "exprtk");
+			checkEvalPlan<float32_t>("sin(x3)", params, "exprtk");
+			checkEvalPlan<float32_t>("x0^2 + x1", params, "exprtk");
+
+			// Performance comparison.
+			Image<uint8_t> a(400, 400, 400);
+			Image<uint8_t> b(400, 400, 400);
+			Image<uint8_t> result(a.dimensions());
+			Image<uint8_t> expected(a.dimensions());
+			for (coord_t n = 0; n < a.pixelCount(); n++)
+			{
+				a(n) = (uint8_t)(n % 251);
+				b(n) = (uint8_t)(n % 13);
+			}
+
+			for (const string expression : { "x0 * 2 + x1 > 100", "x0 * 0.5 + x1 / 3" })
+			{
+				Timer timer;
+				timer.start();
+				itl2::eval(expression, result, { &a, &b });
+				timer.stop();
+				cout << expression << ": evaluation plan took " << timer.getSeconds() << " s" << endl;
+
+				timer.start();
+				internals::evalExprtk(expression, expected, { &a, &b });
+				timer.stop();
+				cout << expression << ": exprtk took " << timer.getSeconds() << " s" << endl;
+
+				checkDifference(result, expected, string("evaluation plan result of ") + expression);
+			}
+		}
+	}
+}
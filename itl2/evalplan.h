@@ -0,0 +1,130 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "image.h"
+
+namespace itl2
+{
+	namespace internals
+	{
+		/**
+		Count of pixels processed at once by EvalPlan.
+		*/
+		constexpr coord_t EVAL_CHUNK_SIZE = 2048;
+
+		/**
+		Type of the values used in calculations of an EvalPlan.
+		*/
+		enum class EvalValueType
+		{
+			/**
+			All values are integers that fit into int32_t.
+			*/
+			Int32,
+			/**
+			All values are exactly representable as float32_t and no operation rounds its result.
+			*/
+			Float32,
+			/**
+			Values are doubles, as in exprtk.
+			*/
+			Float64
+		};
+
+		/**
+		Node of the expression tree of an EvalPlan.
+		*/
+		struct EvalNode;
+
+		/**
+		Typed, vectorized evaluation plan for expressions that are evaluated with eval function.
+		The plan supports numbers, constants pi, epsilon and inf, pixel values x0, x1, ..., arithmetic operations + - * / %,
+		comparisons < <= > >= == = != <>, logical operations and, or, not, and functions min, max, abs, floor, ceil, sqrt and if
+		with the same precedence and semantics than in exprtk.
+		The expression is evaluated for chunks of EVAL_CHUNK_SIZE pixels at a time, directly from the pixel buffers of the parameter images.
+		The calculations are made in int32_t or float32_t arithmetic instead of double if that gives exactly the same result.
+		*/
+		class EvalPlan
+		{
+		private:
+			std::vector<EvalNode> nodes;
+
+			/**
+			Parameter images, one for each variable xN.
+			*/
+			std::vector<ImageBase*> params;
+
+			/**
+			Index of register where each parameter image is loaded, or -1 if the parameter is not used.
+			*/
+			std::vector<int> paramRegisters;
+
+			/**
+			Indices of nodes that are evaluated for each chunk, in evaluation order.
+			*/
+			std::vector<size_t> schedule;
+
+			/**
+			Indices of constant nodes whose registers are filled when the registers are created.
+			*/
+			std::vector<size_t> constants;
+
+			/**
+			Total count of registers.
+			*/
+			size_t registerCount = 0;
+
+			/**
+			Index of the node whose value is the result of the expression.
+			*/
+			size_t root = 0;
+
+			EvalValueType type = EvalValueType::Float64;
+
+			EvalPlan();
+
+		public:
+			~EvalPlan();
+
+			EvalPlan(const EvalPlan&) = delete;
+			EvalPlan& operator=(const EvalPlan&) = delete;
+
+			/**
+			Creates evaluation plan for the given expression.
+			The expression must be valid for exprtk.
+			@return The plan, or nullptr if the expression contains something that the plan does not support. In that case the expression must be evaluated with exprtk.
+			*/
+			static std::unique_ptr<EvalPlan> compile(const std::string& expression, const std::vector<ImageBase*>& params);
+
+			/**
+			Gets the type of the values used in the calculations.
+			Registers and results are of type int32_t, float32_t or double, correspondingly.
+			*/
+			EvalValueType valueType() const
+			{
+				return type;
+			}
+
+			/**
+			Creates registers (buffers for intermediate results) for one thread.
+			*/
+			template<typename value_t> std::vector<std::vector<value_t> > createRegisters() const;
+
+			/**
+			Evaluates the expression for pixels [start, start + count[.
+			count must not be larger than EVAL_CHUNK_SIZE.
+			@param registers Registers created with createRegisters.
+			@return Pointer to the results. The pointer is valid until the registers are used again.
+			*/
+			template<typename value_t> const value_t* evaluate(coord_t start, coord_t count, std::vector<std::vector<value_t> >& registers) const;
+		};
+	}
+
+	namespace tests
+	{
+		void evalPlan();
+	}
+}
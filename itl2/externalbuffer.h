@@ -0,0 +1,63 @@
+#pragma once
+
+#include <functional>
+
+#include "buffer.h"
+
+namespace itl2
+{
+
+	/**
+	Buffer that points to memory owned by someone else, e.g. a NumPy array or a .NET array.
+	The buffer does not allocate or free the memory, and it does not construct or destruct the pixels in it.
+	*/
+	template<typename pixel_t> class ExternalBuffer : public Buffer<pixel_t>
+	{
+	private:
+
+		/**
+		The external memory.
+		*/
+		pixel_t* pBuffer;
+
+		/**
+		Function that is called when the buffer is not needed anymore, or empty function.
+		*/
+		std::function<void()> release;
+
+	public:
+
+		/**
+		Constructor
+		@param buffer Pointer to the external memory.
+		@param release Function that is called when the buffer is destroyed. The owner of the memory may free it in this function.
+		*/
+		ExternalBuffer(pixel_t* buffer, std::function<void()> release = std::function<void()>()) :
+			pBuffer(buffer),
+			release(std::move(release))
+		{
+		}
+
+		virtual ~ExternalBuffer()
+		{
+			if (release)
+				release();
+		}
+
+		virtual pixel_t* getBufferPointer() override
+		{
+			return pBuffer;
+		}
+
+		virtual void prefetch(size_t start, size_t end) const override
+		{
+			// Do nothing, the owner of the memory takes care of it.
+		}
+
+		virtual bool ownsData() const override
+		{
+			return false;
+		}
+	};
+
+}
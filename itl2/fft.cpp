@@ -3,6 +3,10 @@
 #include <random>
 #include <cmath>
 #include <iomanip>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <thread>
 
 #include "ompatomic.h"
 #include "io/raw.h"
@@ -14,6 +18,9 @@
 #include "transform.h"
 #include "noise.h"
 #include "math/mathutils.h"
+#include "io/fileutils.h"
+#include "timer.h"
+#include "filesystem.h"
 
 using namespace std;
 
@@ -47,293 +54,300 @@ namespace itl2
 		//}
 	}
 
-	void setThreads()
-	{
-		//if (omp_in_parallel())
-		//	fftwf_plan_with_nthreads(1);
-		//else
-		//	fftwf_plan_with_nthreads(omp_get_num_threads());
-	}
-
-	void dct(Image<float32_t>& img)
+	namespace internals
 	{
-		initFFTW();
-
-		if (img.dimensionality() == 1)
+		/**
+		Identifies a plan in the FFT plan cache.
+		*/
+		struct FFTPlanKey
 		{
-			coord_t w = img.dimension(0);
+			FFTKind kind;
+			size_t dimensionality;
+			Vec3c dimensions;
+			bool inPlace;
+			int inAlignment;
+			int outAlignment;
+			FFTPlanning planning;
 
-			fftwf_plan p;
-			#pragma omp critical
-			{
-				setThreads();
-				p = fftwf_plan_r2r_1d((int)w, img.getData(), img.getData(), FFTW_REDFT10, FFTW_ESTIMATE);
-			}
-			fftwf_execute(p);
-			#pragma omp critical
+			bool operator<(const FFTPlanKey& r) const
 			{
-				fftwf_destroy_plan(p);
+				return std::tie(kind, dimensionality, dimensions.x, dimensions.y, dimensions.z, inPlace, inAlignment, outAlignment, planning) <
+					std::tie(r.kind, r.dimensionality, r.dimensions.x, r.dimensions.y, r.dimensions.z, r.inPlace, r.inAlignment, r.outAlignment, r.planning);
 			}
-		}
-		else if (img.dimensionality() == 2)
-		{
-			coord_t w = img.dimension(0);
-			coord_t h = img.dimension(1);
+		};
 
-			fftwf_plan p;
-			#pragma omp critical
-			{
-				setThreads();
-				p = fftwf_plan_r2r_2d((int)h, (int)w, img.getData(), img.getData(), FFTW_REDFT10, FFTW_REDFT10, FFTW_ESTIMATE);
-			}
-			fftwf_execute(p);
-			#pragma omp critical
-			{
-				fftwf_destroy_plan(p);
-			}
-		}
-		else if (img.dimensionality() == 3)
+		/**
+		Process-wide storage of FFT plans.
+		FFTW planner is not thread-safe, so all plans are created while holding the lock of the cache.
+		*/
+		class FFTPlanCache
 		{
-			coord_t w = img.dimension(0);
-			coord_t h = img.dimension(1);
-			coord_t d = img.dimension(2);
+		private:
+			std::mutex lock;
+			std::map<FFTPlanKey, fftwf_plan> plans;
+			FFTPlanning planning = FFTPlanning::Estimate;
+			string wisdomFile;
+
+			/**
+			Converts FFTPlanning to FFTW planner flags.
+			*/
+			static unsigned int plannerFlags(FFTPlanning planning)
+			{
+				switch (planning)
+				{
+				case FFTPlanning::Estimate: return FFTW_ESTIMATE;
+				case FFTPlanning::Measure: return FFTW_MEASURE;
+				case FFTPlanning::Patient: return FFTW_PATIENT;
+				}
+				throw ITLException("Invalid FFT planning mode.");
+			}
 
-			fftwf_plan p;
-			#pragma omp critical
+			/**
+			Allocates temporary buffer of given size whose alignment (as reported by fftwf_alignment_of) is the given value.
+			Plans must be created using temporary buffers as FFTW overwrites the buffers while measuring.
+			In estimate mode FFTW does not touch the buffers, and only a few bytes are needed to get the alignment right.
+			*/
+			static float32_t* allocateAligned(size_t bytes, int alignment, void*& base)
 			{
-				setThreads();
-				p = fftwf_plan_r2r_3d((int)d, (int)h, (int)w, img.getData(), img.getData(), FFTW_REDFT10, FFTW_REDFT10, FFTW_REDFT10, FFTW_ESTIMATE);
+				base = fftwf_malloc(bytes + 64);
+				if (!base)
+					throw ITLException("Out of memory while creating FFT plan.");
+				return (float32_t*)((uint8_t*)base + alignment);
 			}
-			fftwf_execute(p);
-			#pragma omp critical
+
+			fftwf_plan createPlan(const FFTPlanKey& key)
 			{
-				fftwf_destroy_plan(p);
-			}
-		}
-		else
-		{
-			throw ITLException("Unsupported dimensionality.");
-		}
+				int rank = (int)key.dimensionality;
+				int n[3];
+				for (int i = 0; i < rank; i++)
+					n[i] = (int)key.dimensions[rank - 1 - i];
 
-		// Normalize the output image
-		multiply(img, 1 / sqrt(::pow(2, img.dimensionality()) * img.pixelCount()));
-	}
+				size_t realBytes = key.dimensions.x * key.dimensions.y * key.dimensions.z * sizeof(float32_t);
+				size_t halfComplexBytes = (key.dimensions.x / 2 + 1) * key.dimensions.y * key.dimensions.z * sizeof(complex32_t);
+				size_t complexBytes = key.dimensions.x * key.dimensions.y * key.dimensions.z * sizeof(complex32_t);
 
-	void idct(Image<float32_t>& img)
-	{
-		initFFTW();
+				size_t inBytes, outBytes;
+				switch (key.kind)
+				{
+				case FFTKind::DCT:
+				case FFTKind::IDCT: inBytes = realBytes; outBytes = realBytes; break;
+				case FFTKind::RealToComplex: inBytes = realBytes; outBytes = halfComplexBytes; break;
+				case FFTKind::ComplexToReal: inBytes = halfComplexBytes; outBytes = realBytes; break;
+				case FFTKind::ComplexForward: inBytes = complexBytes; outBytes = complexBytes; break;
+				default: throw ITLException("Invalid FFT kind.");
+				}
 
-		if (img.dimensionality() == 1)
-		{
-			coord_t w = img.dimension(0);
+				unsigned int flags = plannerFlags(key.planning);
+				if (key.planning == FFTPlanning::Estimate)
+				{
+					inBytes = sizeof(complex32_t);
+					outBytes = sizeof(complex32_t);
+				}
 
-			fftwf_plan p;
-			#pragma omp critical
+				void* inBase = nullptr;
+				void* outBase = nullptr;
+				float32_t* in;
+				float32_t* out;
+				if (key.inPlace)
+				{
+					in = allocateAligned(std::max(inBytes, outBytes), key.inAlignment, inBase);
+					out = in;
+				}
+				else
+				{
+					in = allocateAligned(inBytes, key.inAlignment, inBase);
+					out = allocateAligned(outBytes, key.outAlignment, outBase);
+				}
+
+				fftwf_plan plan;
+				switch (key.kind)
+				{
+				case FFTKind::DCT:
+				{
+					fftwf_r2r_kind kinds[] = { FFTW_REDFT10, FFTW_REDFT10, FFTW_REDFT10 };
+					plan = fftwf_plan_r2r(rank, n, in, out, kinds, flags);
+					break;
+				}
+				case FFTKind::IDCT:
+				{
+					fftwf_r2r_kind kinds[] = { FFTW_REDFT01, FFTW_REDFT01, FFTW_REDFT01 };
+					plan = fftwf_plan_r2r(rank, n, in, out, kinds, flags);
+					break;
+				}
+				case FFTKind::RealToComplex:
+					plan = fftwf_plan_dft_r2c(rank, n, in, (fftwf_complex*)out, flags);
+					break;
+				case FFTKind::ComplexToReal:
+					plan = fftwf_plan_dft_c2r(rank, n, (fftwf_complex*)in, out, flags);
+					break;
+				default:
+					plan = fftwf_plan_dft(rank, n, (fftwf_complex*)in, (fftwf_complex*)out, FFTW_FORWARD, flags);
+					break;
+				}
+
+				fftwf_free(outBase);
+				fftwf_free(inBase);
+
+				if (!plan)
+					throw ITLException("Unable to create FFT plan.");
+
+				return plan;
+			}
+
+			/**
+			Saves wisdom to the wisdom file.
+			Other processes (e.g. distributed jobs) may share the file, so the wisdom in the file is merged to ours first,
+			and the result is written to a temporary file that is then renamed over the wisdom file.
+			*/
+			void saveWisdom()
 			{
-				setThreads();
-				p = fftwf_plan_r2r_1d((int)w, img.getData(), img.getData(), FFTW_REDFT01, FFTW_ESTIMATE);
+				if (fileExists(wisdomFile))
+					fftwf_import_wisdom_from_filename(wisdomFile.c_str());
+
+				static mt19937_64 generator(random_device{}() ^ (uint64_t)hash<thread::id>()(this_thread::get_id()));
+				string temp = wisdomFile + ".tmp" + itl2::toString(generator());
+				if (fftwf_export_wisdom_to_filename(temp.c_str()) == 0)
+				{
+					deleteFile(temp);
+					return;
+				}
+
+				std::error_code ec;
+				fs::rename(temp, wisdomFile, ec);
+				if (ec)
+					deleteFile(temp);
 			}
-			fftwf_execute(p);
-			#pragma omp critical
+
+		public:
+			~FFTPlanCache()
 			{
-				fftwf_destroy_plan(p);
+				for (auto& item : plans)
+					fftwf_destroy_plan(item.second);
 			}
-		}
-		else if (img.dimensionality() == 2)
-		{
-			coord_t w = img.dimension(0);
-			coord_t h = img.dimension(1);
 
-			fftwf_plan p;
-			#pragma omp critical
+			fftwf_plan get(FFTKind kind, size_t dimensionality, const Vec3c& dimensions, const void* in, const void* out)
 			{
-				setThreads();
-				p = fftwf_plan_r2r_2d((int)h, (int)w, img.getData(), img.getData(), FFTW_REDFT01, FFTW_REDFT01, FFTW_ESTIMATE);
+				if (dimensionality < 1 || dimensionality > 3)
+					throw ITLException("Unsupported dimensionality.");
+
+				std::lock_guard<std::mutex> guard(lock);
+
+				FFTPlanKey key;
+				key.kind = kind;
+				key.dimensionality = dimensionality;
+				key.dimensions = dimensions;
+				key.inPlace = in == out;
+				key.inAlignment = fftwf_alignment_of((float32_t*)in);
+				key.outAlignment = fftwf_alignment_of((float32_t*)out);
+				key.planning = planning;
+
+				auto it = plans.find(key);
+				if (it != plans.end())
+					return it->second;
+
+				fftwf_plan plan = createPlan(key);
+				plans[key] = plan;
+
+				if (planning != FFTPlanning::Estimate && wisdomFile.length() > 0)
+					saveWisdom();
+
+				return plan;
 			}
-			fftwf_execute(p);
-			#pragma omp critical
+
+			void setPlanning(FFTPlanning value)
 			{
-				fftwf_destroy_plan(p);
+				std::lock_guard<std::mutex> guard(lock);
+				planning = value;
 			}
-		}
-		else if (img.dimensionality() == 3)
-		{
-			coord_t w = img.dimension(0);
-			coord_t h = img.dimension(1);
-			coord_t d = img.dimension(2);
 
-			fftwf_plan p;
-			#pragma omp critical
+			FFTPlanning getPlanning()
 			{
-				setThreads();
-				p = fftwf_plan_r2r_3d((int)d, (int)h, (int)w, img.getData(), img.getData(), FFTW_REDFT01, FFTW_REDFT01, FFTW_REDFT01, FFTW_ESTIMATE);
+				std::lock_guard<std::mutex> guard(lock);
+				return planning;
 			}
-			fftwf_execute(p);
-			#pragma omp critical
+
+			void setWisdomFile(const string& filename)
 			{
-				fftwf_destroy_plan(p);
+				std::lock_guard<std::mutex> guard(lock);
+				wisdomFile = filename;
+				if (wisdomFile.length() > 0 && fileExists(wisdomFile))
+					fftwf_import_wisdom_from_filename(wisdomFile.c_str());
 			}
+		};
+
+		FFTPlanCache& planCache()
+		{
+			static FFTPlanCache cache;
+			return cache;
 		}
-		else
+
+		fftwf_plan getFFTPlan(FFTKind kind, size_t dimensionality, const Vec3c& dimensions, const void* in, const void* out)
 		{
-			throw ITLException("Unsupported dimensionality.");
+			initFFTW();
+			return planCache().get(kind, dimensionality, dimensions, in, out);
 		}
+	}
 
-		// Normalize the output image
-		multiply(img, 1 / sqrt(::pow(2, img.dimensionality()) * img.pixelCount()));
+	void setFFTPlanning(FFTPlanning planning)
+	{
+		internals::planCache().setPlanning(planning);
 	}
 
+	FFTPlanning getFFTPlanning()
+	{
+		return internals::planCache().getPlanning();
+	}
 
-	void fft(Image<float32_t>& img, Image<complex32_t>& out)
+	void setFFTWisdomFile(const string& filename)
 	{
 		initFFTW();
+		internals::planCache().setWisdomFile(filename);
+	}
 
-		if (img.dimensionality() == 1)
-		{
-			coord_t w = img.dimension(0);
+	void dct(Image<float32_t>& img)
+	{
+		fftwf_plan p = internals::getFFTPlan(internals::FFTKind::DCT, img.dimensionality(), img.dimensions(), img.getData(), img.getData());
+		fftwf_execute_r2r(p, img.getData(), img.getData());
 
-			out.ensureSize(w / 2 + 1);
+		// Normalize the output image
+		multiply(img, 1 / sqrt(::pow(2, img.dimensionality()) * img.pixelCount()));
+	}
 
-			fftwf_plan p;
-			#pragma omp critical
-			{
-				setThreads();
-				p = fftwf_plan_dft_r2c_1d((int)w, img.getData(), (fftwf_complex*)out.getData(), FFTW_ESTIMATE);
-			}
-			fftwf_execute(p);
-			#pragma omp critical
-			{
-				fftwf_destroy_plan(p);
-			}
-		}
-		else if (img.dimensionality() == 2)
-		{
-			coord_t w = img.dimension(0);
-			coord_t h = img.dimension(1);
+	void idct(Image<float32_t>& img)
+	{
+		fftwf_plan p = internals::getFFTPlan(internals::FFTKind::IDCT, img.dimensionality(), img.dimensions(), img.getData(), img.getData());
+		fftwf_execute_r2r(p, img.getData(), img.getData());
 
-			out.ensureSize(w / 2 + 1, h);
+		// Normalize the output image
+		multiply(img, 1 / sqrt(::pow(2, img.dimensionality()) * img.pixelCount()));
+	}
 
-			fftwf_plan p;
-			#pragma omp critical
-			{
-				setThreads();
-				p = fftwf_plan_dft_r2c_2d((int)h, (int)w, img.getData(), (fftwf_complex*)out.getData(), FFTW_ESTIMATE);
-			}
-			fftwf_execute(p);
-			#pragma omp critical
-			{
-				fftwf_destroy_plan(p);
-			}
-		}
-		else if (img.dimensionality() == 3)
-		{
-			coord_t w = img.dimension(0);
-			coord_t h = img.dimension(1);
-			coord_t d = img.dimension(2);
 
-			out.ensureSize(w / 2 + 1, h, d);
+	void fft(Image<float32_t>& img, Image<complex32_t>& out)
+	{
+		Vec3c dimensions = img.dimensions();
+		dimensions.x = dimensions.x / 2 + 1;
+		out.ensureSize(dimensions);
 
-			fftwf_plan p;
-			#pragma omp critical
-			{
-				setThreads();
-				p = fftwf_plan_dft_r2c_3d((int)d, (int)h, (int)w, img.getData(), (fftwf_complex*)out.getData(), FFTW_ESTIMATE);
-			}
-			fftwf_execute(p);
-			#pragma omp critical
-			{
-				fftwf_destroy_plan(p);
-			}
-		}
-		else
-		{
-			throw ITLException("Unsupported dimensionality.");
-		}
+		fftwf_plan p = internals::getFFTPlan(internals::FFTKind::RealToComplex, img.dimensionality(), img.dimensions(), img.getData(), out.getData());
+		fftwf_execute_dft_r2c(p, img.getData(), (fftwf_complex*)out.getData());
 	}
 
 	void ifft(Image<complex32_t>& img, Image<float32_t>& out)
 	{
-		initFFTW();
-
 		if (img.dimensionality() != out.dimensionality() ||
 			out.width() < img.width() ||
 			out.height() < img.height() ||
 			out.depth() < img.depth())
 			throw ITLException("Size and dimensionality of the output image is not set correctly.");
 
-		if (img.dimensionality() == 1)
-		{
-			//coord_t w = (img.dimension(0) - 1) * 2;
-			coord_t w = out.dimension(0);
-
-			//out.ensureSize(w);
-
-			fftwf_plan p;
-			#pragma omp critical
-			{
-				setThreads();
-				p = fftwf_plan_dft_c2r_1d((int)w, (fftwf_complex*)img.getData(), out.getData(), FFTW_ESTIMATE);
-			}
-			fftwf_execute(p);
-			#pragma omp critical
-			{
-				fftwf_destroy_plan(p);
-			}
-		}
-		else if (img.dimensionality() == 2)
-		{
-			//coord_t w = (img.dimension(0) - 1) * 2;
-			//coord_t h = img.dimension(1);
-			coord_t w = out.dimension(0);
-			coord_t h = out.dimension(1);
-
-			//out.ensureSize(w, h);
-
-			fftwf_plan p;
-			#pragma omp critical
-			{
-				setThreads();
-				p = fftwf_plan_dft_c2r_2d((int)h, (int)w, (fftwf_complex*)img.getData(), out.getData(), FFTW_ESTIMATE);
-			}
-			fftwf_execute(p);
-			#pragma omp critical
-			{
-				fftwf_destroy_plan(p);
-			}
-		}
-		else if (img.dimensionality() == 3)
-		{
-			//coord_t w = (img.dimension(0) - 1) * 2;
-			//coord_t h = img.dimension(1);
-			//coord_t d = img.dimension(2);
-			coord_t w = out.dimension(0);
-			coord_t h = out.dimension(1);
-			coord_t d = out.dimension(2);
-
-			//out.ensureSize(w, h, d);
-
-			fftwf_plan p;
-			#pragma omp critical
-			{
-				setThreads();
-				p = fftwf_plan_dft_c2r_3d((int)d, (int)h, (int)w, (fftwf_complex*)img.getData(), out.getData(), FFTW_ESTIMATE);
-			}
-			fftwf_execute(p);
-			#pragma omp critical
-			{
-				fftwf_destroy_plan(p);
-			}
-		}
-		else
-		{
-			throw ITLException("Unsupported dimensionality.");
-		}
+		fftwf_plan p = internals::getFFTPlan(internals::FFTKind::ComplexToReal, out.dimensionality(), out.dimensions(), img.getData(), out.getData());
+		fftwf_execute_dft_c2r(p, (fftwf_complex*)img.getData(), out.getData());
 
 		// Normalize the output image
 		divide(out, (double)out.pixelCount());
 	}
 
-
 	void bandpassFilter(Image<float32_t>& img, double min_size, double max_size, bool zeroEdges)
 	{
 		// This method is tuned to be consistent with gauss function, and to mimic ImageJ's 2D bandpass as well as possible.
@@ -847,5 +861,103 @@ namespace itl2
 			}
 
 		}
+		void fftPlanCache()
+		{
+			Image<float32_t> img(100, 80, 30);
+			noise(img, 0, 100, 1);
+
+			// Plans are re-used.
+			Image<complex32_t> ft;
+			fft(img, ft);
+			fftwf_plan p1 = itl2::internals::getFFTPlan(itl2::internals::FFTKind::RealToComplex, img.dimensionality(), img.dimensions(), img.getData(), ft.getData());
+			fftwf_plan p2 = itl2::internals::getFFTPlan(itl2::internals::FFTKind::RealToComplex, img.dimensionality(), img.dimensions(), img.getData(), ft.getData());
+			testAssert(p1 == p2, "plan is re-used");
+
+			// Cached plan gives the same result than a plan made for the image.
+			Image<complex32_t> ftRef(ft.dimensions());
+			Image<float32_t> tmp(img.dimensions());
+			fftwf_plan pRef = fftwf_plan_dft_r2c_3d((int)img.depth(), (int)img.height(), (int)img.width(), tmp.getData(), (fftwf_complex*)ftRef.getData(), FFTW_ESTIMATE);
+			fftwf_execute_dft_r2c(pRef, img.getData(), (fftwf_complex*)ftRef.getData());
+			fftwf_destroy_plan(pRef);
+			for (coord_t n = 0; n < ft.pixelCount(); n++)
+				testAssert(NumberUtils<float32_t>::equals(ft(n).real(), ftRef(n).real(), 1e-2f) && NumberUtils<float32_t>::equals(ft(n).imag(), ftRef(n).imag(), 1e-2f), "cached plan and single-use plan");
+
+			Image<float32_t> back(img.dimensions());
+			ifft(ft, back);
+			subtract(back, img);
+			abs(back);
+			testAssert(max(back) < 1e-3, "FFT - inverse FFT pair");
+
+			// Plans can be used from multiple threads, also for images with different alignments.
+			Image<float32_t> rows(257, 400);
+			noise(rows, 0, 100, 2);
+			Image<float32_t> rowsSerial(rows.dimensions());
+			setValue(rowsSerial, rows);
+
+			for (coord_t y = 0; y < rowsSerial.height(); y++)
+			{
+				Image<float32_t> row(rowsSerial.width());
+				for (coord_t x = 0; x < row.width(); x++)
+					row(x) = rowsSerial(x, y);
+				dct(row);
+				for (coord_t x = 0; x < row.width(); x++)
+					rowsSerial(x, y) = row(x);
+			}
+
+			#pragma omp parallel for
+			for (coord_t y = 0; y < rows.height(); y++)
+			{
+				// Every other row is processed in a view whose alignment differs from the alignment of a new image.
+				Image<float32_t> storage(rows.width(), 1, 2);
+				Image<float32_t> view(storage, y % 2, y % 2);
+				for (coord_t x = 0; x < view.width(); x++)
+					view(x) = rows(x, y);
+				dct(view);
+				for (coord_t x = 0; x < view.width(); x++)
+					rows(x, y) = view(x);
+			}
+
+			testAssert(equals(rows, rowsSerial), "DCT of rows in parallel");
+
+			// Measured plans and wisdom.
+			string wisdomFile = "./fft/wisdom";
+			createFoldersFor(wisdomFile);
+			if (fileExists(wisdomFile))
+				deleteFile(wisdomFile);
+
+			Image<float32_t> line(2048);
+			noise(line, 0, 100, 3);
+			Image<complex32_t> lineFT;
+			coord_t count = 20000;
+
+			Timer timer;
+			timer.start();
+			for (coord_t n = 0; n < count; n++)
+				fft(line, lineFT);
+			timer.stop();
+			cout << "Estimated plan: " << timer.getSeconds() << " s" << endl;
+
+			setFFTWisdomFile(wisdomFile);
+			setFFTPlanning(FFTPlanning::Measure);
+			fft(line, lineFT);
+			timer.start();
+			for (coord_t n = 0; n < count; n++)
+				fft(line, lineFT);
+			timer.stop();
+			cout << "Measured plan: " << timer.getSeconds() << " s" << endl;
+
+			testAssert(fileExists(wisdomFile), "wisdom file is saved");
+			testAssert(fftwf_import_wisdom_from_filename(wisdomFile.c_str()) != 0, "wisdom file can be imported");
+			size_t fileCount = 0;
+			for (auto& entry : fs::directory_iterator("./fft"))
+			{
+				if (entry.path().filename().string().find("wisdom") == 0)
+					fileCount++;
+			}
+			testAssert(fileCount == 1, "no temporary wisdom files are left");
+
+			setFFTPlanning(FFTPlanning::Estimate);
+			setFFTWisdomFile("");
+		}
 	}
 }
@@ -6,6 +6,7 @@
 
 #include "image.h"
 #include "math/vec3.h"
+#include "stringutils.h"
 
 namespace itl2
 {
@@ -15,6 +16,113 @@ namespace itl2
 	*/
 	void initFFTW();
 
+	/**
+	Amount of effort that is spent on finding a fast algorithm for each FFT size.
+	*/
+	enum class FFTPlanning
+	{
+		/**
+		Select the algorithm heuristically without running any transforms.
+		*/
+		Estimate,
+		/**
+		Time several algorithms and select the fastest one.
+		Planning of a large transform may take seconds, but it is done only once per transform size and process.
+		*/
+		Measure,
+		/**
+		Like Measure, but time a larger set of algorithms.
+		*/
+		Patient
+	};
+
+	inline std::ostream& operator<<(std::ostream& stream, const FFTPlanning& x)
+	{
+		switch (x)
+		{
+		case FFTPlanning::Estimate: stream << "Estimate"; return stream;
+		case FFTPlanning::Measure: stream << "Measure"; return stream;
+		case FFTPlanning::Patient: stream << "Patient"; return stream;
+		}
+		throw ITLException("Invalid FFT planning mode.");
+	}
+
+	template<>
+	inline FFTPlanning fromString(const string& str0)
+	{
+		string str = str0;
+		toLower(str);
+		if (str == "estimate")
+			return FFTPlanning::Estimate;
+		if (str == "measure")
+			return FFTPlanning::Measure;
+		if (str == "patient")
+			return FFTPlanning::Patient;
+
+		throw ITLException("Invalid FFT planning mode: " + str0);
+	}
+
+	/**
+	Sets the planning effort used for FFT plans that are created from now on.
+	Plans that have already been created are not re-created.
+	The default value is FFTPlanning::Estimate.
+	*/
+	void setFFTPlanning(FFTPlanning planning);
+
+	/**
+	Gets the planning effort used for new FFT plans.
+	*/
+	FFTPlanning getFFTPlanning();
+
+	/**
+	Sets the file where FFTW wisdom is stored.
+	Wisdom in the file is imported immediately, and the file is re-written every time a new plan
+	is created with FFTPlanning::Measure or FFTPlanning::Patient.
+	Set to empty string to stop saving wisdom.
+	*/
+	void setFFTWisdomFile(const string& filename);
+
+	namespace internals
+	{
+		/**
+		Kinds of transforms available from the FFT plan cache.
+		*/
+		enum class FFTKind
+		{
+			/**
+			Discrete Cosine Transform, float32_t to float32_t.
+			*/
+			DCT,
+			/**
+			Inverse Discrete Cosine Transform, float32_t to float32_t.
+			*/
+			IDCT,
+			/**
+			Forward FFT, float32_t to complex32_t.
+			*/
+			RealToComplex,
+			/**
+			Inverse FFT, complex32_t to float32_t. The input is overwritten.
+			*/
+			ComplexToReal,
+			/**
+			Forward FFT, complex32_t to complex32_t.
+			*/
+			ComplexForward
+		};
+
+		/**
+		Gets a plan from the process-wide plan cache, and creates the plan if it has not been created yet.
+		The plan can be used for any arrays whose alignment and placement (in-place or out-of-place) match those of in and out.
+		It must be executed with the new-array execute functions, e.g. fftwf_execute_dft_r2c(plan, in, out),
+		as the arrays in and out are not used in the planning.
+		The plans are owned by the cache and must not be destroyed.
+		This function can be called from multiple threads simultaneously.
+		@param dimensions Size of the transform. For real-to-complex and complex-to-real transforms, this is the size of the real data.
+		*/
+		fftwf_plan getFFTPlan(FFTKind kind, size_t dimensionality, const Vec3c& dimensions, const void* in, const void* out);
+	}
+
 	/**
 	Calculates Discrete Cosine Transform of the input image.
 	Calculates 1D DCT if img is 1-dimensional, 2D DCT if img is 2-dimensional etc.
@@ -98,5 +206,6 @@ namespace itl2
 		void phaseCorrelation();
 		void phaseCorrelation2();
 		void modulo();
+		void fftPlanCache();
 	}
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "io/raw.h"
 #include "conversions.h"
 #include "projections.h"
+#include "noise.h"
 
 namespace itl2
 {
@@ -143,6 +144,80 @@ namespace itl2
 			raw::writed(filtered2, "./filters/test_rect_rect_filtered_xy");
 		}
 
+		/**
+		Median filter that copies the neighbourhood to an image, for comparison with filtering through neighbourhood views.
+		*/
+		template<typename pixel_t> typename NumberUtils<pixel_t>::FloatType copyingMedianOp(const Image<pixel_t>& nb, const Image<pixel_t>& mask)
+		{
+			std::vector<pixel_t> values;
+			for (coord_t n = 0; n < nb.pixelCount(); n++)
+			{
+				if (mask(n) != 0)
+					values.push_back(nb(n));
+			}
+			return calcMedian(values);
+		}
+
+		void neighbourhoodViewFiltering()
+		{
+			// Image that is smaller than the neighbourhood in z-direction, so that some rows do not have any interior pixels.
+			Image<uint16_t> img(30, 25, 4);
+			noise(img, 1000, 200, 123);
+
+			Image<uint16_t> viewResult;
+			Image<uint16_t> copyResult;
+			for (BoundaryCondition bc : { BoundaryCondition::Zero, BoundaryCondition::Nearest })
+			{
+				medianFilter(img, viewResult, Vec3c(3, 2, 3), NeighbourhoodType::Ellipsoidal, bc);
+				filter<uint16_t, uint16_t, copyingMedianOp<uint16_t> >(img, copyResult, Vec3c(3, 2, 3), NeighbourhoodType::Ellipsoidal, bc);
+				testAssert(equals(viewResult, copyResult), string("median filter through neighbourhood view, ") + toString(bc));
+
+				medianFilter(img, viewResult, Vec3c(1, 4, 1), NeighbourhoodType::Rectangular, bc);
+				filter<uint16_t, uint16_t, copyingMedianOp<uint16_t> >(img, copyResult, Vec3c(1, 4, 1), NeighbourhoodType::Rectangular, bc);
+				testAssert(equals(viewResult, copyResult), string("rectangular median filter through neighbourhood view, ") + toString(bc));
+			}
+		}
+
+		template<typename pixel_t> void testHistogramPercentileFilter(const Image<pixel_t>& img, const Vec3c& r, NeighbourhoodType nbType, BoundaryCondition bc)
+		{
+			Image<pixel_t> fast;
+			Image<pixel_t> reference;
+
+			medianFilter(img, fast, r, nbType, bc, true);
+			medianFilter(img, reference, r, nbType, bc, false);
+			testAssert(equals(fast, reference), string("sliding histogram median filter, ") + toString(nbType) + ", " + toString(bc));
+
+			percentileFilter(img, fast, r, 0.2, nbType, bc, true);
+			percentileFilter(img, reference, r, 0.2, nbType, bc, false);
+			testAssert(equals(fast, reference), string("sliding histogram percentile filter, ") + toString(nbType) + ", " + toString(bc));
+
+			percentileFilter(img, fast, r, 1.0, nbType, bc, true);
+			maxFilter(img, reference, r, nbType, bc, false);
+			testAssert(equals(fast, reference), string("sliding histogram percentile filter vs max filter, ") + toString(nbType) + ", " + toString(bc));
+		}
+
+		void histogramPercentileFilter()
+		{
+			Image<uint8_t> img8(40, 30, 20);
+			noise(img8, 128, 40, 1);
+
+			Image<uint16_t> img16(40, 30, 20);
+			noise(img16, 1000, 300, 2);
+
+			Image<uint16_t> img2D(50, 40);
+			noise(img2D, 1000, 300, 3);
+
+			for (NeighbourhoodType nbType : { NeighbourhoodType::Ellipsoidal, NeighbourhoodType::Rectangular })
+			{
+				for (BoundaryCondition bc : { BoundaryCondition::Zero, BoundaryCondition::Nearest })
+				{
+					testHistogramPercentileFilter(img8, Vec3c(3, 2, 4), nbType, bc);
+					testHistogramPercentileFilter(img16, Vec3c(2, 3, 1), nbType, bc);
+					testHistogramPercentileFilter(img2D, Vec3c(4, 4, 4), nbType, bc);
+				}
+			}
+		}
+
 		void bilateral()
 		{
 			// NOTE: No asserts!
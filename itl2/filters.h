@@ -10,6 +10,7 @@
 #include "utilities.h"
 #include "fastmaxminfilters.h"
 #include "median.h"
+#include "percentilefilter.h"
 
 namespace itl2
 {
@@ -110,17 +111,125 @@ namespace itl2
 		}
 	}
 
+	namespace internals
+	{
+		/**
+		Filter input image and place result to output image.
+		Neighbourhoods that are completely inside the input image are accessed directly in the input image. Only neighbourhoods
+		closer than nbRadius to the image edges are copied to a temporary image where the boundary condition is applied.
+		@param processNeighbourhood Callable that produces output value given a NeighbourhoodView.
+		*/
+		template<typename pixel_t, typename out_t, typename F>
+		void filterNeighbourhoodViews(const Image<pixel_t>& img, Image<out_t>& out, Vec3c nbRadius, NeighbourhoodType nbType, BoundaryCondition bc, F processNeighbourhood)
+		{
+			out.mustNotBe(img);
+			out.ensureSize(img);
+
+			// Zero radius in those dimensions that are not in use
+			for (size_t n = img.dimensionality(); n < nbRadius.size(); n++)
+				nbRadius[n] = 0;
+
+			Image<pixel_t> mask;
+			createNeighbourhoodMask(nbType, nbRadius, mask);
+
+			NeighbourhoodOffsets imgOffsets(mask, img.dimensions());
+			NeighbourhoodOffsets nbOffsets(mask, mask.dimensions());
+			const pixel_t* pImg = img.getData();
+
+			size_t totalProcessed = 0;
+			#pragma omp parallel if(!omp_in_parallel() && img.pixelCount() > PARALLELIZATION_THRESHOLD)
+			{
+
+				Image<pixel_t> nb(mask.dimensions());
+				NeighbourhoodView<pixel_t> edgeView(nb.getData() + nb.getLinearIndex(nbRadius), nbOffsets);
+
+				#pragma omp for
+				for (coord_t z = 0; z < img.depth(); z++)
+				{
+					for (coord_t y = 0; y < img.height(); y++)
+					{
+						// Neighbourhoods in range [xStart, xEnd[ are inside the image if the row is far enough from the edges in y and z directions.
+						coord_t xStart = 0;
+						coord_t xEnd = 0;
+						if (z >= nbRadius.z && z < img.depth() - nbRadius.z && y >= nbRadius.y && y < img.height() - nbRadius.y)
+						{
+							xStart = std::min(nbRadius.x, img.width());
+							xEnd = std::max(xStart, img.width() - nbRadius.x);
+						}
+
+						for (coord_t x = 0; x < img.width(); x++)
+						{
+							if (x >= xStart && x < xEnd)
+							{
+								NeighbourhoodView<pixel_t> view(pImg + img.getLinearIndex(x, y, z), imgOffsets);
+								out(x, y, z) = pixelRound<out_t>(processNeighbourhood(view));
+							}
+							else
+							{
+								getNeighbourhood(img, Vec3c(x, y, z), nbRadius, nb, bc);
+								out(x, y, z) = pixelRound<out_t>(processNeighbourhood(edgeView));
+							}
+						}
+					}
+
+					showThreadProgress(totalProcessed, img.depth());
+				}
+			}
+		}
+	}
+
+	/**
+	Filter input image and place result to output image.
+	This version gives the neighbourhood to the processing function as a view to the input image, and it does not copy the neighbourhood pixels
+	except near the image edges.
+	@param pixel_t Pixel data type in input image.
+	@param out_t Pixel data type in output image.
+	@param processNeighbourhood Processing function that produces output value given the pixels inside the neighbourhood.
+	@param img Input image.
+	@param nbType Type of neighbourhood to use.
+	@param nbRadius Radius of the neighbourhood.
+	@param out Output image.
+	*/
+	template<typename pixel_t, typename out_t, typename NumberUtils<pixel_t>::FloatType processNeighbourhood(const NeighbourhoodView<pixel_t>& nb)>
+	void filter(const Image<pixel_t>& img, Image<out_t>& out, Vec3c nbRadius, NeighbourhoodType nbType, BoundaryCondition bc)
+	{
+		internals::filterNeighbourhoodViews(img, out, nbRadius, nbType, bc,
+			[](const NeighbourhoodView<pixel_t>& nb) { return processNeighbourhood(nb); });
+	}
+
+	/**
+	Filter input image and place result to output image.
+	This version gives the neighbourhood to the processing function as a view to the input image, and it does not copy the neighbourhood pixels
+	except near the image edges.
+	@param pixel_t Pixel data type in input image.
+	@param out_t Pixel data type in output image.
+	@param param_t Type of parameter.
+	@param processNeighbourhood Processing function that produces output value given the pixels inside the neighbourhood and parameter value.
+	@param img Input image.
+	@param nbType Type of neighbourhood to use.
+	@param nbRadius Radius of the neighbourhood.
+	@param out Output image.
+	@param parameter Parameter that is given directly to processNeighbourhood function.
+	*/
+	template<typename pixel_t, typename out_t, typename param_t, typename NumberUtils<pixel_t>::FloatType processNeighbourhood(const NeighbourhoodView<pixel_t>& nb, param_t parameter)>
+	void filter(const Image<pixel_t>& img, Image<out_t>& out, Vec3c nbRadius, const param_t parameter, NeighbourhoodType nbType, BoundaryCondition bc)
+	{
+		internals::filterNeighbourhoodViews(img, out, nbRadius, nbType, bc,
+			[&parameter](const NeighbourhoodView<pixel_t>& nb) { return processNeighbourhood(nb, parameter); });
+	}
+
 	namespace internals
 	{
 		/**
 		Separable filtering helper (for one image+parameter).
 		*/
-		template<typename pixel_t, typename param_t, typename NumberUtils<pixel_t>::FloatType processNeighbourhood(const Image<pixel_t>& nb, const Image<pixel_t>& mask, param_t param)>
+		template<typename pixel_t, typename param_t, typename NumberUtils<pixel_t>::FloatType processNeighbourhood(const NeighbourhoodView<pixel_t>& nb, param_t param)>
 		void sepFilterOneDimension(Image<pixel_t>& img, coord_t r, size_t dim, param_t param, BoundaryCondition bc, bool showProgressInfo = true)
 		{
 			coord_t N = 2 * r + 1;
 			Image<pixel_t> mask(N);
 			setValue(mask, (pixel_t)1);
+			NeighbourhoodOffsets offsets(mask, mask.dimensions());
 
 			size_t counter = 0;
 
@@ -129,6 +238,7 @@ namespace itl2
 				#pragma omp parallel if(!omp_in_parallel() && img.pixelCount() > PARALLELIZATION_THRESHOLD)
 				{
 					Image<pixel_t> buffer(N);
+					NeighbourhoodView<pixel_t> nb(buffer.getData() + r, offsets);
 					#pragma omp for
 					for (coord_t z = 0; z < img.depth(); z++)
 					{
@@ -151,7 +261,7 @@ namespace itl2
 							// Process
 							for (coord_t x = 0; x < img.width() - r - 1; x++)
 							{
-								img(x, y, z) = pixelRound<pixel_t>(processNeighbourhood(buffer, mask, param));
+								img(x, y, z) = pixelRound<pixel_t>(processNeighbourhood(nb, param));
 
 								for (coord_t i = 0; i < N - 1; i++)
 									buffer(i) = buffer(i + 1);
@@ -161,7 +271,7 @@ namespace itl2
 							// Process end of line
 							for (coord_t x = std::max((coord_t)0, img.width() - r - 1); x < img.width(); x++)
 							{
-								img(x, y, z) = pixelRound<pixel_t>(processNeighbourhood(buffer, mask, param));
+								img(x, y, z) = pixelRound<pixel_t>(processNeighbourhood(nb, param));
 
 								for (coord_t i = 0; i < N - 1; i++)
 									buffer(i) = buffer(i + 1);
@@ -179,6 +289,7 @@ namespace itl2
 				#pragma omp parallel if(!omp_in_parallel() && img.pixelCount() > PARALLELIZATION_THRESHOLD)
 				{
 					Image<pixel_t> buffer(N);
+					NeighbourhoodView<pixel_t> nb(buffer.getData() + r, offsets);
 					#pragma omp for
 					for (coord_t z = 0; z < img.depth(); z++)
 					{
@@ -201,7 +312,7 @@ namespace itl2
 							// Process
 							for (coord_t y = 0; y < img.height() - r - 1; y++)
 							{
-								img(x, y, z) = pixelRound<pixel_t>(processNeighbourhood(buffer, mask, param));
+								img(x, y, z) = pixelRound<pixel_t>(processNeighbourhood(nb, param));
 
 								for (coord_t i = 0; i < N - 1; i++)
 									buffer(i) = buffer(i + 1);
@@ -211,7 +322,7 @@ namespace itl2
 							// Process end of line
 							for (coord_t y = std::max((coord_t)0, img.height() - r - 1); y < img.height(); y++)
 							{
-								img(x, y, z) = pixelRound<pixel_t>(processNeighbourhood(buffer, mask, param));
+								img(x, y, z) = pixelRound<pixel_t>(processNeighbourhood(nb, param));
 
 								for (coord_t i = 0; i < N - 1; i++)
 									buffer(i) = buffer(i + 1);
@@ -229,6 +340,7 @@ namespace itl2
 				#pragma omp parallel if(!omp_in_parallel() && img.pixelCount() > PARALLELIZATION_THRESHOLD)
 				{
 					Image<pixel_t> buffer(N);
+					NeighbourhoodView<pixel_t> nb(buffer.getData() + r, offsets);
 					#pragma omp for
 					for (coord_t y = 0; y < img.height(); y++)
 					{
@@ -251,7 +363,7 @@ namespace itl2
 							// Process
 							for (coord_t z = 0; z < img.depth() - r - 1; z++)
 							{
-								img(x, y, z) = pixelRound<pixel_t>(processNeighbourhood(buffer, mask, param));
+								img(x, y, z) = pixelRound<pixel_t>(processNeighbourhood(nb, param));
 
 								for (coord_t i = 0; i < N - 1; i++)
 									buffer(i) = buffer(i + 1);
@@ -261,7 +373,7 @@ namespace itl2
 							// Process end of line
 							for (coord_t z = std::max((coord_t)0, img.depth() - r - 1); z < img.depth(); z++)
 							{
-								img(x, y, z) = pixelRound<pixel_t>(processNeighbourhood(buffer, mask, param));
+								img(x, y, z) = pixelRound<pixel_t>(processNeighbourhood(nb, param));
 
 								for (coord_t i = 0; i < N - 1; i++)
 									buffer(i) = buffer(i + 1);
@@ -280,12 +392,12 @@ namespace itl2
 			}
 		}
 
-		template<typename pixel_t, typename NumberUtils<pixel_t>::FloatType processNeighbourhood(const Image<pixel_t>& nb, const Image<pixel_t>& mask)> typename NumberUtils<pixel_t>::FloatType paramRemover(const Image<pixel_t>& nb, const Image<pixel_t>& mask, int param)
+		template<typename pixel_t, typename NumberUtils<pixel_t>::FloatType processNeighbourhood(const NeighbourhoodView<pixel_t>& nb)> typename NumberUtils<pixel_t>::FloatType paramRemover(const NeighbourhoodView<pixel_t>& nb, int param)
 		{
-			return processNeighbourhood(nb, mask);
+			return processNeighbourhood(nb);
 		}
 
-		template<typename pixel_t, typename NumberUtils<pixel_t>::FloatType processNeighbourhood(const Image<pixel_t>& nb, const Image<pixel_t>& mask)>
+		template<typename pixel_t, typename NumberUtils<pixel_t>::FloatType processNeighbourhood(const NeighbourhoodView<pixel_t>& nb)>
 		void sepFilterOneDimension(Image<pixel_t>& img, coord_t r, size_t dim, BoundaryCondition bc, bool showProgressInfo = true)
 		{
 			internals::sepFilterOneDimension<pixel_t, int, internals::paramRemover<pixel_t, processNeighbourhood> >(img, r, dim, 0, bc, showProgressInfo);
@@ -529,11 +641,11 @@ namespace itl2
 	Filter each dimension of the input image using the same processing function (separable filtering).
 	Neighbourhood type is always Rectangular.
 	@param pixel_t Pixel data type in the image. If the processing function produces real numbers, make sure that this data type can store them with adequate accuracy.
-	@param processNeighbourhood Processing function that produces output value image of a neighbourhood and corresponding mask.
+	@param processNeighbourhood Processing function that produces output value given the pixels of a neighbourhood.
 	@param img Image to filter. The image is filtered in-place.
 	@param nbRadius Radius of the neighbourhood.
 	*/
-	template<typename pixel_t, typename NumberUtils<pixel_t>::FloatType processNeighbourhood(const Image<pixel_t>& nb, const Image<pixel_t>& mask)>
+	template<typename pixel_t, typename NumberUtils<pixel_t>::FloatType processNeighbourhood(const NeighbourhoodView<pixel_t>& nb)>
 	void sepFilter(Image<pixel_t>& img, const Vec3c& nbRadius, BoundaryCondition bc, bool showProgressInfo = true)
 	{
 		for (size_t n = 0; n < std::max<size_t>(1, img.dimensionality()); n++)
@@ -546,12 +658,12 @@ namespace itl2
 	Filter each dimension of the input image using the same processing function (separable filtering).
 	Neighbourhood type is always Rectangular.
 	@param pixel_t Pixel data type in the image. If the processing function produces real numbers, make sure that this data type can store them with adequate accuracy.
-	@param processNeighbourhood Processing function that produces output value image of a neighbourhood and corresponding mask.
+	@param processNeighbourhood Processing function that produces output value given the pixels of a neighbourhood and parameter value.
 	@param img Image to filter. The image is filtered in-place.
 	@param nbRadius Radius of the neighbourhood.
 	@param param Parameter for each dimension.
 	*/
-	template<typename pixel_t, typename param_t, typename NumberUtils<pixel_t>::FloatType processNeighbourhood(const Image<pixel_t>& nb, const Image<pixel_t>& mask, param_t param)>
+	template<typename pixel_t, typename param_t, typename NumberUtils<pixel_t>::FloatType processNeighbourhood(const NeighbourhoodView<pixel_t>& nb, param_t param)>
 	void sepFilter(Image<pixel_t>& img, const Vec3c& nbRadius, const Vec3<param_t>& params, BoundaryCondition bc, bool showProgressInfo = true)
 	{
 		// NOTE: (see also sepgauss)
@@ -591,36 +703,23 @@ namespace itl2
 
 	namespace internals
 	{
-		// TODO: Filtering can be made faster for rectangular neighbourhoods where mask lookup is not required.
-		// In practice the speed improvement is quite minor when compared to more complicated processes.
-
-		template<typename pixel_t> typename NumberUtils<pixel_t>::FloatType meanOp(const Image<pixel_t>& nb, const Image<pixel_t>& mask)
+		template<typename pixel_t> typename NumberUtils<pixel_t>::FloatType meanOp(const NeighbourhoodView<pixel_t>& nb)
 		{
 			typename NumberUtils<pixel_t>::FloatType sum = 0;
-			typename NumberUtils<pixel_t>::RealFloatType count = 0;
-			for (coord_t n = 0; n < nb.pixelCount(); n++)
-			{
-				typename NumberUtils<pixel_t>::FloatType val = (typename NumberUtils<pixel_t>::FloatType)nb(n);
-				typename NumberUtils<pixel_t>::RealFloatType w = (typename NumberUtils<pixel_t>::RealFloatType)mask(n);
-
-				sum += val * w;
-				count += w;
-			}
-			return sum / count;
+			for (size_t n = 0; n < nb.size(); n++)
+				sum += (typename NumberUtils<pixel_t>::FloatType)nb[n];
+			return sum / (typename NumberUtils<pixel_t>::RealFloatType)nb.size();
 		}
 
-		template<typename pixel_t> typename NumberUtils<pixel_t>::FloatType varianceOp(const Image<pixel_t>& nb, const Image<pixel_t>& mask)
+		template<typename pixel_t> typename NumberUtils<pixel_t>::FloatType varianceOp(const NeighbourhoodView<pixel_t>& nb)
 		{
-			typename NumberUtils<pixel_t>::RealFloatType count = 0;
+			typename NumberUtils<pixel_t>::RealFloatType count = (typename NumberUtils<pixel_t>::RealFloatType)nb.size();
 			typename NumberUtils<pixel_t>::FloatType total = 0;
 			typename NumberUtils<pixel_t>::FloatType total2 = 0;
 
-			for (coord_t n = 0; n < nb.pixelCount(); n++)
+			for (size_t n = 0; n < nb.size(); n++)
 			{
-				typename NumberUtils<pixel_t>::FloatType val = (typename NumberUtils<pixel_t>::FloatType)nb(n);
-				typename NumberUtils<pixel_t>::RealFloatType w = (typename NumberUtils<pixel_t>::RealFloatType)mask(n);
-				count += w; // Note: w is either 0 or 1
-				val *= w;
+				typename NumberUtils<pixel_t>::FloatType val = (typename NumberUtils<pixel_t>::FloatType)nb[n];
 				total += val;
 				total2 += val * val;
 			}
@@ -630,56 +729,68 @@ namespace itl2
 			return var;
 		}
 
-		template<typename pixel_t> typename NumberUtils<pixel_t>::FloatType medianOp(const Image<pixel_t>& nb, const Image<pixel_t>& mask)
+		template<typename pixel_t> typename NumberUtils<pixel_t>::FloatType medianOp(const NeighbourhoodView<pixel_t>& nb)
 		{
 			std::vector<pixel_t> values;
-			values.reserve(nb.pixelCount());
+			values.reserve(nb.size());
 
-			for (coord_t n = 0; n < nb.pixelCount(); n++)
-			{
-				if (mask(n) != 0)
-					values.push_back(nb(n));
-			}
+			for (size_t n = 0; n < nb.size(); n++)
+				values.push_back(nb[n]);
 
 			return calcMedian(values);
 		}
 
-		template<typename pixel_t> typename NumberUtils<pixel_t>::FloatType maskedMedianOp(const Image<pixel_t>& nb, const Image<pixel_t>& mask, pixel_t badValue)
+		template<typename pixel_t> typename NumberUtils<pixel_t>::FloatType percentileOp(const NeighbourhoodView<pixel_t>& nb, double percentile)
+		{
+			std::vector<pixel_t> values;
+			values.reserve(nb.size());
+
+			for (size_t n = 0; n < nb.size(); n++)
+				values.push_back(nb[n]);
+
+			if (values.size() <= 0)
+				return pixel_t();
+
+			size_t rank = percentileRank(percentile, values.size());
+			std::nth_element(values.begin(), values.begin() + rank, values.end());
+			return (typename NumberUtils<pixel_t>::FloatType)values[rank];
+		}
+
+		template<typename pixel_t> typename NumberUtils<pixel_t>::FloatType maskedMedianOp(const NeighbourhoodView<pixel_t>& nb, pixel_t badValue)
 		{
 			std::vector<pixel_t> values;
-			values.reserve(nb.pixelCount());
+			values.reserve(nb.size());
 
-			for (coord_t n = 0; n < nb.pixelCount(); n++)
+			for (size_t n = 0; n < nb.size(); n++)
 			{
-				if (mask(n) != 0 && nb(n) != badValue)
-					values.push_back(nb(n));
+				pixel_t val = nb[n];
+				if (val != badValue)
+					values.push_back(val);
 			}
 
 			return calcMedian(values);
 		}
 
-		template<typename pixel_t> typename NumberUtils<pixel_t>::FloatType minOp(const Image<pixel_t>& nb, const Image<pixel_t>& mask)
+		template<typename pixel_t> typename NumberUtils<pixel_t>::FloatType minOp(const NeighbourhoodView<pixel_t>& nb)
 		{
 			typename NumberUtils<pixel_t>::FloatType res = std::numeric_limits<typename NumberUtils<pixel_t>::FloatType>::max();
-			for (coord_t n = 0; n < nb.pixelCount(); n++)
+			for (size_t n = 0; n < nb.size(); n++)
 			{
-				typename NumberUtils<pixel_t>::FloatType val = (typename NumberUtils<pixel_t>::FloatType)nb(n);
-				if (mask(n) != 0 && val < res)
+				typename NumberUtils<pixel_t>::FloatType val = (typename NumberUtils<pixel_t>::FloatType)nb[n];
+				if (val < res)
 					res = val;
-
 			}
 			return res;
 		}
 
-		template<typename pixel_t> typename NumberUtils<pixel_t>::FloatType maxOp(const Image<pixel_t>& nb, const Image<pixel_t>& mask)
+		template<typename pixel_t> typename NumberUtils<pixel_t>::FloatType maxOp(const NeighbourhoodView<pixel_t>& nb)
 		{
 			typename NumberUtils<pixel_t>::FloatType res = std::numeric_limits<typename NumberUtils<pixel_t>::FloatType>::lowest();
-			for (coord_t n = 0; n < nb.pixelCount(); n++)
+			for (size_t n = 0; n < nb.size(); n++)
 			{
-				typename NumberUtils<pixel_t>::FloatType val = (typename NumberUtils<pixel_t>::FloatType)nb(n);
-				if (mask(n) != 0 && val > res)
+				typename NumberUtils<pixel_t>::FloatType val = (typename NumberUtils<pixel_t>::FloatType)nb[n];
+				if (val > res)
 					res = val;
-
 			}
 			return res;
 		}
@@ -709,20 +820,16 @@ namespace itl2
 		/**
 		Variance weighted mean filter.
 		*/
-		template<typename pixel_t> typename NumberUtils<pixel_t>::FloatType vaweOp(const Image<pixel_t>& nb, const Image<pixel_t>& mask, double noiseStdDev)
+		template<typename pixel_t> typename NumberUtils<pixel_t>::FloatType vaweOp(const NeighbourhoodView<pixel_t>& nb, double noiseStdDev)
 		{
 			typename NumberUtils<pixel_t>::FloatType sum = 0.0;
 			typename NumberUtils<pixel_t>::FloatType sum_sqr = 0.0;
-			typename NumberUtils<pixel_t>::RealFloatType count = 0;
-			for (coord_t n = 0; n < nb.pixelCount(); n++)
+			typename NumberUtils<pixel_t>::RealFloatType count = (typename NumberUtils<pixel_t>::RealFloatType)nb.size();
+			for (size_t n = 0; n < nb.size(); n++)
 			{
-				if (mask(n) != 0)
-				{
-					typename NumberUtils<pixel_t>::FloatType pix = (typename NumberUtils<pixel_t>::FloatType)nb(n);
-					sum += pix;
-					sum_sqr += pix * pix;
-					count++;
-				}
+				typename NumberUtils<pixel_t>::FloatType pix = (typename NumberUtils<pixel_t>::FloatType)nb[n];
+				sum += pix;
+				sum_sqr += pix * pix;
 			}
 
 			typename NumberUtils<pixel_t>::FloatType mean = sum / count;
@@ -735,52 +842,56 @@ namespace itl2
 			else
 				multip = 1;
 
-			typename NumberUtils<pixel_t>::FloatType pixel = (typename NumberUtils<pixel_t>::FloatType)nb(nb.pixelCount() / 2);
+			typename NumberUtils<pixel_t>::FloatType pixel = (typename NumberUtils<pixel_t>::FloatType)nb.center();
 			return pixel - (multip * (pixel - mean));
 		}
 
 
+		/**
+		Parameters of bilateral filter.
+		*/
+		struct BilateralParams
+		{
+			/**
+			Spatial weight of each pixel in the neighbourhood, in the order of pixels in NeighbourhoodView.
+			*/
+			std::vector<double> spatialWeights;
+
+			/**
+			Standard deviation of the range kernel.
+			*/
+			double rangeSigma;
+		};
+
 		/**
 		Bilateral filter
-		Mask is not used.
 		*/
-		template<typename pixel_t> typename NumberUtils<pixel_t>::FloatType bilateralOp(const Image<pixel_t>& nb, const Image<pixel_t>& mask, Vec2d spatialandrangesigma)
+		template<typename pixel_t> typename NumberUtils<pixel_t>::FloatType bilateralOp(const NeighbourhoodView<pixel_t>& nb, const BilateralParams* params)
 		{
-			typename NumberUtils<pixel_t>::RealFloatType sigmas = (typename NumberUtils<pixel_t>::RealFloatType)spatialandrangesigma[0];
-			typename NumberUtils<pixel_t>::RealFloatType sigmat = (typename NumberUtils<pixel_t>::RealFloatType)spatialandrangesigma[1];
+			typename NumberUtils<pixel_t>::RealFloatType sigmat = (typename NumberUtils<pixel_t>::RealFloatType)params->rangeSigma;
 
 
 			typename NumberUtils<pixel_t>::FloatType sum = 0.0;
 			typename NumberUtils<pixel_t>::RealFloatType wsum = 0.0;
 
-			Vec3c center((nb.dimensions() - Vec3c(1, 1, 1)) / 2);
-			typename NumberUtils<pixel_t>::FloatType centerVal = (typename NumberUtils<pixel_t>::FloatType)nb(center);
+			typename NumberUtils<pixel_t>::FloatType centerVal = (typename NumberUtils<pixel_t>::FloatType)nb.center();
 
-			for (coord_t z = 0; z < nb.depth(); z++)
+			for (size_t n = 0; n < nb.size(); n++)
 			{
-				for (coord_t y = 0; y < nb.height(); y++)
-				{
-					for (coord_t x = 0; x < nb.width(); x++)
-					{
-						typename NumberUtils<pixel_t>::FloatType pix = (typename NumberUtils<pixel_t>::FloatType)nb(x, y, z);
-						
-						typename NumberUtils<pixel_t>::RealFloatType r2 = (Vec3c(x, y, z) - center).normSquared<typename NumberUtils<pixel_t>::RealFloatType>();
-						//double r2 = (x - cx) * (x - cx) + (y - cy) * (y - cy) + (z - cz) * (z - cz);
-						typename NumberUtils<pixel_t>::FloatType c = pix - centerVal;
+				typename NumberUtils<pixel_t>::FloatType pix = (typename NumberUtils<pixel_t>::FloatType)nb[n];
+				typename NumberUtils<pixel_t>::FloatType c = pix - centerVal;
 
-						typename NumberUtils<pixel_t>::RealFloatType w = (typename NumberUtils<pixel_t>::RealFloatType)(
-							(1 / (sigmas * sqrt(2 * PI)) * ::exp(-(r2) / (2 * sigmas * sigmas))) *	    // Spatial
-							(1 / (sigmat * sqrt(2 * PI)) * ::exp(-(c * c) / (2 * sigmat * sigmat)))     // Range
-							);
-						// This approximation seems to create decent quality image but it is not really faster.
-						//double w = (1 / (2 * PI)) * normPdfApprox(sqrt(r2), 0, sigmas)    // Spatial
-						//	* normPdfApprox(c, 0, sigmat);								// Range
+				typename NumberUtils<pixel_t>::RealFloatType w = (typename NumberUtils<pixel_t>::RealFloatType)(
+					params->spatialWeights[n] *													// Spatial
+					(1 / (sigmat * sqrt(2 * PI)) * ::exp(-(c * c) / (2 * sigmat * sigmat)))     // Range
+					);
+				// This approximation seems to create decent quality image but it is not really faster.
+				//double w = (1 / (2 * PI)) * normPdfApprox(sqrt(r2), 0, sigmas)    // Spatial
+				//	* normPdfApprox(c, 0, sigmat);								// Range
 
 
-						sum += pix * w;
-						wsum += w;
-					}
-				}
+				sum += pix * w;
+				wsum += w;
 			}
 
 			return sum / wsum;
@@ -788,40 +899,35 @@ namespace itl2
 
 		/*
 		Convolution for 1D case (for use in separable filtering).
-		Mask is not used, so this works only with rectangular neighbourhood.
+		Works only with rectangular neighbourhood.
 		Kernel size must match neighbourhood size.
 		*/
-		template<typename pixel_t> typename NumberUtils<pixel_t>::FloatType convolution1DOp(const Image<pixel_t>& nb, const Image<pixel_t>& mask, const Image<float32_t>* kernel)
+		template<typename pixel_t> typename NumberUtils<pixel_t>::FloatType convolution1DOp(const NeighbourhoodView<pixel_t>& nb, const Image<float32_t>* kernel)
 		{
 			typename NumberUtils<pixel_t>::FloatType sum = 0;
 			coord_t N = kernel->pixelCount() - 1;
 			for(coord_t n = 0; n <= N; n++)
 			{
-				sum += (typename NumberUtils<pixel_t>::FloatType)nb(n) * (typename NumberUtils<pixel_t>::RealFloatType)(*kernel)(N - n);
+				sum += (typename NumberUtils<pixel_t>::FloatType)nb[n] * (typename NumberUtils<pixel_t>::RealFloatType)(*kernel)(N - n);
 			}
 			return sum;
 		}
 
 		/*
 		Convolution.
-		Mask is not used, so this works only with rectangular neighbourhood.
+		Works only with rectangular neighbourhood.
 		Kernel size must match neighbourhood size.
 		*/
-		template<typename pixel_t> typename NumberUtils<pixel_t>::FloatType convolution3DOp(const Image<pixel_t>& nb, const Image<pixel_t>& mask, const Image<float32_t>* kernel)
+		template<typename pixel_t> typename NumberUtils<pixel_t>::FloatType convolution3DOp(const NeighbourhoodView<pixel_t>& nb, const Image<float32_t>* kernel)
 		{
 			typename NumberUtils<pixel_t>::FloatType sum = 0;
-			Vec3c N = kernel->dimensions() - Vec3c(1, 1, 1);
-			for (coord_t z = 0; z < nb.depth(); z++)
+			const Vec3c& r = nb.radius();
+			for (size_t n = 0; n < nb.size(); n++)
 			{
-				for (coord_t y = 0; y < nb.height(); y++)
-				{
-					for (coord_t x = 0; x < nb.width(); x++)
-					{
-						typename NumberUtils<pixel_t>::FloatType pix = (typename NumberUtils<pixel_t>::FloatType)nb(x, y, z);
-						typename NumberUtils<pixel_t>::RealFloatType weight = (typename NumberUtils<pixel_t>::RealFloatType)(*kernel)(N.x - x, N.y - y, N.z - z);
-						sum += pix * weight;
-					}
-				}
+				const Vec3c& p = nb.position(n);
+				typename NumberUtils<pixel_t>::FloatType pix = (typename NumberUtils<pixel_t>::FloatType)nb[n];
+				typename NumberUtils<pixel_t>::RealFloatType weight = (typename NumberUtils<pixel_t>::RealFloatType)(*kernel)(r.x - p.x, r.y - p.y, r.z - p.z);
+				sum += pix * weight;
 			}
 			return sum;
 		}
@@ -1507,13 +1613,97 @@ template<typename pixel_t, typename out_t> void name##Filter(const Image<pixel_t
 	DEFINE_FILTER_MINMAX(min, Calculates minimum filtering.)
 	DEFINE_FILTER_MINMAX(max, Calculates maximum filtering.)
 	DEFINE_FILTER_SEP_FLOAT(mean, Calculates mean filtering.)
-	DEFINE_FILTER(median, Calculates median filtering.)
 	DEFINE_FILTER_1PARAM(maskedMedian, pixel_t, Calculates masked median filtering., Image value that should not be considered when calculating median.)
 
 	#define COMMA ,
 	DEFINE_FILTER_1PARAM(vawe, double, Calculates variance weighted mean filtering., Standard deviation of noise. For a rough order of magnitude estimateCOMMA measure standard deviation from a region that does not contain any features.)
 
 
+	/**
+	Calculates median filtering.
+
+	If allowOpt is true, 8- and 16-bit unsigned images are filtered using sliding histogram algorithm.
+	@param in Input image.
+	@param out Output image.
+	@param nbRadius Radius of filtering neighbourhood.
+	@param nbType Neighbourhood type.
+	@param bc Boundary condition.
+	@param allowOpt Set to true to allow use of the sliding histogram algorithm. The result is the same in both cases.
+	*/
+	template<typename pixel_t, typename out_t> void medianFilter(const Image<pixel_t>& in, Image<out_t>& out, const Vec3c& nbRadius, NeighbourhoodType nbType = NeighbourhoodType::Ellipsoidal, BoundaryCondition bc = BoundaryCondition::Nearest, bool allowOpt = true)
+	{
+		if constexpr (internals::supportsHistogramPercentileFilter<pixel_t>())
+		{
+			if (allowOpt)
+			{
+				internals::histogramPercentileFilter(in, out, nbRadius, 0.5, nbType, bc);
+				return;
+			}
+		}
+
+		filter<pixel_t, out_t, internals::medianOp<pixel_t> >(in, out, nbRadius, nbType, bc);
+	}
+
+	/**
+	Calculates median filtering.
+
+	If allowOpt is true, 8- and 16-bit unsigned images are filtered using sliding histogram algorithm.
+	@param in Input image.
+	@param out Output image.
+	@param nbRadius Radius of filtering neighbourhood.
+	@param nbType Neighbourhood type.
+	@param bc Boundary condition.
+	@param allowOpt Set to true to allow use of the sliding histogram algorithm. The result is the same in both cases.
+	*/
+	template<typename pixel_t, typename out_t> void medianFilter(const Image<pixel_t>& in, Image<out_t>& out, coord_t nbRadius, NeighbourhoodType nbType = NeighbourhoodType::Ellipsoidal, BoundaryCondition bc = BoundaryCondition::Nearest, bool allowOpt = true)
+	{
+		medianFilter<pixel_t, out_t>(in, out, Vec3c(nbRadius, nbRadius, nbRadius), nbType, bc, allowOpt);
+	}
+
+	/**
+	Calculates percentile filtering, i.e. replaces each pixel by the given percentile of the pixel values in its neighbourhood.
+
+	If allowOpt is true, 8- and 16-bit unsigned images are filtered using sliding histogram algorithm.
+	@param in Input image.
+	@param out Output image.
+	@param nbRadius Radius of filtering neighbourhood.
+	@param percentile Percentile in range [0, 1]. Zero corresponds to minimum filtering, 0.5 to median filtering, and 1 to maximum filtering.
+	@param nbType Neighbourhood type.
+	@param bc Boundary condition.
+	@param allowOpt Set to true to allow use of the sliding histogram algorithm. The result is the same in both cases.
+	*/
+	template<typename pixel_t, typename out_t> void percentileFilter(const Image<pixel_t>& in, Image<out_t>& out, const Vec3c& nbRadius, double percentile, NeighbourhoodType nbType = NeighbourhoodType::Ellipsoidal, BoundaryCondition bc = BoundaryCondition::Nearest, bool allowOpt = true)
+	{
+		if constexpr (internals::supportsHistogramPercentileFilter<pixel_t>())
+		{
+			if (allowOpt)
+			{
+				internals::histogramPercentileFilter(in, out, nbRadius, percentile, nbType, bc);
+				return;
+			}
+		}
+
+		filter<pixel_t, out_t, double, internals::percentileOp<pixel_t> >(in, out, nbRadius, percentile, nbType, bc);
+	}
+
+	/**
+	Calculates percentile filtering, i.e. replaces each pixel by the given percentile of the pixel values in its neighbourhood.
+
+	If allowOpt is true, 8- and 16-bit unsigned images are filtered using sliding histogram algorithm.
+	@param in Input image.
+	@param out Output image.
+	@param nbRadius Radius of filtering neighbourhood.
+	@param percentile Percentile in range [0, 1]. Zero corresponds to minimum filtering, 0.5 to median filtering, and 1 to maximum filtering.
+	@param nbType Neighbourhood type.
+	@param bc Boundary condition.
+	@param allowOpt Set to true to allow use of the sliding histogram algorithm. The result is the same in both cases.
+	*/
+	template<typename pixel_t, typename out_t> void percentileFilter(const Image<pixel_t>& in, Image<out_t>& out, coord_t nbRadius, double percentile, NeighbourhoodType nbType = NeighbourhoodType::Ellipsoidal, BoundaryCondition bc = BoundaryCondition::Nearest, bool allowOpt = true)
+	{
+		percentileFilter<pixel_t, out_t>(in, out, Vec3c(nbRadius, nbRadius, nbRadius), percentile, nbType, bc, allowOpt);
+	}
+
+
 	// Variance requires special handling
 	/**
 	Calculates variance filtering.
@@ -1676,8 +1866,26 @@ template<typename pixel_t, typename out_t> void name##Filter(const Image<pixel_t
 	*/
 	template<typename pixel_t, typename out_t> void bilateralFilter(const Image<pixel_t>& in, Image<out_t>& out, double spatialSigma, double rangeSigma, BoundaryCondition bc = BoundaryCondition::Nearest)
 	{
-		coord_t nbRadius = (coord_t)ceil(3 * spatialSigma);
-		filter<pixel_t, out_t, Vec2d, internals::bilateralOp<pixel_t> >(in, out, Vec3c(nbRadius, nbRadius, nbRadius), Vec2d(spatialSigma, rangeSigma), NeighbourhoodType::Rectangular, bc);
+		coord_t r = (coord_t)ceil(3 * spatialSigma);
+		Vec3c nbRadius(r, r, r);
+		for (size_t n = in.dimensionality(); n < nbRadius.size(); n++)
+			nbRadius[n] = 0;
+
+		// The spatial weights depend only on the position in the neighbourhood, so they are calculated only once.
+		Image<uint8_t> mask;
+		createNeighbourhoodMask(NeighbourhoodType::Rectangular, nbRadius, mask);
+		NeighbourhoodOffsets offsets(mask, mask.dimensions());
+
+		typename NumberUtils<pixel_t>::RealFloatType sigmas = (typename NumberUtils<pixel_t>::RealFloatType)spatialSigma;
+		internals::BilateralParams params;
+		params.rangeSigma = rangeSigma;
+		for (size_t n = 0; n < offsets.size(); n++)
+		{
+			typename NumberUtils<pixel_t>::RealFloatType r2 = offsets.position(n).template normSquared<typename NumberUtils<pixel_t>::RealFloatType>();
+			params.spatialWeights.push_back(1 / (sigmas * sqrt(2 * PI)) * ::exp(-(r2) / (2 * sigmas * sigmas)));
+		}
+
+		filter<pixel_t, out_t, const internals::BilateralParams*, internals::bilateralOp<pixel_t> >(in, out, nbRadius, &params, NeighbourhoodType::Rectangular, bc);
 	}
 
 
@@ -1713,5 +1921,7 @@ template<typename pixel_t, typename out_t> void name##Filter(const Image<pixel_t
 		void separableOptimization();
 		void gaussFilters();
 		void bilateral();
+		void neighbourhoodViewFiltering();
+		void histogramPercentileFilter();
 	}
 }
@@ -7,6 +7,8 @@
 #include "generation.h"
 #include "dmap.h"
 #include "iteration.h"
+#include "noise.h"
+#include "timer.h"
 
 #include "testutils.h"
 
@@ -996,6 +998,127 @@ namespace itl2
 		}
 
 
+		/**
+		Compares wavefront flood fill to single-threaded flood fill.
+		*/
+		void wavefrontTest(const Image<uint8_t>& geom, const Vec3c& start, Connectivity connectivity, const string& name)
+		{
+			Image<uint8_t> filledST, filledWF;
+			setValue(filledST, geom);
+			setValue(filledWF, geom);
+
+			size_t countST, countWF;
+			vector<Vec3sc> pointsST, pointsWF;
+			set<uint8_t> colorsST, colorsWF;
+
+			Timer timer;
+			timer.start();
+			bool resultST = itl2::floodfillSingleThreaded(filledST, start, (uint8_t)128, (uint8_t)128, connectivity, &countST, &pointsST, 0, &colorsST, false);
+			timer.stop();
+			cout << name << ", " << toString(connectivity) << ": single-threaded flood fill took " << timer.getTime() << " ms" << endl;
+
+			timer.start();
+			// Small minimum frontier size to make sure that the multi-threaded code path is tested.
+			bool resultWF = itl2::floodfillWavefront(filledWF, start, (uint8_t)128, (uint8_t)128, connectivity, &countWF, &pointsWF, 0, &colorsWF, false, 1);
+			timer.stop();
+			cout << name << ", " << toString(connectivity) << ": wavefront flood fill took " << timer.getTime() << " ms" << endl;
+
+			testAssert(resultST == resultWF, "wavefront flood fill result, " + name);
+			testAssert(equals(filledST, filledWF), "wavefront flood fill image, " + name);
+			testAssert(countST == countWF, "wavefront flood fill count, " + name);
+			sort(pointsST.begin(), pointsST.end(), vecComparer<int32_t>);
+			sort(pointsWF.begin(), pointsWF.end(), vecComparer<int32_t>);
+			testAssert(pointsST == pointsWF, "wavefront flood fill points, " + name);
+			testAssert(colorsST == colorsWF, "wavefront flood fill neighbouring colors, " + name);
+
+			// Fill limit
+			size_t limit = countST / 2;
+			setValue(filledWF, geom);
+			resultWF = itl2::floodfillWavefront(filledWF, start, (uint8_t)128, (uint8_t)128, connectivity, &countWF, &pointsWF, limit, (set<uint8_t>*)nullptr, false, 1);
+			testAssert(!resultWF, "wavefront flood fill result with fill limit, " + name);
+			testAssert(countWF == limit, "wavefront flood fill count with fill limit, " + name);
+			testAssert(pointsWF.size() == limit, "wavefront flood fill points with fill limit, " + name);
+			size_t filledPixels = 0;
+			for (coord_t n = 0; n < filledWF.pixelCount(); n++)
+			{
+				if (filledWF(n) == 128 && geom(n) != 128)
+					filledPixels++;
+			}
+			testAssert(filledPixels == limit, "wavefront flood fill image with fill limit, " + name);
+
+			// Stop color
+			if (colorsST.size() > 0)
+			{
+				setValue(filledWF, geom);
+				resultWF = itl2::floodfillWavefront(filledWF, start, (uint8_t)128, *colorsST.begin(), connectivity, nullptr, nullptr, 0, (set<uint8_t>*)nullptr, false, 1);
+				testAssert(!resultWF, "wavefront flood fill result with stop color, " + name);
+
+				// A seed with stop color must prevent filling from the other seeds, too.
+				coord_t stopIndex = 0;
+				while (geom(stopIndex) != *colorsST.begin())
+					stopIndex++;
+				Vec3c stopSeed = geom.getCoords(stopIndex);
+				setValue(filledWF, geom);
+				vector<Vec3sc> seeds = { Vec3sc(start), Vec3sc(stopSeed) };
+				resultWF = itl2::floodfillWavefront(filledWF, seeds, geom(start), (uint8_t)128, *colorsST.begin(), connectivity, &countWF, &pointsWF, 0, (set<uint8_t>*)nullptr, false, 1);
+				testAssert(!resultWF, "wavefront flood fill result with stop color seed, " + name);
+				testAssert(countWF == 0, "wavefront flood fill count with stop color seed, " + name);
+				testAssert(pointsWF.empty(), "wavefront flood fill points with stop color seed, " + name);
+				testAssert(equals(filledWF, geom), "wavefront flood fill image with stop color seed, " + name);
+			}
+		}
+
+		void floodfillWavefront()
+		{
+			// Random percolating structure: long tortuous paths that cross z-blocks many times.
+			Image<uint8_t> geom(200, 200, 200);
+			noise(geom, 128, 40, 1);
+			for (coord_t n = 0; n < geom.pixelCount(); n++)
+				geom(n) = geom(n) > 140 ? 255 : (geom(n) < 50 ? 5 : 0);
+
+			Vec3c start(0, 0, 0);
+			while (geom(start) != 255)
+				start.x++;
+
+			wavefrontTest(geom, start, Connectivity::NearestNeighbours, "percolating structure");
+			wavefrontTest(geom, start, Connectivity::AllNeighbours, "percolating structure");
+
+			// Background of the percolating structure (very large frontiers).
+			Vec3c bgStart(0, 0, 0);
+			while (geom(bgStart) != 0)
+				bgStart.x++;
+			wavefrontTest(geom, bgStart, Connectivity::NearestNeighbours, "background");
+
+			// Serpentine channel that is a single long path.
+			Image<uint8_t> snake(100, 100, 100);
+			for (coord_t z = 0; z < snake.depth(); z += 2)
+			{
+				for (coord_t y = 0; y < snake.height(); y += 2)
+				{
+					for (coord_t x = 0; x < snake.width(); x++)
+						snake(x, y, z) = 255;
+					coord_t connX = (y / 2) % 2 == 0 ? snake.width() - 1 : 0;
+					if (y + 1 < snake.height())
+						snake(connX, y + 1, z) = 255;
+				}
+				if (z + 1 < snake.depth())
+					snake(0, snake.height() - 2, z + 1) = 255;
+			}
+			wavefrontTest(snake, Vec3c(0, 0, 0), Connectivity::NearestNeighbours, "serpentine");
+
+			// 2D image
+			Image<uint8_t> geom2D(500, 400);
+			noise(geom2D, 128, 40, 2);
+			for (coord_t n = 0; n < geom2D.pixelCount(); n++)
+				geom2D(n) = geom2D(n) > 120 ? 255 : 0;
+			Vec3c start2D(0, 0, 0);
+			while (geom2D(start2D) != 255)
+				start2D.x++;
+			wavefrontTest(geom2D, start2D, Connectivity::NearestNeighbours, "2D");
+			wavefrontTest(geom2D, start2D, Connectivity::AllNeighbours, "2D");
+		}
+
+
 		void floodfillLeaks()
 		{
 			{
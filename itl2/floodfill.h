@@ -1,6 +1,7 @@
 #pragma once
 
 #include <set>
+#include <algorithm>
 #include <vector>
 #include <queue>
 #include <tuple>
@@ -9,6 +10,8 @@
 #include "image.h"
 #include "math/vec3.h"
 #include "connectivity.h"
+#include "particleruns.h"
+#include "ompatomic.h"
 
 namespace itl2
 {
@@ -50,166 +53,176 @@ namespace itl2
 
 			return true;
 		}
-	}
-
-	/**
-	Flood fill beginning from the given seed points.
-	@param origColor Original color that we are filling. (the color of the region where the fill is allowed to proceed)
-	@param fillColor Fill color. The filled pixels will be colored with this color.
-	@param stopColor Set to value different from fillColor to stop filling when a pixel of this color is encountered. This argument is used for efficient implementation of small region removal.
-	@param pNeighbouringColors Pointer to a set that will contain colors neighbouring the filled region. Set to null not to collect this information. Values of seed points that are not origColor, fillColor, or stopColor are added to the set, too.
-	@return True if the fill was terminated naturally; false if the fill was terminated by reaching fillLimit in filled pixel count; by encountering pixel with stopColor value; or if the origColor is fillColor.
-	*/
-	template<typename pixel_t> bool floodfillSingleThreaded(Image<pixel_t>& image, const std::vector<Vec3sc>& seeds, pixel_t origColor, pixel_t fillColor, pixel_t stopColor, Connectivity connectivity = Connectivity::NearestNeighbours, size_t* pFilledPointCount = nullptr, std::vector<Vec3sc>* pFilledPoints = nullptr, size_t fillLimit = 0, std::set<pixel_t>* pNeighbouringColors = nullptr, bool showProgressInfo = true)
-	{
-		if (pFilledPointCount)
-			*pFilledPointCount = 0;
 
-		if (pFilledPoints)
-			pFilledPoints->clear();
+		/**
+		Flood fill beginning from the given seed points.
+		The filled points are added to pFilledPoints container, that can be e.g. std::vector<Vec3sc> or ParticleRuns.
+		See the public floodfillSingleThreaded for description of the parameters.
+		*/
+		template<typename pixel_t, typename points_t> bool floodfillSingleThreaded(Image<pixel_t>& image, const std::vector<Vec3sc>& seeds, pixel_t origColor, pixel_t fillColor, pixel_t stopColor, Connectivity connectivity, size_t* pFilledPointCount, points_t* pFilledPoints, size_t fillLimit, std::set<pixel_t>* pNeighbouringColors, bool showProgressInfo)
+		{
+			if (pFilledPointCount)
+				*pFilledPointCount = 0;
 
-		if (pNeighbouringColors)
-			pNeighbouringColors->clear();
+			if (pFilledPoints)
+				pFilledPoints->clear();
 
-		if (origColor == fillColor)
-			return false;
+			if (pNeighbouringColors)
+				pNeighbouringColors->clear();
 
-		if (fillLimit <= 0)
-			fillLimit = std::numeric_limits<size_t>::max();
+			if (origColor == fillColor)
+				return false;
 
-		// Contains {deltay, deltaz, active} for all neighbouring scanlines.
-		std::vector<std::tuple<coord_t, coord_t, bool> > nbs;
-		if (connectivity == Connectivity::NearestNeighbours)
-		{
-			nbs = { {1, 0, false}, {-1, 0, false}, {0, 1, false,}, {0, -1, false} };
-		}
-		else if (connectivity == Connectivity::AllNeighbours)
-		{
-			nbs = { {1, 0, false}, {-1, 0, false}, {0, 1, false,}, {0, -1, false}, {1, 1, false}, {1, -1, false}, {-1, 1, false}, {-1, -1, false} };
-		}
-		else
-		{
-			throw ITLException("Unsupported connectivity value.");
-		}
+			if (fillLimit <= 0)
+				fillLimit = std::numeric_limits<size_t>::max();
 
-		std::queue<Vec3sc> points;
-		for (const Vec3sc& v : seeds)
-		{
-			if (image.isInImage(v))
+			// Contains {deltay, deltaz, active} for all neighbouring scanlines.
+			std::vector<std::tuple<coord_t, coord_t, bool> > nbs;
+			if (connectivity == Connectivity::NearestNeighbours)
 			{
-				pixel_t p = image(v);
-				if (fillColor != stopColor && p == stopColor)
-					return false;
-
-				if (pNeighbouringColors != 0 && p != origColor && p != fillColor)
-					pNeighbouringColors->insert(p);
-
-				points.push(v);
+				nbs = { {1, 0, false}, {-1, 0, false}, {0, 1, false,}, {0, -1, false} };
 			}
-		}
-
-		size_t lastPrinted = 0;
-		size_t tmp = 0;
-		size_t* pCount = &tmp;
-		if (pFilledPointCount)
-			pCount = pFilledPointCount;
-
-		while (!points.empty())
-		{
-			const Vec3c p = Vec3c(points.front());
-			
-			// Check that this point has not been filled before (there might be multiple routes to the same location).
-			if (image(p) == origColor)
+			else if (connectivity == Connectivity::AllNeighbours)
 			{
+				nbs = { {1, 0, false}, {-1, 0, false}, {0, 1, false,}, {0, -1, false}, {1, 1, false}, {1, -1, false}, {-1, 1, false}, {-1, -1, false} };
+			}
+			else
+			{
+				throw ITLException("Unsupported connectivity value.");
+			}
 
-				coord_t xl = p.x;
-				coord_t y = p.y;
-				coord_t z = p.z;
-
-				while (xl >= 0 && image(xl, y, z) == origColor)
-					xl--;
-
-				// Stop color check and neighbouring point set update
-				if (xl >= 0)
+			std::queue<Vec3sc> points;
+			for (const Vec3sc& v : seeds)
+			{
+				if (image.isInImage(v))
 				{
-					pixel_t p = image(xl, y, z);
+					pixel_t p = image(v);
 					if (fillColor != stopColor && p == stopColor)
 						return false;
 
 					if (pNeighbouringColors != 0 && p != origColor && p != fillColor)
 						pNeighbouringColors->insert(p);
-				}
 
-				xl++;
+					points.push(v);
+				}
+			}
 
-				// Set Active flags to zero for all neighbour directions.
-				for (auto& nb : nbs)
-					std::get<2>(nb) = false;
+			size_t lastPrinted = 0;
+			size_t tmp = 0;
+			size_t* pCount = &tmp;
+			if (pFilledPointCount)
+				pCount = pFilledPointCount;
 
-				// Fill neighbouring rows (don't fill the first and last pixels at xl-1 and end pos+1 if doing filling with All connectivity.
-				if (connectivity == Connectivity::AllNeighbours && xl > 0)
+			while (!points.empty())
+			{
+				const Vec3c p = Vec3c(points.front());
+			
+				// Check that this point has not been filled before (there might be multiple routes to the same location).
+				if (image(p) == origColor)
 				{
-					if (!internals::processNeighbours(xl - 1, y, z, points, nbs, image, fillColor, origColor, stopColor, pNeighbouringColors))
-						return false;
-				}
 
-				while (xl < image.width() && image(xl, y, z) == origColor)
-				{
-					image(xl, y, z) = fillColor;
-					(*pCount)++;
-					if (pFilledPoints)
-						pFilledPoints->push_back(Vec3sc((int32_t)xl, (int32_t)y, (int32_t)z));
+					coord_t xl = p.x;
+					coord_t y = p.y;
+					coord_t z = p.z;
 
-					// Fill volume limit check
-					if (*pCount >= fillLimit)
-						return false;
+					while (xl >= 0 && image(xl, y, z) == origColor)
+						xl--;
 
-					if(!internals::processNeighbours(xl, y, z, points, nbs, image, fillColor, origColor, stopColor, pNeighbouringColors))
-						return false;
+					// Stop color check and neighbouring point set update
+					if (xl >= 0)
+					{
+						pixel_t p = image(xl, y, z);
+						if (fillColor != stopColor && p == stopColor)
+							return false;
+
+						if (pNeighbouringColors != 0 && p != origColor && p != fillColor)
+							pNeighbouringColors->insert(p);
+					}
 
 					xl++;
-				}
 
-				if (connectivity == Connectivity::AllNeighbours && xl < image.width())
-				{
-					if (!internals::processNeighbours(xl, y, z, points, nbs, image, fillColor, origColor, stopColor, pNeighbouringColors))
-						return false;
+					// Set Active flags to zero for all neighbour directions.
+					for (auto& nb : nbs)
+						std::get<2>(nb) = false;
+
+					// Fill neighbouring rows (don't fill the first and last pixels at xl-1 and end pos+1 if doing filling with All connectivity.
+					if (connectivity == Connectivity::AllNeighbours && xl > 0)
+					{
+						if (!internals::processNeighbours(xl - 1, y, z, points, nbs, image, fillColor, origColor, stopColor, pNeighbouringColors))
+							return false;
+					}
+
+					while (xl < image.width() && image(xl, y, z) == origColor)
+					{
+						image(xl, y, z) = fillColor;
+						(*pCount)++;
+						if (pFilledPoints)
+							pFilledPoints->push_back(Vec3sc((int32_t)xl, (int32_t)y, (int32_t)z));
+
+						// Fill volume limit check
+						if (*pCount >= fillLimit)
+							return false;
+
+						if(!internals::processNeighbours(xl, y, z, points, nbs, image, fillColor, origColor, stopColor, pNeighbouringColors))
+							return false;
+
+						xl++;
+					}
+
+					if (connectivity == Connectivity::AllNeighbours && xl < image.width())
+					{
+						if (!internals::processNeighbours(xl, y, z, points, nbs, image, fillColor, origColor, stopColor, pNeighbouringColors))
+							return false;
+					}
+
+
+					// Stop color check and neighbouring point set update
+					if (xl < image.width())
+					{
+						pixel_t p = image(xl, y, z);
+						if (fillColor != stopColor && p == stopColor)
+							return false;
+
+						if (pNeighbouringColors != 0 && p != origColor && p != fillColor)
+							pNeighbouringColors->insert(p);
+					}
 				}
 
+				points.pop();
 
-				// Stop color check and neighbouring point set update
-				if (xl < image.width())
+				// Progress report for large fills
+				if (showProgressInfo)
 				{
-					pixel_t p = image(xl, y, z);
-					if (fillColor != stopColor && p == stopColor)
-						return false;
-
-					if (pNeighbouringColors != 0 && p != origColor && p != fillColor)
-						pNeighbouringColors->insert(p);
+					size_t s = points.size();
+					if (s > 0 && s % 50000 == 0 && lastPrinted != s)
+					{
+						lastPrinted = s;
+						std::cout << s << " seeds...\r" << std::flush;
+					}
 				}
 			}
 
-			points.pop();
-
-			// Progress report for large fills
 			if (showProgressInfo)
 			{
-				size_t s = points.size();
-				if (s > 0 && s % 50000 == 0 && lastPrinted != s)
-				{
-					lastPrinted = s;
-					std::cout << s << " seeds...\r" << std::flush;
-				}
+				if (lastPrinted != 0)
+					std::cout << std::endl;
 			}
-		}
 
-		if (showProgressInfo)
-		{
-			if (lastPrinted != 0)
-				std::cout << std::endl;
+			return true;
 		}
+	}
 
-		return true;
+	/**
+	Flood fill beginning from the given seed points.
+	@param origColor Original color that we are filling. (the color of the region where the fill is allowed to proceed)
+	@param fillColor Fill color. The filled pixels will be colored with this color.
+	@param stopColor Set to value different from fillColor to stop filling when a pixel of this color is encountered. This argument is used for efficient implementation of small region removal.
+	@param pNeighbouringColors Pointer to a set that will contain colors neighbouring the filled region. Set to null not to collect this information. Values of seed points that are not origColor, fillColor, or stopColor are added to the set, too.
+	@return True if the fill was terminated naturally; false if the fill was terminated by reaching fillLimit in filled pixel count; by encountering pixel with stopColor value; or if the origColor is fillColor.
+	*/
+	template<typename pixel_t> bool floodfillSingleThreaded(Image<pixel_t>& image, const std::vector<Vec3sc>& seeds, pixel_t origColor, pixel_t fillColor, pixel_t stopColor, Connectivity connectivity = Connectivity::NearestNeighbours, size_t* pFilledPointCount = nullptr, std::vector<Vec3sc>* pFilledPoints = nullptr, size_t fillLimit = 0, std::set<pixel_t>* pNeighbouringColors = nullptr, bool showProgressInfo = true)
+	{
+		return internals::floodfillSingleThreaded(image, seeds, origColor, fillColor, stopColor, connectivity, pFilledPointCount, pFilledPoints, fillLimit, pNeighbouringColors, showProgressInfo);
 	}
 
 	/**
@@ -237,6 +250,24 @@ namespace itl2
 		return floodfillSingleThreaded(image, seeds, origColor, fillColor, stopColor, connectivity, pFilledPointCount, pFilledPoints, fillLimit, pNeighbouringColors, showProgressInfo);
 	}
 
+	/**
+	Perform flood fill and store the filled points in run-length encoded form.
+	Uses single-threaded scanline fill algorithm, so each filled scanline segment becomes one run.
+	See the other floodfillSingleThreaded overloads for description of the parameters.
+	@param pFilledRuns Pointer to object that will receive the filled points. Set to zero if this information is not required.
+	*/
+	template<typename pixel_t> bool floodfillSingleThreaded(Image<pixel_t>& image, const Vec3c& start, pixel_t fillColor, pixel_t stopColor, Connectivity connectivity, size_t* pFilledPointCount, ParticleRuns* pFilledRuns, size_t fillLimit = 0, std::set<pixel_t>* pNeighbouringColors = nullptr, bool showProgressInfo = true)
+	{
+		if (!image.isInImage(start))
+			return true;
+
+		pixel_t origColor = image(start);
+		std::vector<Vec3sc> seeds;
+		seeds.push_back(Vec3sc(start));
+
+		return internals::floodfillSingleThreaded(image, seeds, origColor, fillColor, stopColor, connectivity, pFilledPointCount, pFilledRuns, fillLimit, pNeighbouringColors, showProgressInfo);
+	}
+
 	/**
 	Perform flood fill using a multi-threaded algorithm.
 	@param image Image containing the geometry to be filled.
@@ -508,9 +539,232 @@ namespace itl2
 		return floodfillBlocks(image, seeds, origColor, fillColor, stopColor, connectivity, pFilledPointCount, pFilledPoints, fillLimit, pNeighbouringColors, showProgressInfo, minBlockSize);
 	}
 
+	namespace internals
+	{
+		/**
+		Fills point p if it has the original color, and adds it to the given frontier.
+		Several threads may try to fill the same point; the point is filled and added to a frontier only once.
+		Points that would make the filled point count exceed fillLimit are not filled.
+		@return False if the fill should be stopped because fillLimit has been reached.
+		*/
+		template<typename pixel_t> bool claimWavefrontPoint(Image<pixel_t>& image, const Vec3c& p, pixel_t origColor, pixel_t fillColor, size_t& filledCount, size_t fillLimit, std::vector<Vec3sc>& frontier)
+		{
+			if (!atomicCompareAndSet(image(p), origColor, fillColor))
+				return true;
+
+			size_t count;
+			#pragma omp atomic capture
+			count = ++filledCount;
+
+			if (count > fillLimit)
+			{
+				// Another thread filled the last allowed point first.
+				atomicCompareAndSet(image(p), fillColor, origColor);
+				return false;
+			}
+
+			frontier.push_back(Vec3sc(p));
+
+			return count < fillLimit;
+		}
+	}
+
+	/**
+	Perform flood fill using a multi-threaded level-synchronous breadth-first algorithm.
+	In each step, the threads process a part of the current frontier (points filled in the previous step) and collect their unfilled neighbours into
+	thread-local buffers that are combined into the frontier of the next step. Points are claimed with an atomic compare-and-set on the pixel value,
+	so each point is filled only once.
+	Unlike floodfillBlocks, the performance does not depend on how the filled region crosses block boundaries, but it requires
+	as many steps as there are points in the longest shortest path from the seeds to the filled points.
+	The filled image, filled point count, filled points (in different order), and neighbouring colors are the same than in floodfillSingleThreaded.
+	If the fill is terminated by reaching fillLimit or by encountering stopColor, the filled points may be different.
+	@param image Image containing the geometry to be filled.
+	@param seeds Initial seed points.
+	@param origColor The color to fill.
+	@param fillColor Fill color. The filled pixels will be colored with this color.
+	@param stopColor Set to value different from fillColor to stop filling when a pixel of this color is encountered.
+	@param connectivity Connectivity of the fill.
+	@param pFilledPoints Pointer to vector that will receive the coordinates of the filled points. Set to zero if this information is not required.
+	@param fillLimit Set to value to limit count of filled points to that value. Used in regionremoval code. Set to std::numeric_limits<size_t>::max() to allow (practically) any number of particles.
+	@param pNeighbouringColors Pointer to set that will contain the colors of non-filled points neighbouring the filled region.
+	@param minParallelFrontierSize Frontiers smaller than this are processed in a single thread.
+	@return True if the fill was terminated naturally; false if the fill was terminated by reaching fillLimit in filled pixel count; by encountering pixel with stopColor value; or if the origColor is fillColor.
+	*/
+	template<typename pixel_t> bool floodfillWavefront(Image<pixel_t>& image, const std::vector<Vec3sc>& seeds, pixel_t origColor, pixel_t fillColor, pixel_t stopColor, Connectivity connectivity = Connectivity::NearestNeighbours, size_t* pFilledPointCount = nullptr, std::vector<Vec3sc>* pFilledPoints = nullptr, size_t fillLimit = 0, std::set<pixel_t>* pNeighbouringColors = nullptr, bool showProgressInfo = true,
+		size_t minParallelFrontierSize = 1024)
+	{
+		if (pFilledPointCount)
+			*pFilledPointCount = 0;
+
+		if (pFilledPoints)
+			pFilledPoints->clear();
+
+		if (pNeighbouringColors)
+			pNeighbouringColors->clear();
+
+		if (origColor == fillColor)
+			return false;
+
+		if (fillLimit <= 0)
+			fillLimit = std::numeric_limits<size_t>::max();
+
+		std::vector<Vec3c> deltas;
+		if (connectivity == Connectivity::NearestNeighbours)
+		{
+			deltas = { Vec3c(-1, 0, 0), Vec3c(1, 0, 0), Vec3c(0, -1, 0), Vec3c(0, 1, 0), Vec3c(0, 0, -1), Vec3c(0, 0, 1) };
+		}
+		else if (connectivity == Connectivity::AllNeighbours)
+		{
+			for (coord_t dz = -1; dz <= 1; dz++)
+				for (coord_t dy = -1; dy <= 1; dy++)
+					for (coord_t dx = -1; dx <= 1; dx++)
+						if (dx != 0 || dy != 0 || dz != 0)
+							deltas.push_back(Vec3c(dx, dy, dz));
+		}
+		else
+		{
+			throw ITLException("Unsupported connectivity value.");
+		}
+
+		size_t filledCount = 0;
+		bool result = true;
+		std::vector<Vec3sc> frontier;
+		std::vector<Vec3sc> nextFrontier;
+
+		// Check all seeds before filling any of them so that encountering stopColor leaves the image untouched.
+		for (const Vec3sc& v : seeds)
+		{
+			if (image.isInImage(v))
+			{
+				pixel_t p = image(v);
+				if (fillColor != stopColor && p == stopColor)
+					return false;
+
+				if (pNeighbouringColors != 0 && p != origColor && p != fillColor)
+					pNeighbouringColors->insert(p);
+			}
+		}
+
+		for (const Vec3sc& v : seeds)
+		{
+			if (image.isInImage(v) && image(v) == origColor)
+			{
+				if (!internals::claimWavefrontPoint(image, Vec3c(v), origColor, fillColor, filledCount, fillLimit, frontier))
+				{
+					result = false;
+					break;
+				}
+			}
+		}
+
+		OmpAtomic<bool> stop(!result);
+		size_t lastPrinted = 0;
+		while (!frontier.empty())
+		{
+			if (pFilledPoints)
+				pFilledPoints->insert(pFilledPoints->end(), frontier.begin(), frontier.end());
+
+			if (stop)
+				break;
+
+			nextFrontier.clear();
+
+			#pragma omp parallel if(frontier.size() >= minParallelFrontierSize)
+			{
+				std::vector<Vec3sc> privateFrontier;
+				std::set<pixel_t> privateNeighbouringColors;
+
+				#pragma omp for nowait
+				for (coord_t n = 0; n < (coord_t)frontier.size(); n++)
+				{
+					if (stop)
+						continue;
+
+					Vec3c p(frontier[n]);
+					for (const Vec3c& delta : deltas)
+					{
+						Vec3c np = p + delta;
+						if (!image.isInImage(np))
+							continue;
+
+						pixel_t value = image(np);
+						if (value == origColor)
+						{
+							if (!internals::claimWavefrontPoint(image, np, origColor, fillColor, filledCount, fillLimit, privateFrontier))
+							{
+								stop = true;
+								break;
+							}
+						}
+						else if (fillColor != stopColor && value == stopColor)
+						{
+							stop = true;
+							break;
+						}
+						else if (pNeighbouringColors != 0 && value != fillColor)
+						{
+							privateNeighbouringColors.insert(value);
+						}
+					}
+				}
+
+				#pragma omp critical(floodfill_wavefront)
+				{
+					nextFrontier.insert(nextFrontier.end(), privateFrontier.begin(), privateFrontier.end());
+					if (pNeighbouringColors)
+						pNeighbouringColors->merge(privateNeighbouringColors);
+				}
+			}
+
+			std::swap(frontier, nextFrontier);
+
+			// Progress report for large fills
+			if (showProgressInfo && frontier.size() >= 50000)
+			{
+				lastPrinted = frontier.size();
+				std::cout << lastPrinted << " points in the frontier...\r" << std::flush;
+			}
+		}
+
+		if (showProgressInfo && lastPrinted != 0)
+			std::cout << std::endl;
+
+		if (pFilledPointCount)
+			*pFilledPointCount = std::min(filledCount, fillLimit);
+
+		return !stop;
+	}
+
+	/**
+	Perform flood fill using a multi-threaded level-synchronous breadth-first algorithm.
+	See the other floodfillWavefront overload for description of the algorithm.
+	@param image Image containing the geometry to be filled.
+	@param start Starting position.
+	@param fillColor Fill color. The filled pixels will be colored with this color.
+	@param stopColor Set to value different from fillColor to stop filling when a pixel of this color is encountered.
+	@param connectivity Connectivity of the fill.
+	@param pFilledPoints Pointer to vector that will receive the coordinates of the filled points. Set to zero if this information is not required.
+	@param fillLimit Set to value to limit count of filled points to that value. Used in regionremoval code. Set to std::numeric_limits<size_t>::max() to allow (practically) any number of particles.
+	@param pNeighbouringColors Pointer to set that will contain the colors of non-filled points neighbouring the filled region.
+	@param minParallelFrontierSize Frontiers smaller than this are processed in a single thread.
+	@return True if the fill was terminated naturally; false if the fill was terminated by reaching fillLimit in filled pixel count; by encountering pixel with stopColor value; or if the origColor is fillColor.
+	*/
+	template<typename pixel_t> bool floodfillWavefront(Image<pixel_t>& image, const Vec3c& start, pixel_t fillColor, pixel_t stopColor, Connectivity connectivity = Connectivity::NearestNeighbours, size_t* pFilledPointCount = nullptr, std::vector<Vec3sc>* pFilledPoints = nullptr, size_t fillLimit = 0, std::set<pixel_t>* pNeighbouringColors = nullptr,
+		bool showProgressInfo = true, size_t minParallelFrontierSize = 1024)
+	{
+		if (!image.isInImage(start))
+			return true;
+
+		pixel_t origColor = image(start);
+		std::vector<Vec3sc> seeds;
+		seeds.push_back(Vec3sc(start));
+
+		return floodfillWavefront(image, seeds, origColor, fillColor, stopColor, connectivity, pFilledPointCount, pFilledPoints, fillLimit, pNeighbouringColors, showProgressInfo, minParallelFrontierSize);
+	}
+
 	/**
 	Perform flood fill.
-	Chooses between single- and multi-threaded implementation based on image size.
+	Uses single-threaded scanline fill for small images and multi-threaded floodfillWavefront for large images.
 	@param image Image containing the geometry to be filled.
 	@param start Starting position.
 	@param fillColor Fill color. The filled pixels will be colored with this color.
@@ -526,12 +780,12 @@ namespace itl2
 		if (image.pixelCount() < 700 * 700 * 700)
 			return floodfillSingleThreaded(image, start, fillColor, stopColor, connectivity, pFilledPointCount, pFilledPoints, fillLimit, pNeighbouringColors, showProgressInfo);
 		else
-			return floodfillBlocks(image, start, fillColor, stopColor, connectivity, pFilledPointCount, pFilledPoints, fillLimit, pNeighbouringColors, showProgressInfo);
+			return floodfillWavefront(image, start, fillColor, stopColor, connectivity, pFilledPointCount, pFilledPoints, fillLimit, pNeighbouringColors, showProgressInfo);
 	}
 
 	/**
 	Perform flood fill.
-	Chooses between single- and multi-threaded implementation based on image size.
+	Uses single-threaded scanline fill for small images and multi-threaded floodfillWavefront for large images.
 	@param image Image containing the geometry to be filled.
 	@param seeds Initial seed points.
 	@param fillColor Fill color. The filled pixels will be colored with this color.
@@ -547,7 +801,7 @@ namespace itl2
 		if (image.pixelCount() < 700 * 700 * 700)
 			return floodfillSingleThreaded(image, seeds, origColor, fillColor, stopColor, connectivity, pFilledPointCount, pFilledPoints, fillLimit, pNeighbouringColors, showProgressInfo);
 		else
-			return floodfillBlocks(image, seeds, origColor, fillColor, stopColor, connectivity, pFilledPointCount, pFilledPoints, fillLimit, pNeighbouringColors, showProgressInfo);
+			return floodfillWavefront(image, seeds, origColor, fillColor, stopColor, connectivity, pFilledPointCount, pFilledPoints, fillLimit, pNeighbouringColors, showProgressInfo);
 	}
 
 	/**
@@ -1144,6 +1398,7 @@ namespace itl2
 		void floodfill();
 		void floodfillLeaks();
 		void floodfillThreading();
+		void floodfillWavefront();
 		void growPriority();
 		void growAll();
 		void growComparison();
@@ -7,6 +7,9 @@
 #include "test.h"
 #include "projections.h"
 #include "testutils.h"
+#include "timer.h"
+
+#include <random>
 
 using namespace std;
 
@@ -90,6 +93,116 @@ namespace itl2
 
 			testAssert(itl2::equals(hist, hist2), "Weighted and non weighted bivariate histogram.");
 		}
+
+		/**
+		Calculates histogram pixel by pixel, directly using the definition.
+		*/
+		template<typename pixel_t> void referenceHistogram(const Image<pixel_t>& img, Image<double>& hist, const Vec2d& range, coord_t edgeSkip, const Image<float32_t>* pWeight)
+		{
+			setValue(hist, 0.0);
+			for (coord_t z = 0; z < img.depth(); z++)
+			{
+				for (coord_t y = 0; y < img.height(); y++)
+				{
+					for (coord_t x = 0; x < img.width(); x++)
+					{
+						if (img.edgeDistance(Vec3c(x, y, z)) >= edgeSkip)
+							hist(internals::histogramBin(img(x, y, z), range, hist.pixelCount())) += pWeight ? (*pWeight)(x, y, z) : 1.0;
+					}
+				}
+			}
+		}
+
+		template<typename pixel_t> void checkIntegerHistogram(const Vec3c& dims)
+		{
+			Image<pixel_t> img(dims);
+			Image<float32_t> weight(dims);
+			mt19937 gen(3);
+			uniform_int_distribution<int> dist((int)numeric_limits<pixel_t>::min(), (int)numeric_limits<pixel_t>::max());
+			for (coord_t n = 0; n < img.pixelCount(); n++)
+			{
+				img(n) = (pixel_t)dist(gen);
+				weight(n) = (float32_t)(n % 7);
+			}
+
+			double pmin = (double)numeric_limits<pixel_t>::min();
+			double pmax = (double)numeric_limits<pixel_t>::max();
+			for (const Vec2d& range : { Vec2d(pmin, pmax + 1), Vec2d(0, 1000), Vec2d(3.7, 257.3), Vec2d(pmin / 3, pmax / 5) })
+			{
+				for (coord_t binCount : { 1, 7, 100, 256 })
+				{
+					for (coord_t edgeSkip : { 0, 1, 3, 100 })
+					{
+						for (bool weighted : { false, true })
+						{
+							const Image<float32_t>* pWeight = weighted ? &weight : nullptr;
+
+							Image<double> expected(binCount);
+							referenceHistogram(img, expected, range, edgeSkip, pWeight);
+
+							Image<double> hist(binCount);
+							itl2::histogram(img, hist, range, edgeSkip, pWeight, false);
+
+							testAssert(equals(hist, expected), string("histogram of ") + toString(getDimensionality(dims)) + "-dimensional " + toString(imageDataType<pixel_t>()) + " image, range = " + toString(range) + ", bin count = " + toString(binCount) + ", edge skip = " + toString(edgeSkip));
+						}
+					}
+				}
+			}
+		}
+
+		void histogramIntegerTypes()
+		{
+			// Large enough images so that the lookup table is used.
+			checkIntegerHistogram<uint8_t>(Vec3c(70, 60, 50));
+			checkIntegerHistogram<int8_t>(Vec3c(70, 60, 50));
+			checkIntegerHistogram<uint16_t>(Vec3c(70, 60, 50));
+			checkIntegerHistogram<int16_t>(Vec3c(70, 60, 50));
+			checkIntegerHistogram<uint16_t>(Vec3c(400, 300, 1));
+
+			// Small images, no lookup table.
+			checkIntegerHistogram<uint16_t>(Vec3c(20, 10, 5));
+			checkIntegerHistogram<int32_t>(Vec3c(20, 10, 5));
+
+			// Bivariate histogram.
+			Image<uint16_t> img1(100, 90, 80);
+			Image<uint8_t> img2(100, 90, 81);
+			mt19937 gen(4);
+			uniform_int_distribution<int> dist(0, 65535);
+			for (coord_t n = 0; n < img1.pixelCount(); n++)
+				img1(n) = (uint16_t)dist(gen);
+			for (coord_t n = 0; n < img2.pixelCount(); n++)
+				img2(n) = (uint8_t)(dist(gen) % 256);
+
+			Image<double> hist2;
+			itl2::multiHistogram(hist2, 2, ImageAndRange(img1, Vec2d(10.5, 60000), 30), ImageAndRange(img2, Vec2d(0, 256), 20));
+			Image<double> expected2(30, 20);
+			for (coord_t z = 2; z < img1.depth() - 2; z++)
+			{
+				for (coord_t y = 2; y < img1.height() - 2; y++)
+				{
+					for (coord_t x = 2; x < img1.width() - 2; x++)
+						expected2(internals::histogramBin(img1(x, y, z), Vec2d(10.5, 60000), 30), internals::histogramBin(img2(x, y, z), Vec2d(0, 256), 20))++;
+				}
+			}
+			testAssert(equals(hist2, expected2), "bivariate histogram of integer images");
+
+			// Speed
+			Image<uint16_t> big(512, 512, 512);
+			for (coord_t n = 0; n < big.pixelCount(); n++)
+				big(n) = (uint16_t)(dist(gen) / 16);
+
+			Image<double> hist(256);
+			Timer timer;
+			timer.start();
+			itl2::histogram(big, hist, Vec2d(0, 4096), 0, (const Image<double>*)nullptr, false);
+			timer.stop();
+			cout << "Histogram of " << big.dimensions() << " uint16 image took " << timer.getSeconds() << " s" << endl;
+
+			timer.start();
+			itl2::histogram(big, hist, Vec2d(0, 4096), 5, (const Image<double>*)nullptr, false);
+			timer.stop();
+			cout << "Histogram with edge skip took " << timer.getSeconds() << " s" << endl;
+		}
 	}
 
 }
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include <array>
 #include <tuple>
 #include <numeric>
+#include <vector>
+#include <limits>
 
 #include "image.h"
 #include "utilities.h"
@@ -27,6 +29,136 @@ namespace itl2
 		>::type;
 	};
 
+	namespace internals
+	{
+		/**
+		Calculates index of the histogram bin where the given pixel value belongs to.
+		Pixels out of range are placed in the first or last bin.
+		@param range Gray value range for the histogram.
+		@param binCount Count of bins in the histogram.
+		*/
+		template<typename pixel_t> coord_t histogramBin(pixel_t pix, const Vec2d& range, coord_t binCount)
+		{
+			double dim = (double)binCount;
+			coord_t bin = itl2::floor((((double)pix - range.x) / (range.y - range.x)) * dim);
+
+			// Problem with above expression is that the terms inside floor() may give, e.g. 0.2899999998 for pixel
+			// that should go to bin 290-300. The floor makes it end in bin 280-290.
+			// Check that the pixel really belongs to the bin determined using above expression, and adjust if necessary.
+			// TODO: There is probably some numerically stable algorithm that does not need this check.
+			pixel_t binMin = pixelRound<pixel_t>(range.x + (double)bin / dim * (range.y - range.x));
+			pixel_t binMax = pixelRound<pixel_t>(range.x + (double)(bin + 1) / dim * (range.y - range.x));
+			if (pix < binMin)
+				bin--;
+			else if (pix >= binMax)
+				bin++;
+
+			if (bin < 0)
+				bin = 0;
+			else if (bin >= binCount)
+				bin = binCount - 1;
+
+			return bin;
+		}
+
+		/**
+		Maps pixel values to histogram bins.
+		For integer pixel types of at most 16 bits, the bins of all possible pixel values are pre-calculated
+		into a lookup table using histogramBin, so the results are always equal to those of histogramBin.
+		*/
+		template<typename pixel_t> class HistogramBinner
+		{
+		private:
+			static constexpr bool LUT_SUPPORTED = std::is_integral_v<pixel_t> && !std::is_same_v<pixel_t, bool> && sizeof(pixel_t) <= 2;
+
+			Vec2d range;
+			coord_t binCount;
+			std::vector<uint32_t> lut;
+
+		public:
+			/**
+			Constructor
+			@param range Gray value range for the histogram.
+			@param binCount Count of bins in the histogram.
+			@param pixelCount Count of pixels that will be binned. The lookup table is not made if it has more entries than this.
+			*/
+			HistogramBinner(const Vec2d& range, coord_t binCount, coord_t pixelCount) :
+				range(range),
+				binCount(binCount)
+			{
+				if constexpr (LUT_SUPPORTED)
+				{
+					constexpr coord_t lutSize = (coord_t)1 << (8 * sizeof(pixel_t));
+					if (pixelCount >= lutSize && binCount <= (coord_t)std::numeric_limits<uint32_t>::max())
+					{
+						lut.resize(lutSize);
+						for (coord_t n = 0; n < lutSize; n++)
+							lut[n] = (uint32_t)histogramBin((pixel_t)(n + std::numeric_limits<pixel_t>::min()), range, binCount);
+					}
+				}
+			}
+
+			/**
+			Gets the bin where the given pixel value belongs to.
+			*/
+			coord_t operator()(pixel_t pix) const
+			{
+				if constexpr (LUT_SUPPORTED)
+				{
+					if (lut.size() > 0)
+						return lut[(coord_t)pix - (coord_t)std::numeric_limits<pixel_t>::min()];
+				}
+
+				return histogramBin(pix, range, binCount);
+			}
+		};
+
+		/**
+		Calculates the region [start, end[ of pixels whose edge distance (see edgeDistance) is at least edgeSkip.
+		*/
+		inline void edgeSkipRegion(const Vec3c& dims, coord_t edgeSkip, Vec3c& start, Vec3c& end)
+		{
+			start = Vec3c(0, 0, 0);
+			end = dims;
+
+			if (edgeSkip > 0)
+			{
+				// edgeDistance considers the x coordinate and all the coordinates up to the dimensionality of the image.
+				size_t dimensionality = std::max<size_t>(getDimensionality(dims), 1);
+				for (size_t n = 0; n < dimensionality; n++)
+				{
+					start[n] = edgeSkip;
+					end[n] = dims[n] - edgeSkip;
+					if (end[n] <= start[n])
+					{
+						// No pixels are far enough from the edge.
+						end = start;
+						return;
+					}
+				}
+			}
+		}
+
+		/**
+		Adds histograms calculated by separate threads, each stored in one element of partialHists, to the histogram sums.
+		*/
+		template<typename sum_t> void sumHistograms(const std::vector<std::vector<sum_t> >& partialHists, Image<sum_t>& sums)
+		{
+			coord_t count = sums.pixelCount();
+			#pragma omp parallel for if(count * (coord_t)partialHists.size() > PARALLELIZATION_THRESHOLD && !omp_in_parallel())
+			for (coord_t n = 0; n < count; n++)
+			{
+				sum_t sum = sums(n);
+				for (size_t i = 0; i < partialHists.size(); i++)
+				{
+					if (partialHists[i].size() > 0)
+						sum += partialHists[i][n];
+				}
+				sums(n) = sum;
+			}
+		}
+	}
+
 	/**
 	Calculates unweighted or weighted histogram of input image.
 	@param img Image whose histogram is calculated.
@@ -46,57 +178,68 @@ namespace itl2
 		using sum_t = typename histogram_intermediate_type<hist_t, weight_t>::type;
 		Image<sum_t> sums(histogram.dimensions());
 
+		Vec3c start, end;
+		internals::edgeSkipRegion(img.dimensions(), edgeSkip, start, end);
+		coord_t rowLength = end.x - start.x;
+
+		internals::HistogramBinner<pixel_t> binner(range, dim, img.pixelCount());
+
+		// Unweighted counts are accumulated into several interleaved histograms so that
+		// consecutive pixels in the same bin do not wait for each other's increments.
+		constexpr coord_t MAX_INTERLEAVED = 4;
+		coord_t interleaved = !pWeight && dim <= 65536 ? MAX_INTERLEAVED : 1;
+
+		std::vector<std::vector<sum_t> > partialHists;
 		#pragma omp parallel if(img.pixelCount() > PARALLELIZATION_THRESHOLD)
 		{
-			Image<sum_t> privateHist(sums.dimensions());
+			#pragma omp single
+			partialHists.resize(interleaved * omp_get_num_threads());
+
+			std::array<sum_t*, MAX_INTERLEAVED> hists;
+			for (coord_t i = 0; i < interleaved; i++)
+			{
+				std::vector<sum_t>& h = partialHists[interleaved * omp_get_thread_num() + i];
+				h.resize(dim, 0);
+				hists[i] = h.data();
+			}
+
 			#pragma omp for nowait
-			for (coord_t z = 0; z < img.depth(); z++)
+			for (coord_t z = start.z; z < end.z; z++)
 			{
-				for (coord_t y = 0; y < img.height(); y++)
+				for (coord_t y = start.y; y < end.y; y++)
 				{
-					for (coord_t x = 0; x < img.width(); x++)
+					const pixel_t* row = &img(start.x, y, z);
+
+					if (!pWeight)
 					{
-						if (img.edgeDistance(Vec3c(x, y, z)) >= edgeSkip)
+						coord_t x = 0;
+						if (interleaved == MAX_INTERLEAVED)
 						{
-							pixel_t pix = img(x, y, z);
-							coord_t bin = itl2::floor(((pix - range.x) / (range.y - range.x)) * (double)dim);
-
-							// Problem with above expression is that the terms inside floor() may give, e.g. 0.2899999998 for pixel
-							// that should go to bin 290-300. The floor makes it end in bin 280-290.
-							// Check that the pixel really belongs to the bin determined using above expression, and adjust if necessary.
-							// TODO: There is probably some numerically stable algorithm that does not need this check.
-							pixel_t binMin = pixelRound<pixel_t>(range.x + (double)bin / (double)dim * (range.y - range.x));
-							pixel_t binMax = pixelRound<pixel_t>(range.x + (double)(bin + 1) / (double)dim * (range.y - range.x));
-							if (pix < binMin)
-								bin--;
-							else if (pix >= binMax)
-								bin++;
-
-							if (bin < 0)
-								bin = 0;
-							else if (bin >= dim)
-								bin = dim - 1;
-
-							if (!pWeight)
-								privateHist(bin)++;
-							else
-								privateHist(bin) += (sum_t)(*pWeight)(x, y, z);
+							for (; x + MAX_INTERLEAVED <= rowLength; x += MAX_INTERLEAVED)
+							{
+								hists[0][binner(row[x])]++;
+								hists[1][binner(row[x + 1])]++;
+								hists[2][binner(row[x + 2])]++;
+								hists[3][binner(row[x + 3])]++;
+							}
 						}
+						for (; x < rowLength; x++)
+							hists[0][binner(row[x])]++;
+					}
+					else
+					{
+						const weight_t* weightRow = &(*pWeight)(start.x, y, z);
+						for (coord_t x = 0; x < rowLength; x++)
+							hists[0][binner(row[x])] += (sum_t)weightRow[x];
 					}
 				}
 
-				showThreadProgress(counter, img.depth(), showProgressInfo);
-			}
-
-			#pragma omp critical(histogram_reduction)
-			{
-				for (coord_t n = 0; n < privateHist.pixelCount(); n++)
-				{
-					sums(n) += privateHist(n);
-				}
+				showThreadProgress(counter, end.z - start.z, showProgressInfo);
 			}
 		}
 
+		internals::sumHistograms(partialHists, sums);
+
 		setValue(histogram, sums);
 
 		//coord_t dim = histogram.pixelCount();
@@ -173,6 +316,15 @@ namespace itl2
 		{
 			transform<From>(std::forward<T1>(s), t, f, std::make_index_sequence<To - From + 1>());
 		}
+
+		/**
+		Calculates bin of pixel (x, y, z) of each image in tuple imgs of ImageAndRange objects, using the corresponding element of tuple binners.
+		*/
+		template<typename T1, typename T2, size_t... indices>
+		void multiHistogramBin(const T1& imgs, const T2& binners, coord_t x, coord_t y, coord_t z, Vec3c& bin, std::index_sequence<indices...>)
+		{
+			((bin[indices] = std::get<indices>(binners)(std::get<indices>(imgs).image(x, y, z))), ...);
+		}
 	}
 
 
@@ -225,10 +377,19 @@ namespace itl2
 		using sum_t = typename histogram_intermediate_type<hist_t, weight_t>::type;
 		Image<sum_t> sums(histogram.dimensions());
 
+		coord_t pixelCount = minDims.x * minDims.y * minDims.z;
+		auto binners = std::make_tuple(internals::HistogramBinner<pixel_t>(imgs.range, (coord_t)imgs.binCount, pixelCount)...);
+
 		size_t counter = 0;
-		#pragma omp parallel if(minDims.x * minDims.y * minDims.z > PARALLELIZATION_THRESHOLD)
+		std::vector<std::vector<sum_t> > partialHists;
+		#pragma omp parallel if(pixelCount > PARALLELIZATION_THRESHOLD)
 		{
-			Image<sum_t> privateHist(sums.dimensions());
+			#pragma omp single
+			partialHists.resize(omp_get_num_threads());
+
+			std::vector<sum_t>& privateHist = partialHists[omp_get_thread_num()];
+			privateHist.resize(sums.pixelCount(), 0);
+
 			#pragma omp for nowait
 			for (coord_t z = edgeSkip; z < minDims.z - edgeSkip; z++)
 			{
@@ -237,57 +398,22 @@ namespace itl2
 					for (coord_t x = edgeSkip; x < minDims.x - edgeSkip; x++)
 					{
 						// Calculate bin for each input image
-						std::array<coord_t, N> ndbin;
-						internals::transform<0, N - 1>(t, ndbin, [&](auto i) {
-							auto& img = i.image;
-							Vec2d range = i.range;
-							double dim = (double)i.binCount;
-
-							auto pix = img(x, y, z);
-							coord_t bin = (coord_t)floor((((double)pix - range.x) / (range.y - range.x)) * dim);
-
-							// Problem with above expression is that the terms inside floor() may give, e.g. 0.2899999998 for pixel
-							// that should go to bin 290-300. The floor makes it end in bin 280-290.
-							// Check that the pixel really belongs to the bin determined using above expression, and adjust if necessary.
-							// TODO: There is probably some numerically stable algorithm that does not need this check.
-							auto binMin = pixelRound<decltype(pix)>(range.x + (double)bin / dim * (range.y - range.x));
-							auto binMax = pixelRound<decltype(pix)>(range.x + (double)(bin + 1) / dim * (range.y - range.x));
-							if (pix < binMin)
-								bin--;
-							else if (pix >= binMax)
-								bin++;
-
-							if (bin < 0)
-								bin = 0;
-							else if ((size_t)bin >= i.binCount)
-								bin = i.binCount - 1;
-
-							return bin;
-						});
-
-						Vec3c ndbinv;
-						for (size_t n = 0; n < N; n++)
-							ndbinv[n] = ndbin[n];
+						Vec3c ndbinv(0, 0, 0);
+						internals::multiHistogramBin(t, binners, x, y, z, ndbinv, std::make_index_sequence<N>());
 
 						if (!pWeight)
-							privateHist(ndbinv)++;
+							privateHist[sums.getLinearIndex(ndbinv)]++;
 						else
-							privateHist(ndbinv) += (sum_t)(*pWeight)(x, y, z);
+							privateHist[sums.getLinearIndex(ndbinv)] += (sum_t)(*pWeight)(x, y, z);
 					}
 				}
 
 				showThreadProgress(counter, minDims.z);
 			}
-
-			#pragma omp critical(ndhistogram_reduction)
-			{
-				for (coord_t n = 0; n < privateHist.pixelCount(); n++)
-				{
-					sums(n) += privateHist(n);
-				}
-			}
 		}
 
+		internals::sumHistograms(partialHists, sums);
+
 		setValue(histogram, sums);
 	}
 
@@ -302,6 +428,7 @@ namespace itl2
 		void histogram();
 		void histogram2d();
 		void histogramIntermediateType();
+		void histogramIntegerTypes();
 	}
 
 }
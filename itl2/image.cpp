@@ -56,5 +56,45 @@ namespace itl2
 				cout << "sum|dmap - gt| = " << err << endl;
 			}
 		}
+
+		void externalBuffer()
+		{
+			vector<float32_t> data(4 * 3 * 2, 1.0f);
+			int releaseCount = 0;
+
+			{
+				Image<float32_t> img(data.data(), Vec3c(4, 3, 2), [&]() { releaseCount++; });
+				testAssert(img.dimensions() == Vec3c(4, 3, 2), "external buffer dimensions");
+				testAssert(img.getData() == data.data(), "external buffer data is not copied");
+
+				img(3, 2, 1) = 5;
+				testAssert(data[data.size() - 1] == 5, "external buffer write");
+
+				// Pinned images must not be re-allocated.
+				img.pin();
+				bool thrown = false;
+				try
+				{
+					img.ensureSize(Vec3c(5, 5, 5));
+				}
+				catch (ITLException&)
+				{
+					thrown = true;
+				}
+				testAssert(thrown, "re-allocation of pinned image");
+				testAssert(img.getData() == data.data() && releaseCount == 0, "pinned image data");
+				img.unpin();
+
+				// Re-allocation releases the external buffer.
+				img.ensureSize(Vec3c(5, 5, 5));
+				testAssert(img.getData() != data.data() && releaseCount == 1, "external buffer release on re-allocation");
+			}
+			testAssert(releaseCount == 1, "external buffer release count");
+
+			{
+				Image<float32_t> img(data.data(), Vec3c(4, 3, 2), [&]() { releaseCount++; });
+			}
+			testAssert(releaseCount == 2, "external buffer release on destruction");
+		}
 	}
 }
\ No newline at end of file
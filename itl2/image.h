@@ -12,6 +12,7 @@
 #include "test.h"
 #include "memorybuffer.h"
 #include "diskmappedbuffer.h"
+#include "externalbuffer.h"
 #include "io/imagedatatype.h"
 #include "imagemetadata.h"
 #include "aabox.h"
@@ -90,12 +91,55 @@ namespace itl2
 
 		Vec3c dims;
 
+		/**
+		Count of outstanding pins, see pin().
+		*/
+		size_t pinCount = 0;
+
+		/**
+		Throws exception if the image is pinned.
+		Used to make sure that pixel data of pinned images is not re-allocated.
+		*/
+		void mustNotBePinned() const
+		{
+			if (isPinned())
+				throw ITLException("The image cannot be re-initialized as its pixel data is in use outside of the system.");
+		}
+
 	public:
 		virtual ~ImageBase()
 		{
 
 		}
 
+		/**
+		Pins the image.
+		Pixel data of a pinned image stays at the same memory location, i.e. init methods throw an exception instead of re-allocating it.
+		Use this when a pointer to the pixel data is handed out, e.g. to NumPy.
+		Each call must be paired with a call to unpin().
+		*/
+		void pin()
+		{
+			pinCount++;
+		}
+
+		/**
+		Releases a pin made with pin().
+		*/
+		void unpin()
+		{
+			if (pinCount > 0)
+				pinCount--;
+		}
+
+		/**
+		Returns true if the image has been pinned.
+		*/
+		bool isPinned() const
+		{
+			return pinCount > 0;
+		}
+
 		/**
 		Return raw pointer to the image data.
 		*/
@@ -545,6 +589,26 @@ namespace itl2
 			initBuffer(dimensions.x, dimensions.y, dimensions.z);
 		}
 
+		/**
+		Constructor, creates image that uses pixel data owned by someone else, e.g. a NumPy array.
+		The data is not copied.
+		@param data Pointer to the pixel data. There must be space for dimensions.x * dimensions.y * dimensions.z initialized pixels, stored in the same order than in other images.
+		@param dimensions Dimensions of the image.
+		@param release Function that is called when the image does not need the data anymore, or empty function.
+		*/
+		Image(pixel_t* data, const Vec3c& dimensions, std::function<void()> release = std::function<void()>())
+		{
+			if (!data)
+				throw ITLException("Pixel data pointer must not be null.");
+
+			dims.x = std::max<coord_t>(1, dimensions.x);
+			dims.y = std::max<coord_t>(1, dimensions.y);
+			dims.z = std::max<coord_t>(1, dimensions.z);
+			pBufferObject = new ExternalBuffer<pixel_t>(data, std::move(release));
+			pData = pBufferObject->getBufferPointer();
+			pDataConst = pData;
+		}
+
 		/**
 		Constructor, creates image that points to a z-range in another image.
 		@param startZ z-coordinate of the first slice to include in the view.
@@ -580,6 +644,7 @@ namespace itl2
 		*/
 		void init(coord_t width, coord_t height = 0, coord_t depth = 0, const pixel_t val = pixel_t())
 		{
+			mustNotBePinned();
 			deleteData();
 			initBuffer(width, height, depth, val);
 		}
@@ -594,6 +659,7 @@ namespace itl2
 		*/
 		void init(const string& filePrefix, bool readOnly, coord_t width, coord_t height = 0, coord_t depth = 0)
 		{
+			mustNotBePinned();
 			deleteData();
 			this->mapReadOnly = readOnly;
 			this->mapFilePrefix = filePrefix;
@@ -605,6 +671,7 @@ namespace itl2
 			if (startZ < 0 || endZ < 0 || startZ >= source.depth() || endZ >= source.depth() || startZ > endZ)
 				throw ITLException("Invalid z range.");
 
+			mustNotBePinned();
 			deleteData();
 
 			dims.x = source.width();
@@ -620,6 +687,7 @@ namespace itl2
 			if (startZ < 0 || endZ < 0 || startZ >= source.depth() || endZ >= source.depth() || startZ > endZ)
 				throw ITLException("Invalid z range.");
 
+			mustNotBePinned();
 			deleteData();
 
 			dims.x = source.width();
@@ -638,9 +706,12 @@ namespace itl2
 		{
 			if (pBufferObject)
 			{
+				if (pBufferObject->ownsData())
+				{
 #pragma omp parallel for if(pixelCount() > PARALLELIZATION_THRESHOLD && !omp_in_parallel())
-				for (coord_t n = 0; n < pixelCount(); n++)
-					pData[n].~pixel_t();
+					for (coord_t n = 0; n < pixelCount(); n++)
+						pData[n].~pixel_t();
+				}
 
 				pData = 0;
 				pDataConst = 0;
@@ -800,5 +871,6 @@ namespace itl2
 	{
 		void image();
 		void buffers();
+		void externalBuffer();
 	}
 }
@@ -38,6 +38,52 @@ namespace itl2
 		return getPixelSafe(img, x, y, z, BoundaryCondition::Nearest);
 	}
 
+	namespace internals
+	{
+		/**
+		Pixel access for interpolation kernels, obeys boundary conditions.
+		*/
+		template<typename input_t> class SafePixelAccess
+		{
+		private:
+			const Image<input_t>& img;
+			BoundaryCondition bc;
+
+		public:
+			SafePixelAccess(const Image<input_t>& img, BoundaryCondition bc) : img(img), bc(bc)
+			{
+			}
+
+			input_t operator()(coord_t x, coord_t y, coord_t z) const
+			{
+				return getPixelSafe(img, x, y, z, bc);
+			}
+		};
+
+		/**
+		Pixel access for interpolation kernels, does not check image bounds.
+		Used for sample positions whose whole interpolation neighbourhood is inside the image.
+		In 2D images, all z-coordinates refer to the only slice of the image.
+		*/
+		template<typename input_t> class DirectPixelAccess
+		{
+		private:
+			const input_t* pData;
+			coord_t strideY;
+			coord_t strideZ;
+
+		public:
+			DirectPixelAccess(const Image<input_t>& img) : pData(img.getData()), strideY(img.width()), strideZ(img.depth() > 1 ? img.width() * img.height() : 0)
+			{
+			}
+
+			input_t operator()(coord_t x, coord_t y, coord_t z) const
+			{
+				return pData[x + y * strideY + z * strideZ];
+			}
+		};
+	}
+
 	/**
 	Base class for interpolator functors.
 	*/
@@ -79,6 +125,24 @@ namespace itl2
 			return operator()(img, x.x, x.y, x.z);
 		}
 
+		/**
+		Interpolates given image at locations start + i * step, where i = 0, 1, ..., count - 1, and stores the results to out[i].
+		*/
+		virtual void interpolateRow(const Image<input_t>& img, const Vec3<real_t>& start, const Vec3<real_t>& step, coord_t count, output_t* out) const
+		{
+			for (coord_t i = 0; i < count; i++)
+				out[i] = operator()(img, start.x + (real_t)i * step.x, start.y + (real_t)i * step.y, start.z + (real_t)i * step.z);
+		}
+
+		/**
+		Interpolates given image at locations positions[i], where i = 0, 1, ..., count - 1, and stores the results to out[i].
+		*/
+		virtual void interpolateRow(const Image<input_t>& img, const Vec3<real_t>* positions, coord_t count, output_t* out) const
+		{
+			for (coord_t i = 0; i < count; i++)
+				out[i] = operator()(img, positions[i].x, positions[i].y, positions[i].z);
+		}
+
 		/**
 		Returns boundary condition of this interpolator.
 		*/
@@ -89,22 +153,102 @@ namespace itl2
 	};
 
 	/**
-	Nearest neighbour interpolation functor.
+	Base class for interpolators that are implemented with an interpolation kernel in the derived class.
+	The derived class must have
+	- method template<typename access_t> output_t interpolate(const access_t& pixel, real_t x, real_t y, real_t z) const
+	that interpolates using pixel values pixel(u, v, w), and
+	- constants SUPPORT_BEFORE and SUPPORT_AFTER that define the neighbourhood [floor(x) - SUPPORT_BEFORE, floor(x) + SUPPORT_AFTER] read by the kernel.
+	The kernel is called directly (without virtual function calls) for all locations in a row, and pixels are read without
+	boundary checks if the whole neighbourhood is inside the image.
 	*/
-	template<typename output_t, typename input_t, typename real_t = typename NumberUtils<output_t>::RealFloatType> class NearestNeighbourInterpolator : public Interpolator<output_t, input_t, real_t>
+	template<typename derived_t, typename output_t, typename input_t, typename real_t> class KernelInterpolator : public Interpolator<output_t, input_t, real_t>
 	{
+	private:
+		const derived_t& kernel() const
+		{
+			return static_cast<const derived_t&>(*this);
+		}
+
+		/**
+		Tests if the neighbourhood of the given location is inside the image.
+		In 2D images, locations in the plane z = 0 are considered interior if their xy-neighbourhood is inside the image.
+		The kernels give zero weight to all slices except z = 0 at those locations, so reading the only slice
+		in place of the slices outside of the image (see DirectPixelAccess) does not change the result.
+		*/
+		static bool isInterior(const Image<input_t>& img, real_t x, real_t y, real_t z)
+		{
+			coord_t u0 = itl2::floor(x);
+			coord_t v0 = itl2::floor(y);
+			bool xyInterior = u0 >= derived_t::SUPPORT_BEFORE && u0 < img.width() - derived_t::SUPPORT_AFTER &&
+				v0 >= derived_t::SUPPORT_BEFORE && v0 < img.height() - derived_t::SUPPORT_AFTER;
+
+			if (img.depth() == 1)
+				return xyInterior && z == 0;
+
+			coord_t w0 = itl2::floor(z);
+			return xyInterior && w0 >= derived_t::SUPPORT_BEFORE && w0 < img.depth() - derived_t::SUPPORT_AFTER;
+		}
+
+		/**
+		Interpolates at one location of a row.
+		*/
+		output_t interpolateInRow(const Image<input_t>& img, const internals::SafePixelAccess<input_t>& safe, const internals::DirectPixelAccess<input_t>& direct, real_t x, real_t y, real_t z) const
+		{
+			if (isInterior(img, x, y, z))
+				return kernel().interpolate(direct, x, y, z);
+			return kernel().interpolate(safe, x, y, z);
+		}
+
 	public:
-		NearestNeighbourInterpolator(BoundaryCondition bc) : Interpolator<output_t, input_t, real_t>(bc)
+		KernelInterpolator(BoundaryCondition bc) : Interpolator<output_t, input_t, real_t>(bc)
 		{
 
 		}
 
+		using Interpolator<output_t, input_t, real_t>::operator();
+
 		virtual output_t operator()(const Image<input_t>& img, real_t x, real_t y, real_t z) const override
+		{
+			return kernel().interpolate(internals::SafePixelAccess<input_t>(img, this->boundaryCondition()), x, y, z);
+		}
+
+		virtual void interpolateRow(const Image<input_t>& img, const Vec3<real_t>& start, const Vec3<real_t>& step, coord_t count, output_t* out) const override
+		{
+			internals::SafePixelAccess<input_t> safe(img, this->boundaryCondition());
+			internals::DirectPixelAccess<input_t> direct(img);
+			for (coord_t i = 0; i < count; i++)
+				out[i] = interpolateInRow(img, safe, direct, start.x + (real_t)i * step.x, start.y + (real_t)i * step.y, start.z + (real_t)i * step.z);
+		}
+
+		virtual void interpolateRow(const Image<input_t>& img, const Vec3<real_t>* positions, coord_t count, output_t* out) const override
+		{
+			internals::SafePixelAccess<input_t> safe(img, this->boundaryCondition());
+			internals::DirectPixelAccess<input_t> direct(img);
+			for (coord_t i = 0; i < count; i++)
+				out[i] = interpolateInRow(img, safe, direct, positions[i].x, positions[i].y, positions[i].z);
+		}
+	};
+
+	/**
+	Nearest neighbour interpolation functor.
+	*/
+	template<typename output_t, typename input_t, typename real_t = typename NumberUtils<output_t>::RealFloatType> class NearestNeighbourInterpolator : public KernelInterpolator<NearestNeighbourInterpolator<output_t, input_t, real_t>, output_t, input_t, real_t>
+	{
+	public:
+		static constexpr coord_t SUPPORT_BEFORE = 0;
+		static constexpr coord_t SUPPORT_AFTER = 1;
+
+		NearestNeighbourInterpolator(BoundaryCondition bc) : KernelInterpolator<NearestNeighbourInterpolator<output_t, input_t, real_t>, output_t, input_t, real_t>(bc)
+		{
+
+		}
+
+		template<typename access_t> output_t interpolate(const access_t& pixel, real_t x, real_t y, real_t z) const
 		{
 			coord_t ix = (coord_t)::round(x);
 			coord_t iy = (coord_t)::round(y);
 			coord_t iz = (coord_t)::round(z);
-			return pixelRound<output_t>(this->getPixelSafe(img, ix, iy, iz));
+			return pixelRound<output_t>(pixel(ix, iy, iz));
 		}
 	};
 
@@ -115,7 +259,7 @@ namespace itl2
 	@param real_t Scalar real number type, typically double.
 	@param intermediate_t Type of intermediate values, typically double or Vec3d etc.
 	*/
-	template<typename output_t, typename input_t, typename real_t = typename NumberUtils<output_t>::RealFloatType, typename intermediate_t = typename NumberUtils<output_t>::FloatType > class LinearInterpolator : public Interpolator<output_t, input_t, real_t>
+	template<typename output_t, typename input_t, typename real_t = typename NumberUtils<output_t>::RealFloatType, typename intermediate_t = typename NumberUtils<output_t>::FloatType > class LinearInterpolator : public KernelInterpolator<LinearInterpolator<output_t, input_t, real_t, intermediate_t>, output_t, input_t, real_t>
 	{
 	private:
 		inline real_t w_lin(real_t dx) const
@@ -124,12 +268,15 @@ namespace itl2
 		}
 
 	public:
-		LinearInterpolator(BoundaryCondition bc) : Interpolator<output_t, input_t, real_t>(bc)
+		static constexpr coord_t SUPPORT_BEFORE = 0;
+		static constexpr coord_t SUPPORT_AFTER = 1;
+
+		LinearInterpolator(BoundaryCondition bc) : KernelInterpolator<LinearInterpolator<output_t, input_t, real_t, intermediate_t>, output_t, input_t, real_t>(bc)
 		{
 
 		}
 
-		virtual output_t operator()(const Image<input_t>& img, real_t x, real_t y, real_t z) const override
+		template<typename access_t> output_t interpolate(const access_t& pixel, real_t x, real_t y, real_t z) const
 		{
 			coord_t u0 = itl2::floor(x);
 			coord_t v0 = itl2::floor(y);
@@ -149,7 +296,7 @@ namespace itl2
 					for (int i = 0; i <= 1; i++)
 					{
 						coord_t u = u0 + i;
-						input_t pixval = this->getPixelSafe(img, u, v, w);
+						input_t pixval = pixel(u, v, w);
 						p = p + pixval * w_lin(x - u);
 					}
 
@@ -172,7 +319,7 @@ namespace itl2
 	@param real_t Scalar real number type, typically double.
 	@param intermediate_t Type of intermediate values, typically double or Vec3d etc.
 	*/
-	template<typename output_t, typename input_t, typename real_t = typename NumberUtils<output_t>::RealFloatType, typename intermediate_t = typename NumberUtils<output_t>::FloatType> class LinearInvalidValueInterpolator : public Interpolator<output_t, input_t, real_t>
+	template<typename output_t, typename input_t, typename real_t = typename NumberUtils<output_t>::RealFloatType, typename intermediate_t = typename NumberUtils<output_t>::FloatType> class LinearInvalidValueInterpolator : public KernelInterpolator<LinearInvalidValueInterpolator<output_t, input_t, real_t, intermediate_t>, output_t, input_t, real_t>
 	{
 	private:
 		inline real_t w_lin(real_t dx) const
@@ -184,12 +331,15 @@ namespace itl2
 		output_t invalidOutputValue;
 
 	public:
-		LinearInvalidValueInterpolator(BoundaryCondition bc, input_t invalidInputValue, output_t invalidOutputValue) : Interpolator<output_t, input_t, real_t>(bc), invalidInputValue(invalidInputValue), invalidOutputValue(invalidOutputValue)
+		static constexpr coord_t SUPPORT_BEFORE = 0;
+		static constexpr coord_t SUPPORT_AFTER = 1;
+
+		LinearInvalidValueInterpolator(BoundaryCondition bc, input_t invalidInputValue, output_t invalidOutputValue) : KernelInterpolator<LinearInvalidValueInterpolator<output_t, input_t, real_t, intermediate_t>, output_t, input_t, real_t>(bc), invalidInputValue(invalidInputValue), invalidOutputValue(invalidOutputValue)
 		{
 
 		}
 
-		virtual output_t operator()(const Image<input_t>& img, real_t x, real_t y, real_t z) const override
+		template<typename access_t> output_t interpolate(const access_t& pixel, real_t x, real_t y, real_t z) const
 		{
 			coord_t u0 = (coord_t)floor(x);
 			coord_t v0 = (coord_t)floor(y);
@@ -212,7 +362,7 @@ namespace itl2
 					for (int i = 0; i <= 1; i++)
 					{
 						coord_t u = u0 + i;
-						input_t pixval = this->getPixelSafe(img, u, v, w);
+						input_t pixval = pixel(u, v, w);
 						if (pixval != invalidInputValue)
 						{
 							real_t ww = w_lin(x - u);
@@ -253,7 +403,7 @@ namespace itl2
 	https://github.com/imagingbook/imagingbook-common/blob/master/src/main/java/imagingbook/lib/interpolation/BicubicInterpolator.java
 	See http://imagingbook.com
 	*/
-	template<typename output_t, typename input_t, typename real_t = typename NumberUtils<output_t>::RealFloatType, typename intermediate_t = typename NumberUtils<output_t>::FloatType> class CubicInterpolator : public Interpolator<output_t, input_t, real_t>
+	template<typename output_t, typename input_t, typename real_t = typename NumberUtils<output_t>::RealFloatType, typename intermediate_t = typename NumberUtils<output_t>::FloatType> class CubicInterpolator : public KernelInterpolator<CubicInterpolator<output_t, input_t, real_t, intermediate_t>, output_t, input_t, real_t>
 	{
 	private:
 		real_t a;
@@ -275,12 +425,15 @@ namespace itl2
 		}
 
 	public:
-		CubicInterpolator(BoundaryCondition bc, real_t sharpness = (real_t)0.5) : Interpolator<output_t, input_t, real_t>(bc), a(sharpness)
+		static constexpr coord_t SUPPORT_BEFORE = 1;
+		static constexpr coord_t SUPPORT_AFTER = 2;
+
+		CubicInterpolator(BoundaryCondition bc, real_t sharpness = (real_t)0.5) : KernelInterpolator<CubicInterpolator<output_t, input_t, real_t, intermediate_t>, output_t, input_t, real_t>(bc), a(sharpness)
 		{
 
 		}
 
-		virtual output_t operator()(const Image<input_t>& img, real_t x, real_t y, real_t z) const override
+		template<typename access_t> output_t interpolate(const access_t& pixel, real_t x, real_t y, real_t z) const
 		{
 			coord_t u0 = (coord_t)floor(x);
 			coord_t v0 = (coord_t)floor(y);
@@ -300,7 +453,7 @@ namespace itl2
 					for (int i = 0; i <= 3; i++)
 					{
 						coord_t u = u0 - 1 + i;
-						input_t pixval = this->getPixelSafe(img, u, v, w);
+						input_t pixval = pixel(u, v, w);
 						p = p + pixval * w_cub(x - u);
 					}
 
@@ -322,7 +475,7 @@ namespace itl2
 	https://github.com/imagingbook/imagingbook-common/blob/master/src/main/java/imagingbook/lib/interpolation/BicubicInterpolator.java
 	See http://imagingbook.com
 	*/
-	template<typename output_t, typename input_t, typename real_t = typename NumberUtils<output_t>::RealFloatType, typename intermediate_t = typename NumberUtils<output_t>::FloatType> class CubicInvalidValueInterpolator : public Interpolator<output_t, input_t, real_t>
+	template<typename output_t, typename input_t, typename real_t = typename NumberUtils<output_t>::RealFloatType, typename intermediate_t = typename NumberUtils<output_t>::FloatType> class CubicInvalidValueInterpolator : public KernelInterpolator<CubicInvalidValueInterpolator<output_t, input_t, real_t, intermediate_t>, output_t, input_t, real_t>
 	{
 	private:
 		real_t a;
@@ -347,12 +500,15 @@ namespace itl2
 		output_t invalidOutputValue;
 
 	public:
-		CubicInvalidValueInterpolator(BoundaryCondition bc, input_t invalidInputValue, output_t invalidOutputValue, real_t sharpness = (real_t)0.5) : Interpolator<output_t, input_t, real_t>(bc), a(sharpness), invalidInputValue(invalidInputValue), invalidOutputValue(invalidOutputValue)
+		static constexpr coord_t SUPPORT_BEFORE = 1;
+		static constexpr coord_t SUPPORT_AFTER = 2;
+
+		CubicInvalidValueInterpolator(BoundaryCondition bc, input_t invalidInputValue, output_t invalidOutputValue, real_t sharpness = (real_t)0.5) : KernelInterpolator<CubicInvalidValueInterpolator<output_t, input_t, real_t, intermediate_t>, output_t, input_t, real_t>(bc), a(sharpness), invalidInputValue(invalidInputValue), invalidOutputValue(invalidOutputValue)
 		{
 
 		}
 
-		virtual output_t operator()(const Image<input_t>& img, real_t x, real_t y, real_t z) const override
+		template<typename access_t> output_t interpolate(const access_t& pixel, real_t x, real_t y, real_t z) const
 		{
 			coord_t u0 = (coord_t)floor(x);
 			coord_t v0 = (coord_t)floor(y);
@@ -375,7 +531,7 @@ namespace itl2
 					for (int i = 0; i <= 3; i++)
 					{
 						coord_t u = u0 - 1 + i;
-						input_t pixval = this->getPixelSafe(img, u, v, w);
+						input_t pixval = pixel(u, v, w);
 						if (pixval != invalidInputValue)
 						{
 							real_t ww = w_cub(x - u);
@@ -10,8 +10,12 @@ namespace itl2
 	
     	bool getInfo(const std::string& filename, Vec3c& dimensions, ImageDataType& dataType, string& reason)
 		{
-			string volReason, tiffReason, nrrdReason, sequenceReason, rawReason, pcrReason;
-			if (vol::getInfo(filename, dimensions, dataType, volReason))
+			string volReason, tiffReason, nrrdReason, sequenceReason, rawReason, pcrReason, nn5Reason;
+			if (nn5::getInfo(filename, dimensions, dataType, nn5Reason))
+			{
+				return true;
+			}
+			else if (vol::getInfo(filename, dimensions, dataType, volReason))
 			{
 				return true;
 			}
@@ -37,7 +41,7 @@ namespace itl2
 			}
 			else
 			{
-				reason = internals::combineReasons(rawReason, tiffReason, sequenceReason, volReason, nrrdReason, pcrReason);
+				reason = internals::combineReasons(rawReason, tiffReason, sequenceReason, volReason, nrrdReason, pcrReason, nn5Reason);
 				return false;
 			}
 		}
@@ -7,6 +7,7 @@
 #include "io/vol.h"
 #include "io/nrrd.h"
 #include "io/pcr.h"
+#include "io/nn5.h"
 
 namespace itl2
 {
@@ -14,7 +15,7 @@ namespace itl2
 	{
 		namespace internals
 		{
-			inline std::string combineReasons(const std::string& rawReason, const std::string& tiffReason, const std::string& sequenceReason, const std::string& volReason, const std::string& nrrdReason, const std::string& pcrReason)
+			inline std::string combineReasons(const std::string& rawReason, const std::string& tiffReason, const std::string& sequenceReason, const std::string& volReason, const std::string& nrrdReason, const std::string& pcrReason, const std::string& nn5Reason)
 			{
 				return std::string() +
 					"raw: " + rawReason + "\n" +
@@ -22,7 +23,8 @@ namespace itl2
 					"sequence: " + sequenceReason + "\n" +
 					"vol: " + volReason + "\n" +
 					"nrrd: " + nrrdReason + "\n" +
-					"pcr: " + pcrReason;
+					"pcr: " + pcrReason + "\n" +
+					"nn5: " + nn5Reason;
 			}
 		}
 
@@ -30,13 +32,17 @@ namespace itl2
 		Finds data format of given file and reads it to the given image.
 		The data type of the target image must be correct but its size is set automatically.
 		*/
-		template<typename pixel_t> void read(Image<pixel_t>& img, const std::string& filename)
+		template<typename pixel_t> void read(Image<pixel_t>& img, const std::string& filename, bool showProgressInfo = false)
 		{
 			Vec3c dimensions;
 			ImageDataType dt;
 			
-			std::string volReason, tiffReason, nrrdReason, sequenceReason, rawReason, pcrReason;
-			if (vol::getInfo(filename, dimensions, dt, volReason))
+			std::string volReason, tiffReason, nrrdReason, sequenceReason, rawReason, pcrReason, nn5Reason;
+			if (nn5::getInfo(filename, dimensions, dt, nn5Reason))
+			{
+				nn5::read(img, filename, showProgressInfo);
+			}
+			else if (vol::getInfo(filename, dimensions, dt, volReason))
 			{
 				vol::read(img, filename);
 			}
@@ -58,12 +64,12 @@ namespace itl2
 			}
 			else if (raw::getInfo(filename, dimensions, dt, rawReason))
 			{
-				raw::read(img, filename);
+				raw::read(img, filename, 0, raw::readPixel<pixel_t>, showProgressInfo);
 			}
 			else
 			{
 				throw ITLException(std::string("Unsupported file type, file not found, or cannot be read: ") + filename + "\n" +
-					internals::combineReasons(rawReason, tiffReason, sequenceReason, volReason, nrrdReason, pcrReason));
+					internals::combineReasons(rawReason, tiffReason, sequenceReason, volReason, nrrdReason, pcrReason, nn5Reason));
 			}
 		}
 
@@ -84,8 +90,12 @@ namespace itl2
 			Vec3c dimensions;
 			ImageDataType dt;
 
-			std::string volReason, tiffReason, nrrdReason, sequenceReason, rawReason, pcrReason;
-			if (vol::getInfo(filename, dimensions, dt, volReason))
+			std::string volReason, tiffReason, nrrdReason, sequenceReason, rawReason, pcrReason, nn5Reason;
+			if (nn5::getInfo(filename, dimensions, dt, nn5Reason))
+			{
+				nn5::readBlock(img, filename, blockStart, showProgressInfo);
+			}
+			else if (vol::getInfo(filename, dimensions, dt, volReason))
 			{
 				vol::readBlock(img, filename, blockStart, showProgressInfo);
 			}
@@ -112,7 +122,7 @@ namespace itl2
 			else
 			{
 				throw ITLException(std::string("Unsupported file type, file not found, or cannot be read: ") + filename + "\n" +
-					internals::combineReasons(rawReason, tiffReason, sequenceReason, volReason, nrrdReason, pcrReason));
+					internals::combineReasons(rawReason, tiffReason, sequenceReason, volReason, nrrdReason, pcrReason, nn5Reason));
 			}
 		}
 
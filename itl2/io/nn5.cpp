@@ -0,0 +1,780 @@
+#include "io/nn5.h"
+#include "io/fileutils.h"
+#include "io/inireader.h"
+#include "utilities.h"
+#include "generation.h"
+#include "pointprocess.h"
+#include "transform.h"
+#include "testutils.h"
+#include "filesystem.h"
+
+#include <fstream>
+#include <random>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+
+using namespace std;
+
+namespace itl2
+{
+	namespace nn5
+	{
+		namespace internals
+		{
+			/**
+			Name of the header file in the dataset directory.
+			*/
+			const string HEADER_FILE = "metadata.txt";
+
+			/**
+			Identifiers of the compression methods in the chunk files.
+			*/
+			const char CHUNK_RAW = 0;
+			const char CHUNK_LZ4 = 1;
+
+			// LZ4 block format constants
+			const size_t LZ4_MIN_MATCH = 4;
+			const size_t LZ4_LAST_LITERALS = 5;
+			const size_t LZ4_MF_LIMIT = 12;
+			const size_t LZ4_MAX_OFFSET = 65535;
+			const int LZ4_HASH_BITS = 16;
+
+			inline uint32_t read32(const uint8_t* p)
+			{
+				uint32_t v;
+				memcpy(&v, p, sizeof(v));
+				return v;
+			}
+
+			inline uint32_t lz4Hash(uint32_t sequence)
+			{
+				return (sequence * 2654435761U) >> (32 - LZ4_HASH_BITS);
+			}
+
+			/**
+			Writes LZ4 length extension bytes.
+			*/
+			inline void writeLength(vector<char>& dst, size_t len)
+			{
+				while (len >= 255)
+				{
+					dst.push_back((char)255);
+					len -= 255;
+				}
+				dst.push_back((char)len);
+			}
+
+			/**
+			Writes one LZ4 sequence. If matchLength is zero, writes only literals (the last sequence of a block).
+			*/
+			inline void writeSequence(vector<char>& dst, const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength)
+			{
+				uint8_t token = (uint8_t)(std::min<size_t>(literalLength, 15) << 4);
+				if (matchLength > 0)
+					token |= (uint8_t)std::min<size_t>(matchLength - LZ4_MIN_MATCH, 15);
+				dst.push_back((char)token);
+
+				if (literalLength >= 15)
+					writeLength(dst, literalLength - 15);
+				dst.insert(dst.end(), (const char*)literals, (const char*)literals + literalLength);
+
+				if (matchLength > 0)
+				{
+					dst.push_back((char)(offset & 0xff));
+					dst.push_back((char)((offset >> 8) & 0xff));
+					if (matchLength - LZ4_MIN_MATCH >= 15)
+						writeLength(dst, matchLength - LZ4_MIN_MATCH - 15);
+				}
+			}
+
+			void compressLZ4(const char* srcChar, size_t srcSize, vector<char>& dst)
+			{
+				const uint8_t* src = (const uint8_t*)srcChar;
+				dst.clear();
+				dst.reserve(srcSize / 2 + 16);
+
+				size_t anchor = 0;
+
+				if (srcSize > LZ4_MF_LIMIT)
+				{
+					vector<size_t> table((size_t)1 << LZ4_HASH_BITS, numeric_limits<size_t>::max());
+					const size_t matchLimit = srcSize - LZ4_LAST_LITERALS;
+					const size_t ipLimit = srcSize - LZ4_MF_LIMIT;
+
+					size_t ip = 0;
+					size_t searchCount = 0;
+					while (ip < ipLimit)
+					{
+						uint32_t sequence = read32(src + ip);
+						uint32_t h = lz4Hash(sequence);
+						size_t ref = table[h];
+						table[h] = ip;
+
+						if (ref < ip && ip - ref <= LZ4_MAX_OFFSET && read32(src + ref) == sequence)
+						{
+							size_t matchLength = LZ4_MIN_MATCH;
+							while (ip + matchLength < matchLimit && src[ref + matchLength] == src[ip + matchLength])
+								matchLength++;
+
+							// Extend the match backwards into the literals.
+							while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1])
+							{
+								ip--;
+								ref--;
+								matchLength++;
+							}
+
+							writeSequence(dst, src + anchor, ip - anchor, ip - ref, matchLength);
+
+							ip += matchLength;
+							anchor = ip;
+							searchCount = 0;
+
+							// Insert position just before the current one to the hash table to improve matching of repeating data.
+							if (ip - 2 < ipLimit)
+								table[lz4Hash(read32(src + ip - 2))] = ip - 2;
+						}
+						else
+						{
+							// Skip faster through incompressible data.
+							ip += 1 + (searchCount++ >> 6);
+						}
+					}
+				}
+
+				writeSequence(dst, src + anchor, srcSize - anchor, 0, 0);
+			}
+
+			void decompressLZ4(const char* srcChar, size_t srcSize, char* dstChar, size_t dstSize)
+			{
+				const uint8_t* src = (const uint8_t*)srcChar;
+				uint8_t* dst = (uint8_t*)dstChar;
+
+				auto readLength = [&](size_t& ip, size_t len)
+				{
+					if (len == 15)
+					{
+						uint8_t b;
+						do
+						{
+							if (ip >= srcSize)
+								throw ITLException("Corrupted LZ4 data.");
+							b = src[ip++];
+							len += b;
+						} while (b == 255);
+					}
+					return len;
+				};
+
+				size_t ip = 0;
+				size_t op = 0;
+				while (ip < srcSize)
+				{
+					uint8_t token = src[ip++];
+
+					size_t literalLength = readLength(ip, token >> 4);
+					if (ip + literalLength > srcSize || op + literalLength > dstSize)
+						throw ITLException("Corrupted LZ4 data.");
+					memcpy(dst + op, src + ip, literalLength);
+					ip += literalLength;
+					op += literalLength;
+
+					if (ip >= srcSize)
+						break;
+
+					if (ip + 2 > srcSize)
+						throw ITLException("Corrupted LZ4 data.");
+					size_t offset = (size_t)src[ip] | ((size_t)src[ip + 1] << 8);
+					ip += 2;
+					if (offset <= 0 || offset > op)
+						throw ITLException("Corrupted LZ4 data.");
+
+					size_t matchLength = readLength(ip, token & 15) + LZ4_MIN_MATCH;
+					if (op + matchLength > dstSize)
+						throw ITLException("Corrupted LZ4 data.");
+
+					const uint8_t* match = dst + op - offset;
+					if (offset >= matchLength)
+					{
+						memcpy(dst + op, match, matchLength);
+					}
+					else
+					{
+						// Overlapping copy, e.g. a run of a repeating value.
+						for (size_t n = 0; n < matchLength; n++)
+							dst[op + n] = match[n];
+					}
+					op += matchLength;
+				}
+
+				if (op != dstSize)
+					throw ITLException("Corrupted LZ4 data.");
+			}
+
+			/**
+			Creates a unique name for a temporary file in the same directory than the given file.
+			*/
+			string tempFilename(const string& filename)
+			{
+				static thread_local mt19937_64 generator(random_device{}() ^ (uint64_t)hash<thread::id>()(this_thread::get_id()));
+				return filename + ".tmp" + itl2::toString(generator());
+			}
+
+			/**
+			Writes data to a temporary file and then renames it to the final name.
+			*/
+			void writeFileAtomic(const string& filename, const char* pHeader, size_t headerSize, const char* pData, size_t size)
+			{
+				string temp = tempFilename(filename);
+				{
+					ofstream out(temp, ios_base::out | ios_base::trunc | ios_base::binary);
+					if (!out)
+						throw ITLException(string("Unable to open ") + temp + ", " + getStreamErrorMessage());
+
+					out.write(pHeader, headerSize);
+					out.write(pData, size);
+
+					if (!out)
+						throw ITLException(string("Unable to write to ") + temp + ", " + getStreamErrorMessage());
+				}
+
+				try
+				{
+					fs::rename(temp, filename);
+				}
+				catch (fs::filesystem_error& e)
+				{
+					fs::remove(temp);
+					throw ITLException(string("Unable to rename ") + temp + " to " + filename + ", " + e.what());
+				}
+			}
+
+			bool readHeader(const string& path, Vec3c& dimensions, ImageDataType& dataType, Vec3c& chunkSize, NN5Compression& compression, string& reason)
+			{
+				dimensions = Vec3c(0, 0, 0);
+				dataType = ImageDataType::Unknown;
+
+				fs::path headerFile = fs::path(path) / HEADER_FILE;
+				if (!fs::is_directory(path) || !fs::exists(headerFile))
+				{
+					reason = "The path is not a directory containing NN5 metadata file.";
+					return false;
+				}
+
+				INIReader reader(headerFile.string());
+				if (reader.parseError() != 0)
+				{
+					reason = "Unable to parse NN5 metadata file.";
+					return false;
+				}
+
+				try
+				{
+					dimensions.x = reader.get<coord_t>("width", 0);
+					dimensions.y = reader.get<coord_t>("height", 0);
+					dimensions.z = reader.get<coord_t>("depth", 0);
+					chunkSize.x = reader.get<coord_t>("chunk_width", 0);
+					chunkSize.y = reader.get<coord_t>("chunk_height", 0);
+					chunkSize.z = reader.get<coord_t>("chunk_depth", 0);
+					dataType = fromString<ImageDataType>(reader.get<string>("data_type", ""));
+					compression = fromString<NN5Compression>(reader.get<string>("compression", "raw"));
+				}
+				catch (ITLException& e)
+				{
+					reason = string("Invalid value in NN5 metadata file. ") + e.message();
+					return false;
+				}
+
+				if (dimensions.min() <= 0 || chunkSize.min() <= 0)
+				{
+					reason = "Invalid dimensions or chunk size in NN5 metadata file.";
+					return false;
+				}
+
+				if (dataType == ImageDataType::Unknown)
+				{
+					reason = "Unsupported pixel data type in NN5 metadata file.";
+					return false;
+				}
+
+				return true;
+			}
+
+			void writeHeader(const string& path, const Vec3c& dimensions, ImageDataType dataType, const Vec3c& chunkSize, NN5Compression compression)
+			{
+				stringstream s;
+				s << "; NN5 chunked image" << endl;
+				s << "width = " << dimensions.x << endl;
+				s << "height = " << dimensions.y << endl;
+				s << "depth = " << dimensions.z << endl;
+				s << "data_type = " << toString(dataType) << endl;
+				s << "chunk_width = " << chunkSize.x << endl;
+				s << "chunk_height = " << chunkSize.y << endl;
+				s << "chunk_depth = " << chunkSize.z << endl;
+				s << "compression = " << toString(compression) << endl;
+
+				string str = s.str();
+				writeFileAtomic((fs::path(path) / HEADER_FILE).string(), nullptr, 0, str.c_str(), str.length());
+			}
+
+			/**
+			Tests if the given directory contains only temporary header files, i.e. another process is creating a dataset to it.
+			*/
+			bool isBeingCreated(const string& path)
+			{
+				std::error_code ec;
+				if (!fs::is_directory(path, ec))
+					return false;
+
+				bool tempHeaderFound = false;
+				for (auto& entry : fs::directory_iterator(path, ec))
+				{
+					if (!startsWith(entry.path().filename().string(), HEADER_FILE + ".tmp"))
+						return false;
+					tempHeaderFound = true;
+				}
+
+				return tempHeaderFound;
+			}
+
+			void prepareDataset(const string& path, const Vec3c& dimensions, ImageDataType dataType, Vec3c& chunkSize, NN5Compression& compression)
+			{
+				Vec3c existingDims, existingChunkSize;
+				ImageDataType existingDataType;
+				NN5Compression existingCompression;
+				string reason;
+
+				// If another process is writing the header, wait until it appears.
+				// A directory that stays in that state is probably left behind by a failed process.
+				auto startTime = chrono::steady_clock::now();
+				while (!readHeader(path, existingDims, existingDataType, existingChunkSize, existingCompression, reason) &&
+					isBeingCreated(path) &&
+					chrono::steady_clock::now() - startTime < chrono::seconds(60))
+				{
+					this_thread::sleep_for(chrono::milliseconds(10));
+				}
+
+				if (readHeader(path, existingDims, existingDataType, existingChunkSize, existingCompression, reason))
+				{
+					if (existingDims != dimensions || existingDataType != dataType)
+						throw ITLException(string("NN5 dataset ") + path + " already exists and its dimensions or data type are different from the image being written.");
+
+					chunkSize = existingChunkSize;
+					compression = existingCompression;
+					return;
+				}
+
+				if (fs::exists(path) && (!fs::is_directory(path) || !fs::is_empty(path)))
+					throw ITLException(string("Unable to create NN5 dataset to ") + path + " as a file or a non-empty directory with that name exists.");
+
+				if (chunkSize.min() <= 0)
+					throw ITLException("NN5 chunk size must be positive.");
+
+				// Chunks do not need to be larger than the image.
+				chunkSize = min(chunkSize, max(dimensions, Vec3c(1, 1, 1)));
+
+				// Multiple processes may create the dataset simultaneously, but they all write the same header, and
+				// writeHeader replaces the header atomically.
+				fs::create_directories(path);
+				writeHeader(path, dimensions, dataType, chunkSize, compression);
+			}
+
+			void removeDataset(const string& path)
+			{
+				if (!fs::exists(path))
+					return;
+
+				Vec3c dims, chunkSize;
+				ImageDataType dt;
+				NN5Compression compression;
+				string reason;
+				if (readHeader(path, dims, dt, chunkSize, compression, reason) ||
+					(fs::is_directory(path) && fs::is_empty(path)))
+				{
+					fs::remove_all(path);
+				}
+				else
+				{
+					throw ITLException(string("Unable to replace ") + path + " as it is not a NN5 dataset.");
+				}
+			}
+
+			string chunkFile(const string& path, const Vec3c& chunkIndex)
+			{
+				return (fs::path(path) / (string("chunk_") + itl2::toString(chunkIndex.x) + "_" + itl2::toString(chunkIndex.y) + "_" + itl2::toString(chunkIndex.z))).string();
+			}
+
+			void readChunk(const string& filename, char* pData, size_t size)
+			{
+				ifstream in(filename, ios_base::in | ios_base::binary);
+				if (!in)
+				{
+					// Missing chunk corresponds to zeroes.
+					memset(pData, 0, size);
+					return;
+				}
+
+				in.seekg(0, ios_base::end);
+				size_t fileSize = (size_t)in.tellg();
+				in.seekg(0, ios_base::beg);
+
+				if (fileSize < 1)
+					throw ITLException(string("NN5 chunk file ") + filename + " is corrupted.");
+
+				char method;
+				in.read(&method, 1);
+
+				if (method == CHUNK_RAW)
+				{
+					if (fileSize - 1 != size)
+						throw ITLException(string("NN5 chunk file ") + filename + " has invalid size.");
+					in.read(pData, size);
+				}
+				else if (method == CHUNK_LZ4)
+				{
+					vector<char> compressed(fileSize - 1);
+					in.read(compressed.data(), compressed.size());
+					if (!in)
+						throw ITLException(string("Unable to read ") + filename + ", " + getStreamErrorMessage());
+
+					try
+					{
+						decompressLZ4(compressed.data(), compressed.size(), pData, size);
+					}
+					catch (ITLException& e)
+					{
+						throw ITLException(string("Unable to decompress NN5 chunk file ") + filename + ". " + e.message());
+					}
+				}
+				else
+				{
+					throw ITLException(string("NN5 chunk file ") + filename + " uses unsupported compression method.");
+				}
+
+				if (!in)
+					throw ITLException(string("Unable to read ") + filename + ", " + getStreamErrorMessage());
+			}
+
+			/**
+			Tests if the given buffer contains only zero bytes.
+			*/
+			bool isZero(const char* pData, size_t size)
+			{
+				for (size_t n = 0; n < size; n++)
+				{
+					if (pData[n] != 0)
+						return false;
+				}
+				return true;
+			}
+
+			void writeChunk(const string& filename, const char* pData, size_t size, NN5Compression compression)
+			{
+				if (isZero(pData, size))
+				{
+					// Empty chunks are not stored.
+					fs::remove(filename);
+					return;
+				}
+
+				if (compression == NN5Compression::LZ4)
+				{
+					vector<char> compressed;
+					compressLZ4(pData, size, compressed);
+
+					// Store uncompressed if the data does not compress.
+					if (compressed.size() < size)
+					{
+						writeFileAtomic(filename, &CHUNK_LZ4, 1, compressed.data(), compressed.size());
+						return;
+					}
+				}
+
+				writeFileAtomic(filename, &CHUNK_RAW, 1, pData, size);
+			}
+
+			/**
+			Removes a lock file that has been seen with the given modification time for a long time.
+			The file is first renamed so that only one process can remove it. If the renamed file turns out to be a new lock,
+			it is put back.
+			*/
+			void breakStaleLock(const string& lockFile, fs::file_time_type staleModified)
+			{
+				string temp = tempFilename(lockFile);
+				std::error_code ec;
+				fs::rename(lockFile, temp, ec);
+				if (ec)
+					return;
+
+				if (fs::last_write_time(temp, ec) == staleModified && !ec)
+				{
+					fs::remove(temp, ec);
+				}
+				else
+				{
+					// The lock was re-created after it was found to be stale. Restore it unless somebody has already created a new one.
+					fs::create_hard_link(temp, lockFile, ec);
+					fs::remove(temp, ec);
+				}
+			}
+
+			ChunkLock::ChunkLock(const string& chunkFilename) : lockFile(chunkFilename + ".lock")
+			{
+				// The staleness is decided from the modification time of the lock file, but its age is measured using
+				// the clock of this process, as the clocks of the file server and this computer might not be in sync.
+				// A new lock has a new modification time, so a lock is broken only if the same lock has been held for the whole stale time.
+				const auto staleTime = chrono::seconds(60);
+				auto startTime = chrono::steady_clock::now();
+				bool lockSeen = false;
+				fs::file_time_type lockModified;
+				while (true)
+				{
+					// Mode "x" fails if the file exists (C11), i.e. the file is created exclusively.
+					FILE* f = fopen(lockFile.c_str(), "wx");
+					if (f)
+					{
+						fclose(f);
+						return;
+					}
+
+					std::error_code ec;
+					fs::file_time_type modified = fs::last_write_time(lockFile, ec);
+					if (ec)
+					{
+						// The lock does not exist anymore, or creation failed for some other reason than existing lock.
+						if (!fs::exists(lockFile) && lockSeen)
+						{
+							lockSeen = false;
+							startTime = chrono::steady_clock::now();
+						}
+						else if (chrono::steady_clock::now() - startTime > staleTime)
+						{
+							throw ITLException(string("Unable to create lock file ") + lockFile + ", " + getStreamErrorMessage());
+						}
+					}
+					else if (!lockSeen || modified != lockModified)
+					{
+						// New lock, start measuring its age.
+						lockSeen = true;
+						lockModified = modified;
+						startTime = chrono::steady_clock::now();
+					}
+					else if (chrono::steady_clock::now() - startTime > staleTime)
+					{
+						// The same lock has been held for a long time. Assume that its owner has crashed.
+						breakStaleLock(lockFile, lockModified);
+						lockSeen = false;
+						startTime = chrono::steady_clock::now();
+						continue;
+					}
+
+					this_thread::sleep_for(chrono::milliseconds(5));
+				}
+			}
+
+			ChunkLock::~ChunkLock()
+			{
+				std::error_code ec;
+				fs::remove(lockFile, ec);
+			}
+		}
+
+		bool getInfo(const string& path, Vec3c& dimensions, ImageDataType& dataType, string& reason)
+		{
+			Vec3c chunkSize;
+			NN5Compression compression;
+			return internals::readHeader(path, dimensions, dataType, chunkSize, compression, reason);
+		}
+
+		double storedChunkFraction(const string& path, const Vec3c& start, const Vec3c& size)
+		{
+			Vec3c dimensions;
+			ImageDataType dataType;
+			Vec3c chunkSize;
+			NN5Compression compression;
+			string reason;
+			if (!internals::readHeader(path, dimensions, dataType, chunkSize, compression, reason))
+				throw ITLException(string("Unable to read NN5 dataset ") + path + ". " + reason);
+
+			Vec3c cStart = start;
+			clamp(cStart, Vec3c(0, 0, 0), dimensions);
+			Vec3c cEnd = start + size;
+			clamp(cEnd, Vec3c(0, 0, 0), dimensions);
+
+			vector<Vec3c> chunks = internals::chunksInRegion(cStart, cEnd, chunkSize);
+			if (chunks.size() <= 0)
+				return 0;
+
+			size_t stored = 0;
+			for (const Vec3c& chunkIndex : chunks)
+			{
+				if (fs::exists(internals::chunkFile(path, chunkIndex)))
+					stored++;
+			}
+
+			return (double)stored / (double)chunks.size();
+		}
+
+		namespace tests
+		{
+			void lz4()
+			{
+				auto roundTrip = [](const vector<char>& data, const string& name)
+				{
+					vector<char> compressed;
+					internals::compressLZ4(data.data(), data.size(), compressed);
+					vector<char> result(data.size());
+					internals::decompressLZ4(compressed.data(), compressed.size(), result.data(), result.size());
+					testAssert(result == data, string("LZ4 round trip, ") + name);
+					return compressed.size();
+				};
+
+				// Empty and tiny data
+				roundTrip(vector<char>(), "empty");
+				roundTrip(vector<char>(3, 7), "tiny");
+
+				// Zeroes should compress very well.
+				size_t s = roundTrip(vector<char>(1000000, 0), "zeroes");
+				testAssert(s < 5000, "LZ4 compression of zeroes");
+
+				// Random data
+				vector<char> data(1000000);
+				for (size_t n = 0; n < data.size(); n++)
+					data[n] = (char)randc(256);
+				roundTrip(data, "random");
+
+				// Repeating patterns with random breaks
+				for (size_t n = 0; n < data.size(); n++)
+					data[n] = (char)((n % 37) + (randc(100) == 0 ? 1 : 0));
+				s = roundTrip(data, "pattern");
+				testAssert(s < data.size() / 4, "LZ4 compression of repeating pattern");
+
+				// Corrupted data must be detected
+				vector<char> compressed;
+				internals::compressLZ4(data.data(), data.size(), compressed);
+				bool thrown = false;
+				try
+				{
+					vector<char> result(data.size() + 1);
+					internals::decompressLZ4(compressed.data(), compressed.size(), result.data(), result.size());
+				}
+				catch (ITLException&)
+				{
+					thrown = true;
+				}
+				testAssert(thrown, "LZ4 corrupted data");
+			}
+
+			void nn5io()
+			{
+				Image<uint16_t> img(100, 80, 60);
+				ramp(img, 0);
+				draw(img, Sphere(Vec3c(50, 40, 30), (coord_t)20), (uint16_t)0);
+				add(img, 1);
+				draw(img, AABox(Vec3c(0, 0, 0), Vec3c(100, 80, 20)), (uint16_t)0);
+
+				nn5::write(img, "./nn5/simple", Vec3c(16, 16, 16));
+
+				Vec3c dims;
+				ImageDataType dt;
+				string reason;
+				testAssert(nn5::getInfo("./nn5/simple", dims, dt, reason), "NN5 getInfo");
+				testAssert(dims == img.dimensions(), "NN5 dimensions");
+				testAssert(dt == ImageDataType::UInt16, "NN5 data type");
+
+				Image<uint16_t> read;
+				nn5::read(read, "./nn5/simple");
+				checkDifference(img, read, "NN5 write and read");
+
+				// Empty chunks should not be stored
+				testAssert(!fs::exists(internals::chunkFile("./nn5/simple", Vec3c(0, 0, 0))), "Empty NN5 chunk was saved.");
+				testAssert(nn5::storedChunkFraction("./nn5/simple", Vec3c(0, 0, 0), Vec3c(100, 80, 16)) == 0, "NN5 stored chunk fraction of empty block");
+				double storedFraction = nn5::storedChunkFraction("./nn5/simple", Vec3c(0, 0, 0), Vec3c(100, 80, 32));
+				testAssert(storedFraction > 0 && storedFraction <= 0.5, "NN5 stored chunk fraction of partially empty block");
+
+				// Read block
+				Image<uint16_t> block(33, 21, 17);
+				nn5::readBlock(block, "./nn5/simple", Vec3c(7, 13, 11));
+				Image<uint16_t> gtBlock(block.dimensions());
+				crop(img, gtBlock, Vec3c(7, 13, 11));
+				checkDifference(block, gtBlock, "NN5 read block");
+
+				// Write block that is not aligned to chunks
+				Image<uint16_t> patch(23, 19, 29);
+				setValue(patch, 7);
+				nn5::writeBlock(patch, "./nn5/simple", Vec3c(5, 9, 13), img.dimensions(), Vec3c(2, 3, 4), Vec3c(20, 15, 22));
+				for (coord_t z = 0; z < 22; z++)
+					for (coord_t y = 0; y < 15; y++)
+						for (coord_t x = 0; x < 20; x++)
+							img(5 + x, 9 + y, 13 + z) = 7;
+
+				nn5::read(read, "./nn5/simple");
+				checkDifference(img, read, "NN5 write block");
+			}
+
+			void nn5ConcurrentWrite()
+			{
+				Image<float32_t> img(120, 90, 70);
+				ramp(img, 1);
+				internals::removeDataset("./nn5/concurrent");
+
+				// Write blocks whose boundaries are not aligned to chunks in parallel.
+				Vec3c blockSize(37, 29, 23);
+				vector<Vec3c> blocks;
+				for (coord_t z = 0; z < img.depth(); z += blockSize.z)
+					for (coord_t y = 0; y < img.height(); y += blockSize.y)
+						for (coord_t x = 0; x < img.width(); x += blockSize.x)
+							blocks.push_back(Vec3c(x, y, z));
+
+				#pragma omp parallel for
+				for (coord_t n = 0; n < (coord_t)blocks.size(); n++)
+				{
+					Vec3c size = min(blockSize, img.dimensions() - blocks[n]);
+					nn5::writeBlock(img, "./nn5/concurrent", blocks[n], img.dimensions(), blocks[n], size, Vec3c(32, 32, 32));
+				}
+
+				Image<float32_t> read;
+				nn5::read(read, "./nn5/concurrent");
+				checkDifference(img, read, "NN5 concurrent write");
+
+				// A dataset whose header is being written by another process is waited for.
+				internals::removeDataset("./nn5/creating");
+				fs::create_directories("./nn5/creating");
+				{
+					ofstream tmp("./nn5/creating/metadata.txt.tmp1");
+				}
+				thread creator([]()
+					{
+						this_thread::sleep_for(chrono::milliseconds(200));
+						internals::writeHeader("./nn5/creating", Vec3c(10, 10, 10), ImageDataType::UInt8, Vec3c(16, 16, 16), NN5Compression::Raw);
+						fs::remove("./nn5/creating/metadata.txt.tmp1");
+					});
+				Vec3c chunkSize(32, 32, 32);
+				NN5Compression compression = NN5Compression::LZ4;
+				internals::prepareDataset("./nn5/creating", Vec3c(10, 10, 10), ImageDataType::UInt8, chunkSize, compression);
+				creator.join();
+				testAssert(chunkSize == Vec3c(16, 16, 16) && compression == NN5Compression::Raw, "NN5 dataset being created by another process");
+
+				// A lock that is held is waited for.
+				string chunk = internals::chunkFile("./nn5/creating", Vec3c(0, 0, 0));
+				{
+					ofstream lock(chunk + ".lock");
+				}
+				thread owner([&]()
+					{
+						this_thread::sleep_for(chrono::milliseconds(200));
+						fs::remove(chunk + ".lock");
+					});
+				auto start = chrono::steady_clock::now();
+				{
+					internals::ChunkLock lock(chunk);
+					testAssert(chrono::steady_clock::now() - start >= chrono::milliseconds(150), "NN5 chunk lock waits for the owner");
+				}
+				owner.join();
+				testAssert(!fs::exists(chunk + ".lock"), "NN5 chunk lock is released");
+			}
+		}
+	}
+}
@@ -0,0 +1,387 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "image.h"
+#include "itlexception.h"
+#include "io/imagedatatype.h"
+#include "math/vec3.h"
+#include "ompatomic.h"
+#include "progress.h"
+
+namespace itl2
+{
+	/**
+	Compression methods supported by the NN5 format.
+	*/
+	enum class NN5Compression
+	{
+		/**
+		Chunks are stored without compression.
+		*/
+		Raw,
+		/**
+		Chunks are compressed using the LZ4 block format.
+		*/
+		LZ4
+	};
+
+	template<> inline NN5Compression fromString(const string& str)
+	{
+		string str2 = str;
+		trim(str2);
+		toLower(str2);
+		if (str2 == "raw")
+			return NN5Compression::Raw;
+		if (str2 == "lz4")
+			return NN5Compression::LZ4;
+		throw ITLException(string("Invalid NN5 compression method: ") + str);
+	}
+
+	inline string toString(NN5Compression compression)
+	{
+		switch (compression)
+		{
+		case NN5Compression::Raw: return "raw";
+		case NN5Compression::LZ4: return "lz4";
+		default: throw ITLException("Invalid NN5 compression method.");
+		}
+	}
+
+	/**
+	NN5 is a simple chunked image format similar to N5 and Zarr.
+	The image is stored in a directory that contains a header file (metadata.txt) and one file for each chunk of the image.
+	Each chunk is compressed separately, and chunks containing only zeroes are not stored at all.
+	Reading a block of the image touches only the chunks that intersect the block.
+	Pixel data is stored in the native byte order.
+	*/
+	namespace nn5
+	{
+		/**
+		Default size of the chunks.
+		*/
+		inline const Vec3c DEFAULT_CHUNK_SIZE = Vec3c(64, 64, 64);
+
+		namespace internals
+		{
+			/**
+			Compresses data using the LZ4 block format.
+			@param src Data to compress.
+			@param srcSize Size of the data in bytes.
+			@param dst Output buffer. Its size is set to the size of the compressed data.
+			*/
+			void compressLZ4(const char* src, size_t srcSize, std::vector<char>& dst);
+
+			/**
+			Decompresses LZ4 block.
+			Throws ITLException if the data is corrupted or its uncompressed size is not dstSize.
+			*/
+			void decompressLZ4(const char* src, size_t srcSize, char* dst, size_t dstSize);
+
+			/**
+			Reads NN5 header from the given dataset directory.
+			@return True if the header is valid, false otherwise. In the false case, reason contains a description of the problem.
+			*/
+			bool readHeader(const std::string& path, Vec3c& dimensions, ImageDataType& dataType, Vec3c& chunkSize, NN5Compression& compression, std::string& reason);
+
+			/**
+			Makes sure that the given directory contains NN5 dataset with the given dimensions and data type.
+			The dataset is created if it does not exist.
+			Throws ITLException if the path contains an incompatible dataset or something else than a NN5 dataset.
+			@param chunkSize Chunk size used if the dataset is created. At output, contains the chunk size of the dataset.
+			@param compression Compression used if the dataset is created. At output, contains the compression method of the dataset.
+			*/
+			void prepareDataset(const std::string& path, const Vec3c& dimensions, ImageDataType dataType, Vec3c& chunkSize, NN5Compression& compression);
+
+			/**
+			Removes NN5 dataset from the given path, if it exists.
+			Throws ITLException if the path contains something else than a NN5 dataset.
+			*/
+			void removeDataset(const std::string& path);
+
+			/**
+			Gets name of file where the given chunk is stored.
+			*/
+			std::string chunkFile(const std::string& path, const Vec3c& chunkIndex);
+
+			/**
+			Reads data of one chunk to the given buffer.
+			If the chunk file does not exist, the buffer is filled with zeroes.
+			*/
+			void readChunk(const std::string& filename, char* pData, size_t size);
+
+			/**
+			Writes data of one chunk to the given file.
+			The write is atomic: readers see either the old or the new data.
+			If the data contains only zeroes, the chunk file is removed.
+			*/
+			void writeChunk(const std::string& filename, const char* pData, size_t size, NN5Compression compression);
+
+			/**
+			Lock that prevents simultaneous read-modify-write operations of a chunk from multiple processes.
+			The lock is implemented as a lock file that is created exclusively, as that is the most robust locking mechanism on network file systems.
+			A lock file whose modification time has not changed in about one minute is assumed to be left behind by a failed process, and it is broken.
+			*/
+			class ChunkLock
+			{
+			private:
+				std::string lockFile;
+
+			public:
+				ChunkLock(const std::string& chunkFilename);
+				~ChunkLock();
+
+				ChunkLock(const ChunkLock&) = delete;
+				ChunkLock& operator=(const ChunkLock&) = delete;
+			};
+
+			/**
+			Lists indices of chunks that intersect the region [start, end[.
+			*/
+			inline std::vector<Vec3c> chunksInRegion(const Vec3c& start, const Vec3c& end, const Vec3c& chunkSize)
+			{
+				std::vector<Vec3c> chunks;
+				if (start.x >= end.x || start.y >= end.y || start.z >= end.z)
+					return chunks;
+
+				Vec3c first = start.componentwiseDivide(chunkSize);
+				Vec3c last = (end - Vec3c(1, 1, 1)).componentwiseDivide(chunkSize);
+				for (coord_t z = first.z; z <= last.z; z++)
+				{
+					for (coord_t y = first.y; y <= last.y; y++)
+					{
+						for (coord_t x = first.x; x <= last.x; x++)
+						{
+							chunks.push_back(Vec3c(x, y, z));
+						}
+					}
+				}
+				return chunks;
+			}
+
+			/**
+			Runs the given function for each chunk in parallel, and reports the first error after all chunks have been processed.
+			*/
+			template<typename F> void forAllChunks(const std::vector<Vec3c>& chunks, bool showProgressInfo, F&& f)
+			{
+				std::string errorMessage;
+				OmpAtomic<bool> broken = false;
+
+				ProgressIndicator prog(chunks.size(), showProgressInfo);
+				#pragma omp parallel for schedule(dynamic) if(chunks.size() > 1 && !omp_in_parallel())
+				for (coord_t n = 0; n < (coord_t)chunks.size(); n++)
+				{
+					if (!broken)
+					{
+						try
+						{
+							f(chunks[n]);
+						}
+						catch (const ITLException& ex)
+						{
+							broken = true;
+
+							#pragma omp critical(nn5Error)
+							{
+								errorMessage = ex.message();
+							}
+						}
+					}
+
+					prog.step();
+				}
+
+				if (broken)
+					throw ITLException(errorMessage);
+			}
+		}
+
+		/**
+		Gets information about NN5 dataset in the given path.
+		@return True if the path contains a NN5 dataset.
+		*/
+		bool getInfo(const std::string& path, Vec3c& dimensions, ImageDataType& dataType, std::string& reason);
+
+		/**
+		Calculates the fraction of chunks intersecting the given block of NN5 dataset that are stored in the dataset.
+		Empty chunks are not stored, so this is a cheap estimate of the fraction of non-zero pixels in the block.
+		Only existence of the chunk files is tested.
+		*/
+		double storedChunkFraction(const std::string& path, const Vec3c& start, const Vec3c& size);
+
+		/**
+		Reads a block of NN5 dataset to the given image.
+		Only chunks that intersect the block are read.
+		Regions of the block that are outside of the dataset are not changed.
+		@param img Image where the data is placed. The size of the image defines the size of the block that is read.
+		@param path Path to the dataset directory.
+		@param start Start location of the read in the dataset.
+		*/
+		template<typename pixel_t> void readBlock(Image<pixel_t>& img, const std::string& path, const Vec3c& start, bool showProgressInfo = false)
+		{
+			Vec3c dimensions;
+			ImageDataType dataType;
+			Vec3c chunkSize;
+			NN5Compression compression;
+			std::string reason;
+			if (!internals::readHeader(path, dimensions, dataType, chunkSize, compression, reason))
+				throw ITLException(std::string("Unable to read NN5 dataset ") + path + ". " + reason);
+
+			if (dataType != imageDataType<pixel_t>())
+				throw ITLException(std::string("Pixel data type in the NN5 dataset is ") + toString(dataType) + ", but image data type is " + toString(imageDataType<pixel_t>()) + ".");
+
+			Vec3c cStart = start;
+			clamp(cStart, Vec3c(0, 0, 0), dimensions);
+			Vec3c cEnd = start + img.dimensions();
+			clamp(cEnd, Vec3c(0, 0, 0), dimensions);
+
+			internals::forAllChunks(internals::chunksInRegion(cStart, cEnd, chunkSize), showProgressInfo, [&](const Vec3c& chunkIndex)
+				{
+					Vec3c chunkStart = chunkIndex.componentwiseMultiply(chunkSize);
+					Vec3c chunkDims = min(chunkSize, dimensions - chunkStart);
+					std::vector<pixel_t> buffer(chunkDims.x * chunkDims.y * chunkDims.z);
+					internals::readChunk(internals::chunkFile(path, chunkIndex), (char*)buffer.data(), buffer.size() * sizeof(pixel_t));
+
+					// Copy the intersection of the chunk and the block
+					Vec3c s = max(chunkStart, cStart);
+					Vec3c e = min(chunkStart + chunkDims, cEnd);
+					for (coord_t z = s.z; z < e.z; z++)
+					{
+						for (coord_t y = s.y; y < e.y; y++)
+						{
+							const pixel_t* pSrc = &buffer[((z - chunkStart.z) * chunkDims.y + (y - chunkStart.y)) * chunkDims.x + (s.x - chunkStart.x)];
+							pixel_t* pDst = &img(s.x - start.x, y - start.y, z - start.z);
+							std::copy(pSrc, pSrc + (e.x - s.x), pDst);
+						}
+					}
+				});
+		}
+
+		/**
+		Reads NN5 dataset to the given image.
+		The size of the image is set automatically.
+		@param img Image where the data is placed.
+		@param path Path to the dataset directory.
+		*/
+		template<typename pixel_t> void read(Image<pixel_t>& img, const std::string& path, bool showProgressInfo = false)
+		{
+			Vec3c dimensions;
+			ImageDataType dataType;
+			std::string reason;
+			if (!getInfo(path, dimensions, dataType, reason))
+				throw ITLException(std::string("Unable to read NN5 dataset ") + path + ". " + reason);
+
+			img.ensureSize(dimensions);
+			readBlock(img, path, Vec3c(0, 0, 0), showProgressInfo);
+		}
+
+		/**
+		Writes a block of an image to the specified location in a NN5 dataset.
+		If the dataset does not exist, it is created. Existing data outside of the block is not changed.
+		Chunks that are completely covered by the block are written without reading them first.
+		Partially covered chunks are updated under a lock so that multiple processes can write non-overlapping blocks of the same dataset simultaneously.
+		Part of the block extending beyond [0, fileDimensions[ is not written.
+		@param img Image to write.
+		@param path Path to the dataset directory.
+		@param filePosition Position in the dataset to write to.
+		@param fileDimensions Total dimensions of the dataset.
+		@param imagePosition Position in the image where the block to be written starts.
+		@param imageDimensions Dimensions of the block of the source image to write.
+		@param chunkSize Size of the chunks if a new dataset is created.
+		@param compression Compression method if a new dataset is created.
+		@param showProgressInfo Set to true to show a progress bar.
+		*/
+		template<typename pixel_t> void writeBlock(const Image<pixel_t>& img, const std::string& path, const Vec3c& filePosition, const Vec3c& fileDimensions,
+			const Vec3c& imagePosition, const Vec3c& imageDimensions,
+			const Vec3c& chunkSize = DEFAULT_CHUNK_SIZE, NN5Compression compression = NN5Compression::LZ4,
+			bool showProgressInfo = false)
+		{
+			if (!img.isInImage(imagePosition))
+				throw ITLException("Block start position must be inside the image.");
+			if (!img.isInImage(imagePosition + imageDimensions - Vec3c(1, 1, 1)))
+				throw ITLException("Block end position must be inside the image.");
+
+			Vec3c realChunkSize = chunkSize;
+			NN5Compression realCompression = compression;
+			internals::prepareDataset(path, fileDimensions, imageDataType<pixel_t>(), realChunkSize, realCompression);
+
+			Vec3c cStart = filePosition;
+			clamp(cStart, Vec3c(0, 0, 0), fileDimensions);
+			Vec3c cEnd = filePosition + imageDimensions;
+			clamp(cEnd, Vec3c(0, 0, 0), fileDimensions);
+
+			// Converts position in the dataset to position in the image.
+			Vec3c shift = imagePosition - filePosition;
+
+			internals::forAllChunks(internals::chunksInRegion(cStart, cEnd, realChunkSize), showProgressInfo, [&](const Vec3c& chunkIndex)
+				{
+					Vec3c chunkStart = chunkIndex.componentwiseMultiply(realChunkSize);
+					Vec3c chunkDims = min(realChunkSize, fileDimensions - chunkStart);
+					Vec3c s = max(chunkStart, cStart);
+					Vec3c e = min(chunkStart + chunkDims, cEnd);
+
+					std::vector<pixel_t> buffer(chunkDims.x * chunkDims.y * chunkDims.z);
+					std::string filename = internals::chunkFile(path, chunkIndex);
+
+					auto copyBlock = [&]()
+					{
+						for (coord_t z = s.z; z < e.z; z++)
+						{
+							for (coord_t y = s.y; y < e.y; y++)
+							{
+								const pixel_t* pSrc = &img(s.x + shift.x, y + shift.y, z + shift.z);
+								pixel_t* pDst = &buffer[((z - chunkStart.z) * chunkDims.y + (y - chunkStart.y)) * chunkDims.x + (s.x - chunkStart.x)];
+								std::copy(pSrc, pSrc + (e.x - s.x), pDst);
+							}
+						}
+					};
+
+					if (s == chunkStart && e == chunkStart + chunkDims)
+					{
+						// The whole chunk is overwritten.
+						copyBlock();
+						internals::writeChunk(filename, (const char*)buffer.data(), buffer.size() * sizeof(pixel_t), realCompression);
+					}
+					else
+					{
+						// Part of the chunk is overwritten. Other processes might be writing other parts of the chunk.
+						internals::ChunkLock lock(filename);
+						internals::readChunk(filename, (char*)buffer.data(), buffer.size() * sizeof(pixel_t));
+						copyBlock();
+						internals::writeChunk(filename, (const char*)buffer.data(), buffer.size() * sizeof(pixel_t), realCompression);
+					}
+				});
+		}
+
+		/**
+		Writes a block of an image to the specified location in a NN5 dataset.
+		See the other overload for details.
+		*/
+		template<typename pixel_t> void writeBlock(const Image<pixel_t>& img, const std::string& path, const Vec3c& filePosition, const Vec3c& fileDimensions, bool showProgressInfo = false)
+		{
+			writeBlock(img, path, filePosition, fileDimensions, Vec3c(0, 0, 0), img.dimensions(), DEFAULT_CHUNK_SIZE, NN5Compression::LZ4, showProgressInfo);
+		}
+
+		/**
+		Writes an image to a NN5 dataset.
+		If the dataset exists, it is replaced.
+		@param img Image to write.
+		@param path Path to the dataset directory.
+		@param chunkSize Size of the chunks.
+		@param compression Compression method.
+		*/
+		template<typename pixel_t> void write(const Image<pixel_t>& img, const std::string& path, const Vec3c& chunkSize = DEFAULT_CHUNK_SIZE, NN5Compression compression = NN5Compression::LZ4, bool showProgressInfo = false)
+		{
+			internals::removeDataset(path);
+			writeBlock(img, path, Vec3c(0, 0, 0), img.dimensions(), Vec3c(0, 0, 0), img.dimensions(), chunkSize, compression, showProgressInfo);
+		}
+
+		namespace tests
+		{
+			void lz4();
+			void nn5io();
+			void nn5ConcurrentWrite();
+		}
+	}
+}
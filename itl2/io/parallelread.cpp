@@ -0,0 +1,476 @@
+#include "io/parallelread.h"
+#include "io/writebehind.h"
+#include "io/fileutils.h"
+#include "itlexception.h"
+#include "utilities.h"
+#include "progress.h"
+#include "ompatomic.h"
+#include "timer.h"
+#include "test.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <iostream>
+#include <omp.h>
+
+#if defined(__linux__)
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#elif defined(_WIN32)
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+
+#else
+
+#error parallelread.cpp not configured for this platform.
+
+#endif
+
+using namespace std;
+
+namespace itl2
+{
+	ParallelReadSettings& parallelReadSettings()
+	{
+		static ParallelReadSettings settings;
+		return settings;
+	}
+
+	namespace internals
+	{
+		/**
+		Alignment of file positions, sizes and memory buffers in direct I/O.
+		*/
+		constexpr size_t DIRECT_IO_ALIGNMENT = 4096;
+
+		/**
+		One read operation that is issued to the operating system.
+		Covers file region [filePos, filePos + size[ and fills requests [first, last[.
+		*/
+		struct ReadOperation
+		{
+			size_t filePos;
+			size_t size;
+			size_t first;
+			size_t last;
+
+			/**
+			True if the operation can be read directly to the memory of the first request.
+			*/
+			bool contiguous;
+		};
+
+		/**
+		Memory buffer aligned suitably for direct I/O.
+		*/
+		class AlignedBuffer
+		{
+		private:
+			char* pData = nullptr;
+			size_t capacity = 0;
+
+			static void freeData(char* p)
+			{
+#if defined(__linux__)
+				free(p);
+#elif defined(_WIN32)
+				_aligned_free(p);
+#endif
+			}
+
+		public:
+			AlignedBuffer() = default;
+			AlignedBuffer(const AlignedBuffer&) = delete;
+			AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+			~AlignedBuffer()
+			{
+				freeData(pData);
+			}
+
+			/**
+			Returns pointer to buffer that can hold at least the given number of bytes.
+			*/
+			char* get(size_t size)
+			{
+				if (size > capacity)
+				{
+					freeData(pData);
+					pData = nullptr;
+					capacity = 0;
+
+					size_t alignedSize = (size + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+#if defined(__linux__)
+					void* p = nullptr;
+					if (posix_memalign(&p, DIRECT_IO_ALIGNMENT, alignedSize) != 0)
+						throw std::bad_alloc();
+					pData = (char*)p;
+#elif defined(_WIN32)
+					pData = (char*)_aligned_malloc(alignedSize, DIRECT_IO_ALIGNMENT);
+					if (!pData)
+						throw std::bad_alloc();
+#endif
+					capacity = alignedSize;
+				}
+				return pData;
+			}
+		};
+
+#if defined(__linux__)
+
+		typedef int FileHandle;
+
+		/**
+		Opens file for reading, possibly in direct I/O mode.
+		Returns -1 on failure.
+		*/
+		FileHandle openForRead(const string& filename, bool directIO)
+		{
+			int flags = O_RDONLY;
+			if (directIO)
+				flags |= O_DIRECT;
+			return ::open(filename.c_str(), flags);
+		}
+
+		bool isValid(FileHandle h)
+		{
+			return h != -1;
+		}
+
+		void closeFile(FileHandle h)
+		{
+			::close(h);
+		}
+
+		/**
+		Reads at most size bytes from the given position.
+		Returns count of bytes read, zero at end of file, or -1 on error.
+		*/
+		int64_t positionalRead(FileHandle h, char* pTarget, size_t size, size_t filePos)
+		{
+			while (true)
+			{
+				ssize_t result = ::pread(h, pTarget, size, (off_t)filePos);
+				if (result < 0 && errno == EINTR)
+					continue;
+				return result;
+			}
+		}
+
+#elif defined(_WIN32)
+
+		typedef HANDLE FileHandle;
+
+		FileHandle openForRead(const string& filename, bool directIO)
+		{
+			DWORD flags = FILE_ATTRIBUTE_NORMAL;
+			if (directIO)
+				flags |= FILE_FLAG_NO_BUFFERING;
+			return CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, flags, NULL);
+		}
+
+		bool isValid(FileHandle h)
+		{
+			return h != INVALID_HANDLE_VALUE;
+		}
+
+		void closeFile(FileHandle h)
+		{
+			CloseHandle(h);
+		}
+
+		int64_t positionalRead(FileHandle h, char* pTarget, size_t size, size_t filePos)
+		{
+			OVERLAPPED ov;
+			memset(&ov, 0, sizeof(ov));
+			ov.Offset = (DWORD)(filePos & 0xffffffff);
+			ov.OffsetHigh = (DWORD)(filePos >> 32);
+
+			DWORD toRead = (DWORD)std::min(size, (size_t)(1024 * 1024 * 1024));
+			DWORD bytesRead = 0;
+			if (!ReadFile(h, pTarget, toRead, &bytesRead, &ov))
+			{
+				if (GetLastError() == ERROR_HANDLE_EOF)
+					return 0;
+				return -1;
+			}
+			return bytesRead;
+		}
+
+#endif
+
+		/**
+		Reads exactly size bytes from the given position, or at least minSize bytes if end of file is encountered.
+		@return False if the read fails.
+		*/
+		bool readFully(FileHandle h, char* pTarget, size_t size, size_t filePos, size_t minSize)
+		{
+			size_t done = 0;
+			while (done < size)
+			{
+				int64_t result = positionalRead(h, pTarget + done, size - done, filePos + done);
+				if (result < 0)
+					return false;
+				if (result == 0)
+					return done >= minSize;
+				done += (size_t)result;
+			}
+			return true;
+		}
+
+		/**
+		Splits requests larger than maxSize into smaller pieces.
+		*/
+		void splitLargeRequests(vector<FileReadRequest>& requests, size_t maxSize)
+		{
+			vector<FileReadRequest> result;
+			result.reserve(requests.size());
+			for (const FileReadRequest& r : requests)
+			{
+				if (r.size <= maxSize)
+				{
+					result.push_back(r);
+				}
+				else
+				{
+					for (size_t pos = 0; pos < r.size; pos += maxSize)
+					{
+						size_t size = std::min(maxSize, r.size - pos);
+						result.push_back(FileReadRequest{ r.filePos + pos, size, r.pTarget + pos });
+					}
+				}
+			}
+			requests = result;
+		}
+
+		/**
+		Combines sorted requests into read operations.
+		*/
+		vector<ReadOperation> coalesce(const vector<FileReadRequest>& requests, size_t maxSize, size_t maxGap)
+		{
+			vector<ReadOperation> ops;
+
+			for (size_t n = 0; n < requests.size(); n++)
+			{
+				const FileReadRequest& r = requests[n];
+				if (r.size <= 0)
+					continue;
+
+				if (ops.size() > 0)
+				{
+					ReadOperation& op = ops.back();
+					const FileReadRequest& prev = requests[op.last - 1];
+					size_t opEnd = op.filePos + op.size;
+					size_t newEnd = r.filePos + r.size;
+					if (r.filePos >= opEnd && r.filePos - opEnd <= maxGap && newEnd - op.filePos <= maxSize)
+					{
+						if (r.filePos != opEnd || prev.pTarget + prev.size != r.pTarget)
+							op.contiguous = false;
+						op.size = newEnd - op.filePos;
+						op.last = n + 1;
+						continue;
+					}
+				}
+
+				ops.push_back(ReadOperation{ r.filePos, r.size, n, n + 1, true });
+			}
+
+			return ops;
+		}
+	}
+
+	ReadStatistics parallelRead(const string& filename, vector<FileReadRequest>& requests, bool showProgressInfo)
+	{
+		using namespace internals;
+
+		const ParallelReadSettings& settings = parallelReadSettings();
+
+		ReadStatistics stats;
+		for (const FileReadRequest& r : requests)
+			stats.bytes += r.size;
+
+		if (stats.bytes <= 0)
+			return stats;
+
+		// Make sure that data written in the background by this process is visible.
+		waitForWrites(filename);
+
+		Timer timer;
+		timer.start();
+
+		size_t maxSize = std::max(settings.maxRequestSize, DIRECT_IO_ALIGNMENT);
+		splitLargeRequests(requests, maxSize);
+		sort(requests.begin(), requests.end(), [](const FileReadRequest& a, const FileReadRequest& b) { return a.filePos < b.filePos; });
+		vector<ReadOperation> ops = coalesce(requests, maxSize, settings.maxGap);
+
+		FileHandle h = openForRead(filename, settings.directIO);
+		bool directIO = settings.directIO;
+		if (!isValid(h) && directIO)
+		{
+			// The file system might not support direct I/O.
+			h = openForRead(filename, false);
+			directIO = false;
+		}
+
+		if (!isValid(h))
+			throw ITLException(string("Unable to open ") + filename + string(", ") + getStreamErrorMessage());
+
+		stats.directIO = directIO;
+		stats.operations = ops.size();
+
+		int threadCount = settings.threadCount > 0 ? (int)settings.threadCount : omp_get_max_threads();
+		threadCount = (int)std::max<size_t>(1, std::min<size_t>(threadCount, ops.size()));
+
+		OmpAtomic<bool> failed(false);
+		string errorMessage;
+		{
+			ProgressIndicator prog(ops.size(), showProgressInfo);
+
+#pragma omp parallel num_threads(threadCount)
+			{
+				AlignedBuffer buffer;
+
+#pragma omp for schedule(dynamic)
+				for (coord_t i = 0; i < (coord_t)ops.size(); i++)
+				{
+					if (failed)
+						continue;
+
+					const ReadOperation& op = ops[i];
+
+					try
+					{
+						if (!directIO && op.contiguous)
+						{
+							// Read straight to the target memory.
+							if (!readFully(h, requests[op.first].pTarget, op.size, op.filePos, op.size))
+								throw ITLException(string("Read failed, file size might be incorrect: ") + filename + string(", ") + getStreamErrorMessage());
+						}
+						else
+						{
+							// Read to temporary buffer and copy requested parts to the target memory.
+							size_t readPos = op.filePos;
+							size_t readSize = op.size;
+							if (directIO)
+							{
+								readPos = op.filePos / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+								size_t readEnd = (op.filePos + op.size + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+								readSize = readEnd - readPos;
+							}
+
+							char* pBuffer = buffer.get(readSize);
+							size_t minSize = op.filePos + op.size - readPos;
+							if (!readFully(h, pBuffer, readSize, readPos, minSize))
+								throw ITLException(string("Read failed, file size might be incorrect: ") + filename + string(", ") + getStreamErrorMessage());
+
+							for (size_t n = op.first; n < op.last; n++)
+							{
+								const FileReadRequest& r = requests[n];
+								memcpy(r.pTarget, pBuffer + (r.filePos - readPos), r.size);
+							}
+						}
+					}
+					catch (ITLException& e)
+					{
+#pragma omp critical(parallelReadError)
+						{
+							failed = true;
+							errorMessage = e.message();
+						}
+					}
+					catch (std::bad_alloc&)
+					{
+#pragma omp critical(parallelReadError)
+						{
+							failed = true;
+							errorMessage = "Out of memory while reading " + filename;
+						}
+					}
+
+					prog.step();
+				}
+			}
+		}
+
+		closeFile(h);
+
+		if (failed)
+			throw ITLException(errorMessage);
+
+		timer.stop();
+		stats.seconds = timer.getSeconds();
+
+		if (showProgressInfo)
+		{
+			cout << "Read " << bytesToString((double)stats.bytes) << " in " << stats.operations << " operations using " << threadCount << " threads";
+			if (stats.directIO)
+				cout << " and direct I/O";
+			cout << ", " << stats.megabytesPerSecond() << " MB/s." << endl;
+		}
+
+		return stats;
+	}
+
+	namespace tests
+	{
+		void parallelRead()
+		{
+			// Create test file
+			string filename = "./parallelread/test.dat";
+			createFoldersFor(filename);
+			size_t fileSize = 3 * 1024 * 1024 + 17;
+			vector<char> data(fileSize);
+			for (size_t n = 0; n < fileSize; n++)
+				data[n] = (char)((n * 7919) % 251);
+			{
+				ofstream out(filename, ios_base::out | ios_base::trunc | ios_base::binary);
+				out.write(&data[0], fileSize);
+			}
+
+			ParallelReadSettings orig = parallelReadSettings();
+
+			for (bool direct : { false, true })
+			{
+				parallelReadSettings().directIO = direct;
+				parallelReadSettings().maxRequestSize = 100 * 1024;
+				parallelReadSettings().maxGap = 1000;
+
+				// Requests with varying gaps, some adjacent, one large one and one that ends at the end of the file.
+				vector<char> result(fileSize, 0);
+				vector<FileReadRequest> requests;
+				size_t pos = 0;
+				size_t step = 1;
+				while (pos < fileSize)
+				{
+					size_t size = std::min(step * 13 + 1, fileSize - pos);
+					requests.push_back(FileReadRequest{ pos, size, &result[pos] });
+					pos += size + (step % 3 == 0 ? 0 : step * 5);
+					step++;
+				}
+				requests.push_back(FileReadRequest{ fileSize - 10, 10, &result[fileSize - 10] });
+
+				vector<FileReadRequest> check = requests;
+				ReadStatistics stats = itl2::parallelRead(filename, requests, true);
+
+				bool ok = true;
+				for (const FileReadRequest& r : check)
+				{
+					if (memcmp(r.pTarget, &data[r.filePos], r.size) != 0)
+						ok = false;
+				}
+				testAssert(ok, string("parallel read result, direct I/O = ") + toString(direct));
+				testAssert(stats.operations < check.size(), "request coalescing");
+			}
+
+			parallelReadSettings() = orig;
+		}
+	}
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace itl2
+{
+	/**
+	Describes one contiguous region of a file that should be read to memory.
+	*/
+	struct FileReadRequest
+	{
+		/**
+		Position of the first byte to read in the file.
+		*/
+		size_t filePos;
+
+		/**
+		Count of bytes to read.
+		*/
+		size_t size;
+
+		/**
+		Location in memory where the data is placed.
+		*/
+		char* pTarget;
+	};
+
+	/**
+	Settings of the parallel file reader.
+	*/
+	struct ParallelReadSettings
+	{
+		/**
+		Count of concurrent read operations.
+		Set to zero to use the count of OpenMP threads.
+		*/
+		size_t threadCount = 0;
+
+		/**
+		Set to true to bypass the page cache of the operating system (O_DIRECT in Linux).
+		If the file system does not support direct I/O, normal buffered reads are made instead.
+		*/
+		bool directIO = false;
+
+		/**
+		Maximum size of a single read operation in bytes.
+		Larger requests are split so that they can be read concurrently.
+		*/
+		size_t maxRequestSize = 32 * 1024 * 1024;
+
+		/**
+		Requests that are separated by at most this many bytes in the file are combined into a single read operation.
+		The data in the gap is read to a temporary buffer and discarded.
+		*/
+		size_t maxGap = 256 * 1024;
+	};
+
+	/**
+	Statistics of a read operation.
+	*/
+	struct ReadStatistics
+	{
+		/**
+		Count of bytes requested.
+		*/
+		size_t bytes = 0;
+
+		/**
+		Count of read operations made.
+		*/
+		size_t operations = 0;
+
+		/**
+		Wall clock time taken by the read operations in seconds.
+		*/
+		double seconds = 0;
+
+		/**
+		Indicates if the read was made using direct I/O.
+		*/
+		bool directIO = false;
+
+		/**
+		Calculates read speed in megabytes (10^6 bytes) per second.
+		*/
+		double megabytesPerSecond() const
+		{
+			if (seconds <= 0)
+				return 0;
+			return bytes / 1e6 / seconds;
+		}
+	};
+
+	/**
+	Gets the global settings of the parallel reader.
+	The settings are used by all .raw file readers.
+	*/
+	ParallelReadSettings& parallelReadSettings();
+
+	/**
+	Reads the given regions of a file to memory using multiple concurrent positional read operations.
+	Adjacent and nearly adjacent regions are coalesced into larger read operations, and very large regions are split to
+	parts that are read concurrently.
+	Throws ITLException if the file cannot be opened or if any of the reads fails.
+	@param filename The name of the file to read.
+	@param requests The regions to read. The list is reordered by the function.
+	@param showProgressInfo Set to true to show a progress bar and the achieved read speed.
+	@return Statistics of the read operation.
+	*/
+	ReadStatistics parallelRead(const std::string& filename, std::vector<FileReadRequest>& requests, bool showProgressInfo = false);
+
+	namespace tests
+	{
+		void parallelRead();
+	}
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <cstring>
 
 #include "datatypes.h"
 #include "itlexception.h"
@@ -11,6 +12,8 @@
 #include "io/imagedatatype.h"
 #include "io/sequence.h"
 #include "io/fileutils.h"
+#include "io/parallelread.h"
+#include "io/writebehind.h"
 #include "math/vec3.h"
 #include "progress.h"
 
@@ -250,42 +253,30 @@ namespace itl2
 		@param filename The name of the file to read.
 		@param bytesToSkip Skip this many bytes from the beginning of the file.
 		@param readPixel Pixel reading function. Relevant only for non-trivially copyable pixel data types.
+		@param showProgressInfo Set to true to show progress and read speed.
 		*/
-		template<typename pixel_t, typename ReadPixel = decltype(raw::readPixel<pixel_t>)> void readNoParse(Image<pixel_t>& img, const std::string& filename, size_t bytesToSkip = 0, ReadPixel readPixel = raw::readPixel<pixel_t>)
+		template<typename pixel_t, typename ReadPixel = decltype(raw::readPixel<pixel_t>)> void readNoParse(Image<pixel_t>& img, const std::string& filename, size_t bytesToSkip = 0, ReadPixel readPixel = raw::readPixel<pixel_t>, bool showProgressInfo = false)
 		{
-			std::ifstream in(filename.c_str(), std::ios_base::in | std::ios_base::binary);
-
-			if(!in)
-            {
-                throw ITLException(std::string("Unable to open ") + filename + std::string(", ") + getStreamErrorMessage());
-            }
-
-			in.seekg(bytesToSkip, std::ios::beg);
-
 			if constexpr (std::is_trivially_copyable_v<pixel_t>)
 			{
-				// Load directly to the buffer
-				size_t READ_SIZE = 200 * 1024 * 1024;
-				size_t read_start = 0;
-				char* pBuffer = (char*)img.getData();
-				while (read_start < img.pixelCount() * sizeof(pixel_t))
-				{
-					size_t read_size = READ_SIZE;
-					if (read_start + read_size > img.pixelCount() * sizeof(pixel_t))
-						read_size = img.pixelCount() * sizeof(pixel_t) - read_start;
-
-					in.read(pBuffer + read_start, read_size);
-
-					if (in.bad())
-					{
-						throw ITLException(std::string("Read failed, file size might be incorrect: ") + filename);
-					}
-
-					read_start += read_size;
-				}
+				// Load directly to the buffer using concurrent reads.
+				std::vector<FileReadRequest> requests;
+				requests.push_back(FileReadRequest{ bytesToSkip, img.pixelCount() * sizeof(pixel_t), (char*)img.getData() });
+				parallelRead(filename, requests, showProgressInfo);
 			}
 			else
 			{
+				waitForWrites(filename);
+
+				std::ifstream in(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+
+				if (!in)
+				{
+					throw ITLException(std::string("Unable to open ") + filename + std::string(", ") + getStreamErrorMessage());
+				}
+
+				in.seekg(bytesToSkip, std::ios::beg);
+
 				for (coord_t n = 0; n < img.pixelCount(); n++)
 				{
 					readPixel(in, img(n));
@@ -314,68 +305,50 @@ namespace itl2
 			if (cStart == Vec3c(0, 0, 0) && cEnd == dimensions)
 			{
 				// Reading whole file, use the whole file reading function.
-				raw::readNoParse(img, filename, bytesToSkip);
+				raw::readNoParse(img, filename, bytesToSkip, raw::readPixel<pixel_t>, showProgressInfo);
 				return;
 			}
 
 
-			std::ifstream in(filename.c_str(), std::ios_base::in | std::ios_base::binary);
-
-			if (!in)
-			{
-				throw ITLException(std::string("Unable to open ") + filename + std::string(", ") + getStreamErrorMessage());
-			}
-
-			in.seekg(bytesToSkip, std::ios::beg);
-
-			pixel_t* pBuffer = img.getData();
+			// Build list of regions to read.
+			// Adjacent regions are combined and the reads are made concurrently in parallelRead.
+			char* pBuffer = (char*)img.getData();
+			std::vector<FileReadRequest> requests;
 
 			if (cStart.x == 0 && cEnd.x == dimensions.x)
 			{
 				// Reading whole scan lines.
-				// We can read one slice per one read call.
+				// We can read one slice per one read request.
 				for (coord_t z = cStart.z; z < cEnd.z; z++)
 				{
-					size_t filePos = (z * dimensions.x * dimensions.y + cStart.y * dimensions.x + cStart.x) * sizeof(pixel_t);
-					in.seekg(filePos);
-
+					size_t filePos = bytesToSkip + (z * dimensions.x * dimensions.y + cStart.y * dimensions.x + cStart.x) * sizeof(pixel_t);
 					size_t imgPos = img.getLinearIndex(0, 0, z - cStart.z);
-					in.read((char*)&pBuffer[imgPos], (cEnd.x - cStart.x) * (cEnd.y - cStart.y) * sizeof(pixel_t));
-
-					if (in.bad())
-					{
-						showProgress(cEnd.z - cStart.z, cEnd.z - cStart.z, showProgressInfo);
-						throw ITLException(std::string("Failed to read (slice at a time) block of ") + filename + std::string(", ") + getStreamErrorMessage());
-					}
-
-					showProgress(z - cStart.z, cEnd.z - cStart.z, showProgressInfo);
+					requests.push_back(FileReadRequest{ filePos, (cEnd.x - cStart.x) * (cEnd.y - cStart.y) * sizeof(pixel_t), pBuffer + imgPos * sizeof(pixel_t) });
 				}
 			}
 			else
 			{
 				// Reading partial scan lines.
+				requests.reserve((cEnd.z - cStart.z) * (cEnd.y - cStart.y));
 				for (coord_t z = cStart.z; z < cEnd.z; z++)
 				{
 					for (coord_t y = cStart.y; y < cEnd.y; y++)
 					{
-						size_t filePos = (z * dimensions.x * dimensions.y + y * dimensions.x + cStart.x) * sizeof(pixel_t);
-						in.seekg(filePos);
-
+						size_t filePos = bytesToSkip + (z * dimensions.x * dimensions.y + y * dimensions.x + cStart.x) * sizeof(pixel_t);
 						size_t imgPos = img.getLinearIndex(0, y - cStart.y, z - cStart.z);
-						in.read((char*)&pBuffer[imgPos], (cEnd.x - cStart.x) * sizeof(pixel_t));
-
-						if (in.bad())
-						{
-							showProgress(cEnd.z - cStart.z, cEnd.z - cStart.z, showProgressInfo);
-							throw ITLException(std::string("Failed to read block of ") + filename + std::string(", ") + getStreamErrorMessage());
-						}
+						requests.push_back(FileReadRequest{ filePos, (cEnd.x - cStart.x) * sizeof(pixel_t), pBuffer + imgPos * sizeof(pixel_t) });
 					}
-
-					
-					showProgress(z - cStart.z, cEnd.z - cStart.z, showProgressInfo);
 				}
 			}
 
+			try
+			{
+				parallelRead(filename, requests, showProgressInfo);
+			}
+			catch (ITLException& e)
+			{
+				throw ITLException(std::string("Failed to read block of ") + filename + std::string(", ") + e.message());
+			}
 		}
 
 		template<typename pixel_t> void getInfoAndCheck(const std::string& filename, Vec3c& dimensions)
@@ -416,15 +389,16 @@ namespace itl2
 		@param filename The name of the file to read.
 		@param bytesToSkip Skip this many bytes from the beginning of the file.
 		@param readPixel Function that reads one pixel. Relevant only for non-trivially copyable pixel data types.
+		@param showProgressInfo Set to true to show progress and read speed.
 		*/
-		template<typename pixel_t, typename ReadPixel = decltype(raw::readPixel<pixel_t>)> void read(Image<pixel_t>& img, std::string filename, size_t bytesToSkip = 0, ReadPixel readPixel = raw::readPixel<pixel_t>)
+		template<typename pixel_t, typename ReadPixel = decltype(raw::readPixel<pixel_t>)> void read(Image<pixel_t>& img, std::string filename, size_t bytesToSkip = 0, ReadPixel readPixel = raw::readPixel<pixel_t>, bool showProgressInfo = false)
 		{
 			Vec3c dimensions;
 			getInfoAndCheck<pixel_t>(filename, dimensions);
 
 			img.ensureSize(dimensions);
 			internals::expandRawFilename(filename);
-			readNoParse<pixel_t, ReadPixel>(img, filename, bytesToSkip, readPixel);
+			readNoParse<pixel_t, ReadPixel>(img, filename, bytesToSkip, readPixel, showProgressInfo);
 		}
 
 		/**
@@ -474,6 +448,9 @@ namespace itl2
 
 			createFoldersFor(filename);
 
+			// Earlier background writes to the same file must not overwrite this data.
+			waitForWrites(filename);
+
 			// Create file if it does not exist, otherwise set file size to correct value.
 			setFileSize(filename, fileDimensions.x * fileDimensions.y * fileDimensions.z * sizeof(pixel_t));
 
@@ -545,6 +522,71 @@ namespace itl2
 			writeBlock(img, filename, filePosition, fileDimensions, Vec3c(0, 0, 0), img.dimensions(), showProgressInfo);
 		}
 
+		/**
+		Works as writeBlock, but returns before the data has been written to the file.
+		The block is copied to a temporary buffer, and the buffer is written to the file in a background thread.
+		Writes of consecutive blocks to the same file are combined into large vectored write operations.
+		Call flushWrites to wait until all the writes have finished and to check for errors.
+		@param img Image to write.
+		@param filename Name of file to write.
+		@param filePosition Position in the file to write to.
+		@param fileDimension Total dimensions of the output file.
+		@param imagePosition Position in the image where the block to be written starts.
+		@param imageDimensions Dimensions of the block of the source image to write.
+		*/
+		template<typename pixel_t> void writeBlockAsync(const Image<pixel_t>& img, const std::string& filename, const Vec3c& filePosition, const Vec3c& fileDimensions,
+			const Vec3c& imagePosition, const Vec3c& imageDimensions)
+		{
+			Vec3c cStart = filePosition;
+			clamp(cStart, Vec3c(0, 0, 0), fileDimensions);
+			Vec3c cEnd = filePosition + imageDimensions;
+			clamp(cEnd, Vec3c(0, 0, 0), fileDimensions);
+
+			if (!img.isInImage(imagePosition))
+				throw ITLException("Block start position must be inside the image.");
+			if (!img.isInImage(imagePosition + imageDimensions - Vec3c(1, 1, 1)))
+				throw ITLException("Block end position must be inside the image.");
+
+			createFoldersFor(filename);
+
+			// Create file if it does not exist, otherwise set file size to correct value.
+			// This is done right away so that errors are reported immediately.
+			setFileSize(filename, fileDimensions.x * fileDimensions.y * fileDimensions.z * sizeof(pixel_t));
+
+			size_t rowSize = (cEnd.x - cStart.x) * sizeof(pixel_t);
+			size_t rowCount = (cEnd.y - cStart.y) * (cEnd.z - cStart.z);
+			if (rowSize <= 0 || rowCount <= 0)
+				return;
+
+			// Reserve space for the buffer from the write-behind engine before allocating it so that
+			// the buffers of the queued writes do not take more memory than allowed.
+			WriteReservation reservation(rowSize * rowCount);
+
+			// Pack the rows of the block to a buffer. Rows that are adjacent in the file form a single segment.
+			std::vector<char> data(rowSize * rowCount);
+			std::vector<FileWriteSegment> segments;
+			const pixel_t* pBuffer = img.getData();
+			size_t bufferPos = 0;
+			for (coord_t z = cStart.z; z < cEnd.z; z++)
+			{
+				for (coord_t y = cStart.y; y < cEnd.y; y++)
+				{
+					size_t filePos = (z * fileDimensions.x * fileDimensions.y + y * fileDimensions.x + cStart.x) * sizeof(pixel_t);
+					size_t imgPos = img.getLinearIndex(imagePosition.x, y - cStart.y + imagePosition.y, z - cStart.z + imagePosition.z);
+					memcpy(&data[bufferPos], &pBuffer[imgPos], rowSize);
+
+					if (segments.size() > 0 && segments.back().filePos + segments.back().size == filePos)
+						segments.back().size += rowSize;
+					else
+						segments.push_back(FileWriteSegment{ filePos, bufferPos, rowSize });
+
+					bufferPos += rowSize;
+				}
+			}
+
+			writeBehind(filename, std::move(data), std::move(segments), std::move(reservation));
+		}
+
 		/**
 		Write image to .raw file.
 		If the pixel data type is trivially copyable, the pixels are written directly to the file from the image memory buffer.
@@ -560,6 +602,7 @@ namespace itl2
 		template<typename pixel_t, typename WritePixel = decltype(raw::writePixel<pixel_t>)> void write(const Image<pixel_t>& img, const std::string& filename, bool truncate = true, WritePixel writePixel = raw::writePixel<pixel_t>)
 		{
 			createFoldersFor(filename);
+			waitForWrites(filename);
 
 			std::ios::openmode mode;
 			if(truncate)
@@ -207,6 +207,8 @@ namespace itl2
 		    height = 0;
 		    depth = 0;
 		    dataType = ImageDataType::Unknown;
+
+			waitForWrites(filename);
 		    
 		    vector<string> files = internals::buildFilteredFileList(filename);
 
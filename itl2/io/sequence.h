@@ -6,6 +6,7 @@
 #include "io/itltiff.h"
 #include "utilities.h"
 #include "ompatomic.h"
+#include "io/writebehind.h"
 
 #include <cmath>
 #include "filesystem.h"
@@ -112,6 +113,8 @@ namespace itl2
 		*/
 		template<typename pixel_t> void read(Image<pixel_t>& img, const std::string& filename, size_t firstSlice = 0, size_t lastSlice = std::numeric_limits<size_t>::max())
 		{
+			waitForWrites(filename);
+
 			std::vector<std::string> files = internals::buildFilteredFileList(filename);
 
 			if (files.size() <= 0)
@@ -197,6 +200,8 @@ namespace itl2
 		*/
 		template<typename pixel_t> void readBlock(Image<pixel_t>& img, const std::string& filename, const Vec3c& start, bool showProgressInfo = false)
 		{
+			waitForWrites(filename);
+
 			std::vector<std::string> files = internals::buildFilteredFileList(filename);
 
 			if (files.size() <= 0)
@@ -434,6 +439,9 @@ namespace itl2
 
 			fs::create_directories(dir);
 
+			// Earlier background writes to the same sequence must not overwrite this data.
+			waitForWrites(filename);
+
 			std::string errorMessage;
 			OmpAtomic<bool> broken = false;
 
@@ -556,6 +564,48 @@ namespace itl2
 			writeBlock(img, filename, filePosition, fileDimensions, Vec3c(0, 0, 0), img.dimensions(), showProgressInfo);
 		}
 
+		/**
+		Works as writeBlock, but returns before the data has been written to the files.
+		The block is copied to a temporary image that is written to the sequence in a background thread.
+		Call flushWrites to wait until all the writes have finished and to check for errors.
+		@param img Image to write.
+		@param filename Filename template, see writeBlock.
+		@param filePosition Position in the file to write to.
+		@param fileDimension Total dimensions of the output file.
+		@param imagePosition Position in the image where the block to be written starts.
+		@param imageDimensions Dimensions of the block of the source image to write.
+		*/
+		template<typename pixel_t> void writeBlockAsync(const Image<pixel_t>& img, const std::string& filename, const Vec3c& filePosition, const Vec3c& fileDimensions,
+			const Vec3c& imagePosition, const Vec3c& imageDimensions)
+		{
+			if (!img.isInImage(imagePosition))
+				throw ITLException("Block start position must be inside the image.");
+			if (!img.isInImage(imagePosition + imageDimensions - Vec3c(1, 1, 1)))
+				throw ITLException("Block end position must be inside the image.");
+
+			// Reserve space for the copy from the write-behind engine before allocating it.
+			WriteReservation reservation(imageDimensions.x * imageDimensions.y * imageDimensions.z * sizeof(pixel_t));
+
+			std::shared_ptr<Image<pixel_t> > block = std::make_shared<Image<pixel_t> >(imageDimensions);
+			#pragma omp parallel for if(block->pixelCount() > PARALLELIZATION_THRESHOLD && !omp_in_parallel())
+			for (coord_t z = 0; z < imageDimensions.z; z++)
+			{
+				for (coord_t y = 0; y < imageDimensions.y; y++)
+				{
+					for (coord_t x = 0; x < imageDimensions.x; x++)
+					{
+						(*block)(x, y, z) = img(x + imagePosition.x, y + imagePosition.y, z + imagePosition.z);
+					}
+				}
+			}
+
+			writeBehind(filename, [block, filename, filePosition, fileDimensions]()
+				{
+					writeBlock(*block, filename, filePosition, fileDimensions, Vec3c(0, 0, 0), block->dimensions(), false);
+				},
+				std::move(reservation));
+		}
+
 		/**
 		Move or copy image sequence from one location to another.
 		*/
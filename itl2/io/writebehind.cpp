@@ -0,0 +1,792 @@
+#include "io/writebehind.h"
+#include "io/fileutils.h"
+#include "itlexception.h"
+#include "utilities.h"
+#include "test.h"
+#include "filesystem.h"
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <set>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+#if defined(__linux__)
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+
+#elif defined(_WIN32)
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+
+#else
+
+#error writebehind.cpp not configured for this platform.
+
+#endif
+
+using namespace std;
+
+namespace itl2
+{
+	WriteBehindSettings& writeBehindSettings()
+	{
+		static WriteBehindSettings settings;
+		return settings;
+	}
+
+	namespace internals
+	{
+		/**
+		One queued write operation.
+		*/
+		struct WriteJob
+		{
+			/**
+			Name of the file or file set that this job writes to.
+			*/
+			string key;
+
+			/**
+			Data to write (.raw writes only).
+			*/
+			vector<char> data;
+
+			/**
+			Regions of data that are written (.raw writes only).
+			*/
+			vector<FileWriteSegment> segments;
+
+			/**
+			General task to run, if this is not a .raw write.
+			*/
+			function<void()> task;
+
+			/**
+			Amount of memory held by this job.
+			*/
+			size_t bytes;
+
+			/**
+			Owner of this job, see WriteOwnerScope.
+			*/
+			const void* owner = nullptr;
+		};
+
+		/**
+		Owner of the writes queued by the current thread.
+		*/
+		thread_local const void* currentWriteOwner = nullptr;
+
+		/**
+		Converts file name to a form where all names of the same file are equal.
+		*/
+		string canonicalKey(const string& filename)
+		{
+			std::error_code ec;
+			fs::path p = fs::weakly_canonical(fs::path(filename), ec);
+			if (ec)
+				return filename;
+			return p.string();
+		}
+
+		/**
+		Segment of data ready to be written: source pointer, file position and size.
+		*/
+		struct PendingSegment
+		{
+			const char* pData;
+			size_t filePos;
+			size_t size;
+		};
+
+#if defined(__linux__)
+
+		/**
+		Writes given segments to the file. Segments must be sorted according to file position.
+		Segments adjacent in the file are written using a single vectored write.
+		*/
+		void writeSegments(const string& filename, const vector<PendingSegment>& segments)
+		{
+			int fd = ::open(filename.c_str(), O_WRONLY);
+			if (fd == -1)
+				throw ITLException(string("Unable to open ") + filename + string(", ") + getStreamErrorMessage());
+
+			const size_t maxIov = std::min<size_t>(IOV_MAX, 1024);
+			vector<iovec> iov;
+			iov.reserve(maxIov);
+
+			size_t i = 0;
+			while (i < segments.size())
+			{
+				// Collect run of adjacent segments
+				size_t runStart = segments[i].filePos;
+				size_t runSize = 0;
+				iov.clear();
+				while (i < segments.size() && iov.size() < maxIov && segments[i].filePos == runStart + runSize)
+				{
+					iov.push_back(iovec{ (void*)segments[i].pData, segments[i].size });
+					runSize += segments[i].size;
+					i++;
+				}
+
+				// Write the run, taking partial writes into account.
+				size_t done = 0;
+				size_t iovIndex = 0;
+				while (done < runSize)
+				{
+					ssize_t result = ::pwritev(fd, &iov[iovIndex], (int)(iov.size() - iovIndex), (off_t)(runStart + done));
+					if (result < 0)
+					{
+						if (errno == EINTR)
+							continue;
+						string msg = getStreamErrorMessage();
+						::close(fd);
+						throw ITLException(string("Unable to write to ") + filename + string(", ") + msg);
+					}
+
+					done += (size_t)result;
+
+					// Skip fully written buffers and adjust the partially written one.
+					size_t r = (size_t)result;
+					while (iovIndex < iov.size() && r >= iov[iovIndex].iov_len)
+					{
+						r -= iov[iovIndex].iov_len;
+						iovIndex++;
+					}
+					if (iovIndex < iov.size())
+					{
+						iov[iovIndex].iov_base = (char*)iov[iovIndex].iov_base + r;
+						iov[iovIndex].iov_len -= r;
+					}
+				}
+			}
+
+			if (::close(fd) != 0)
+				throw ITLException(string("Unable to write to ") + filename + string(", ") + getStreamErrorMessage());
+		}
+
+		/**
+		Flushes the given file from the operating system cache to the storage device.
+		*/
+		void syncFile(const string& filename)
+		{
+			int fd = ::open(filename.c_str(), O_WRONLY);
+			if (fd == -1)
+				throw ITLException(string("Unable to open ") + filename + string(", ") + getStreamErrorMessage());
+
+			if (::fdatasync(fd) != 0)
+			{
+				string msg = getStreamErrorMessage();
+				::close(fd);
+				throw ITLException(string("Unable to flush ") + filename + string(" to disk, ") + msg);
+			}
+
+			::close(fd);
+		}
+
+#elif defined(_WIN32)
+
+		void writeSegments(const string& filename, const vector<PendingSegment>& segments)
+		{
+			HANDLE h = CreateFileA(filename.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (h == INVALID_HANDLE_VALUE)
+				throw ITLException(string("Unable to open ") + filename);
+
+			for (const PendingSegment& s : segments)
+			{
+				size_t done = 0;
+				while (done < s.size)
+				{
+					OVERLAPPED ov;
+					memset(&ov, 0, sizeof(ov));
+					size_t pos = s.filePos + done;
+					ov.Offset = (DWORD)(pos & 0xffffffff);
+					ov.OffsetHigh = (DWORD)(pos >> 32);
+					DWORD toWrite = (DWORD)std::min(s.size - done, (size_t)(1024 * 1024 * 1024));
+					DWORD written = 0;
+					if (!WriteFile(h, s.pData + done, toWrite, &written, &ov))
+					{
+						CloseHandle(h);
+						throw ITLException(string("Unable to write to ") + filename);
+					}
+					done += written;
+				}
+			}
+
+			CloseHandle(h);
+		}
+
+		void syncFile(const string& filename)
+		{
+			HANDLE h = CreateFileA(filename.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (h == INVALID_HANDLE_VALUE)
+				throw ITLException(string("Unable to open ") + filename);
+			bool ok = FlushFileBuffers(h) != 0;
+			CloseHandle(h);
+			if (!ok)
+				throw ITLException(string("Unable to flush ") + filename + " to disk.");
+		}
+
+#endif
+
+		/**
+		Writes data of the given .raw write jobs (all for the same file) to disk.
+		Segments of all the jobs are sorted and combined, unless they overlap; in that case the jobs are written in order.
+		*/
+		void writeJobs(const string& filename, const vector<WriteJob>& jobs)
+		{
+			vector<PendingSegment> all;
+			for (const WriteJob& job : jobs)
+			{
+				for (const FileWriteSegment& s : job.segments)
+				{
+					if (s.size > 0)
+						all.push_back(PendingSegment{ &job.data[s.bufferPos], s.filePos, s.size });
+				}
+			}
+
+			stable_sort(all.begin(), all.end(), [](const PendingSegment& a, const PendingSegment& b) { return a.filePos < b.filePos; });
+
+			bool overlaps = false;
+			for (size_t n = 1; n < all.size(); n++)
+			{
+				if (all[n].filePos < all[n - 1].filePos + all[n - 1].size)
+				{
+					overlaps = true;
+					break;
+				}
+			}
+
+			if (!overlaps)
+			{
+				writeSegments(filename, all);
+			}
+			else
+			{
+				// Later writes must override earlier ones, so write the jobs one by one.
+				for (const WriteJob& job : jobs)
+				{
+					vector<PendingSegment> segs;
+					for (const FileWriteSegment& s : job.segments)
+						segs.push_back(PendingSegment{ &job.data[s.bufferPos], s.filePos, s.size });
+					sort(segs.begin(), segs.end(), [](const PendingSegment& a, const PendingSegment& b) { return a.filePos < b.filePos; });
+					writeSegments(filename, segs);
+				}
+			}
+		}
+
+		/**
+		Set to true in the background threads of the write-behind engine.
+		The tasks run by the engine must not wait for their own completion.
+		*/
+		thread_local bool isWriteBehindThread = false;
+
+		/**
+		Queue of write jobs and the background threads that process it.
+		Jobs for the same file are processed by one thread at a time, in the order they were submitted.
+		*/
+		class WriteBehindEngine
+		{
+		private:
+			mutex m;
+			condition_variable workAvailable;
+			condition_variable workDone;
+
+			deque<WriteJob> queue;
+
+			/**
+			Count of queued or running jobs for each key.
+			*/
+			map<string, size_t> pendingPerKey;
+
+			/**
+			Keys that are being processed by some thread.
+			*/
+			set<string> busyKeys;
+
+			/**
+			Count of queued or running jobs for each owner.
+			*/
+			map<const void*, size_t> pendingPerOwner;
+
+			/**
+			Amount of memory held by queued and running jobs, and reserved for jobs that have not been submitted yet.
+			*/
+			size_t pendingBytes = 0;
+
+			/**
+			Count of jobs being processed.
+			*/
+			size_t running = 0;
+
+			/**
+			.raw files written by each owner since last flush.
+			*/
+			map<const void*, set<string> > writtenFiles;
+
+			/**
+			First error of each owner since last flush.
+			*/
+			map<const void*, string> errors;
+
+			bool stopping = false;
+
+			vector<thread> workers;
+
+			size_t maxPendingBytes() const
+			{
+				size_t limit = writeBehindSettings().maxPendingBytes;
+				if (limit <= 0)
+					limit = memorySize() / 10;
+				return limit;
+			}
+
+			void ensureWorkers()
+			{
+				if (workers.empty())
+				{
+					size_t count = std::max<size_t>(1, writeBehindSettings().threadCount);
+					for (size_t n = 0; n < count; n++)
+						workers.push_back(thread(&WriteBehindEngine::worker, this));
+				}
+			}
+
+			void worker()
+			{
+				isWriteBehindThread = true;
+
+				while (true)
+				{
+					vector<WriteJob> jobs;
+					{
+						unique_lock<mutex> lock(m);
+
+						// Find first job whose key is not being processed by another thread.
+						auto it = queue.end();
+						workAvailable.wait(lock, [&]
+							{
+								it = find_if(queue.begin(), queue.end(), [&](const WriteJob& j) { return busyKeys.find(j.key) == busyKeys.end(); });
+								return it != queue.end() || (stopping && queue.empty());
+							});
+
+						if (it == queue.end())
+							return;
+
+						string key = it->key;
+						bool isTask = (bool)it->task;
+						jobs.push_back(std::move(*it));
+						queue.erase(it);
+
+						// Combine all queued .raw writes to the same file, until a task for the same key is encountered.
+						if (!isTask)
+						{
+							for (auto it2 = queue.begin(); it2 != queue.end(); )
+							{
+								if (it2->key == key)
+								{
+									if (it2->task)
+										break;
+									jobs.push_back(std::move(*it2));
+									it2 = queue.erase(it2);
+								}
+								else
+								{
+									it2++;
+								}
+							}
+						}
+
+						busyKeys.insert(key);
+						running++;
+					}
+
+					string errorMessage;
+					try
+					{
+						if (jobs[0].task)
+							jobs[0].task();
+						else
+							writeJobs(jobs[0].key, jobs);
+					}
+					catch (ITLException& e)
+					{
+						errorMessage = e.message();
+					}
+					catch (exception& e)
+					{
+						errorMessage = e.what();
+					}
+
+					{
+						unique_lock<mutex> lock(m);
+
+						const string& key = jobs[0].key;
+						for (const WriteJob& job : jobs)
+						{
+							pendingBytes -= job.bytes;
+
+							auto oit = pendingPerOwner.find(job.owner);
+							oit->second--;
+							if (oit->second <= 0)
+								pendingPerOwner.erase(oit);
+
+							if (!job.task)
+								writtenFiles[job.owner].insert(key);
+
+							if (errorMessage.length() > 0 && errors[job.owner].length() <= 0)
+								errors[job.owner] = errorMessage;
+						}
+
+						auto pit = pendingPerKey.find(key);
+						pit->second -= jobs.size();
+						if (pit->second <= 0)
+							pendingPerKey.erase(pit);
+
+						busyKeys.erase(key);
+						running--;
+					}
+
+					workDone.notify_all();
+					workAvailable.notify_all();
+				}
+			}
+
+		public:
+			WriteBehindEngine() = default;
+			WriteBehindEngine(const WriteBehindEngine&) = delete;
+			WriteBehindEngine& operator=(const WriteBehindEngine&) = delete;
+
+			~WriteBehindEngine()
+			{
+				{
+					unique_lock<mutex> lock(m);
+					stopping = true;
+				}
+				workAvailable.notify_all();
+				for (thread& t : workers)
+					t.join();
+			}
+
+			/**
+			Waits until the given amount of memory fits in the limit of pending data, and reserves it.
+			*/
+			void reserve(size_t bytes)
+			{
+				unique_lock<mutex> lock(m);
+
+				// Always allow one job so that large jobs do not block forever.
+				size_t limit = maxPendingBytes();
+				workDone.wait(lock, [&] { return pendingBytes <= 0 || pendingBytes + bytes <= limit; });
+
+				pendingBytes += bytes;
+			}
+
+			/**
+			Releases memory reserved using reserve.
+			*/
+			void unreserve(size_t bytes)
+			{
+				{
+					unique_lock<mutex> lock(m);
+					pendingBytes -= bytes;
+				}
+				workDone.notify_all();
+			}
+
+			/**
+			Queues a job whose memory (job.bytes) has already been reserved.
+			*/
+			void submit(WriteJob&& job)
+			{
+				unique_lock<mutex> lock(m);
+
+				ensureWorkers();
+
+				pendingPerKey[job.key]++;
+				pendingPerOwner[job.owner]++;
+				queue.push_back(std::move(job));
+
+				lock.unlock();
+				workAvailable.notify_one();
+			}
+
+			void wait(const string& key)
+			{
+				unique_lock<mutex> lock(m);
+				workDone.wait(lock, [&] { return pendingPerKey.find(key) == pendingPerKey.end(); });
+			}
+
+			void flush(bool sync)
+			{
+				set<string> files;
+				string err;
+				{
+					unique_lock<mutex> lock(m);
+					workDone.wait(lock, [&] { return queue.empty() && running <= 0; });
+					for (auto& item : writtenFiles)
+						files.insert(item.second.begin(), item.second.end());
+					for (auto& item : errors)
+					{
+						if (err.length() <= 0)
+							err = item.second;
+					}
+					writtenFiles.clear();
+					errors.clear();
+				}
+
+				finishFlush(files, err, sync);
+			}
+
+			void flush(const void* owner, bool sync)
+			{
+				set<string> files;
+				string err;
+				{
+					unique_lock<mutex> lock(m);
+					workDone.wait(lock, [&] { return pendingPerOwner.find(owner) == pendingPerOwner.end(); });
+
+					auto fit = writtenFiles.find(owner);
+					if (fit != writtenFiles.end())
+					{
+						files.swap(fit->second);
+						writtenFiles.erase(fit);
+					}
+
+					auto eit = errors.find(owner);
+					if (eit != errors.end())
+					{
+						err.swap(eit->second);
+						errors.erase(eit);
+					}
+				}
+
+				finishFlush(files, err, sync);
+			}
+
+		private:
+			/**
+			Reports error and syncs files after the writes have been waited for.
+			*/
+			static void finishFlush(const set<string>& files, const string& err, bool sync)
+			{
+				if (err.length() > 0)
+					throw ITLException(err);
+
+				if (sync)
+				{
+					for (const string& file : files)
+						syncFile(file);
+				}
+			}
+
+		public:
+			bool isIdle()
+			{
+				unique_lock<mutex> lock(m);
+				return pendingPerKey.empty();
+			}
+		};
+
+		WriteBehindEngine& writeBehindEngine()
+		{
+			static WriteBehindEngine engine;
+			return engine;
+		}
+	}
+
+	WriteReservation::WriteReservation(size_t bytes) : bytes(bytes)
+	{
+		internals::writeBehindEngine().reserve(bytes);
+	}
+
+	WriteReservation::WriteReservation(WriteReservation&& other) noexcept : bytes(other.bytes)
+	{
+		other.bytes = 0;
+	}
+
+	WriteReservation::~WriteReservation()
+	{
+		if (bytes > 0)
+			internals::writeBehindEngine().unreserve(bytes);
+	}
+
+	size_t WriteReservation::release()
+	{
+		size_t result = bytes;
+		bytes = 0;
+		return result;
+	}
+
+	WriteOwnerScope::WriteOwnerScope(const void* owner) : previous(internals::currentWriteOwner)
+	{
+		internals::currentWriteOwner = owner;
+	}
+
+	WriteOwnerScope::~WriteOwnerScope()
+	{
+		internals::currentWriteOwner = previous;
+	}
+
+	void writeBehind(const string& filename, vector<char>&& data, vector<FileWriteSegment>&& segments, WriteReservation&& reservation)
+	{
+		internals::WriteJob job;
+		job.key = internals::canonicalKey(filename);
+		job.bytes = reservation.release();
+		job.owner = internals::currentWriteOwner;
+		job.data = std::move(data);
+		job.segments = std::move(segments);
+		internals::writeBehindEngine().submit(std::move(job));
+	}
+
+	void writeBehind(const string& filename, vector<char>&& data, vector<FileWriteSegment>&& segments)
+	{
+		WriteReservation reservation(data.size());
+		writeBehind(filename, std::move(data), std::move(segments), std::move(reservation));
+	}
+
+	void writeBehind(const string& key, function<void()>&& task, WriteReservation&& reservation)
+	{
+		internals::WriteJob job;
+		job.key = internals::canonicalKey(key);
+		job.bytes = reservation.release();
+		job.owner = internals::currentWriteOwner;
+		job.task = std::move(task);
+		internals::writeBehindEngine().submit(std::move(job));
+	}
+
+	void writeBehind(const string& key, function<void()>&& task, size_t bytes)
+	{
+		writeBehind(key, std::move(task), WriteReservation(bytes));
+	}
+
+	void waitForWrites(const string& filename)
+	{
+		if (internals::isWriteBehindThread)
+			return;
+
+		internals::WriteBehindEngine& engine = internals::writeBehindEngine();
+		if (!engine.isIdle())
+			engine.wait(internals::canonicalKey(filename));
+	}
+
+	void flushWrites(bool sync)
+	{
+		internals::writeBehindEngine().flush(sync);
+	}
+
+	void flushWrites(const void* owner, bool sync)
+	{
+		internals::writeBehindEngine().flush(owner, sync);
+	}
+
+	namespace tests
+	{
+		void writeBehind()
+		{
+			string filename = "./writebehind/test.dat";
+			createFoldersFor(filename);
+			size_t fileSize = 1024 * 1024;
+			setFileSize(filename, fileSize);
+
+			vector<char> expected(fileSize, 0);
+
+			// Many small adjacent writes, written in scrambled order.
+			size_t segSize = 1000;
+			for (size_t n = 0; n < fileSize / segSize; n += 2)
+			{
+				for (size_t k : { n + 1, n })
+				{
+					vector<char> data(segSize);
+					for (size_t i = 0; i < segSize; i++)
+						data[i] = (char)((k * segSize + i) % 253);
+					memcpy(&expected[k * segSize], &data[0], segSize);
+					vector<FileWriteSegment> segs = { FileWriteSegment{ k * segSize, 0, segSize } };
+					itl2::writeBehind(filename, std::move(data), std::move(segs));
+				}
+			}
+
+			// Overlapping write that must override the previous data.
+			{
+				vector<char> data(10, 77);
+				memcpy(&expected[5], &data[0], 10);
+				vector<FileWriteSegment> segs = { FileWriteSegment{ 5, 0, 10 } };
+				itl2::writeBehind(filename, std::move(data), std::move(segs));
+			}
+
+			// General task
+			bool taskRun = false;
+			itl2::writeBehind("task", [&]() { taskRun = true; }, 0);
+
+			flushWrites();
+
+			testAssert(taskRun, "write-behind task was not run");
+
+			vector<char> result(fileSize);
+			ifstream in(filename, ios_base::in | ios_base::binary);
+			in.read(&result[0], fileSize);
+			testAssert(result == expected, "write-behind result");
+
+			// Errors must be reported in flush.
+			itl2::writeBehind("./writebehind/nonexisting_folder/file.dat", vector<char>(10), vector<FileWriteSegment>{ FileWriteSegment{ 0, 0, 10 } });
+			bool thrown = false;
+			try
+			{
+				flushWrites();
+			}
+			catch (ITLException&)
+			{
+				thrown = true;
+			}
+			testAssert(thrown, "write-behind error reporting");
+
+			// Errors are reported only to the owner of the failed write.
+			int owner1 = 0, owner2 = 0;
+			{
+				WriteOwnerScope scope(&owner1);
+				itl2::writeBehind("./writebehind/nonexisting_folder/file.dat", vector<char>(10), vector<FileWriteSegment>{ FileWriteSegment{ 0, 0, 10 } });
+			}
+			{
+				WriteOwnerScope scope(&owner2);
+				vector<char> data(10, 5);
+				WriteReservation reservation(data.size());
+				itl2::writeBehind(filename, std::move(data), vector<FileWriteSegment>{ FileWriteSegment{ 0, 0, 10 } }, std::move(reservation));
+			}
+			flushWrites(&owner2, false);
+			thrown = false;
+			try
+			{
+				flushWrites(&owner1, false);
+			}
+			catch (ITLException&)
+			{
+				thrown = true;
+			}
+			testAssert(thrown, "write-behind error reported to the owner");
+
+			// Different names of the same file refer to the same pending writes.
+			bool slowTaskDone = false;
+			itl2::writeBehind("./writebehind/../writebehind/test.dat", [&]()
+				{
+					this_thread::sleep_for(chrono::milliseconds(100));
+					slowTaskDone = true;
+				}, 0);
+			waitForWrites("writebehind/test.dat");
+			testAssert(slowTaskDone, "waiting for writes to the same file using different name");
+			flushWrites();
+		}
+	}
+}
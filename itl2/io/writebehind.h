@@ -0,0 +1,165 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace itl2
+{
+	/**
+	One contiguous region of data that is written to a file.
+	*/
+	struct FileWriteSegment
+	{
+		/**
+		Position of the first byte in the file.
+		*/
+		size_t filePos;
+
+		/**
+		Position of the first byte in the data buffer of the write operation.
+		*/
+		size_t bufferPos;
+
+		/**
+		Count of bytes to write.
+		*/
+		size_t size;
+	};
+
+	/**
+	Settings of the write-behind engine.
+	*/
+	struct WriteBehindSettings
+	{
+		/**
+		Count of background threads that perform the writes.
+		*/
+		size_t threadCount = 2;
+
+		/**
+		Maximum amount of data in bytes that can be waiting to be written.
+		If a new write operation would exceed this limit, the caller waits until enough data has been written.
+		Set to zero to use 10 % of the physical memory.
+		*/
+		size_t maxPendingBytes = 0;
+	};
+
+	/**
+	Gets the global settings of the write-behind engine.
+	The settings should be changed only when there are no pending writes.
+	*/
+	WriteBehindSettings& writeBehindSettings();
+
+	/**
+	Reservation of memory from the limit of pending data of the write-behind engine.
+	Create the reservation before allocating the buffer that is passed to writeBehind so that the buffers of the queued
+	writes never take more memory than the limit allows.
+	The reservation is released in the destructor unless it has been passed to writeBehind.
+	*/
+	class WriteReservation
+	{
+	private:
+		size_t bytes;
+
+	public:
+		/**
+		Waits until the given amount of memory is available and reserves it.
+		*/
+		explicit WriteReservation(size_t bytes);
+
+		WriteReservation(WriteReservation&& other) noexcept;
+
+		~WriteReservation();
+
+		WriteReservation(const WriteReservation&) = delete;
+		WriteReservation& operator=(const WriteReservation&) = delete;
+		WriteReservation& operator=(WriteReservation&&) = delete;
+
+		/**
+		Returns the amount of reserved memory and transfers the responsibility of releasing it to the caller.
+		*/
+		size_t release();
+	};
+
+	/**
+	Sets the owner of the writes queued by the current thread while the object exists.
+	flushWrites(owner, sync) waits only for the writes of the given owner, so e.g. separate PI systems or jobs
+	running in the same process do not wait for each other's writes nor receive each other's errors.
+	*/
+	class WriteOwnerScope
+	{
+	private:
+		const void* previous;
+
+	public:
+		explicit WriteOwnerScope(const void* owner);
+		~WriteOwnerScope();
+
+		WriteOwnerScope(const WriteOwnerScope&) = delete;
+		WriteOwnerScope& operator=(const WriteOwnerScope&) = delete;
+	};
+
+	/**
+	Queues write of the given data to the given file.
+	The file must exist and be large enough to hold the data.
+	The write is made in a background thread. Segments of the same file that are adjacent in the file are combined into
+	large vectored write operations, also across separate calls to this function.
+	Errors are reported by the next call to flushWrites.
+	@param filename Name of the file to write to.
+	@param data Buffer containing the data to write. Ownership of the buffer is transferred to the write-behind engine.
+	@param segments The regions of the buffer to write and their positions in the file.
+	@param reservation Memory reserved for the data buffer.
+	*/
+	void writeBehind(const std::string& filename, std::vector<char>&& data, std::vector<FileWriteSegment>&& segments, WriteReservation&& reservation);
+
+	/**
+	Queues write of the given data to the given file.
+	Waits until there is space for the data in the limit of pending data. Prefer reserving the memory before allocating the data buffer.
+	*/
+	void writeBehind(const std::string& filename, std::vector<char>&& data, std::vector<FileWriteSegment>&& segments);
+
+	/**
+	Queues a general write task that is run in a background thread.
+	Use e.g. for writing files whose format requires encoding.
+	Errors (exceptions) are reported by the next call to flushWrites.
+	@param key Name of the file or file set (e.g. image sequence) written by the task. Used by waitForWrites.
+	@param task The task to run.
+	@param reservation Memory reserved for the data held by the task.
+	*/
+	void writeBehind(const std::string& key, std::function<void()>&& task, WriteReservation&& reservation);
+
+	/**
+	Queues a general write task that is run in a background thread.
+	@param bytes Approximate amount of memory held by the task, used for limiting amount of pending data.
+	*/
+	void writeBehind(const std::string& key, std::function<void()>&& task, size_t bytes);
+
+	/**
+	Waits until all pending writes to the given file (or file set) are finished.
+	This is called automatically before the file is read.
+	File names that refer to the same file (e.g. ./a.raw and a.raw) are considered equal.
+	*/
+	void waitForWrites(const std::string& filename);
+
+	/**
+	Waits until all pending writes are finished, and optionally flushes the written files to the storage device.
+	Throws ITLException if any of the writes made after previous call to this function failed.
+	@param sync Set to true to flush written .raw files from operating system cache to the storage device.
+	*/
+	void flushWrites(bool sync = true);
+
+	/**
+	Waits until all pending writes of the given owner are finished, and optionally flushes the files written by the owner
+	to the storage device.
+	Throws ITLException if any of the writes of the owner made after previous flush failed.
+	@param owner The owner, see WriteOwnerScope.
+	@param sync Set to true to flush written .raw files from operating system cache to the storage device.
+	*/
+	void flushWrites(const void* owner, bool sync);
+
+	namespace tests
+	{
+		void writeBehind();
+	}
+}
@@ -413,15 +413,12 @@ namespace itl2
 		}
 
 
-		template<typename pixel_t> bool isSimplePointLine(const Image<pixel_t>& nb)
+		/**
+		Tests if the center point of a neighbourhood is a simple point.
+		@param Np Values of the 26 neighbours (0 or 1), not including the center point.
+		*/
+		inline bool isSimplePointLine(const uint8_t Np[26])
 		{
-			// Initialize neighbor list. The list will not contain the center pixel.
-			uint8_t Np[26];
-			for (coord_t i = 0; i < 13; i++)  // i =  0..12 -> cube[0..12]
-				Np[i] = nb(i) != (pixel_t)0 ? 1 : 0;
-			for (coord_t i = 14; i < 27; i++) // i = 14..26 -> cube[13..25]
-				Np[i - 1] = nb(i) != (pixel_t)0 ? 1 : 0;
-
 			// Calculate count of foreground 6-connected neighbours
 			static const size_t N6[] = { 4, 10, 12, 13, 15, 21 };
 			int N6Sum = 6;
@@ -465,6 +462,18 @@ namespace itl2
 			return true;
 		}
 
+		template<typename pixel_t> bool isSimplePointLine(const Image<pixel_t>& nb)
+		{
+			// Initialize neighbor list. The list will not contain the center pixel.
+			uint8_t Np[26];
+			for (coord_t i = 0; i < 13; i++)  // i =  0..12 -> cube[0..12]
+				Np[i] = nb(i) != (pixel_t)0 ? 1 : 0;
+			for (coord_t i = 14; i < 27; i++) // i = 14..26 -> cube[13..25]
+				Np[i - 1] = nb(i) != (pixel_t)0 ? 1 : 0;
+
+			return isSimplePointLine(Np);
+		}
+
 		/*
 		This function uses similar getNeighbourhood pixel ordering than ImageJ implementation,
 		but it should not be necessary to use exactly this ordering...
@@ -520,17 +529,17 @@ namespace itl2
 		size_t changed = 0;
 		std::deque<Vec3c> points;
 		size_t counter = 0;
+		internals::NeighbourhoodTest& isSimple = internals::simplePointLineTest();
 
 		for(int direction = 1; direction <= 6; direction++)
 		{
 			points.clear();
+			size_t tests = 0;
 
 			// Collect initial list of points
 			#pragma omp parallel
 			{
-				Image<pixel_t> nbPrivate(3, 3, 3);
-
-				#pragma omp for
+				#pragma omp for reduction(+ : tests)
 				for (coord_t z = 0; z < img.depth(); z++)
 				{
 					for (coord_t y = 0; y < img.height(); y++)
@@ -542,11 +551,12 @@ namespace itl2
 							{
 								if (internals::isBorderPoint(direction, img, x, y, z))
 								{
-									getNeighbourhood(img, Vec3c(x, y, z), Vec3c(1, 1, 1), nbPrivate, BoundaryCondition::Zero);
+									uint32_t nb = internals::neighbourhoodBits(img, Vec3c(x, y, z));
+									tests++;
 
 									// Note: This uses the same isEndPoint than hybridSkeleton!
-									if (!internals::isEndPoint(nbPrivate) &&
-										internals::isSimplePointLine(nbPrivate))
+									if (!internals::isEndPoint(nb) &&
+										isSimple(nb))
 									{
 										#pragma omp critical(linethin_insert)
 											points.push_back(Vec3c(x, y, z));
@@ -564,9 +574,94 @@ namespace itl2
 			// Otherwise, the point removal order may change the skeleton points.
 			std::sort(points.begin(), points.end(), vecComparer<coord_t>);
 
+			isSimple.addEvaluations(tests + points.size());
+
+			// Process all points
+			size_t counter = 0;
+			while (!points.empty())
+			{
+				Vec3c p;
+				if (counter % 2 == 0)
+				{
+					p = points.front();
+					points.pop_front();
+				}
+				else
+				{
+					p = points.back();
+					points.pop_back();
+				}
+
+				uint32_t nb = internals::neighbourhoodBits(img, p);
+				if (!internals::isEndPoint(nb) &&
+					isSimple(nb))
+				{
+					img(p) = 0;
+					changed++;
+				}
+
+				counter++;
+			}
+		}
+
+		return changed;
+	}
+
+	/*
+	Performs one thinning iteration and returns count of pixels removed from the image.
+	Gives the same result than lineThin(img), but tests only the given border points instead of scanning the whole image.
+	@param img Image that should be thinned.
+	@param borderPoints List of border points of img, initialized with internals::findBorderPoints. The list is updated to correspond to the thinned image.
+	*/
+	template<typename pixel_t> size_t lineThin(Image<pixel_t>& img, std::vector<Vec3c>& borderPoints)
+	{
+		size_t changed = 0;
+		std::vector<Vec3c> candidates;
+		std::deque<Vec3c> points;
+		std::vector<Vec3c> newBorderPoints;
+		internals::NeighbourhoodTest& isSimple = internals::simplePointLineTest();
+
+		for(int direction = 1; direction <= 6; direction++)
+		{
+			candidates.clear();
+			size_t tests = 0;
+
+			// Collect initial list of points
+			#pragma omp parallel
+			{
+				std::vector<Vec3c> privatePoints;
+
+				#pragma omp for nowait reduction(+ : tests)
+				for (coord_t n = 0; n < (coord_t)borderPoints.size(); n++)
+				{
+					const Vec3c& p = borderPoints[n];
+					if (internals::isBorderPoint(direction, img, p.x, p.y, p.z))
+					{
+						uint32_t nb = internals::neighbourhoodBits(img, p);
+						tests++;
+
+						if (!internals::isEndPoint(nb) &&
+							isSimple(nb))
+						{
+							privatePoints.push_back(p);
+						}
+					}
+				}
+
+				#pragma omp critical(linethin_insert)
+				candidates.insert(candidates.end(), privatePoints.begin(), privatePoints.end());
+			}
+
+			// The points must be processed in the same order than in lineThin(img).
+			std::sort(candidates.begin(), candidates.end(), vecComparer<coord_t>);
+			points.assign(candidates.begin(), candidates.end());
+
+			isSimple.addEvaluations(tests + points.size());
+
 			// Process all points
 			size_t counter = 0;
-			Image<pixel_t> nb(3, 3, 3);
+			size_t changedBefore = changed;
+			newBorderPoints.clear();
 			while (!points.empty())
 			{
 				Vec3c p;
@@ -581,16 +676,20 @@ namespace itl2
 					points.pop_back();
 				}
 
-				getNeighbourhood(img, p, Vec3c(1, 1, 1), nb, BoundaryCondition::Zero);
+				uint32_t nb = internals::neighbourhoodBits(img, p);
 				if (!internals::isEndPoint(nb) &&
-					internals::isSimplePointLine(nb))
+					isSimple(nb))
 				{
+					internals::findNewBorderPoints(img, p, newBorderPoints);
 					img(p) = 0;
 					changed++;
 				}
 
 				counter++;
 			}
+
+			if (changed > changedBefore)
+				internals::updateBorderPoints(img, borderPoints, newBorderPoints);
 		}
 
 		return changed;
@@ -605,16 +704,20 @@ namespace itl2
 	The resulting skeleton consists of lines only so it is referred to as "line skeleton".
 	Note that if line skeleton is required, it might be better idea to fill holes in the structure
 	and use hybrid skeleton as that algorithm seems to produce cleaner looking skeletons.
+	Only the current border points are tested in each iteration, so the processing time depends on the surface area rather than on the volume of the structure.
 	@param img Image that should be skeletonized.
 	*/
 	template<typename pixel_t> void lineSkeleton(Image<pixel_t>& img, size_t maxIterations = std::numeric_limits<size_t>::max())
 	{
+		// Only border points may be removed, so the whole image is scanned only once to find them.
+		std::vector<Vec3c> borderPoints;
+		internals::findBorderPoints(img, borderPoints);
 
 		size_t it = 0;
 		size_t changes;
 		do
 		{
-			changes = lineThin(img);
+			changes = lineThin(img, borderPoints);
 
 			std::cout << changes << " pixels removed." << std::endl;
 
@@ -630,6 +733,7 @@ namespace itl2
 	namespace tests
 	{
 		void lineSkeleton();
+		void lineSkeletonBorderPoints();
 	}
 
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <omp.h>
+#include <vector>
 
 #include "image.h"
 #include "math/mathutils.h"
@@ -76,6 +77,154 @@ namespace itl2
 		}
 	}
 
+	/**
+	Linear offsets of the pixels in a neighbourhood, relative to the center of the neighbourhood, in an image of given dimensions.
+	Only the pixels that are inside the neighbourhood mask are included.
+	*/
+	class NeighbourhoodOffsets
+	{
+	private:
+		/**
+		Radius of the neighbourhood.
+		*/
+		Vec3c nbRadius;
+
+		/**
+		Offset of each pixel in the neighbourhood from the center pixel, in the pixel data array of the image.
+		*/
+		std::vector<coord_t> linearOffsets;
+
+		/**
+		Position of each pixel in the neighbourhood relative to the center pixel.
+		*/
+		std::vector<Vec3c> relativePositions;
+
+	public:
+		/**
+		Constructor
+		@param mask Neighbourhood mask whose size is 2 * nbRadius + 1, e.g. created by createNeighbourhoodMask.
+		@param imageDimensions Dimensions of the image where the neighbourhood is going to be accessed.
+		*/
+		template<typename mask_t> NeighbourhoodOffsets(const Image<mask_t>& mask, const Vec3c& imageDimensions) :
+			nbRadius((mask.dimensions() - Vec3c(1, 1, 1)) / 2)
+		{
+			coord_t strideY = imageDimensions.x;
+			coord_t strideZ = imageDimensions.x * imageDimensions.y;
+
+			for (coord_t z = 0; z < mask.depth(); z++)
+			{
+				for (coord_t y = 0; y < mask.height(); y++)
+				{
+					for (coord_t x = 0; x < mask.width(); x++)
+					{
+						if (mask(x, y, z) != mask_t())
+						{
+							Vec3c relPos = Vec3c(x, y, z) - nbRadius;
+							linearOffsets.push_back(relPos.x + relPos.y * strideY + relPos.z * strideZ);
+							relativePositions.push_back(relPos);
+						}
+					}
+				}
+			}
+		}
+
+		/**
+		Gets count of pixels in the neighbourhood.
+		*/
+		size_t size() const
+		{
+			return linearOffsets.size();
+		}
+
+		/**
+		Gets linear offset of the n:th pixel from the center pixel.
+		*/
+		coord_t offset(size_t n) const
+		{
+			return linearOffsets[n];
+		}
+
+		/**
+		Gets position of the n:th pixel relative to the center pixel.
+		*/
+		const Vec3c& position(size_t n) const
+		{
+			return relativePositions[n];
+		}
+
+		/**
+		Gets radius of the neighbourhood.
+		*/
+		const Vec3c& radius() const
+		{
+			return nbRadius;
+		}
+	};
+
+	/**
+	Read-only view to the pixels of a neighbourhood in an image.
+	The pixels are read directly from the image through precomputed linear offsets, so the neighbourhood must be completely
+	inside the image.
+	*/
+	template<typename pixel_t> class NeighbourhoodView
+	{
+	private:
+		const pixel_t* pCenter;
+		const NeighbourhoodOffsets& offsets;
+
+	public:
+		/**
+		Constructor
+		@param pCenter Pointer to the center pixel of the neighbourhood.
+		@param offsets Offsets of the neighbourhood pixels. The offsets must have been calculated for the image where pCenter points to.
+		*/
+		NeighbourhoodView(const pixel_t* pCenter, const NeighbourhoodOffsets& offsets) :
+			pCenter(pCenter),
+			offsets(offsets)
+		{
+		}
+
+		/**
+		Gets count of pixels in the neighbourhood.
+		*/
+		size_t size() const
+		{
+			return offsets.size();
+		}
+
+		/**
+		Gets value of the n:th pixel in the neighbourhood.
+		*/
+		pixel_t operator[](size_t n) const
+		{
+			return pCenter[offsets.offset(n)];
+		}
+
+		/**
+		Gets position of the n:th pixel relative to the center pixel.
+		*/
+		const Vec3c& position(size_t n) const
+		{
+			return offsets.position(n);
+		}
+
+		/**
+		Gets value of the center pixel.
+		*/
+		pixel_t center() const
+		{
+			return *pCenter;
+		}
+
+		/**
+		Gets radius of the neighbourhood.
+		*/
+		const Vec3c& radius() const
+		{
+			return offsets.radius();
+		}
+	};
+
 
 
 	namespace internals
@@ -1,5 +1,13 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 namespace itl2
 {
 	/**
@@ -58,4 +66,67 @@ namespace itl2
 		}
 	};
 
-}
\ No newline at end of file
+	namespace internals
+	{
+		/**
+		Unsigned integer type of the given size in bytes.
+		*/
+		template<size_t size> struct AtomicWord;
+		template<> struct AtomicWord<1> { using type = uint8_t; };
+		template<> struct AtomicWord<2> { using type = uint16_t; };
+		template<> struct AtomicWord<4> { using type = uint32_t; };
+		template<> struct AtomicWord<8> { using type = uint64_t; };
+
+		/**
+		Atomically sets *target = desired if *target == expected.
+		@return True if the value was set.
+		*/
+		template<typename word_t> bool compareExchangeWord(word_t* target, word_t expected, word_t desired)
+		{
+#if defined(_MSC_VER)
+			if constexpr (sizeof(word_t) == 1)
+				return (word_t)_InterlockedCompareExchange8((volatile char*)target, (char)desired, (char)expected) == expected;
+			else if constexpr (sizeof(word_t) == 2)
+				return (word_t)_InterlockedCompareExchange16((volatile short*)target, (short)desired, (short)expected) == expected;
+			else if constexpr (sizeof(word_t) == 4)
+				return (word_t)_InterlockedCompareExchange((volatile long*)target, (long)desired, (long)expected) == expected;
+			else
+				return (word_t)_InterlockedCompareExchange64((volatile long long*)target, (long long)desired, (long long)expected) == expected;
+#else
+			return __atomic_compare_exchange_n(target, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+#endif
+		}
+	}
+
+	/**
+	Atomically replaces the value of target by desired if target == expected.
+	Can be used for e.g. claiming pixels of an image in multiple threads without locks.
+	The values are compared using operator== of T, so e.g. 0.0f and -0.0f are considered equal.
+	T must be a trivially copyable type whose size is 1, 2, 4, or 8 bytes, and target must be aligned to its size.
+	@return True if the value was replaced.
+	*/
+	template<typename T> bool atomicCompareAndSet(T& target, const T& expected, const T& desired)
+	{
+		static_assert(std::is_trivially_copyable_v<T> && (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8), "atomicCompareAndSet supports only trivially copyable types of size 1, 2, 4, or 8 bytes.");
+
+		using word_t = typename internals::AtomicWord<sizeof(T)>::type;
+		word_t* pTarget = reinterpret_cast<word_t*>(&target);
+
+		word_t desiredWord;
+		std::memcpy(&desiredWord, &desired, sizeof(T));
+
+		while (true)
+		{
+			word_t currentWord = *(volatile word_t*)pTarget;
+			T current;
+			std::memcpy(&current, &currentWord, sizeof(T));
+
+			if (!(current == expected))
+				return false;
+
+			// If the exchange fails, the value changed after it was read, so compare again.
+			if (internals::compareExchangeWord(pTarget, currentWord, desiredWord))
+				return true;
+		}
+	}
+}
@@ -59,7 +59,7 @@ namespace itl2
 			testAssert(!different, "multi- and single-threaded particle analysis");
 		}
 
-		Results checkThreading(const Image<uint8_t>& img, Connectivity conn, coord_t volumeLimit)
+		Results checkThreading(const Image<uint8_t>& img, Connectivity conn, coord_t volumeLimit, AnalyzerSet<Vec3sc, uint8_t>& analyzers)
 		{
 
 			Image<uint8_t> img1;
@@ -71,8 +71,6 @@ namespace itl2
 			Image<uint8_t> img3;
 			setValue(img3, img);
 
-
-			auto analyzers = allAnalyzers(img);
 			Results results_multi, results_single, results_alternate;
 
 			Timer timer;
@@ -82,7 +80,7 @@ namespace itl2
 			{
 				vector<Results> allResults;
 				vector<vector<vector<Vec3sc> > > allBlockLargeEdgePoints;
-				vector<vector<vector<Vec3sc> > > allBlockIncompleteParticles;
+				vector<vector<internals::IncompleteParticle> > allBlockIncompleteParticles;
 				vector<vector<coord_t> > allBlockEdgeZ;
 
 				coord_t blockSize = 100;
@@ -96,7 +94,7 @@ namespace itl2
 
 					Results blockResults;
 					vector<vector<Vec3sc> > blockLargeEdgePoints;
-					vector<vector<Vec3sc> > blockIncompleteParticles;
+					vector<internals::IncompleteParticle> blockIncompleteParticles;
 					vector<coord_t> blockEdgeZ;
 					size_t counter = 0;
 					uint8_t fillColor = internals::SpecialColors<uint8_t>::fillColor();
@@ -118,7 +116,7 @@ namespace itl2
 				Results finalResults = allResults[0];
 				finalResults.headers() = analyzers.headers();
 				vector<vector<Vec3sc> > finalLargeEdgePoints = allBlockLargeEdgePoints[0];
-				vector<vector<Vec3sc> > finalIncompleteParticles = allBlockIncompleteParticles[0];
+				vector<internals::IncompleteParticle> finalIncompleteParticles = allBlockIncompleteParticles[0];
 				vector<coord_t> finalEdgeZ = allBlockEdgeZ[0];
 
 				if (allResults.size() > 1)
@@ -184,17 +182,29 @@ namespace itl2
 			return results_multi;
 		}
 
-		void checkThreading(const Image<uint8_t>& img)
+		Results checkThreading(const Image<uint8_t>& img, Connectivity conn, coord_t volumeLimit)
+		{
+			auto analyzers = allAnalyzers(img);
+			return checkThreading(img, conn, volumeLimit, analyzers);
+		}
+
+		void checkThreading(const Image<uint8_t>& img, AnalyzerSet<Vec3sc, uint8_t>& analyzers)
 		{
 			cout << "------- AllNeighbours, no volume limit -------" << endl;
-			checkThreading(img, Connectivity::AllNeighbours, 0);
+			checkThreading(img, Connectivity::AllNeighbours, 0, analyzers);
 			cout << "------- NearestNeighbours, no volume limit -------" << endl;
-			checkThreading(img, Connectivity::NearestNeighbours, 0);
+			checkThreading(img, Connectivity::NearestNeighbours, 0, analyzers);
 
 			cout << "------- AllNeighbours, with volume limit -------" << endl;
-			checkThreading(img, Connectivity::AllNeighbours, 100);
+			checkThreading(img, Connectivity::AllNeighbours, 100, analyzers);
 			cout << "------- NearestNeighbours, with volume limit -------" << endl;
-			checkThreading(img, Connectivity::NearestNeighbours, 100);
+			checkThreading(img, Connectivity::NearestNeighbours, 100, analyzers);
+		}
+
+		void checkThreading(const Image<uint8_t>& img)
+		{
+			auto analyzers = allAnalyzers(img);
+			checkThreading(img, analyzers);
 		}
 
 		void analyzeParticlesThreading()
@@ -209,6 +219,25 @@ namespace itl2
 			checkThreading(img);
 		}
 
+		void analyzeParticlesMergeable()
+		{
+			// Deep image so that particles cross many calculation block edges.
+			Image<uint8_t> img(100, 100, 450);
+
+			draw(img, AABox(Vec3c(40, 40, 10), Vec3c(60, 60, 440)), (uint8_t)1);
+			for (coord_t n = 0; n < 300; n++)
+			{
+				Vec3d pos(frand((double)img.width()), frand((double)img.height()), frand((double)img.depth()));
+				draw(img, Sphere(pos, frand(1, 8)), (uint8_t)1);
+			}
+
+			auto analyzers = createAnalyzers<uint8_t>("coordinates, isonedge, volume, bounds", img.dimensions());
+			testAssert(analyzers.isMergeable(), "analyzers are mergeable");
+			testAssert(!allAnalyzers(img).isMergeable(), "all analyzers are not mergeable");
+
+			checkThreading(img, analyzers);
+		}
+
 		void analyzeParticlesThreadingBig()
 		{
 			for (size_t trial = 0; trial < 50; trial++)
@@ -326,6 +355,74 @@ namespace itl2
 			}
 		}
 
+		void particleRunAnalyzers()
+		{
+			Image<uint8_t> img(80, 70, 60);
+			for (coord_t n = 0; n < 40; n++)
+			{
+				Vec3d pos(frand((double)img.width()), frand((double)img.height()), frand((double)img.depth()));
+				draw(img, Sphere(pos, frand(2, 12)), (uint8_t)1);
+			}
+
+			auto analyzers = allAnalyzers(img);
+			Headers headers = analyzers.headers();
+			std::set<string> orientationColumns = { "phi1 [rad]", "theta1 [rad]", "phi2 [rad]", "theta2 [rad]", "phi3 [rad]", "theta3 [rad]", "d1 [pixel]", "d2 [pixel]", "d3 [pixel]", "bounding scale [1]" };
+
+			// Fill the same particles into point and run lists and compare analysis results.
+			Image<uint8_t> img2(img.dimensions());
+			setValue(img2, img);
+			size_t particleCount = 0;
+			size_t orientedCount = 0;
+			for (coord_t z = 0; z < img.depth(); z++)
+			{
+				for (coord_t y = 0; y < img.height(); y++)
+				{
+					for (coord_t x = 0; x < img.width(); x++)
+					{
+						if (img(x, y, z) == 1)
+						{
+							vector<Vec3sc> points;
+							ParticleRuns runs;
+							floodfillSingleThreaded(img, Vec3c(x, y, z), (uint8_t)2, (uint8_t)2, Connectivity::AllNeighbours, nullptr, &points, 0, (set<uint8_t>*)nullptr, false);
+							floodfillSingleThreaded(img2, Vec3c(x, y, z), (uint8_t)2, (uint8_t)2, Connectivity::AllNeighbours, nullptr, &runs, 0, (set<uint8_t>*)nullptr, false);
+
+							vector<Vec3sc> runPoints;
+							runs.toPoints(runPoints);
+							testAssert(runPoints == points, "flood fill runs");
+							testAssert(runs.pointCount() == points.size(), "run point count");
+							testAssert(runs.runCount() < points.size() || points.size() <= 1, "run count");
+
+							vector<double> pointResults, runResults;
+							analyzers.analyze(points, pointResults);
+							analyzers.analyze(runs, runResults);
+
+							// Principal directions are not accurate if the particle has nearly equal eigenvalues,
+							// as the eigenvalue solver is not accurate in that case.
+							double l1 = pointResults[headers.getColumnIndex("l1")];
+							double l2 = pointResults[headers.getColumnIndex("l2")];
+							double l3 = pointResults[headers.getColumnIndex("l3")];
+							bool isDegenerate = l1 - l2 < 0.05 * l1 || l2 - l3 < 0.05 * l1;
+							if (!isDegenerate)
+								orientedCount++;
+
+							for (size_t n = 0; n < pointResults.size(); n++)
+							{
+								if (isDegenerate && orientationColumns.count(headers[n]) > 0)
+									continue;
+
+								testAssert(NumberUtils<double>::equals(pointResults[n], runResults[n], 1e-4), string("run analyzer result ") + headers[n]);
+							}
+
+							particleCount++;
+						}
+					}
+				}
+			}
+
+			testAssert(particleCount > 0, "particles found");
+			testAssert(orientedCount > 0, "particles with distinct principal directions found");
+		}
+
 		void analyzeParticlesSanity()
 		{
 			Image<uint8_t> img(150, 150, 150);
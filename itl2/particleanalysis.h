@@ -5,12 +5,14 @@
 
 #include "image.h"
 #include "floodfill.h"
+#include "connectedcomponents.h"
 #include "utilities.h"
 
 #include "math/vec2.h"
 #include "math/vec3.h"
 
 #include "indexforest.h"
+#include "particleruns.h"
 #include "aabox.h"
 #include "misc.h"
 
@@ -70,10 +72,55 @@ namespace itl2
 	//	}
 	//}
 
+	namespace internals
+	{
+		/**
+		Labels particles using labels of given data type. See labelParticles.
+		*/
+		template<typename pixel_t, typename label_t> pixel_t labelParticles(Image<pixel_t>& image, pixel_t particleColor, pixel_t firstLabelValue, Connectivity connectivity, bool showProgress)
+		{
+			// In the "color all particles" case the original algorithm colored the particles with the maximum value before labeling.
+			// That color is skipped in the label values.
+			pixel_t skipColor = particleColor == 0 ? std::numeric_limits<pixel_t>::max() : particleColor;
+
+			size_t particleCount = 0;
+			double lastValue = 0;
+			auto checkCount = [&](size_t count)
+			{
+				particleCount = count;
+				if (count <= 0)
+					return;
+
+				lastValue = (double)firstLabelValue + (double)(count - 1);
+				if (firstLabelValue <= skipColor && lastValue >= (double)skipColor)
+					lastValue++;
+				if (lastValue >= (double)std::numeric_limits<pixel_t>::max() - 2)
+					throw ITLException("Unable to label because there are not enough distinct pixel values available. Consider converting input image to higher bitdepth (e.g. uint8 to uint16).");
+			};
+
+			// The labels are written directly to the image, so that a label image of the size of the input image is not needed.
+			auto output = [&](coord_t x, coord_t y, coord_t z, label_t l)
+			{
+				pixel_t value = (pixel_t)(firstLabelValue + (l - 1));
+				if (firstLabelValue <= skipColor && value >= skipColor)
+					value++;
+				image(x, y, z) = value;
+			};
+
+			internals::labelConnectedComponentsInSlabs<label_t>(image, particleColor, connectivity, showProgress, checkCount, output);
+
+			if (particleCount <= 0)
+				return (pixel_t)(firstLabelValue - 1);
+
+			return (pixel_t)lastValue;
+		}
+	}
+
 	/**
 	Label all particles with distinct colors beginning from one.
 	It is assumed that background pixels are set to zero.
-	Uses simple flood fill algorithm.
+	Uses parallel connected component labelling, see labelConnectedComponents. The particles are numbered in the order
+	in which they are encountered in a raster scan of the image.
 	If the pixel data type does not support large enough values to label all particles, an exception is thrown.
 	@param image Image containing the particles.
 	@param particleColor Color of particles. This color will be skipped in labeling, and regions having some other color than this are not labeled. Pass zero to label particles of any color.
@@ -82,57 +129,12 @@ namespace itl2
 	*/
 	template<typename pixel_t> pixel_t labelParticles(Image<pixel_t>& image, pixel_t particleColor = 0, pixel_t firstLabelValue = 1, Connectivity connectivity = Connectivity::NearestNeighbours, bool showProgress = true)
 	{
-		size_t counter = 0;
-
-		// Handle "color all particles" case first
-		if (particleColor == 0)
-		{
-			particleColor = std::numeric_limits<pixel_t>::max();
-
-			#pragma omp parallel for if (image.pixelCount() > PARALLELIZATION_THRESHOLD && !omp_in_parallel())
-			for (coord_t n = 0; n < image.pixelCount(); n++)
-			{
-				if (image(n) != 0)
-					image(n) = particleColor;
-			}
-		}
-
-		pixel_t particleNumber = firstLabelValue;
-		if(particleNumber == particleColor)
-			particleNumber++;
-
-		for (coord_t z = 0; z < image.depth(); z++)
-		{
-			for (coord_t y = 0; y < image.height(); y++)
-			{
-				for (coord_t x = 0; x < image.width(); x++)
-				{
-					pixel_t pixel = image(x, y, z);
-
-					if (pixel == particleColor)
-					{
-						if (particleNumber >= std::numeric_limits<pixel_t>::max() - 2)
-							throw ITLException("Unable to label because there are not enough distinct pixel values available. Consider converting input image to higher bitdepth (e.g. uint8 to uint16).");
-
-						floodfill(image, Vec3c(x, y, z), particleNumber, particleNumber, connectivity);
-
-						particleNumber++;
-						if (particleNumber == particleColor)
-							particleNumber++;
-					}
-
-					
-				}
-
-				showThreadProgress(counter, image.depth() * image.height(), showProgress);
-			}
-		}
-
-		return particleNumber - 1;
+		if (image.pixelCount() < (coord_t)std::numeric_limits<uint32_t>::max())
+			return internals::labelParticles<pixel_t, uint32_t>(image, particleColor, firstLabelValue, connectivity, showProgress);
+		else
+			return internals::labelParticles<pixel_t, uint64_t>(image, particleColor, firstLabelValue, connectivity, showProgress);
 	}
 
-    
-
 	namespace internals
 	{
 
@@ -207,6 +209,75 @@ namespace itl2
 			return false;
 		}
 
+		/**
+		Tests if Z coordinate of any particle point is 0 or maxZ.
+		*/
+		inline bool isOnZEdge(const ParticleRuns& particle, coord_t maxZ)
+		{
+			return particle.hasZ(0, maxZ);
+		}
+
+		/**
+		Particle that touches calculation block edge, and must be combined with particles from the neighbouring blocks before it can be analyzed.
+		*/
+		struct IncompleteParticle
+		{
+			/**
+			Runs of pixels in the particle.
+			If the particle has partial analysis state, only the runs on the calculation block edges are stored.
+			*/
+			ParticleRuns runs;
+
+			/**
+			Partial analysis state of the particle for each analyzer.
+			Empty if the analyzers are not mergeable, and the particle must be analyzed from its runs.
+			*/
+			std::vector<std::vector<double> > state;
+
+			/**
+			Count of pixels in the particle.
+			*/
+			size_t volume;
+
+			IncompleteParticle() :
+				volume(0)
+			{
+			}
+
+			IncompleteParticle(const ParticleRuns& runs) :
+				runs(runs),
+				volume(runs.pointCount())
+			{
+			}
+
+			/**
+			Adds the other part of the same particle to this one, and clears the other part.
+			*/
+			template<typename pixel_t> void append(IncompleteParticle& other, const AnalyzerSet<Vec3sc, pixel_t>& analyzers)
+			{
+				runs.append(other.runs);
+				if (!state.empty())
+					analyzers.mergeState(state, other.state);
+				volume += other.volume;
+
+				other.state.clear();
+				other.state.shrink_to_fit();
+				other.volume = 0;
+			}
+
+			/**
+			Removes runs that are not on the given z-planes.
+			*/
+			void keepRunsAt(int32_t z1, int32_t z2)
+			{
+				runs.removeRuns(
+					[=](const ParticleRun& run)
+					{
+						return run.start.z != z1 && run.start.z != z2;
+					});
+			}
+		};
+
 		/**
 		Perform particle analysis for single image block.
 		Has no restrictions on particle count. (uses flood fill algorithm)
@@ -222,11 +293,13 @@ namespace itl2
 		@param largeColor Particles that are skipped because their size is larger than volumeLimit are colored with this color.
 		@param backgroundColor Color of background.
 		*/
-		template<typename pixel_t> void analyzeParticlesSingleBlock(Image<pixel_t>& image, AnalyzerSet<Vec3sc, pixel_t>& analyzers, Results& results, std::vector<std::vector<Vec3sc> >* pIncompleteParticles, std::vector<std::vector<Vec3sc> >* pLargeEdgePoints, Connectivity connectivity, size_t volumeLimit, pixel_t fillColor, pixel_t largeColor, size_t& counter, size_t counterMax, const Vec3sc& coordinateShift)
+		template<typename pixel_t> void analyzeParticlesSingleBlock(Image<pixel_t>& image, AnalyzerSet<Vec3sc, pixel_t>& analyzers, Results& results, std::vector<IncompleteParticle>* pIncompleteParticles, std::vector<std::vector<Vec3sc> >* pLargeEdgePoints, Connectivity connectivity, size_t volumeLimit, pixel_t fillColor, pixel_t largeColor, size_t& counter, size_t counterMax, const Vec3sc& coordinateShift)
 		{
-			std::vector<Vec3sc> particlePoints;
+			ParticleRuns particlePoints;
 			particlePoints.reserve(1000);
 
+			bool isMergeable = analyzers.isMergeable();
+
 			for (coord_t z = 0; z < image.depth(); z++)
 			{
 				for (coord_t y = 0; y < image.height(); y++)
@@ -265,15 +338,22 @@ namespace itl2
 
 								// Apply shift to particlePoints
 								if (coordinateShift != Vec3sc(0, 0, 0))
-								{
-									for (size_t n = 0; n < particlePoints.size(); n++)
-										particlePoints[n] += coordinateShift;
-								}
+									particlePoints.shift(coordinateShift);
 
 								if (isIncomplete)
 								{
-									// The particle touches image edge, store it as incomplete point set.
-									pIncompleteParticles->push_back(particlePoints);
+									// The particle touches image edge, store it as incomplete particle.
+									IncompleteParticle particle(particlePoints);
+
+									if (isMergeable)
+									{
+										// Combining with particles from the neighbouring blocks requires only the partial analysis state
+										// and the runs on the block edges.
+										analyzers.partialState(particlePoints, particle.state);
+										particle.keepRunsAt(coordinateShift.z, coordinateShift.z + (int32_t)image.depth() - 1);
+									}
+
+									pIncompleteParticles->push_back(particle);
 								}
 								else
 								{
@@ -288,12 +368,15 @@ namespace itl2
 								// The fill was ended by size limit or the filled region touches large region
 								// --> the filled region is part of large particle.
 
-								if (particlePoints.size() <= 0)
+								if (particlePoints.empty())
 									particlePoints.push_back(Vec3sc((int32_t)x, (int32_t)y, (int32_t)z));
 
 								// Mark the filled points as belonging to a large particle.
-								for (size_t n = 0; n < particlePoints.size(); n++)
-									image(particlePoints[n]) = largeColor;
+								for (const ParticleRun& run : particlePoints)
+								{
+									for (coord_t px = run.start.x; px < run.start.x + run.length; px++)
+										image(px, run.start.y, run.start.z) = largeColor;
+								}
 
 								// Store image edge points belonging to large particle
 								if (pLargeEdgePoints)
@@ -301,10 +384,13 @@ namespace itl2
 									std::vector<Vec3sc> edgePoints;
 
 									// Find edge points and apply shift
-									for (size_t n = 0; n < particlePoints.size(); n++)
+									for (const ParticleRun& run : particlePoints)
 									{
-										if (particlePoints[n].z <= 0 || particlePoints[n].z >= image.depth() - 1)
-											edgePoints.push_back(particlePoints[n] + coordinateShift);
+										if (run.start.z <= 0 || run.start.z >= image.depth() - 1)
+										{
+											for (int32_t n = 0; n < run.length; n++)
+												edgePoints.push_back(Vec3sc(run.start.x + n, run.start.y, run.start.z) + coordinateShift);
+										}
 									}
 
 									if(edgePoints.size() > 0)
@@ -345,7 +431,7 @@ namespace itl2
 		@param fillColor The analyzed particles will be colored with this color.
 		@param largeColor Particles that are skipped because their size is larger than volumeLimit are colored with this color.
 		*/
-		template<typename pixel_t> void analyzeParticlesBlocks(Image<pixel_t>& image, AnalyzerSet<Vec3sc, pixel_t>& analyzers, Results& results, std::vector<std::vector<Vec3sc> >& largeEdgePoints, std::vector<std::vector<Vec3sc> >& incompleteParticles, Connectivity connectivity, size_t volumeLimit, pixel_t fillColor, pixel_t largeColor, const Vec3sc& origin, std::vector<coord_t>& blockEdgeZ)
+		template<typename pixel_t> void analyzeParticlesBlocks(Image<pixel_t>& image, AnalyzerSet<Vec3sc, pixel_t>& analyzers, Results& results, std::vector<std::vector<Vec3sc> >& largeEdgePoints, std::vector<IncompleteParticle>& incompleteParticles, Connectivity connectivity, size_t volumeLimit, pixel_t fillColor, pixel_t largeColor, const Vec3sc& origin, std::vector<coord_t>& blockEdgeZ)
 		{
 			size_t counter = 0;
 
@@ -409,7 +495,7 @@ namespace itl2
 					// Analyze the block. All coordinates are shifted in analyzeParticlesSingleBlock function to global original image coordinates.
 					Results blockResults;
 					std::vector<std::vector<Vec3sc> > blockLargeEdgePoints;
-					std::vector<std::vector<Vec3sc> > blockIncompleteParticles;
+					std::vector<IncompleteParticle> blockIncompleteParticles;
 					internals::analyzeParticlesSingleBlock(block, analyzers, blockResults, &blockIncompleteParticles, &blockLargeEdgePoints, connectivity, volumeLimit, fillColor, largeColor, counter, image.depth() * image.height(), origin + Vec3sc(0, 0, (int32_t)minZ));
 
 					//raw::writed(block, "./particleanalysis/block");
@@ -608,7 +694,7 @@ namespace itl2
 		The added particles must not be from already processed blocks.
 		@param isSubBlock Set to false if this is the final call to this function. This ensures that also particles that touch z-block edges are included in the results table.
 		*/
-		template<typename pixel_t> void combineParticleAnalysisResults(const AnalyzerSet<Vec3sc, pixel_t>& analyzers, Results& results, std::vector<std::vector<Vec3sc> >& largeEdgePoints, std::vector<std::vector<Vec3sc> >& incompleteParticles, size_t volumeLimit, Connectivity connectivity, std::vector<coord_t>& blockEdgeZ, bool isSubBlock)
+		template<typename pixel_t> void combineParticleAnalysisResults(const AnalyzerSet<Vec3sc, pixel_t>& analyzers, Results& results, std::vector<std::vector<Vec3sc> >& largeEdgePoints, std::vector<IncompleteParticle>& incompleteParticles, size_t volumeLimit, Connectivity connectivity, std::vector<coord_t>& blockEdgeZ, bool isSubBlock)
 		{
 			/*
 			At end of this function:
@@ -632,12 +718,15 @@ namespace itl2
 			size_t counter = 0;
 			for (coord_t n = 0; n < (coord_t)incompleteParticles.size(); n++)
 			{
-				auto& points = incompleteParticles[n];
+				auto& runs = incompleteParticles[n].runs;
 				std::vector<Vec3sc> currEdgePoints;
-				for (size_t m = 0; m < points.size(); m++)
+				for (const ParticleRun& run : runs)
 				{
-					if (find(blockEdgeZ.begin(), blockEdgeZ.end(), points[m].z) != blockEdgeZ.end())
-						currEdgePoints.push_back(points[m]);
+					if (find(blockEdgeZ.begin(), blockEdgeZ.end(), run.start.z) != blockEdgeZ.end())
+					{
+						for (int32_t m = 0; m < run.length; m++)
+							currEdgePoints.push_back(Vec3sc(run.start.x + m, run.start.y, run.start.z));
+					}
 				}
 
 				// Order of insertions must be the same than order of particles in incompleteParticles list.
@@ -668,7 +757,7 @@ namespace itl2
 					{
 						if (base < incompleteParticles.size())
 						{
-							concatAndShrink(incompleteParticles[base], incompleteParticles[n]);
+							incompleteParticles[base].append(incompleteParticles[n], analyzers);
 							concatAndShrink(edgePoints[base], edgePoints[n]);
 						}
 						else
@@ -681,13 +770,7 @@ namespace itl2
 							edgePoints[n].clear();
 							edgePoints[n].shrink_to_fit();
 
-							incompleteParticles[n].erase(
-								std::remove_if(incompleteParticles[n].begin(), incompleteParticles[n].end(),
-									[=](Vec3sc& p)
-									{
-										return p.z != 0 && p.z != maxZ;
-									}),
-								incompleteParticles[n].end());
+							incompleteParticles[n].keepRunsAt(0, (int32_t)maxZ);
 						}
 					}
 
@@ -700,7 +783,7 @@ namespace itl2
 					// big particle not in incompleteParticles list)
 					for (coord_t n = 0; n < (coord_t)incompleteParticles.size(); n++)
 					{
-						if (incompleteParticles[n].size() >= volumeLimit)
+						if (incompleteParticles[n].volume >= volumeLimit)
 							isBig[n] = true;
 					}
 
@@ -720,7 +803,7 @@ namespace itl2
 			counter = 0;
 
 			std::vector<std::vector<Vec3sc> > remainingLargeEdgePoints;
-			std::vector<std::vector<Vec3sc> > remainingIncompleteParticles;
+			std::vector<IncompleteParticle> remainingIncompleteParticles;
 			std::vector<coord_t> remainingBlockEdgeZ;
 
 			remainingBlockEdgeZ.push_back(0);
@@ -730,10 +813,11 @@ namespace itl2
 			for (coord_t n = 0; n < (coord_t)incompleteParticles.size(); n++)
 			{
 
-				auto& points = incompleteParticles[n];
+				auto& particle = incompleteParticles[n];
+				auto& points = particle.runs;
 				// NOTE: Empty point list is used to indicate that the particle has been combined with some other particle,
 				// and thus must not be analyzed. (the other particle to which this one was combined contains all the points)
-				if(points.size() > 0)
+				if(!points.empty())
 				{
 
 					if(volumeLimit <= 0 || (volumeLimit > 0 && !isBig[n]))
@@ -741,9 +825,13 @@ namespace itl2
 						if (isSubBlock && isOnZEdge(points, maxZ))
 						{
 							// The particle is incomplete.
+							// If the particle has partial analysis state, only the runs on the edges of the combined block are needed later.
+							if (!particle.state.empty())
+								particle.keepRunsAt(0, (int32_t)maxZ);
+
 							#pragma omp critical(remainingIncompleteParticlesInsert)
 							{
-								remainingIncompleteParticles.push_back(points);
+								remainingIncompleteParticles.push_back(particle);
 							}
 						}
 						else
@@ -753,7 +841,10 @@ namespace itl2
 							// do not overlap so there are no duplicate points in the point list
 							//Vec3c point = points[0];
 							std::vector<double> resultLine;
-							analyzers.analyze(points, resultLine);
+							if (!particle.state.empty())
+								analyzers.finalize(particle.state, resultLine);
+							else
+								analyzers.analyze(points, resultLine);
 
 							#pragma omp critical(resultsInsert)
 							{
@@ -764,9 +855,12 @@ namespace itl2
 					else if (volumeLimit > 0 && isBig[n])
 					{
 						// The particle is big. Add its edge points to the new largeEdgePoints list.
+						std::vector<Vec3sc> edgePoints;
+						points.toPoints(edgePoints);
+
 						#pragma omp critical(remainingLargeEdgePointsInsert)
 						{
-							remainingLargeEdgePoints.push_back(points);
+							remainingLargeEdgePoints.push_back(edgePoints);
 						}
 					}
 
@@ -846,7 +940,7 @@ namespace itl2
 		if (largeColor == 0)
 			throw ITLException("Large color must not be zero as zero is background color.");
 
-		std::vector<std::vector<Vec3sc> > incompleteParticles;
+		std::vector<internals::IncompleteParticle> incompleteParticles;
 		std::vector<std::vector<Vec3sc> > largeEdgePoints;
 		std::vector<coord_t> edgeZ;
 		
@@ -954,8 +1048,8 @@ namespace itl2
 	{
 		// TODO: This can be done more efficiently by changing analyzers such that they don't require all the points at once.
 
-		// Divide pixels into point sets based on their value
-		std::map<pixel_t, std::vector<Vec3sc> > points;
+		// Divide pixels into run-length encoded point sets based on their value
+		std::map<pixel_t, ParticleRuns> points;
 		{
 			ProgressIndicator prog(image.depth());
 			for (coord_t z = 0; z < image.depth(); z++)
@@ -1331,6 +1425,8 @@ namespace itl2
 		void analyzeParticlesSanity();
 		void analyzeParticlesSanity2();
 		void analyzeParticlesVolumeLimit();
+		void particleRunAnalyzers();
+		void analyzeParticlesMergeable();
 	}
 }
 
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "math/vec3.h"
+
+namespace itl2
+{
+	/**
+	Run of consecutive particle pixels in the x-direction.
+	The run contains pixels (start.x + n, start.y, start.z), where n is in range [0, length[.
+	*/
+	struct ParticleRun
+	{
+		/**
+		First pixel of the run.
+		*/
+		Vec3sc start;
+
+		/**
+		Count of pixels in the run.
+		*/
+		int32_t length;
+
+		ParticleRun() :
+			length(0)
+		{
+		}
+
+		ParticleRun(const Vec3sc& start, int32_t length) :
+			start(start),
+			length(length)
+		{
+		}
+
+		/**
+		Gets the last pixel of the run.
+		*/
+		Vec3sc end() const
+		{
+			return Vec3sc(start.x + length - 1, start.y, start.z);
+		}
+	};
+
+	/**
+	Run-length encoded particle, i.e. list of runs of particle pixels in the x-direction.
+	Points added with push_back are merged to the last run if they are consecutive to it, so
+	points filled by a scanline flood fill are stored in one run per filled scanline.
+	*/
+	class ParticleRuns
+	{
+	private:
+		std::vector<ParticleRun> runs;
+		size_t count;
+
+	public:
+		ParticleRuns() :
+			count(0)
+		{
+		}
+
+		/**
+		Adds a point to the particle.
+		*/
+		void push_back(const Vec3sc& p)
+		{
+			if (!runs.empty())
+			{
+				ParticleRun& last = runs.back();
+				if (last.start.y == p.y && last.start.z == p.z && last.start.x + last.length == p.x)
+				{
+					last.length++;
+					count++;
+					return;
+				}
+			}
+
+			runs.push_back(ParticleRun(p, 1));
+			count++;
+		}
+
+		/**
+		Adds a run to the particle.
+		*/
+		void push_back(const ParticleRun& run)
+		{
+			runs.push_back(run);
+			count += run.length;
+		}
+
+		/**
+		Adds all runs of the other particle to this one, and clears the other particle.
+		*/
+		void append(ParticleRuns& other)
+		{
+			runs.insert(runs.end(), other.runs.begin(), other.runs.end());
+			count += other.count;
+			other.clear();
+			other.shrink_to_fit();
+		}
+
+		/**
+		Removes all runs.
+		*/
+		void clear()
+		{
+			runs.clear();
+			count = 0;
+		}
+
+		void shrink_to_fit()
+		{
+			runs.shrink_to_fit();
+		}
+
+		void reserve(size_t runCount)
+		{
+			runs.reserve(runCount);
+		}
+
+		/**
+		Gets count of pixels in the particle.
+		*/
+		size_t pointCount() const
+		{
+			return count;
+		}
+
+		/**
+		Gets count of runs in the particle.
+		*/
+		size_t runCount() const
+		{
+			return runs.size();
+		}
+
+		bool empty() const
+		{
+			return count <= 0;
+		}
+
+		const ParticleRun& operator[](size_t n) const
+		{
+			return runs[n];
+		}
+
+		std::vector<ParticleRun>::const_iterator begin() const
+		{
+			return runs.begin();
+		}
+
+		std::vector<ParticleRun>::const_iterator end() const
+		{
+			return runs.end();
+		}
+
+		/**
+		Gets the list of runs.
+		*/
+		const std::vector<ParticleRun>& getRuns() const
+		{
+			return runs;
+		}
+
+		/**
+		Adds shift to the coordinates of all the runs.
+		*/
+		void shift(const Vec3sc& delta)
+		{
+			for (ParticleRun& run : runs)
+				run.start += delta;
+		}
+
+		/**
+		Removes runs for which the given predicate returns true.
+		*/
+		template<typename F> void removeRuns(F pred)
+		{
+			runs.erase(std::remove_if(runs.begin(), runs.end(), pred), runs.end());
+			count = 0;
+			for (const ParticleRun& run : runs)
+				count += run.length;
+		}
+
+		/**
+		Tests if any run in this particle has z-coordinate equal to any of the given values.
+		*/
+		bool hasZ(coord_t z1, coord_t z2) const
+		{
+			for (const ParticleRun& run : runs)
+			{
+				if (run.start.z == z1 || run.start.z == z2)
+					return true;
+			}
+			return false;
+		}
+
+		/**
+		Adds all the points of this particle to the given list.
+		*/
+		template<typename POINT> void toPoints(std::vector<POINT>& points) const
+		{
+			points.reserve(points.size() + count);
+			for (const ParticleRun& run : runs)
+			{
+				for (int32_t n = 0; n < run.length; n++)
+					points.push_back(POINT(run.start.x + n, run.start.y, run.start.z));
+			}
+		}
+	};
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <type_traits>
+
+#include "image.h"
+#include "neighbourhood.h"
+#include "utilities.h"
+
+namespace itl2
+{
+	namespace internals
+	{
+		/**
+		Tests if percentile filtering of images of given pixel data type can be made using the sliding histogram algorithm.
+		The histogram contains one bin for each possible pixel value, so the algorithm is used for 8- and 16-bit unsigned images only.
+		*/
+		template<typename pixel_t> constexpr bool supportsHistogramPercentileFilter()
+		{
+			return std::is_same_v<pixel_t, uint8_t> || std::is_same_v<pixel_t, uint16_t>;
+		}
+
+		/**
+		Calculates index of the pixel that corresponds to the given percentile in a sorted list of pixel values.
+		@param percentile Percentile in range [0, 1].
+		@param count Count of pixels.
+		*/
+		inline size_t percentileRank(double percentile, size_t count)
+		{
+			if (count <= 0)
+				return 0;
+
+			clamp(percentile, 0.0, 1.0);
+			return (size_t)::round(percentile * (double)(count - 1));
+		}
+
+		/**
+		Calculates percentile filtering using sliding histogram algorithm.
+		A histogram of the pixel values in the neighbourhood is updated incrementally when the neighbourhood moves along the x-axis,
+		similarly to the algorithm in Huang - A fast two-dimensional median filtering algorithm. The neighbourhood is divided into lines in the
+		x-direction, so that each move requires removing and adding one pixel per line. The percentile is found from the histogram by
+		moving the previous percentile value by as many bins as necessary.
+		Generic neighbourhoods are supported as long as they are convex in the x-direction, i.e. each line in the x-direction intersects
+		the neighbourhood in a single run of pixels that is symmetric around the center of the neighbourhood.
+		Column histograms (Perreault - Median filtering in constant time) are not used as they would require one 16-bit histogram per image column
+		and work only for rectangular neighbourhoods.
+		@param percentile Percentile in range [0, 1].
+		*/
+		template<typename pixel_t, typename out_t> void histogramPercentileFilter(const Image<pixel_t>& img, Image<out_t>& out, Vec3c nbRadius, double percentile, NeighbourhoodType nbType, BoundaryCondition bc)
+		{
+			static_assert(supportsHistogramPercentileFilter<pixel_t>(), "Sliding histogram percentile filter supports only 8- and 16-bit unsigned images.");
+
+			out.mustNotBe(img);
+			out.ensureSize(img);
+
+			// Zero radius in those dimensions that are not in use
+			for (size_t n = img.dimensionality(); n < nbRadius.size(); n++)
+				nbRadius[n] = 0;
+
+			Image<uint8_t> mask;
+			createNeighbourhoodMask(nbType, nbRadius, mask);
+
+			// Lines in the x-direction that intersect the neighbourhood, as (radius in x-direction, y offset, z offset).
+			std::vector<Vec3c> lines;
+			size_t count = 0;
+			for (coord_t z = 0; z < mask.depth(); z++)
+			{
+				for (coord_t y = 0; y < mask.height(); y++)
+				{
+					for (coord_t x = 0; x <= nbRadius.x; x++)
+					{
+						if (mask(x, y, z) != 0)
+						{
+							coord_t rx = nbRadius.x - x;
+							lines.push_back(Vec3c(rx, y - nbRadius.y, z - nbRadius.z));
+							count += 2 * rx + 1;
+							break;
+						}
+					}
+				}
+			}
+
+			const coord_t rank = (coord_t)percentileRank(percentile, count);
+			const coord_t w = img.width();
+			const coord_t h = img.height();
+			const coord_t d = img.depth();
+
+			size_t counter = 0;
+			#pragma omp parallel if(!omp_in_parallel() && img.pixelCount() > PARALLELIZATION_THRESHOLD)
+			{
+				std::vector<coord_t> hist((size_t)std::numeric_limits<pixel_t>::max() + 1, 0);
+
+				// Current percentile candidate and count of pixels in the histogram whose value is less than that.
+				coord_t m = 0;
+				coord_t below = 0;
+
+				auto get = [&](coord_t x, coord_t y, coord_t z)
+				{
+					if (x >= 0 && y >= 0 && z >= 0 && x < w && y < h && z < d)
+						return img(x, y, z);
+
+					if (bc == BoundaryCondition::Zero)
+						return pixel_t();
+
+					clamp<coord_t>(x, 0, w - 1);
+					clamp<coord_t>(y, 0, h - 1);
+					clamp<coord_t>(z, 0, d - 1);
+					return img(x, y, z);
+				};
+
+				auto add = [&](pixel_t v)
+				{
+					hist[v]++;
+					if (v < m)
+						below++;
+				};
+
+				auto remove = [&](pixel_t v)
+				{
+					hist[v]--;
+					if (v < m)
+						below--;
+				};
+
+				#pragma omp for
+				for (coord_t z = 0; z < d; z++)
+				{
+					for (coord_t y = 0; y < h; y++)
+					{
+						// Fill histogram for the first pixel of the row.
+						for (const Vec3c& line : lines)
+						{
+							for (coord_t dx = -line.x; dx <= line.x; dx++)
+								add(get(dx, y + line.y, z + line.z));
+						}
+
+						for (coord_t x = 0; x < w; x++)
+						{
+							if (x > 0)
+							{
+								for (const Vec3c& line : lines)
+								{
+									remove(get(x - 1 - line.x, y + line.y, z + line.z));
+									add(get(x + line.x, y + line.y, z + line.z));
+								}
+							}
+
+							// Move the candidate until it contains the pixel whose rank is the required one.
+							while (below > rank)
+							{
+								m--;
+								below -= hist[m];
+							}
+							while (below + hist[m] <= rank)
+							{
+								below += hist[m];
+								m++;
+							}
+
+							out(x, y, z) = pixelRound<out_t>((pixel_t)m);
+						}
+
+						// Empty the histogram for the next row.
+						// The percentile candidate is left to its current value as the next row probably has similar pixel values.
+						for (const Vec3c& line : lines)
+						{
+							for (coord_t dx = -line.x; dx <= line.x; dx++)
+								remove(get(w - 1 + dx, y + line.y, z + line.z));
+						}
+					}
+
+					showThreadProgress(counter, d);
+				}
+			}
+		}
+	}
+}
@@ -431,6 +431,22 @@ namespace itl2
 			return interpolator(defPoints, fx, fy, fz);
 		}
 
+		/*
+		Calculates projectPointToDeformed for points (xStart + i, y, z), where i = 0, 1, ..., count - 1, and stores the results to result[i].
+		@param gridPositions Temporary buffer.
+		*/
+		template<typename real_t> void projectRowToDeformed(coord_t xStart, coord_t y, coord_t z, coord_t count, const PointGrid3D<coord_t>& refPoints, const Image<Vec3<real_t> >& defPoints, const Interpolator<Vec3<real_t>, Vec3<real_t>, real_t>& interpolator, std::vector<Vec3<real_t> >& gridPositions, Vec3<real_t>* result)
+		{
+			real_t fy = (real_t)refPoints.yg.getIndex((real_t)y);
+			real_t fz = (real_t)refPoints.zg.getIndex((real_t)z);
+
+			gridPositions.resize(count);
+			for (coord_t i = 0; i < count; i++)
+				gridPositions[i] = Vec3<real_t>((real_t)refPoints.xg.getIndex((real_t)(xStart + i)), fy, fz);
+
+			interpolator.interpolateRow(defPoints, gridPositions.data(), count, result);
+		}
+
 		/*
 		Converts refGrid+defPoints to refGrid+shifts.
 		*/
@@ -505,17 +521,20 @@ namespace itl2
 		#pragma omp parallel for if(pullback.pixelCount() > PARALLELIZATION_THRESHOLD && !omp_in_parallel())
 		for (coord_t z = 0; z < pullback.depth(); z++)
 		{
+			std::vector<Vec3d> gridPositions;
+			std::vector<Vec3d> xDef(pullback.width());
+
 			for (coord_t y = 0; y < pullback.height(); y++)
 			{
+				internals::projectRowToDeformed(0, y, z, pullback.width(), refGrid, shifts, shiftInterpolator, gridPositions, xDef.data());
+
 				for (coord_t x = 0; x < pullback.width(); x++)
 				{
 					Vec3d xRef((double)x, (double)y, (double)z);
-					Vec3d shift = internals::projectPointToDeformed(xRef, refGrid, shifts, shiftInterpolator);
-					
-					Vec3d xDef = xRef + shift;
-					result_t val = interpolator(deformed, xDef);
-					pullback(x, y, z) = val;
+					xDef[x] = xRef + xDef[x];
 				}
+
+				interpolator.interpolateRow(deformed, xDef.data(), pullback.width(), &pullback(0, y, z));
 			}
 
 			showThreadProgress(counter, pullback.depth());
@@ -6,6 +6,10 @@
 #include "io/raw.h"
 #include "pointprocess.h"
 #include "projections.h"
+#include "noise.h"
+#include "filters.h"
+#include "timer.h"
+#include "testutils.h"
 
 namespace itl2
 {
@@ -68,6 +72,90 @@ namespace itl2
 			raw::writed(head, "./skeleton/head_line_skeleton");
 		}
 
+		/**
+		Creates test geometry for skeletonization: smooth random structure that contains both plates and rods.
+		*/
+		void skeletonTestGeometry(Image<uint8_t>& geom)
+		{
+			Image<float32_t> tmp(80, 70, 60);
+			noise(tmp, 0, 1, 1);
+			Image<float32_t> smooth;
+			gaussFilter(tmp, smooth, 2.0);
+			geom.ensureSize(tmp);
+			for (coord_t n = 0; n < smooth.pixelCount(); n++)
+				geom(n) = smooth(n) > 0.02f ? 255 : 0;
+		}
+
+		void surfaceSkeletonBorderPoints(const Image<uint8_t>& geom, bool retainSurfaces, const string& name)
+		{
+			Timer timer;
+
+			// Reference: repeat full-image thinning iterations.
+			Image<uint8_t> reference;
+			setValue(reference, geom);
+			timer.start();
+			while (thin(reference, retainSurfaces) > 0)
+				;
+			timer.stop();
+			std::cout << "Surface skeleton of " << name << " (retain surfaces = " << retainSurfaces << ") with full image scans takes " << timer.getSeconds() << " s" << std::endl;
+
+			Image<uint8_t> result;
+			setValue(result, geom);
+			timer.start();
+			surfaceSkeleton(result, retainSurfaces);
+			timer.stop();
+			std::cout << "Surface skeleton of " << name << " (retain surfaces = " << retainSurfaces << ") with border point list takes " << timer.getSeconds() << " s" << std::endl;
+
+			testAssert(equals(reference, result), "surface skeleton with border point list, " + name + ", retain surfaces = " + toString(retainSurfaces));
+		}
+
+		void surfaceSkeletonBorderPoints()
+		{
+			Image<uint8_t> geom;
+			skeletonTestGeometry(geom);
+			surfaceSkeletonBorderPoints(geom, true, "random geometry");
+			surfaceSkeletonBorderPoints(geom, false, "random geometry");
+
+			Image<uint8_t> head;
+			raw::read(head, "./input_data/t1-head_bin_256x256x129.raw");
+			surfaceSkeletonBorderPoints(head, true, "head");
+			surfaceSkeletonBorderPoints(head, false, "head");
+		}
+
+		void lineSkeletonBorderPoints(const Image<uint8_t>& geom, const string& name)
+		{
+			Timer timer;
+
+			// Reference: repeat full-image thinning iterations.
+			Image<uint8_t> reference;
+			setValue(reference, geom);
+			timer.start();
+			while (lineThin(reference) > 0)
+				;
+			timer.stop();
+			std::cout << "Line skeleton of " << name << " with full image scans takes " << timer.getSeconds() << " s" << std::endl;
+
+			Image<uint8_t> result;
+			setValue(result, geom);
+			timer.start();
+			lineSkeleton(result);
+			timer.stop();
+			std::cout << "Line skeleton of " << name << " with border point list takes " << timer.getSeconds() << " s" << std::endl;
+
+			testAssert(equals(reference, result), "line skeleton with border point list, " + name);
+		}
+
+		void lineSkeletonBorderPoints()
+		{
+			Image<uint8_t> geom;
+			skeletonTestGeometry(geom);
+			lineSkeletonBorderPoints(geom, "random geometry");
+
+			Image<uint8_t> head;
+			raw::read(head, "./input_data/t1-head_bin_256x256x129.raw");
+			lineSkeletonBorderPoints(head, "head");
+		}
+
 		//void cavities()
 		//{
 		//	Image<uint8_t> head;
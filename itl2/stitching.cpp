@@ -1,5 +1,6 @@
 
 #include "stitching.h"
+#include "testutils.h"
 #include <cmath>
 
 namespace itl2
@@ -113,5 +114,87 @@ namespace itl2
 			//raw::writed(output, "./elastic_stitching/test_output");
 
 		}
+
+		void stitchBlockwise()
+		{
+			// Create source image and a deformation that shifts it by a few pixels.
+			Image<uint16_t> src(80, 70, 60);
+			for (coord_t z = 0; z < src.depth(); z++)
+			{
+				for (coord_t y = 0; y < src.height(); y++)
+				{
+					for (coord_t x = 0; x < src.width(); x++)
+					{
+						src(x, y, z) = pixelRound<uint16_t>(1000 + 500 * std::sin(0.3 * x) * std::cos(0.2 * y) + 7 * z);
+					}
+				}
+			}
+			string srcFile = raw::writed(src, "./stitching/blockwise_src");
+
+			PointGrid3D<coord_t> refPoints(PointGrid1D<coord_t>(0, 80, 10), PointGrid1D<coord_t>(0, 70, 10), PointGrid1D<coord_t>(0, 60, 10));
+			Image<Vec3<float32_t> > shifts(refPoints.pointCounts());
+			for (coord_t z = 0; z < shifts.depth(); z++)
+			{
+				for (coord_t y = 0; y < shifts.height(); y++)
+				{
+					for (coord_t x = 0; x < shifts.width(); x++)
+					{
+						shifts(x, y, z) = Vec3<float32_t>((float32_t)(3 * std::sin(0.7 * x + z)), (float32_t)(2 * std::cos(0.5 * y)), (float32_t)(-1.5 + 0.2 * x));
+					}
+				}
+			}
+
+			string wlPrefix = "./stitching/blockwise_wl";
+			{
+				std::ofstream out(wlPrefix + "_refpoints.txt");
+				out << refPoints.xg.first << ", " << refPoints.xg.maximum << ", " << refPoints.xg.step << std::endl;
+				out << refPoints.yg.first << ", " << refPoints.yg.maximum << ", " << refPoints.yg.step << std::endl;
+				out << refPoints.zg.first << ", " << refPoints.zg.maximum << ", " << refPoints.zg.step << std::endl;
+				out << 0 << std::endl;
+				out << 1 << std::endl;
+				out << 0 << std::endl;
+			}
+			raw::write(shifts, wlPrefix + "_shifts_" + toString(shifts.width()) + "x" + toString(shifts.height()) + "x" + toString(shifts.depth()) + ".raw");
+
+			string indexFile = "./stitching/blockwise_index.txt";
+			{
+				std::ofstream out(indexFile);
+				out << srcFile << std::endl;
+				out << wlPrefix << std::endl;
+			}
+
+			Vec3c outPos(12, -5, 20);
+			Vec3c outSize(50, 40, 30);
+
+			// Reference: transform the whole source image.
+			Image<float32_t> mean(outSize);
+			Image<float32_t> weight(outSize);
+			internals::stitchOneVer3<uint16_t, float32_t>(src, Vec3c(0, 0, 0), src.dimensions(), refPoints, shifts, 0, 1, 0, outPos, outPos + outSize, outPos, mean, weight, nullptr, false);
+			Image<uint16_t> expected;
+			convert(mean, expected);
+
+			// The source block must be smaller than the source image.
+			Vec3c blockStart, blockEnd;
+			internals::sourceBlockBounds(refPoints, shifts, outPos, outPos + outSize, src.dimensions(), blockStart, blockEnd);
+			testAssert(blockStart.x > 0 && blockStart.z > 0 && blockEnd.x < src.width() && blockEnd.y < src.height(), "source block is smaller than source image");
+
+			// Read one block, and read many small blocks.
+			Image<uint16_t> oneBlock(outSize);
+			stitchVer3<uint16_t>(indexFile, outPos, outSize, oneBlock, nullptr, false, 1024 * 1024 * 1024);
+			checkDifference(oneBlock, expected, "stitching with one source block");
+
+			Image<uint16_t> manyBlocks(outSize);
+			stitchVer3<uint16_t>(indexFile, outPos, outSize, manyBlocks, nullptr, false, 20 * 20 * 20 * sizeof(uint16_t));
+			checkDifference(manyBlocks, expected, "stitching with many source blocks");
+
+			// A budget smaller than the margins of the blocks must not cause the region to be divided down to single pixels.
+			Image<float32_t> tinyMean(outSize);
+			Image<float32_t> tinyWeight(outSize);
+			size_t blockCount = internals::stitchRegionVer3<uint16_t, float32_t>(srcFile, src.dimensions(), refPoints, shifts, 0, 1, 0, outPos, outPos + outSize, outPos, tinyMean, tinyWeight, nullptr, false, 1);
+			Image<uint16_t> tinyBlocks;
+			convert(tinyMean, tinyBlocks);
+			checkDifference(tinyBlocks, expected, "stitching with tiny source block budget");
+			testAssert(blockCount > 1 && blockCount < 200, "count of source blocks with tiny budget");
+		}
 	}
 }
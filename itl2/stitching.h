@@ -881,16 +881,21 @@ namespace itl2
 
 		/*
 		Stitch src image and the corresponding transformation to output image, and update weight image.
-		This function only processes region starting at outPos and having the size of output image.
+		This function only processes region starting at outPos and having the size of output image, and within that,
+		only the region [regionStart, regionEnd[ given in the coordinates of the stitched image.
 		This version can also calculate standard deviation of overlapping images in the overlapping regions.
 		After calling the method for all input images:
 		- image mean does not need further processing.
 		- image S must be divided by image weight and to get standard deviation, sqrt must be taken.
+		@param src Block of the source image. The block must contain all the source pixels needed to process the region, see sourceBlockBounds.
+		@param srcBlockPos Position of the block in the source image.
+		@param srcDimensions Dimensions of the whole source image.
 		*/
 		template<typename pixel_t, typename real_t> void stitchOneVer3(
-			const Image<pixel_t>& src,
+			const Image<pixel_t>& src, const Vec3c& srcBlockPos, const Vec3c& srcDimensions,
 			const PointGrid3D<coord_t>& refPoints, const Image<Vec3<real_t> >& shifts,
 			real_t normFactor, real_t normFactorStd, real_t meanDef,
+			const Vec3c& regionStart, const Vec3c& regionEnd,
 			const Vec3c& outPos, Image<real_t>& mean, Image<real_t>& weight, Image<real_t>* S,
 			bool normalize)
 		{
@@ -921,38 +926,68 @@ namespace itl2
 			ymax = std::min(ymax, outPos.y + mean.height());
 			zmax = std::min(zmax, outPos.z + mean.depth());
 
-			Vec3c srcDimensions = src.dimensions();
 			coord_t s = srcDimensions.min();
+			size_t srcDimensionality = getDimensionality(srcDimensions);
 
-			if (src.dimensionality() < 3)
+			if (srcDimensionality < 3)
 			{
 				zmin = 0;
 				zmax = 1;
 			}
 
+			xmin = std::max(xmin, regionStart.x);
+			ymin = std::max(ymin, regionStart.y);
+			zmin = std::max(zmin, regionStart.z);
+
+			xmax = std::min(xmax, regionEnd.x);
+			ymax = std::min(ymax, regionEnd.y);
+			zmax = std::min(zmax, regionEnd.z);
+
+			auto isInSource = [&](const Vec3<real_t>& p)
+			{
+				return p.x >= 0 && p.y >= 0 && p.z >= 0 && (coord_t)p.x < srcDimensions.x && (coord_t)p.y < srcDimensions.y && (coord_t)p.z < srcDimensions.z;
+			};
+
 			std::cout << "Transforming..." << std::endl;
 			// Process all pixels in the relevant region of the target image and find source image value at each location.
 			size_t counter = 0;
 #pragma omp parallel for if((zmax-zmin)*(ymax-ymin)*(xmax-xmin) > PARALLELIZATION_THRESHOLD && !omp_in_parallel())
 			for (coord_t z = zmin; z < zmax; z++)
 			{
+				coord_t rowLength = std::max<coord_t>(xmax - xmin, 0);
+				std::vector<Vec3<real_t> > gridPositions;
+				std::vector<Vec3<real_t> > pRow(rowLength);
+				std::vector<Vec3<real_t> > pdotRow(rowLength);
+				std::vector<real_t> pixels(rowLength);
+
 				for (coord_t y = ymin; y < ymax; y++)
 				{
-					for (coord_t x = xmin; x < xmax; x++)
-					{
-						// X is position in the output image
-						Vec3<real_t> X((real_t)x, (real_t)y, (real_t)z);
+					// Convert X = (x, y, z), position in the output image, to p, position in the input image.
+					internals::projectRowToDeformed(xmin, y, z, rowLength, refPoints, shifts, shiftInterpolator, gridPositions, pRow.data());
 
-						// Convert X to p, position in the input image.
-						Vec3<real_t> p = X + internals::projectPointToDeformed(X, refPoints, shifts, shiftInterpolator);
+					for (coord_t i = 0; i < rowLength; i++)
+					{
+						Vec3<real_t> X((real_t)(xmin + i), (real_t)y, (real_t)z);
+						pRow[i] = X + pRow[i];
 
 						// Convert p to pdot, position in the input block.
-						//Vec3<real_t> pdot = p - Vec3<real_t>(srcBlockPos);
-						Vec3<real_t> pdot = p; // No src block support
+						// The subtraction is exact, so the interpolated value does not depend on the block position.
+						// Positions outside of the source image are not used, so they are replaced by a dummy position.
+						if (isInSource(pRow[i]))
+							pdotRow[i] = pRow[i] - Vec3<real_t>(srcBlockPos);
+						else
+							pdotRow[i] = Vec3<real_t>(0, 0, 0);
+					}
+
+					interpolator.interpolateRow(src, pdotRow.data(), rowLength, pixels.data());
+
+					for (coord_t x = xmin; x < xmax; x++)
+					{
+						const Vec3<real_t>& p = pRow[x - xmin];
 
-						if (src.isInImage(pdot))
+						if (isInSource(p))
 						{
-							real_t pix = interpolator(src, pdot);
+							real_t pix = pixels[x - xmin];
 							if (pix != 0) // Don't process pixels that could not be interpolated (are given background value)
 							{
 								if (normalize)
@@ -963,7 +998,7 @@ namespace itl2
 								real_t w2 = 2 * std::min(p.y, srcDimensions.y - 1 - p.y) / s;
 								real_t w3 = 2 * std::min(p.z, srcDimensions.z - 1 - p.z) / s;
 
-								if (src.dimensionality() < 3)
+								if (srcDimensionality < 3)
 									w3 = 1;
 
 								real_t ww = w1 * w2 * w3;
@@ -1002,6 +1037,158 @@ namespace itl2
 				showThreadProgress(counter, zmax - zmin);
 			}
 		}
+
+		/*
+		Calculates bounding box [blockStart, blockEnd[ of the source image pixels that stitchOneVer3 needs
+		in order to process region [regionStart, regionEnd[ of the stitched image.
+		The box is clamped to the source image, and it is empty if no source pixels are needed.
+		*/
+		template<typename real_t> void sourceBlockBounds(const PointGrid3D<coord_t>& refPoints, const Image<Vec3<real_t> >& shifts,
+			const Vec3c& regionStart, const Vec3c& regionEnd, const Vec3c& srcDimensions,
+			Vec3c& blockStart, Vec3c& blockEnd)
+		{
+			blockStart = Vec3c(0, 0, 0);
+			blockEnd = Vec3c(0, 0, 0);
+
+			// Find the grid points whose shifts are used when interpolating the shifts in the region.
+			// The indices are padded by one extra point to account for rounding errors.
+			const PointGrid1D<coord_t>* grids[] = { &refPoints.xg, &refPoints.yg, &refPoints.zg };
+			Vec3c gridStart, gridEnd;
+			for (size_t i = 0; i < 3; i++)
+			{
+				if (regionEnd[i] <= regionStart[i] || shifts.dimensions()[i] <= 0)
+					return;
+
+				coord_t first = 0;
+				coord_t last = shifts.dimensions()[i] - 1;
+				if (grids[i]->step > 0)
+				{
+					first = (coord_t)::floor(grids[i]->getIndex((double)regionStart[i])) - 2;
+					last = (coord_t)::floor(grids[i]->getIndex((double)(regionEnd[i] - 1))) + 3;
+					clamp<coord_t>(first, 0, shifts.dimensions()[i] - 1);
+					clamp<coord_t>(last, 0, shifts.dimensions()[i] - 1);
+				}
+				gridStart[i] = first;
+				gridEnd[i] = last + 1;
+			}
+
+			// Find range of the shifts in those points. NaN shifts are skipped as they map the points outside of the source image.
+			Vec3<real_t> minShift(std::numeric_limits<real_t>::infinity(), std::numeric_limits<real_t>::infinity(), std::numeric_limits<real_t>::infinity());
+			Vec3<real_t> maxShift = -minShift;
+			for (coord_t z = gridStart.z; z < gridEnd.z; z++)
+			{
+				for (coord_t y = gridStart.y; y < gridEnd.y; y++)
+				{
+					for (coord_t x = gridStart.x; x < gridEnd.x; x++)
+					{
+						const Vec3<real_t>& shift = shifts(x, y, z);
+						for (size_t i = 0; i < 3; i++)
+						{
+							if (shift[i] < minShift[i])
+								minShift[i] = shift[i];
+							if (shift[i] > maxShift[i])
+								maxShift[i] = shift[i];
+						}
+					}
+				}
+			}
+
+			Vec3c start, end;
+			for (size_t i = 0; i < 3; i++)
+			{
+				if (!(minShift[i] <= maxShift[i]))
+					return;
+
+				// Cubic interpolation of the shifts may overshoot their range, but the sum of absolute values of the
+				// interpolation weights is less than 3, so the overshoot is smaller than the range.
+				double range = (double)maxShift[i] - (double)minShift[i];
+				double pmin = regionStart[i] + (double)minShift[i] - range;
+				double pmax = regionEnd[i] - 1 + (double)maxShift[i] + range;
+				clamp<double>(pmin, -1.0, (double)srcDimensions[i]);
+				clamp<double>(pmax, -1.0, (double)srcDimensions[i]);
+
+				// Add margin for rounding errors and for the 4x4x4 neighbourhood used in the cubic interpolation of the source image.
+				start[i] = (coord_t)::floor(pmin) - 2;
+				end[i] = (coord_t)::floor(pmax) + 4;
+				clamp<coord_t>(start[i], 0, srcDimensions[i]);
+				clamp<coord_t>(end[i], 0, srcDimensions[i]);
+
+				if (end[i] <= start[i])
+					return;
+			}
+
+			blockStart = start;
+			blockEnd = end;
+		}
+
+		/*
+		Calculates size of the block of the source image that is needed to process region [regionStart, regionEnd[ of the stitched image, in bytes.
+		*/
+		template<typename pixel_t, typename real_t> size_t sourceBlockBytes(const PointGrid3D<coord_t>& refPoints, const Image<Vec3<real_t> >& shifts, const Vec3c& regionStart, const Vec3c& regionEnd, const Vec3c& srcDimensions)
+		{
+			Vec3c blockStart, blockEnd;
+			sourceBlockBounds(refPoints, shifts, regionStart, regionEnd, srcDimensions, blockStart, blockEnd);
+			Vec3c blockSize = blockEnd - blockStart;
+			if (blockSize.min() <= 0)
+				return 0;
+			return (size_t)blockSize.x * (size_t)blockSize.y * (size_t)blockSize.z * sizeof(pixel_t);
+		}
+
+		/*
+		Stitches region [regionStart, regionEnd[ of the stitched image from the given source image file,
+		see stitchOneVer3.
+		Reads only the block of the source image that is needed to process the region.
+		If the block would be larger than maxSourceBytes, the region is divided into smaller regions that are processed separately.
+		Division stops when it does not make the source blocks considerably smaller, as the blocks contain a margin
+		for the shifts and the interpolation that does not depend on the size of the region. The block is then read even if it is larger than maxSourceBytes.
+		@return Count of source image blocks read.
+		*/
+		template<typename pixel_t, typename real_t> size_t stitchRegionVer3(
+			const std::string& imgFile, const Vec3c& srcDimensions,
+			const PointGrid3D<coord_t>& refPoints, const Image<Vec3<real_t> >& shifts,
+			real_t normFactor, real_t normFactorStd, real_t meanDef,
+			const Vec3c& regionStart, const Vec3c& regionEnd,
+			const Vec3c& outPos, Image<real_t>& mean, Image<real_t>& weight, Image<real_t>* S,
+			bool normalize, size_t maxSourceBytes)
+		{
+			Vec3c blockStart, blockEnd;
+			sourceBlockBounds(refPoints, shifts, regionStart, regionEnd, srcDimensions, blockStart, blockEnd);
+			Vec3c blockSize = blockEnd - blockStart;
+			if (blockSize.min() <= 0)
+				return 0;
+
+			Vec3c regionSize = regionEnd - regionStart;
+			size_t blockBytes = (size_t)blockSize.x * (size_t)blockSize.y * (size_t)blockSize.z * sizeof(pixel_t);
+			if (blockBytes > maxSourceBytes && regionSize.max() > 1)
+			{
+				// Divide the region in two along its longest dimension.
+				size_t dim = 2;
+				if (regionSize.x >= regionSize.y && regionSize.x >= regionSize.z)
+					dim = 0;
+				else if (regionSize.y >= regionSize.z)
+					dim = 1;
+
+				Vec3c middleEnd = regionEnd;
+				middleEnd[dim] = regionStart[dim] + regionSize[dim] / 2;
+				Vec3c middleStart = regionStart;
+				middleStart[dim] = middleEnd[dim];
+
+				// Divide only if the source blocks of the halves are clearly smaller than the current block.
+				size_t halfBytes = std::max(sourceBlockBytes<pixel_t, real_t>(refPoints, shifts, regionStart, middleEnd, srcDimensions),
+											sourceBlockBytes<pixel_t, real_t>(refPoints, shifts, middleStart, regionEnd, srcDimensions));
+				if (halfBytes <= blockBytes / 4 * 3)
+				{
+					return stitchRegionVer3<pixel_t, real_t>(imgFile, srcDimensions, refPoints, shifts, normFactor, normFactorStd, meanDef, regionStart, middleEnd, outPos, mean, weight, S, normalize, maxSourceBytes) +
+						stitchRegionVer3<pixel_t, real_t>(imgFile, srcDimensions, refPoints, shifts, normFactor, normFactorStd, meanDef, middleStart, regionEnd, outPos, mean, weight, S, normalize, maxSourceBytes);
+				}
+			}
+
+			std::cout << "Reading source image block " << blockStart << " - " << blockEnd << "..." << std::endl;
+			Image<pixel_t> src(blockSize);
+			io::readBlock(src, imgFile, blockStart);
+			stitchOneVer3<pixel_t, real_t>(src, blockStart, srcDimensions, refPoints, shifts, normFactor, normFactorStd, meanDef, regionStart, regionEnd, outPos, mean, weight, S, normalize);
+			return 1;
+		}
 	}
 
 
@@ -1114,8 +1301,16 @@ namespace itl2
 	//	convert(out, output);
 	//}
 
-	template<typename pixel_t> void stitchVer3(const string& indexFile, const Vec3c& outputPos, const Vec3c& outputSize, Image<pixel_t>& output, Image<pixel_t>* std, bool normalize)
+	/*
+	Stitches region [outputPos, outputPos + outputSize[ of the stitched image from the images listed in the given index file.
+	Only the parts of the source images that map to the output region are read.
+	@param std If not nullptr, standard deviation of the overlapping images is stored to this image.
+	@param maxSourceBlockBytes Maximum size of source image block that is read into memory at once. Pass zero to use one fourth of the system RAM.
+	*/
+	template<typename pixel_t> void stitchVer3(const string& indexFile, const Vec3c& outputPos, const Vec3c& outputSize, Image<pixel_t>& output, Image<pixel_t>* std, bool normalize, size_t maxSourceBlockBytes = 0)
 	{
+		if (maxSourceBlockBytes <= 0)
+			maxSourceBlockBytes = memorySize() / 4;
 
 		// Read index file
 		std::cout << "Reading index file..." << std::endl;
@@ -1166,39 +1361,19 @@ namespace itl2
 
 			if (internals::overlapsWithOutput(cc, cd, outputPos, outputSize))
 			{
-
-				//// If source image is big, load it in blocks.
-				//// Python script assumes 116 GB blocks for output (2 x float32_t), so we use 80 GB blocks (1 x uint16_t) for input.
-				//Vec3c srcBlockSize(3500, 3500, 3500);
-				//for (coord_t z = 0; z < srcDimensions.z; z += srcBlockSize.z)
-				//{
-				//	for (coord_t y = 0; y < srcDimensions.y; y += srcBlockSize.y)
-				//	{
-				//		for (coord_t x = 0; x < srcDimensions.x; x += srcBlockSize.x)
-				//		{
-				//			std::cout << "Processing source image block (" << x << ", " << y << ", " << z << ")..." << std::endl;
-
-				//			// Take extra pixel layer so that interpolation succeeds at (x, y, z)
-				//			Vec3c srcBlockPos = Vec3c(x, y, z) - Vec3c(1, 1, 1);
-				//			Vec3c srcBlockEnd = srcBlockPos + srcBlockSize + 2 * Vec3c(1, 1, 1);
-
-				//			clamp(srcBlockPos, Vec3c(0, 0, 0), srcDimensions);
-				//			clamp(srcBlockEnd, Vec3c(0, 0, 0), srcDimensions);
-
-				//			Image<pixel_t> srcBlock(srcBlockEnd - srcBlockPos);
-				//			raw::readBlock(srcBlock, imgFile, srcDimensions, srcBlockPos);
-
-				//			internals::stitchOne<pixel_t, float32_t, float32_t>(srcBlockPos, srcDimensions, srcBlock, transformation, outputPos, out, weight, normalize, cc, cd, true);
-				//		}
-				//	}
-				//}
-
 				Image<Vec3<float32_t> > shifts;
 				internals::readShifts(wlPrefix, refPoints, shifts);
 
-				Image<pixel_t> src(srcDimensions);
-				io::read(src, imgFile);
-				internals::stitchOneVer3<pixel_t, float32_t>(src, refPoints, shifts, normFact, normFactStd, meanDef, outputPos, out, weight, std ? &stdtmp : nullptr, normalize);
+				// Region of the output that this source image may contribute to.
+				Vec3c regionStart(std::max(cc.x, outputPos.x), std::max(cc.y, outputPos.y), std::max(cc.z, outputPos.z));
+				Vec3c regionEnd(std::min(cd.x, outputPos.x + outputSize.x), std::min(cd.y, outputPos.y + outputSize.y), std::min(cd.z, outputPos.z + outputSize.z));
+				if (getDimensionality(srcDimensions) < 3)
+				{
+					regionStart.z = 0;
+					regionEnd.z = 1;
+				}
+
+				internals::stitchRegionVer3<pixel_t, float32_t>(imgFile, srcDimensions, refPoints, shifts, normFact, normFactStd, meanDef, regionStart, regionEnd, outputPos, out, weight, std ? &stdtmp : nullptr, normalize, maxSourceBlockBytes);
 			}
 		}
 
@@ -1222,4 +1397,9 @@ namespace itl2
 			convert(stdtmp, *std);
 		}
 	}
+
+	namespace tests
+	{
+		void stitchBlockwise();
+	}
 }
@@ -4,6 +4,7 @@
 #include "neighbourhood.h"
 #include "utilities.h"
 #include "minhash.h"
+#include "thinninglut.h"
 #include "math/vec3.h"
 
 #include <algorithm>
@@ -948,6 +949,76 @@ namespace itl2
 				isSurfaceCubeCached(nb, Vec3c(0, 1, 1)) &&
 				isSurfaceCubeCached(nb, Vec3c(1, 1, 1));
 		}
+
+		/**
+		Tests if the given foreground point has at least one background 6-neighbour inside the image,
+		i.e. if it is a border point in any of the six directions.
+		*/
+		template<typename pixel_t> bool hasBackground6Neighbour(const Image<pixel_t>& img, const Vec3c& p)
+		{
+			return N(img, p.x, p.y, p.z) || S(img, p.x, p.y, p.z) ||
+				E(img, p.x, p.y, p.z) || W(img, p.x, p.y, p.z) ||
+				U(img, p.x, p.y, p.z) || B(img, p.x, p.y, p.z);
+		}
+
+		/**
+		Finds all foreground points that have a background 6-neighbour.
+		Only these points can be removed in a thinning sub-iteration.
+		@param borderPoints The points are placed here.
+		*/
+		template<typename pixel_t> void findBorderPoints(const Image<pixel_t>& img, std::vector<Vec3c>& borderPoints)
+		{
+			borderPoints.clear();
+
+			#pragma omp parallel
+			{
+				std::vector<Vec3c> privatePoints;
+
+				#pragma omp for nowait
+				for (coord_t z = 0; z < img.depth(); z++)
+				{
+					for (coord_t y = 0; y < img.height(); y++)
+					{
+						for (coord_t x = 0; x < img.width(); x++)
+						{
+							Vec3c p(x, y, z);
+							if (img(p) != (pixel_t)0 && hasBackground6Neighbour(img, p))
+								privatePoints.push_back(p);
+						}
+					}
+				}
+
+				#pragma omp critical(findborderpoints_insert)
+				borderPoints.insert(borderPoints.end(), privatePoints.begin(), privatePoints.end());
+			}
+		}
+
+		/**
+		Finds foreground 6-neighbours of p that become border points when p is set to background, and adds them to the given list.
+		Call this function before setting p to background.
+		As thinning only removes points, each point becomes a border point only once.
+		*/
+		template<typename pixel_t> void findNewBorderPoints(const Image<pixel_t>& img, const Vec3c& p, std::vector<Vec3c>& newBorderPoints)
+		{
+			const Vec3c offsets[] = { Vec3c(-1, 0, 0), Vec3c(1, 0, 0), Vec3c(0, -1, 0), Vec3c(0, 1, 0), Vec3c(0, 0, -1), Vec3c(0, 0, 1) };
+			for (const Vec3c& offset : offsets)
+			{
+				Vec3c q = p + offset;
+				if (img.isInImage(q) && img(q) != (pixel_t)0 && !hasBackground6Neighbour(img, q))
+					newBorderPoints.push_back(q);
+			}
+		}
+
+		/**
+		Updates list of border points after points have been set to background.
+		@param borderPoints List of border points before removal of the points.
+		@param newBorderPoints Points found by findNewBorderPoints for each removed point.
+		*/
+		template<typename pixel_t> void updateBorderPoints(const Image<pixel_t>& img, std::vector<Vec3c>& borderPoints, const std::vector<Vec3c>& newBorderPoints)
+		{
+			borderPoints.erase(std::remove_if(borderPoints.begin(), borderPoints.end(), [&](const Vec3c& p) { return img(p) == (pixel_t)0; }), borderPoints.end());
+			borderPoints.insert(borderPoints.end(), newBorderPoints.begin(), newBorderPoints.end());
+		}
 	}
 
 
@@ -960,6 +1031,8 @@ namespace itl2
 	template<typename pixel_t> size_t thin(Image<pixel_t>& img, bool retainSurfaces)
 	{
 		internals::createAllowedHashList();
+		internals::NeighbourhoodTest& isSimple = internals::simplePointHybridTest();
+		internals::NeighbourhoodTest& isEulerInvariant = internals::eulerInvariantTest();
 
 		size_t changed = 0;
 		size_t counter = 0;
@@ -969,12 +1042,11 @@ namespace itl2
 		for (int currentBorder = 1; currentBorder <= 6; currentBorder++)
 		{
 			pointsToRemove.clear();
+			size_t tests = 0;
 
 			#pragma omp parallel
 			{
-				Image<uint8_t> nbPrivate(3, 3, 3);
-
-				#pragma omp for
+				#pragma omp for reduction(+ : tests)
 				for (coord_t z = 0; z < img.depth(); z++)
 				{
 					for (coord_t y = 0; y < img.height(); y++)
@@ -999,11 +1071,12 @@ namespace itl2
 
 								if (isBorderPoint)
 								{
-									getNeighbourhood(img, Vec3c(x, y, z), Vec3c(1, 1, 1), nbPrivate, BoundaryCondition::Zero);
+									uint32_t nb = internals::neighbourhoodBits(img, Vec3c(x, y, z));
+									tests++;
 
-									if (!internals::isEndPoint(nbPrivate) &&
-										internals::isEulerInvariant(nbPrivate) &&
-										internals::isSimplePointHybrid(nbPrivate))
+									if (!internals::isEndPoint(nb) &&
+										isEulerInvariant(nb) &&
+										isSimple(nb))
 									{
 										#pragma omp critical(surfacethin_insert)
 											pointsToRemove.push_back(Vec3c(x, y, z));
@@ -1022,16 +1095,17 @@ namespace itl2
 			// Otherwise, the point removal order may change the skeleton points.
 			std::sort(pointsToRemove.begin(), pointsToRemove.end(), vecComparer<coord_t>);
 
+			isEulerInvariant.addEvaluations(tests);
+			isSimple.addEvaluations(tests + pointsToRemove.size());
+
 			// Re-check while removing points so that connectivity is preserved.
-			Image<uint8_t> nb(3, 3, 3);
 			for (size_t n = 0; n < pointsToRemove.size(); n++)
 			{
 				Vec3c p = pointsToRemove[n];
 
-				getNeighbourhood(img, p, Vec3c(1, 1, 1), nb, BoundaryCondition::Zero);
-				//nb(1, 1, 1) = 0; // This must not be done. Function isSimplePointHybrid does not consider the center pixel, but it is needed for isSurfacePoint.
+				uint32_t nb = internals::neighbourhoodBits(img, p);
 
-				if (internals::isSimplePointHybrid(nb) &&
+				if (isSimple(nb) &&
 					((retainSurfaces && !internals::isSurfacePoint(nb)) || !retainSurfaces)
 					)
 				{
@@ -1044,6 +1118,98 @@ namespace itl2
 		return changed;
 	}
 
+	/*
+	Performs one thinning iteration and returns count of pixels removed from the image.
+	Gives the same result than thin(img, retainSurfaces), but tests only the given border points instead of scanning the whole image.
+	@param retainSurfaces If true, surfaces are not thinned to lines.
+	@param img Image that should be thinned.
+	@param borderPoints List of border points of img, initialized with internals::findBorderPoints. The list is updated to correspond to the thinned image.
+	*/
+	template<typename pixel_t> size_t thin(Image<pixel_t>& img, bool retainSurfaces, std::vector<Vec3c>& borderPoints)
+	{
+		internals::createAllowedHashList();
+		internals::NeighbourhoodTest& isSimple = internals::simplePointHybridTest();
+		internals::NeighbourhoodTest& isEulerInvariant = internals::eulerInvariantTest();
+
+		size_t changed = 0;
+		std::vector<Vec3c> pointsToRemove;
+		std::vector<Vec3c> newBorderPoints;
+
+		for (int currentBorder = 1; currentBorder <= 6; currentBorder++)
+		{
+			pointsToRemove.clear();
+			size_t tests = 0;
+
+			#pragma omp parallel
+			{
+				std::vector<Vec3c> privatePoints;
+
+				#pragma omp for nowait reduction(+ : tests)
+				for (coord_t n = 0; n < (coord_t)borderPoints.size(); n++)
+				{
+					const Vec3c& p = borderPoints[n];
+
+					bool isBorderPoint = false;
+					switch (currentBorder)
+					{
+					case 1: isBorderPoint = internals::N(img, p.x, p.y, p.z); break;
+					case 2: isBorderPoint = internals::S(img, p.x, p.y, p.z); break;
+					case 3: isBorderPoint = internals::E(img, p.x, p.y, p.z); break;
+					case 4: isBorderPoint = internals::W(img, p.x, p.y, p.z); break;
+					case 5: isBorderPoint = internals::U(img, p.x, p.y, p.z); break;
+					case 6: isBorderPoint = internals::B(img, p.x, p.y, p.z); break;
+					}
+
+					if (isBorderPoint)
+					{
+						uint32_t nb = internals::neighbourhoodBits(img, p);
+						tests++;
+
+						if (!internals::isEndPoint(nb) &&
+							isEulerInvariant(nb) &&
+							isSimple(nb))
+						{
+							privatePoints.push_back(p);
+						}
+					}
+				}
+
+				#pragma omp critical(surfacethin_insert)
+				pointsToRemove.insert(pointsToRemove.end(), privatePoints.begin(), privatePoints.end());
+			}
+
+			// The points must be processed in the same order than in thin(img, retainSurfaces).
+			std::sort(pointsToRemove.begin(), pointsToRemove.end(), vecComparer<coord_t>);
+
+			isEulerInvariant.addEvaluations(tests);
+			isSimple.addEvaluations(tests + pointsToRemove.size());
+
+			// Re-check while removing points so that connectivity is preserved.
+			size_t changedBefore = changed;
+			newBorderPoints.clear();
+			for (size_t n = 0; n < pointsToRemove.size(); n++)
+			{
+				Vec3c p = pointsToRemove[n];
+
+				uint32_t nb = internals::neighbourhoodBits(img, p);
+
+				if (isSimple(nb) &&
+					((retainSurfaces && !internals::isSurfacePoint(nb)) || !retainSurfaces)
+					)
+				{
+					internals::findNewBorderPoints(img, p, newBorderPoints);
+					img(p) = 0;
+					changed++;
+				}
+			}
+
+			if (changed > changedBefore)
+				internals::updateBorderPoints(img, borderPoints, newBorderPoints);
+		}
+
+		return changed;
+	}
+
 	/*
 	Performs one thinning iteration and returns count of pixels removed from the image.
 	Repeating this thinning process until the image does not change results in surface skeleton.
@@ -1060,6 +1226,7 @@ namespace itl2
 	Uses algorithm published in
 	Lee et al. Building skeleton models via 3-D medial surface/axis thinning algorithms. Computer Vision, Graphics, and Image Processing, 56(6):462–478, 1994.
 	The implementation is based on Fiji Skeletonize3D_ plugin (GPL) and ITK implementation, but this version tries to save memory and is multithreaded.
+	Only the current border points are tested in each iteration, so the processing time depends on the surface area rather than on the volume of the structure.
 	This version also uses additional conditions to avoid skeletonizing that are not present in Lee's paper. See internals::isSurfacePoint
 	and internals::createAllowedHashList for details.
 	The resulting skeleton consists of planes (= surfaces) (not lines) so it is referred to as "surface skeleton".
@@ -1068,12 +1235,15 @@ namespace itl2
 	*/
 	template<typename pixel_t> void surfaceSkeleton(Image<pixel_t>& img, bool retainSurfaces = true, size_t maxIterations = std::numeric_limits<size_t>::max())
 	{
+		// Only border points may be removed, so the whole image is scanned only once to find them.
+		std::vector<Vec3c> borderPoints;
+		internals::findBorderPoints(img, borderPoints);
 
 		size_t it = 0;
 		size_t changes;
 		do
 		{
-			changes = thin(img, retainSurfaces);
+			changes = thin(img, retainSurfaces, borderPoints);
 
 			std::cout << std::endl << changes << " pixels removed." << std::endl;
 
@@ -1089,5 +1259,6 @@ namespace itl2
 	namespace tests
 	{
 		void surfaceSkeleton();
+		void surfaceSkeletonBorderPoints();
 	}
 }
@@ -0,0 +1,445 @@
+
+#include "thinninglut.h"
+#include "surfaceskeleton.h"
+#include "lineskeleton.h"
+#include "utilities.h"
+#include "timer.h"
+#include "testutils.h"
+
+#include <array>
+#include <bitset>
+#include <initializer_list>
+#include <random>
+
+using namespace std;
+
+namespace itl2
+{
+	namespace internals
+	{
+		/**
+		Inserts the center pixel (that is assumed to be foreground) to the bit-packed 26-neighbourhood.
+		The result has bit i set if pixel i of the 3x3x3 neighbourhood is nonzero.
+		*/
+		static uint32_t neighbourhoodBits27(uint32_t nb)
+		{
+			return (nb & 0x1fff) | (1 << 13) | ((nb >> 13) << 14);
+		}
+
+		/**
+		Calculates masks that contain bits of the 26-neighbours of each point in the bit-packed 26-neighbourhood.
+		*/
+		static array<uint32_t, 26> adjacencyMasks()
+		{
+			array<uint32_t, 26> masks;
+			for (int i = 0; i < 27; i++)
+			{
+				if (i == 13)
+					continue;
+
+				uint32_t mask = 0;
+				for (int j = 0; j < 27; j++)
+				{
+					if (j == 13 || j == i)
+						continue;
+
+					if (abs(i % 3 - j % 3) <= 1 && abs((i / 3) % 3 - (j / 3) % 3) <= 1 && abs(i / 9 - j / 9) <= 1)
+						mask |= (uint32_t)1 << neighbourBit(j);
+				}
+				masks[neighbourBit(i)] = mask;
+			}
+			return masks;
+		}
+
+		bool isSimplePointHybrid(uint32_t nb)
+		{
+			// Two points in the 26-neighbourhood are in the same octant if and only if they are 26-neighbours,
+			// so the octree labeling in isSimplePointHybrid(const Image&) finds 26-connected components.
+			static const array<uint32_t, 26> adjacency = adjacencyMasks();
+
+			if (nb == 0)
+				return true;
+
+			// Grow one component starting from the lowest foreground bit.
+			uint32_t component = nb & (~nb + 1);
+			uint32_t processed = 0;
+			while (component != processed)
+			{
+				uint32_t todo = component & ~processed;
+				processed = component;
+				while (todo != 0)
+				{
+					uint32_t lowest = todo & (~todo + 1);
+					int bit = (int)std::bitset<32>(lowest - 1).count();
+					component |= adjacency[bit] & nb;
+					todo &= todo - 1;
+				}
+			}
+
+			return component == nb;
+		}
+
+		bool isEulerInvariant(uint32_t nb)
+		{
+			// Indices of the neighbours in each octant, in the same order as in isEulerInvariant(const Image&).
+			static const int octants[8][7] = {
+				{ 24, 25, 15, 16, 21, 22, 12 }, // SWU
+				{ 26, 23, 17, 14, 25, 22, 16 }, // SEU
+				{ 18, 21, 9, 12, 19, 22, 10 }, // NWU
+				{ 20, 23, 19, 22, 11, 14, 10 }, // NEU
+				{ 6, 15, 7, 16, 3, 12, 4 }, // SWB
+				{ 8, 7, 17, 16, 5, 4, 14 }, // SEB
+				{ 0, 9, 3, 12, 1, 10, 4 }, // NWB
+				{ 2, 1, 11, 10, 5, 4, 14 } // NEB
+			};
+
+			uint32_t nb27 = neighbourhoodBits27(nb);
+
+			int eulerChar = 0;
+			for (size_t o = 0; o < 8; o++)
+			{
+				unsigned char n = 1;
+				for (size_t i = 0; i < 7; i++)
+				{
+					if ((nb27 >> octants[o][i]) & 1)
+						n |= (unsigned char)(128 >> i);
+				}
+				eulerChar += eulerLUT[n];
+			}
+
+			return eulerChar == 0;
+		}
+
+		bool isSurfacePoint(uint32_t nb)
+		{
+			uint32_t nb27 = neighbourhoodBits27(nb);
+
+			// Test all the eight 2x2x2 cubes in the neighbourhood, see isSurfacePoint(const Image&).
+			for (int sz = 0; sz <= 1; sz++)
+			{
+				for (int sy = 0; sy <= 1; sy++)
+				{
+					for (int sx = 0; sx <= 1; sx++)
+					{
+						size_t hash = 0;
+						for (int n = 0; n < 8; n++)
+						{
+							int i = (sx + (n & 1)) + 3 * (sy + ((n >> 1) & 1)) + 9 * (sz + (n >> 2));
+							hash |= (size_t)((nb27 >> i) & 1) << n;
+						}
+
+						if (!isSurfaceFlags[hash])
+							return false;
+					}
+				}
+			}
+
+			return true;
+		}
+
+		/**
+		Creates a mask where the bits at the given indices are set.
+		*/
+		static constexpr uint32_t bitMask(std::initializer_list<int> indices)
+		{
+			uint32_t mask = 0;
+			for (int i : indices)
+				mask |= (uint32_t)1 << i;
+			return mask;
+		}
+
+		/**
+		Counts the masks that have at least one bit in common with nb.
+		*/
+		template<size_t N> static int countIntersecting(uint32_t nb, const array<uint32_t, N>& masks)
+		{
+			int count = 0;
+			for (uint32_t mask : masks)
+			{
+				if ((nb & mask) != 0)
+					count++;
+			}
+			return count;
+		}
+
+		bool isSimplePointLine(uint32_t nb)
+		{
+			// This is isSimplePointLine(const uint8_t Np[26]) where the loops over neighbour index lists are replaced by
+			// bit mask operations. Bit i of nb corresponds to Np[i].
+			auto isSet = [nb](int i) { return ((nb >> i) & 1) != 0; };
+
+			static constexpr uint32_t N6 = bitMask({ 4, 10, 12, 13, 15, 21 });
+			int N6Sum = 6 - (int)std::bitset<32>(nb & N6).count();
+
+			if (N6Sum == 1)
+				return true;
+
+			if (N6Sum == 2)
+			{
+				if (!isSet(4) && !isSet(21))
+					return false;
+				if (!isSet(12) && !isSet(13))
+					return false;
+				if (!isSet(15) && !isSet(10))
+					return false;
+
+				return true;
+			}
+
+			if (N6Sum > 2)
+			{
+				// The cells of eulerChar. A cell is present if any of the neighbours in its mask is foreground.
+				static constexpr array<uint32_t, 8> zeroCells = {
+					bitMask({ 10, 11, 13, 18, 19, 21, 22 }),
+					bitMask({ 13, 15, 16, 21, 22, 24, 25 }),
+					bitMask({ 12, 14, 15, 20, 21, 23, 24 }),
+					bitMask({ 9, 10, 12, 17, 18, 20, 21 }),
+					bitMask({ 0, 1, 3, 4, 9, 10, 12 }),
+					bitMask({ 1, 2, 4, 5, 10, 11, 13 }),
+					bitMask({ 4, 5, 7, 8, 13, 15, 16 }),
+					bitMask({ 3, 4, 6, 7, 12, 14, 15 })
+				};
+				static constexpr array<uint32_t, 12> oneCells = {
+					bitMask({ 13, 21, 22 }),
+					bitMask({ 15, 21, 24 }),
+					bitMask({ 12, 20, 21 }),
+					bitMask({ 10, 18, 21 }),
+					bitMask({ 10, 11, 13 }),
+					bitMask({ 13, 15, 16 }),
+					bitMask({ 12, 14, 15 }),
+					bitMask({ 9, 10, 12 }),
+					bitMask({ 1, 4, 10 }),
+					bitMask({ 4, 5, 13 }),
+					bitMask({ 4, 7, 15 }),
+					bitMask({ 3, 4, 12 })
+				};
+				static constexpr array<uint32_t, 6> twoCells = {
+					bitMask({ 10 }), bitMask({ 13 }), bitMask({ 15 }), bitMask({ 12 }), bitMask({ 4 }), bitMask({ 21 })
+				};
+
+				if (countIntersecting(nb, zeroCells) - countIntersecting(nb, oneCells) + countIntersecting(nb, twoCells) != 1)
+					return false;
+
+				// isolated0cell
+				static constexpr int zeroPoints[] = { 0, 2, 6, 8, 17, 19, 23, 25 };
+				static constexpr array<uint32_t, 8> zeroCorners = {
+					bitMask({ 1, 3, 4, 9, 10, 12 }),
+					bitMask({ 1, 4, 5, 10, 11, 13 }),
+					bitMask({ 3, 4, 7, 12, 14, 15 }),
+					bitMask({ 4, 5, 7, 13, 15, 16 }),
+					bitMask({ 9, 10, 12, 18, 20, 21 }),
+					bitMask({ 10, 11, 13, 18, 21, 22 }),
+					bitMask({ 12, 14, 15, 20, 21, 24 }),
+					bitMask({ 13, 15, 16, 21, 22, 24 })
+				};
+				for (int i = 0; i < 8; i++)
+				{
+					if (isSet(zeroPoints[i]) && (nb & zeroCorners[i]) == 0)
+						return false;
+				}
+
+				// isolated1cell
+				static constexpr int onePoints[] = { 1, 3, 5, 7, 9, 11, 14, 16, 18, 20, 22, 24 };
+				static constexpr array<uint32_t, 12> oneCorners = {
+					bitMask({ 0, 2, 3, 4, 5, 9, 10, 11, 12, 13 }),
+					bitMask({ 0, 1, 4, 6, 7, 9, 10, 12, 14, 15 }),
+					bitMask({ 1, 2, 4, 7, 8, 10, 11, 13, 15, 16 }),
+					bitMask({ 3, 4, 5, 6, 8, 12, 13, 14, 15, 16 }),
+					bitMask({ 0, 1, 3, 4, 10, 12, 17, 18, 20, 21 }),
+					bitMask({ 1, 2, 4, 5, 10, 13, 18, 19, 21, 22 }),
+					bitMask({ 3, 4, 6, 7, 12, 15, 20, 21, 23, 24 }),
+					bitMask({ 4, 5, 7, 8, 13, 15, 21, 22, 24, 25 }),
+					bitMask({ 9, 10, 11, 12, 13, 17, 19, 20, 21, 22 }),
+					bitMask({ 9, 10, 12, 14, 15, 17, 18, 21, 23, 24 }),
+					bitMask({ 10, 11, 13, 15, 16, 18, 19, 21, 24, 25 }),
+					bitMask({ 12, 13, 14, 15, 16, 20, 21, 22, 23, 25 })
+				};
+				for (int i = 0; i < 12; i++)
+				{
+					if (isSet(onePoints[i]) && (nb & oneCorners[i]) == 0)
+						return false;
+				}
+
+				// isolatedInv2cell
+				static constexpr int twoPoints[] = { 4, 10, 12, 13, 15, 21 };
+				static constexpr array<uint32_t, 6> twoCorners = {
+					bitMask({ 0, 1, 2, 3, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 }),
+					bitMask({ 0, 1, 2, 3, 4, 5, 9, 11, 12, 13, 17, 18, 19, 20, 21, 22 }),
+					bitMask({ 0, 1, 3, 4, 6, 7, 9, 10, 14, 15, 17, 18, 20, 21, 23, 24 }),
+					bitMask({ 1, 2, 4, 5, 7, 8, 10, 11, 15, 16, 18, 19, 21, 22, 24, 25 }),
+					bitMask({ 3, 4, 5, 6, 7, 8, 12, 13, 14, 16, 20, 21, 22, 23, 24, 25 }),
+					bitMask({ 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 22, 23, 24, 25 })
+				};
+				bool isolatedInv2 = true;
+				for (int i = 0; i < 6; i++)
+				{
+					if (!isSet(twoPoints[i]) && (nb & twoCorners[i]) != twoCorners[i])
+					{
+						isolatedInv2 = false;
+						break;
+					}
+				}
+				if (isolatedInv2)
+					return false;
+			}
+
+			return true;
+		}
+
+		/**
+		Creates lookup table containing values of the given function for all neighbourhood configurations.
+		*/
+		template<typename F> NeighbourhoodLUT createLUT(F f)
+		{
+			NeighbourhoodLUT lut;
+
+			constexpr coord_t wordCount = (coord_t)(NEIGHBOURHOOD_CONFIGURATION_COUNT / 64);
+			#pragma omp parallel for
+			for (coord_t w = 0; w < wordCount; w++)
+			{
+				uint64_t word = 0;
+				for (uint32_t b = 0; b < 64; b++)
+				{
+					if (f((uint32_t)(w * 64) + b))
+						word |= (uint64_t)1 << b;
+				}
+				lut.setWord(w, word);
+			}
+
+			return lut;
+		}
+
+		const NeighbourhoodLUT& simplePointHybridLUT()
+		{
+			static const NeighbourhoodLUT lut = createLUT([](uint32_t nb) { return isSimplePointHybrid(nb); });
+			return lut;
+		}
+
+		const NeighbourhoodLUT& eulerInvariantLUT()
+		{
+			static const NeighbourhoodLUT lut = createLUT([](uint32_t nb) { return isEulerInvariant(nb); });
+			return lut;
+		}
+
+		const NeighbourhoodLUT& simplePointLineLUT()
+		{
+			static const NeighbourhoodLUT lut = createLUT([](uint32_t nb) { return isSimplePointLine(nb); });
+			return lut;
+		}
+
+		NeighbourhoodTest& simplePointHybridTest()
+		{
+			static NeighbourhoodTest test([](uint32_t nb) { return isSimplePointHybrid(nb); }, simplePointHybridLUT);
+			return test;
+		}
+
+		NeighbourhoodTest& eulerInvariantTest()
+		{
+			static NeighbourhoodTest test([](uint32_t nb) { return isEulerInvariant(nb); }, eulerInvariantLUT);
+			return test;
+		}
+
+		NeighbourhoodTest& simplePointLineTest()
+		{
+			static NeighbourhoodTest test([](uint32_t nb) { return isSimplePointLine(nb); }, simplePointLineLUT);
+			return test;
+		}
+	}
+
+	namespace tests
+	{
+		void thinningLUT()
+		{
+			internals::createAllowedHashList();
+
+			Timer timer;
+			timer.start();
+			const internals::NeighbourhoodLUT& simpleLUT = internals::simplePointHybridLUT();
+			const internals::NeighbourhoodLUT& eulerLUT = internals::eulerInvariantLUT();
+			const internals::NeighbourhoodLUT& lineLUT = internals::simplePointLineLUT();
+			timer.stop();
+			cout << "Creating lookup tables took " << timer.getSeconds() << " s" << endl;
+
+			// Compare to the functions that operate on neighbourhood images.
+			// Test random configurations and configurations with only a few foreground or background points.
+			mt19937 gen(1);
+			uniform_int_distribution<uint32_t> dist(0, (uint32_t)internals::NEIGHBOURHOOD_CONFIGURATION_COUNT - 1);
+			vector<uint32_t> configurations;
+			for (size_t n = 0; n < 1000000; n++)
+				configurations.push_back(dist(gen));
+			for (size_t n = 0; n < 100000; n++)
+			{
+				configurations.push_back(dist(gen) & dist(gen) & dist(gen) & dist(gen));
+				configurations.push_back(dist(gen) | dist(gen) | dist(gen) | dist(gen));
+			}
+			configurations.push_back(0);
+			configurations.push_back((uint32_t)internals::NEIGHBOURHOOD_CONFIGURATION_COUNT - 1);
+
+			Image<uint8_t> nb(3, 3, 3);
+			size_t errors = 0;
+			for (uint32_t config : configurations)
+			{
+				for (int i = 0; i < 27; i++)
+					nb(i) = i == 13 ? 1 : ((config >> internals::neighbourBit(i)) & 1);
+
+				bool ok = internals::isEndPoint(config) == internals::isEndPoint(nb) &&
+					simpleLUT(config) == internals::isSimplePointHybrid(nb) &&
+					internals::isSimplePointHybrid(config) == internals::isSimplePointHybrid(nb) &&
+					eulerLUT(config) == internals::isEulerInvariant(nb) &&
+					internals::isEulerInvariant(config) == internals::isEulerInvariant(nb) &&
+					internals::isSurfacePoint(config) == internals::isSurfacePoint(nb) &&
+					lineLUT(config) == internals::isSimplePointLine(nb) &&
+					internals::isSimplePointLine(config) == internals::isSimplePointLine(nb);
+
+				if (!ok)
+					errors++;
+			}
+
+			testAssert(errors == 0, "thinning lookup tables");
+
+			// NeighbourhoodTest must give the same results before and after it takes the lookup table into use.
+			internals::NeighbourhoodTest lineTest([](uint32_t nb) { return internals::isSimplePointLine(nb); }, internals::simplePointLineLUT);
+			errors = 0;
+			for (size_t n = 0; n < 1000; n++)
+			{
+				if (lineTest(configurations[n]) != lineLUT(configurations[n]))
+					errors++;
+			}
+			lineTest.addEvaluations(1000);
+			testAssert(!lineTest.usesLUT(), "neighbourhood test does not use lookup table after a few evaluations");
+			lineTest.addEvaluations(internals::NEIGHBOURHOOD_CONFIGURATION_COUNT);
+			testAssert(lineTest.usesLUT(), "neighbourhood test uses lookup table after many evaluations");
+			for (size_t n = 0; n < 1000; n++)
+			{
+				if (lineTest(configurations[n]) != lineLUT(configurations[n]))
+					errors++;
+			}
+			testAssert(errors == 0, "neighbourhood test");
+
+			// Compare bit-packed neighbourhoods to neighbourhoods extracted with getNeighbourhood, also near image edges.
+			Image<uint16_t> img(7, 6, 5);
+			for (coord_t n = 0; n < img.pixelCount(); n++)
+				img(n) = dist(gen) % 3 == 0 ? 0 : 2;
+
+			Image<uint16_t> imgNb(3, 3, 3);
+			for (coord_t z = 0; z < img.depth(); z++)
+			{
+				for (coord_t y = 0; y < img.height(); y++)
+				{
+					for (coord_t x = 0; x < img.width(); x++)
+					{
+						getNeighbourhood(img, Vec3c(x, y, z), Vec3c(1, 1, 1), imgNb, BoundaryCondition::Zero);
+						uint32_t expected = 0;
+						for (int i = 0; i < 27; i++)
+						{
+							if (i != 13 && imgNb(i) != 0)
+								expected |= (uint32_t)1 << internals::neighbourBit(i);
+						}
+
+						testAssert(internals::neighbourhoodBits(img, Vec3c(x, y, z)) == expected, "bit-packed neighbourhood");
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,261 @@
+#pragma once
+
+#include "image.h"
+#include "math/vec3.h"
+
+#include <vector>
+#include <bitset>
+#include <atomic>
+
+namespace itl2
+{
+	namespace internals
+	{
+		/**
+		Count of configurations of the 26-neighbourhood of a point.
+		*/
+		constexpr size_t NEIGHBOURHOOD_CONFIGURATION_COUNT = (size_t)1 << 26;
+
+		/**
+		Converts index of a pixel in a 3x3x3 neighbourhood (as in nb(i) for neighbourhood nb extracted with getNeighbourhood) to the corresponding
+		bit index in the bit-packed 26-neighbourhood returned by neighbourhoodBits.
+		The center pixel (i = 13) does not have a bit.
+		*/
+		constexpr int neighbourBit(int i)
+		{
+			return i < 13 ? i : i - 1;
+		}
+
+		/**
+		Gets bit-packed 26-neighbourhood of p directly from the image, without copying it to a separate neighbourhood image.
+		Bit neighbourBit(i) is set if pixel i of the 3x3x3 neighbourhood around p is nonzero.
+		The center pixel is not included. Pixels outside of the image are treated as zero.
+		*/
+		template<typename pixel_t> uint32_t neighbourhoodBits(const Image<pixel_t>& img, const Vec3c& p)
+		{
+			uint32_t bits = 0;
+			int bit = 0;
+
+			if (p.x >= 1 && p.y >= 1 && p.z >= 1 && p.x < img.width() - 1 && p.y < img.height() - 1 && p.z < img.depth() - 1)
+			{
+				// Fast path for points that are not on the image edge.
+				const coord_t sy = img.width();
+				const coord_t sz = img.width() * img.height();
+				const pixel_t* c = img.getData() + img.getLinearIndex(p);
+				for (coord_t dz = -1; dz <= 1; dz++)
+				{
+					for (coord_t dy = -1; dy <= 1; dy++)
+					{
+						const pixel_t* row = c + dz * sz + dy * sy;
+						for (coord_t dx = -1; dx <= 1; dx++)
+						{
+							if (dx == 0 && dy == 0 && dz == 0)
+								continue;
+
+							if (row[dx] != (pixel_t)0)
+								bits |= (uint32_t)1 << bit;
+							bit++;
+						}
+					}
+				}
+			}
+			else
+			{
+				for (coord_t dz = -1; dz <= 1; dz++)
+				{
+					for (coord_t dy = -1; dy <= 1; dy++)
+					{
+						for (coord_t dx = -1; dx <= 1; dx++)
+						{
+							if (dx == 0 && dy == 0 && dz == 0)
+								continue;
+
+							Vec3c q(p.x + dx, p.y + dy, p.z + dz);
+							if (img.isInImage(q) && img(q) != (pixel_t)0)
+								bits |= (uint32_t)1 << bit;
+							bit++;
+						}
+					}
+				}
+			}
+
+			return bits;
+		}
+
+		/**
+		Bit set containing one bit for each configuration of the 26-neighbourhood of a point (8 MB).
+		*/
+		class NeighbourhoodLUT
+		{
+		private:
+			std::vector<uint64_t> bits;
+
+		public:
+			NeighbourhoodLUT() : bits(NEIGHBOURHOOD_CONFIGURATION_COUNT / 64, 0)
+			{
+			}
+
+			/**
+			Gets value corresponding to the given bit-packed neighbourhood.
+			*/
+			bool operator()(uint32_t nb) const
+			{
+				return ((bits[nb >> 6] >> (nb & 63)) & 1) != 0;
+			}
+
+			/**
+			Sets values of 64 consecutive configurations starting from configuration 64 * index.
+			*/
+			void setWord(size_t index, uint64_t value)
+			{
+				bits[index] = value;
+			}
+		};
+
+		/**
+		Tests if the center point of the given bit-packed neighbourhood is the end point of an arc, i.e. it has exactly one foreground neighbour.
+		Equals isEndPoint for a neighbourhood whose center is foreground.
+		*/
+		inline bool isEndPoint(uint32_t nb)
+		{
+			return std::bitset<32>(nb).count() == 1;
+		}
+
+		/**
+		Tests if the foreground points in the bit-packed 26-neighbourhood form zero or one 26-connected components.
+		Equals isSimplePointHybrid.
+		*/
+		bool isSimplePointHybrid(uint32_t nb);
+
+		/**
+		Tests if removal of the center point of the bit-packed neighbourhood does not change the Euler characteristic.
+		Equals isEulerInvariant for a neighbourhood whose center is foreground.
+		*/
+		bool isEulerInvariant(uint32_t nb);
+
+		/**
+		Tests if the center point of the given bit-packed neighbourhood is a surface point.
+		Equals isSurfacePoint for a neighbourhood whose center is foreground.
+		createAllowedHashList must be called before calling this function.
+		*/
+		bool isSurfacePoint(uint32_t nb);
+
+		/**
+		Tests if the center point of the given bit-packed neighbourhood is a simple point in the line skeleton algorithm.
+		Equals isSimplePointLine.
+		*/
+		bool isSimplePointLine(uint32_t nb);
+
+		/**
+		Test of bit-packed neighbourhoods that is evaluated directly until it has been evaluated as many times as there are
+		neighbourhood configurations, and using a lookup table after that.
+		Filling the lookup table takes about as long as evaluating the test for all the configurations, so this way small images,
+		and single thinning iterations run as separate distributed jobs, do not pay for the table, and large images are processed
+		at most about two times slower than if the table had been available from the beginning.
+		*/
+		class NeighbourhoodTest
+		{
+		private:
+			bool (*test)(uint32_t);
+			const NeighbourhoodLUT& (*getLUT)();
+
+			/**
+			Count of direct evaluations made so far.
+			*/
+			std::atomic<size_t> directEvaluations;
+
+			/**
+			The lookup table, or nullptr if it has not been taken into use yet.
+			*/
+			std::atomic<const NeighbourhoodLUT*> pLUT;
+
+		public:
+			/**
+			Constructor
+			@param test Function that evaluates the test directly.
+			@param getLUT Function that returns the lookup table of the test, and creates it if necessary.
+			*/
+			NeighbourhoodTest(bool (*test)(uint32_t), const NeighbourhoodLUT& (*getLUT)()) :
+				test(test),
+				getLUT(getLUT),
+				directEvaluations(0),
+				pLUT(nullptr)
+			{
+			}
+
+			NeighbourhoodTest(const NeighbourhoodTest&) = delete;
+			NeighbourhoodTest& operator=(const NeighbourhoodTest&) = delete;
+
+			/**
+			Evaluates the test for the given bit-packed neighbourhood.
+			*/
+			bool operator()(uint32_t nb) const
+			{
+				const NeighbourhoodLUT* lut = pLUT.load(std::memory_order_relaxed);
+				if (lut)
+					return (*lut)(nb);
+				return test(nb);
+			}
+
+			/**
+			Records that the test has been evaluated the given number of times, and takes the lookup table into use
+			if the total count of direct evaluations reaches the count of neighbourhood configurations.
+			Call this outside of parallel regions, e.g. after each thinning pass.
+			*/
+			void addEvaluations(size_t count)
+			{
+				if (pLUT.load() || count <= 0)
+					return;
+
+				if (directEvaluations.fetch_add(count) + count >= NEIGHBOURHOOD_CONFIGURATION_COUNT)
+					pLUT.store(&getLUT());
+			}
+
+			/**
+			Returns true if the lookup table is in use.
+			*/
+			bool usesLUT() const
+			{
+				return pLUT.load() != nullptr;
+			}
+		};
+
+		/**
+		Gets lookup table for isSimplePointHybrid.
+		The table is created when this function is called for the first time.
+		*/
+		const NeighbourhoodLUT& simplePointHybridLUT();
+
+		/**
+		Gets lookup table for isEulerInvariant.
+		The table is created when this function is called for the first time.
+		*/
+		const NeighbourhoodLUT& eulerInvariantLUT();
+
+		/**
+		Gets lookup table for isSimplePointLine.
+		The table is created when this function is called for the first time.
+		*/
+		const NeighbourhoodLUT& simplePointLineLUT();
+
+		/**
+		Gets process-wide NeighbourhoodTest for isSimplePointHybrid.
+		*/
+		NeighbourhoodTest& simplePointHybridTest();
+
+		/**
+		Gets process-wide NeighbourhoodTest for isEulerInvariant.
+		*/
+		NeighbourhoodTest& eulerInvariantTest();
+
+		/**
+		Gets process-wide NeighbourhoodTest for isSimplePointLine.
+		*/
+		NeighbourhoodTest& simplePointLineTest();
+	}
+
+	namespace tests
+	{
+		void thinningLUT();
+	}
+}
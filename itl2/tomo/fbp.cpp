@@ -10,7 +10,11 @@
 #include "projections.h"
 #include "math/vec4.h"
 #include "io/raw.h"
+#include "io/io.h"
 #include "generation.h"
+#include "noise.h"
+#include "timer.h"
+#include "testutils.h"
 
 #if defined(USE_OPENCL)
 #define __CL_ENABLE_EXCEPTIONS
@@ -19,6 +23,7 @@
 
 #include <iostream>
 #include <functional>
+#include <future>
 #include <array>
 using namespace std;
 
@@ -294,10 +299,11 @@ namespace itl2
 		/**
 		Checks that projection images and settings correspond to each other.
 		Adjusts zero elements in roi size vector to full image dimension.
+		@param projectionSize Dimensions of the projection stack.
 		*/
-		void sanityCheck(const Image<float32_t>& transmissionProjections, RecSettings& settings, bool projectionsAreBinned)
+		void sanityCheck(const Vec3c& projectionSize, RecSettings& settings, bool projectionsAreBinned)
 		{
-			if (transmissionProjections.depth() != settings.angles.size())
+			if ((size_t)projectionSize.z != settings.angles.size())
 				throw ITLException("Count of projection images and count of angles do not match.");
 
 			if (settings.objectShifts.size() != settings.angles.size())
@@ -311,19 +317,28 @@ namespace itl2
 
 			// Roi size and position
 			if (settings.roiSize.x <= 0)
-				settings.roiSize.x = projectionsAreBinned ? transmissionProjections.width() * settings.binning : transmissionProjections.width();
+				settings.roiSize.x = projectionsAreBinned ? projectionSize.x * settings.binning : projectionSize.x;
 			if (settings.roiSize.x <= 0)
 				settings.roiSize.x = 1;
 			if (settings.roiSize.y <= 0)
-				settings.roiSize.y = projectionsAreBinned ? transmissionProjections.width() * settings.binning : transmissionProjections.width();
+				settings.roiSize.y = projectionsAreBinned ? projectionSize.x * settings.binning : projectionSize.x;
 			if (settings.roiSize.y <= 0)
 				settings.roiSize.y = 1;
 			if (settings.roiSize.z <= 0)
-				settings.roiSize.z = projectionsAreBinned ? transmissionProjections.height() * settings.binning : transmissionProjections.height();
+				settings.roiSize.z = projectionsAreBinned ? projectionSize.y * settings.binning : projectionSize.y;
 			if (settings.roiSize.z <= 0)
 				settings.roiSize.z = 1;
 
 		}
+
+		/**
+		Checks that projection images and settings correspond to each other.
+		Adjusts zero elements in roi size vector to full image dimension.
+		*/
+		void sanityCheck(const Image<float32_t>& transmissionProjections, RecSettings& settings, bool projectionsAreBinned)
+		{
+			sanityCheck(transmissionProjections.dimensions(), settings, projectionsAreBinned);
+		}
 	}
 
 	/**
@@ -462,16 +477,11 @@ namespace itl2
 			}
 			case FilterType::Ramp:
 			{
-				initFFTW();
 				coord_t s = filter.width() - 1;
 				coord_t pow2 = s << 1;
 				Image<complex32_t> F(pow2);
 
-				fftwf_plan plan;
-				#pragma omp critical
-				{
-					plan = fftwf_plan_dft_1d((int)pow2, (fftwf_complex*)F.getData(), (fftwf_complex*)F.getData(), FFTW_FORWARD, FFTW_ESTIMATE);
-				}
+				fftwf_plan plan = internals::getFFTPlan(internals::FFTKind::ComplexForward, 1, F.dimensions(), F.getData(), F.getData());
 
 				F(0) = 0.25;
 				for (coord_t i = 1; i < F.width(); i++)
@@ -487,16 +497,11 @@ namespace itl2
 						F(i) = F(pow2 - i);
 				}
 
-				fftwf_execute(plan);
+				fftwf_execute_dft(plan, (fftwf_complex*)F.getData(), (fftwf_complex*)F.getData());
 
 				for (coord_t n = 0; n < filter.width(); n++)
 					filter(n) = 2 * F(n).real();
 
-				#pragma omp critical
-				{
-					fftwf_destroy_plan(plan);
-				}
-
 				break;
 			}
 			case FilterType::SheppLogan:
@@ -612,6 +617,7 @@ namespace itl2
 
 		/**
 		FFT plans.
+		The plans are owned by the FFT plan cache.
 		*/
 		fftwf_plan forward;
 		fftwf_plan backward;
@@ -640,20 +646,8 @@ namespace itl2
 
 			createFilter(H, filterType, cutoff);
 
-			#pragma omp critical
-			{
-				forward = fftwf_plan_dft_r2c_1d((int)paddedWidth, in.getData(), (fftwf_complex*)out.getData(), FFTW_ESTIMATE);
-				backward = fftwf_plan_dft_c2r_1d((int)paddedWidth, (fftwf_complex*)out.getData(), in.getData(), FFTW_ESTIMATE);
-			}
-		}
-
-		~FilterSettings()
-		{
-			#pragma omp critical
-			{
-				fftwf_destroy_plan(backward);
-				fftwf_destroy_plan(forward);
-			}
+			forward = internals::getFFTPlan(internals::FFTKind::RealToComplex, 1, in.dimensions(), in.getData(), out.getData());
+			backward = internals::getFFTPlan(internals::FFTKind::ComplexToReal, 1, in.dimensions(), out.getData(), in.getData());
 		}
 	};
 
@@ -690,14 +684,14 @@ namespace itl2
 
 			// Transform
 			// NOTE: Output stores only non-negative frequencies!
-			fftwf_execute(settings.forward);
+			fftwf_execute_dft_r2c(settings.forward, settings.in.getData(), (fftwf_complex*)settings.out.getData());
 
 			// Apply filter
 			for (coord_t x = 0; x < settings.out.width(); x++)
 				settings.out(x) *= settings.H(x);
 
 			// Inverse transform
-			fftwf_execute(settings.backward);
+			fftwf_execute_dft_c2r(settings.backward, (fftwf_complex*)settings.out.getData(), settings.in.getData());
 
 			// Normalize and copy to output
 			for (coord_t x = 0; x < projectionWidth; x++)
@@ -870,32 +864,114 @@ namespace itl2
 		}
 	}
 	
-	void fbpPreprocess(const Image<float32_t>& transmissionProjections, Image<float32_t>& preprocessedProjections, RecSettings settings)
+	namespace internals
 	{
-		internals::sanityCheck(transmissionProjections, settings, false);
+		/**
+		Calculates size of projections after cropping and after cropping and binning.
+		@param projectionSize Size of the original projection stack.
+		@param croppedSize Size of the projection stack after cropping is placed here.
+		@return Size of the preprocessed projection stack.
+		*/
+		Vec3c preprocessedSize(const Vec3c& projectionSize, const RecSettings& settings, Vec3c& croppedSize)
+		{
+			croppedSize = projectionSize;
+			if (settings.cropSize.max() > 0)
+			{
+				croppedSize.x = projectionSize.x - 2 * settings.cropSize.x;
+				croppedSize.y = projectionSize.y - 2 * settings.cropSize.y;
 
-		size_t origBinning = settings.binning;
+				//if (croppedSize.x / settings.binning <= 0 || croppedSize.y / settings.binning <= 0)
+				//	throw ITLException("Too large crop size. Cropped projection image size must be at least 1x1 pixels after cropping and binning.");
+			}
 
-		// Calculate size of preprocessed projections
-		Vec3c croppedSize(transmissionProjections.dimensions());
-		if (settings.cropSize.max() > 0)
-		{
-			croppedSize.x = transmissionProjections.width() - 2 * settings.cropSize.x;
-			croppedSize.y = transmissionProjections.height() - 2 * settings.cropSize.y;
+			Vec3c outputSize = croppedSize;
+			if (settings.binning > 1)
+			{
+				outputSize.x /= (coord_t)settings.binning;
+				outputSize.y /= (coord_t)settings.binning;
+			}
+
+			if (outputSize.min() <= 0)
+				throw ITLException("Too large crop size or binning. A projection image must have at least 1x1 pixels after cropping and binning.");
 
-			//if (croppedSize.x / settings.binning <= 0 || croppedSize.y / settings.binning <= 0)
-			//	throw ITLException("Too large crop size. Cropped projection image size must be at least 1x1 pixels after cropping and binning.");
+			return outputSize;
 		}
 
-		Vec3c outputSize = croppedSize;
-		if (settings.binning > 1)
+		/**
+		Buffers needed to preprocess one projection in one thread.
+		*/
+		struct PreprocessBuffers
+		{
+			Image<float32_t> med;
+			Image<float32_t> tmp;
+			Image<float32_t> cropTmp;
+			FilterSettings filterSettings;
+
+			PreprocessBuffers(const Vec3c& croppedSize, coord_t preprocessedWidth, const RecSettings& settings) :
+				cropTmp(croppedSize.x, croppedSize.y),
+				filterSettings(settings.padFraction, preprocessedWidth, settings.filterType, settings.filterCutOff)
+			{
+			}
+		};
+
+		/**
+		Performs all preprocessing steps for a single projection.
+		@param origSlice The original projection.
+		@param slice The preprocessed projection is placed here. The size of the image must be correct.
+		@param angleIndex Index of the projection in the list of angles.
+		@param settings Reconstruction settings where binning has been applied.
+		@param origBinning Binning before it was applied to settings.
+		*/
+		void preprocessSlice(const Image<float32_t>& origSlice, Image<float32_t>& slice, coord_t angleIndex, const RecSettings& settings, size_t origBinning,
+			float32_t centralAngle, float32_t gammamax0, PreprocessBuffers& buffers)
 		{
-			outputSize.x /= (coord_t)settings.binning;
-			outputSize.y /= (coord_t)settings.binning;
+			if (settings.cropSize.max() > 0 && origBinning <= 1)
+			{
+				// Cropping but no binning
+				crop(origSlice, slice, Vec3c(settings.cropSize.x, settings.cropSize.y, 0));
+			}
+			else if (settings.cropSize.max() <= 0 && origBinning > 1)
+			{
+				// Binning but no cropping
+				binning(origSlice, slice, Vec3c(origBinning, origBinning, 1), false);
+			}
+			else if (settings.cropSize.max() > 0 && origBinning > 1)
+			{
+				// Cropping and binning
+				crop(origSlice, buffers.cropTmp, Vec3c(settings.cropSize.x, settings.cropSize.y, 0));
+				binning(buffers.cropTmp, slice, Vec3c(origBinning, origBinning, 1), false);
+			}
+			else
+			{
+				// No binning, no cropping
+				setValue(slice, origSlice);
+			}
+
+			replaceBadValues(slice);
+
+			if(settings.removeDeadPixels)
+				deadPixelRemovalSlice(slice, buffers.med, buffers.tmp);
+
+			phaseRetrievalSlice(slice, settings.phaseMode, settings.phasePadType, settings.phasePadFraction, settings.sourceToRA, settings.objectCameraDistance, settings.delta, settings.mu);
+
+			if(!NumberUtils<float32_t>::equals(settings.bhc, 0))
+				beamHardeningCorrection(slice, settings.bhc);
+
+			fbpWeightingSlice(slice, angleIndex, settings.reconstructAs180degScan, settings.angles, settings.centerShift, settings.csAngleSlope, settings.sourceToRA, settings.cameraZShift, settings.csZSlope, centralAngle, gammamax0, settings.heuristicSinogramWindowingParameter);
+
+			filterSlice(slice, buffers.filterSettings, settings.padType);
 		}
+	}
+	
+	void fbpPreprocess(const Image<float32_t>& transmissionProjections, Image<float32_t>& preprocessedProjections, RecSettings settings)
+	{
+		internals::sanityCheck(transmissionProjections, settings, false);
 
-		if (outputSize.min() <= 0)
-			throw ITLException("Too large crop size or binning. A projection image must have at least 1x1 pixels after cropping and binning.");
+		size_t origBinning = settings.binning;
+
+		// Calculate size of preprocessed projections
+		Vec3c croppedSize;
+		Vec3c outputSize = internals::preprocessedSize(transmissionProjections.dimensions(), settings, croppedSize);
 		
 		// Adjust parameters for binning
 		internals::applyBinningToParameters(settings);
@@ -918,11 +994,7 @@ namespace itl2
 		size_t counter = 0;
 		#pragma omp parallel
 		{
-			Image<float32_t> med;
-			Image<float32_t> tmp;
-			FilterSettings filterSettings(settings.padFraction, preprocessedProjections.width(), settings.filterType, settings.filterCutOff);
-
-			Image<float32_t> cropTmp(croppedSize.x, croppedSize.y);
+			internals::PreprocessBuffers buffers(croppedSize, preprocessedProjections.width(), settings);
 
 			#pragma omp for
 			for (coord_t z = 0; z < preprocessedProjections.depth(); z++)
@@ -932,41 +1004,7 @@ namespace itl2
 				Image<float32_t> origSlice(transmissionProjections, z, z);
 				Image<float32_t> slice(preprocessedProjections, z, z);
 
-				if (settings.cropSize.max() > 0 && origBinning <= 1)
-				{
-					// Cropping but no binning
-					crop(origSlice, slice, Vec3c(settings.cropSize.x, settings.cropSize.y, 0));
-				}
-				else if (settings.cropSize.max() <= 0 && origBinning > 1)
-				{
-					// Binning but no cropping
-					binning(origSlice, slice, Vec3c(origBinning, origBinning, 1), false);
-				}
-				else if (settings.cropSize.max() > 0 && origBinning > 1)
-				{
-					// Cropping and binning
-					crop(origSlice, cropTmp, Vec3c(settings.cropSize.x, settings.cropSize.y, 0));
-					binning(cropTmp, slice, Vec3c(origBinning, origBinning, 1), false);
-				}
-				else
-				{
-					// No binning, no cropping
-					setValue(slice, origSlice);
-				}
-				
-				replaceBadValues(slice);
-				
-				if(settings.removeDeadPixels)
-					deadPixelRemovalSlice(slice, med, tmp);
-
-				phaseRetrievalSlice(slice, settings.phaseMode, settings.phasePadType, settings.phasePadFraction, settings.sourceToRA, settings.objectCameraDistance, settings.delta, settings.mu);
-				
-				if(!NumberUtils<float32_t>::equals(settings.bhc, 0))
-					beamHardeningCorrection(slice, settings.bhc);
-
-				fbpWeightingSlice(slice, z, settings.reconstructAs180degScan, settings.angles, settings.centerShift, settings.csAngleSlope, settings.sourceToRA, settings.cameraZShift, settings.csZSlope, centralAngle, gammamax0, settings.heuristicSinogramWindowingParameter);
-				
-				filterSlice(slice, filterSettings, settings.padType);
+				internals::preprocessSlice(origSlice, slice, z, settings, origBinning, centralAngle, gammamax0, buffers);
 				
 				showThreadProgress(counter, preprocessedProjections.depth());
 			}
@@ -999,6 +1037,319 @@ namespace itl2
 		//filter(preprocessedProjections, settings.padType, settings.padFraction, settings.filterType);
 	}
 
+	namespace internals
+	{
+		/**
+		Count of output pixels processed in one pass of backprojectRow.
+		*/
+		constexpr coord_t BACKPROJECTION_CHUNK_SIZE = 64;
+
+		/**
+		Adds contribution of a single projection to one output row (all x for constant y and z).
+		The row is processed in chunks. For each chunk, detector coordinates and interpolation weights are
+		first calculated in a loop that does not contain any branches or memory accesses to the projection,
+		and that is vectorized with OpenMP simd directive. The projection is then sampled in a separate loop.
+		@param slice Pointer to the first pixel of the projection.
+		@param sum Accumulator row.
+		@param rx0 x-coordinate of the first voxel of the row relative to the center of the reconstruction.
+		@param ry, rz y- and z-coordinates of the row relative to the center of the reconstruction.
+		*/
+		inline void backprojectRow(const float32_t* slice, coord_t projectionWidth, coord_t projectionHeight, const BackprojectionGeometry& g,
+			float32_t d, float32_t csZSlope, float32_t rx0, float32_t ry, float32_t rz, float32_t* sum, coord_t rowLength)
+		{
+			const float32_t halfHeight = (float32_t)projectionHeight / 2.0f;
+			const int32_t w = (int32_t)projectionWidth;
+			const int32_t h = (int32_t)projectionHeight;
+			const float32_t c = g.c;
+			const float32_t s = g.s;
+			const float32_t ix0 = g.ix0;
+			const float32_t iy0 = g.iy0;
+
+			int32_t i00[BACKPROJECTION_CHUNK_SIZE];
+			int32_t i01[BACKPROJECTION_CHUNK_SIZE];
+			int32_t i10[BACKPROJECTION_CHUNK_SIZE];
+			int32_t i11[BACKPROJECTION_CHUNK_SIZE];
+			float32_t wu0[BACKPROJECTION_CHUNK_SIZE];
+			float32_t wu1[BACKPROJECTION_CHUNK_SIZE];
+			float32_t wv0[BACKPROJECTION_CHUNK_SIZE];
+			float32_t wv1[BACKPROJECTION_CHUNK_SIZE];
+			float32_t weight[BACKPROJECTION_CHUNK_SIZE];
+
+			for (coord_t xStart = 0; xStart < rowLength; xStart += BACKPROJECTION_CHUNK_SIZE)
+			{
+				coord_t count = std::min(BACKPROJECTION_CHUNK_SIZE, rowLength - xStart);
+
+				#pragma omp simd
+				for (coord_t i = 0; i < count; i++)
+				{
+					float32_t rx = rx0 + (float32_t)(xStart + i);
+					float32_t dprhox = d + (rx * c + ry * s);
+					float32_t Y = (d * (rx * -s + ry * c)) / dprhox;
+					float32_t Z = (d * rz) / dprhox;
+					weight[i] = (d * d) / (dprhox * dprhox);
+
+					float32_t iy = Z + iy0;
+					float32_t ix = Y + ix0 + (iy - halfHeight) * csZSlope;
+
+					// Bilinear interpolation with zero boundary condition.
+					// Indices are clamped to the image and samples outside of the image get zero weight.
+					// The coordinates are limited so that the integer conversions below do not overflow.
+					ix = std::min(std::max(ix, -2.0f), (float32_t)w + 1);
+					iy = std::min(std::max(iy, -2.0f), (float32_t)h + 1);
+
+					// Floor is calculated without std::floor, as (int)std::floor(x) is not vectorized
+					// unless trapping math is disabled.
+					int32_t u0 = (int32_t)ix;
+					int32_t v0 = (int32_t)iy;
+					u0 -= ix < (float32_t)u0 ? 1 : 0;
+					v0 -= iy < (float32_t)v0 ? 1 : 0;
+					int32_t u1 = u0 + 1;
+					int32_t v1 = v0 + 1;
+
+					float32_t du = ix - (float32_t)u0;
+					float32_t dv = iy - (float32_t)v0;
+					float32_t du0 = 1 - du;
+					float32_t dv0 = 1 - dv;
+					wu0[i] = (u0 >= 0) & (u0 < w) ? du0 : 0.0f;
+					wu1[i] = (u1 >= 0) & (u1 < w) ? du : 0.0f;
+					wv0[i] = (v0 >= 0) & (v0 < h) ? dv0 : 0.0f;
+					wv1[i] = (v1 >= 0) & (v1 < h) ? dv : 0.0f;
+
+					u0 = std::min(std::max(u0, 0), w - 1);
+					u1 = std::min(std::max(u1, 0), w - 1);
+					v0 = std::min(std::max(v0, 0), h - 1);
+					v1 = std::min(std::max(v1, 0), h - 1);
+
+					i00[i] = v0 * w + u0;
+					i01[i] = v0 * w + u1;
+					i10[i] = v1 * w + u0;
+					i11[i] = v1 * w + u1;
+				}
+
+				float32_t* chunkSum = sum + xStart;
+				for (coord_t i = 0; i < count; i++)
+				{
+					float32_t p0 = slice[i00[i]] * wu0[i] + slice[i01[i]] * wu1[i];
+					float32_t p1 = slice[i10[i]] * wu0[i] + slice[i11[i]] * wu1[i];
+					chunkSum[i] += weight[i] * (p0 * wv0[i] + p1 * wv1[i]);
+				}
+			}
+		}
+
+		vector<BackprojectionGeometry> calculateBackprojectionGeometry(const RecSettings& settings, coord_t projectionWidth, coord_t projectionHeight)
+		{
+			float32_t gammamax0 = calculateGammaMax0((float32_t)projectionWidth, settings.sourceToRA);
+			float32_t centralAngle = calculateTrueCentralAngle(settings.centralAngleFor180degScan, settings.angles, gammamax0);
+
+			double rotMul = 1.0;
+			if (settings.rotationDirection == RotationDirection::Counterclockwise)
+				rotMul = -1.0;
+
+			vector<BackprojectionGeometry> geometry;
+			geometry.reserve(settings.angles.size());
+			for (size_t anglei = 0; anglei < settings.angles.size(); anglei++)
+			{
+				double angle = rotMul * ((double)settings.angles[anglei] - 90 + (double)settings.rotation) / 180.0 * PI;
+
+				float32_t sdx = settings.objectShifts[anglei].x * settings.shiftScaling * (settings.useShifts ? 1 : 0);
+				float32_t sdz = settings.objectShifts[anglei].y * settings.shiftScaling * (settings.useShifts ? 1 : 0);
+
+				BackprojectionGeometry g;
+				g.c = (float32_t)cos(angle);
+				g.s = (float32_t)sin(angle);
+				g.ix0 = (float32_t)projectionWidth / 2.0f + settings.centerShift + csAnglePerturbation(anglei, centralAngle, settings.angles, settings.csAngleSlope) - sdx;
+				g.iy0 = (float32_t)projectionHeight / 2.0f + settings.cameraZShift - sdz;
+				geometry.push_back(g);
+			}
+
+			return geometry;
+		}
+
+		void backprojectTile(const Image<float32_t>& projections, coord_t firstAngle, const vector<BackprojectionGeometry>& geometry, const RecSettings& settings,
+			const Vec3f& center, coord_t z, coord_t yStart, coord_t yEnd, float32_t* sums, coord_t angleBlockSize)
+		{
+			float32_t d = settings.sourceToRA;
+			float32_t rx0 = -center.x;
+			float32_t rz = (float32_t)z - center.z;
+			coord_t angleCount = projections.depth();
+
+			for (coord_t angleStart = 0; angleStart < angleCount; angleStart += angleBlockSize)
+			{
+				coord_t angleEnd = std::min(angleStart + angleBlockSize, angleCount);
+				for (coord_t y = yStart; y < yEnd; y++)
+				{
+					float32_t ry = (float32_t)y - center.y;
+					float32_t* rowSums = &sums[(y - yStart) * settings.roiSize.x];
+					for (coord_t anglei = angleStart; anglei < angleEnd; anglei++)
+					{
+						backprojectRow(&projections(0, 0, anglei), projections.width(), projections.height(),
+							geometry[firstAngle + anglei], d, settings.csZSlope, rx0, ry, rz, rowSums, settings.roiSize.x);
+					}
+				}
+			}
+		}
+	}
+
+	void fbpStreaming(const function<void(Image<float32_t>& chunk, coord_t firstAngle)>& readProjections, const Vec3c& projectionSize, Image<float32_t>& output, RecSettings settings, coord_t chunkSize)
+	{
+		internals::sanityCheck(projectionSize, settings, false);
+
+		size_t origBinning = settings.binning;
+
+		Vec3c croppedSize;
+		Vec3c preprocessedSize = internals::preprocessedSize(projectionSize, settings, croppedSize);
+
+		internals::applyBinningToParameters(settings);
+
+		if (preprocessedSize.x > numeric_limits<int32_t>::max() / preprocessedSize.y)
+			throw ITLException("The projections are too large for backprojection.");
+
+		if (chunkSize < 1)
+			chunkSize = 1;
+
+		output.ensureSize(settings.roiSize);
+		setValue(output, 0.0f);
+
+		float32_t gammamax0 = internals::calculateGammaMax0((float32_t)preprocessedSize.x, settings.sourceToRA);
+
+		cout << "Maximum half cone angle on optical axis = " << gammamax0 << " deg" << endl;
+
+		float32_t centralAngle = internals::calculateTrueCentralAngle(settings.centralAngleFor180degScan, settings.angles, gammamax0);
+
+		if (settings.reconstructAs180degScan)
+			cout << "Central angle for 180 deg reconstruction: " << centralAngle << " deg (available angular range = " << min(settings.angles) << " deg - " << max(settings.angles) << " deg)" << endl;
+
+		vector<internals::BackprojectionGeometry> geometry = internals::calculateBackprojectionGeometry(settings, preprocessedSize.x, preprocessedSize.y);
+		Vec3f center = internals::backprojectionCenter(settings);
+
+		constexpr coord_t TILE_ROWS = internals::BACKPROJECTION_TILE_ROWS;
+		coord_t tilesPerSlice = (settings.roiSize.y + TILE_ROWS - 1) / TILE_ROWS;
+		coord_t tileCount = tilesPerSlice * settings.roiSize.z;
+
+		coord_t angleCount = projectionSize.z;
+
+		auto readChunk = [&](Image<float32_t>& chunk, coord_t firstAngle)
+		{
+			chunk.ensureSize(projectionSize.x, projectionSize.y, std::min(chunkSize, angleCount - firstAngle));
+			readProjections(chunk, firstAngle);
+		};
+
+		// The next chunk is read in a separate thread while the current chunk is
+		// preprocessed and backprojected. The projections are then swapped.
+		Image<float32_t> chunks[2];
+		Image<float32_t> preprocessed;
+		readChunk(chunks[0], 0);
+
+		cout << "Reconstructing..." << endl;
+
+		size_t current = 0;
+		for (coord_t firstAngle = 0; firstAngle < angleCount; firstAngle += chunkSize)
+		{
+			Image<float32_t>& projections = chunks[current];
+
+			future<void> nextChunk;
+			coord_t nextFirstAngle = firstAngle + chunkSize;
+			if (nextFirstAngle < angleCount)
+				nextChunk = async(launch::async, readChunk, ref(chunks[1 - current]), nextFirstAngle);
+
+			preprocessed.ensureSize(preprocessedSize.x, preprocessedSize.y, projections.depth());
+
+			#pragma omp parallel
+			{
+				internals::PreprocessBuffers buffers(croppedSize, preprocessed.width(), settings);
+
+				#pragma omp for
+				for (coord_t z = 0; z < preprocessed.depth(); z++)
+				{
+					Image<float32_t> origSlice(projections, z, z);
+					Image<float32_t> slice(preprocessed, z, z);
+
+					internals::preprocessSlice(origSlice, slice, firstAngle + z, settings, origBinning, centralAngle, gammamax0, buffers);
+				}
+
+				vector<float32_t> sums(TILE_ROWS * settings.roiSize.x);
+
+				// Each tile is processed by one thread only so no synchronization is needed when accumulating to the output.
+				#pragma omp for schedule(dynamic)
+				for (coord_t tile = 0; tile < tileCount; tile++)
+				{
+					coord_t z = tile / tilesPerSlice;
+					coord_t yStart = (tile % tilesPerSlice) * TILE_ROWS;
+					coord_t yEnd = std::min(yStart + TILE_ROWS, settings.roiSize.y);
+
+					std::fill(sums.begin(), sums.end(), 0.0f);
+
+					internals::backprojectTile(preprocessed, firstAngle, geometry, settings, center, z, yStart, yEnd, &sums[0], 32);
+
+					for (coord_t y = yStart; y < yEnd; y++)
+					{
+						const float32_t* rowSums = &sums[(y - yStart) * settings.roiSize.x];
+						for (coord_t x = 0; x < settings.roiSize.x; x++)
+							output(x, y, z) += rowSums[x];
+					}
+				}
+			}
+
+			// Wait for the next chunk. This also re-throws exceptions from the reader.
+			if (nextChunk.valid())
+				nextChunk.get();
+
+			current = 1 - current;
+
+			showProgress(std::min(nextFirstAngle, angleCount), angleCount);
+		}
+
+		// Normalization and scaling
+		float32_t normFact = normFactor(settings);
+		for (coord_t n = 0; n < output.pixelCount(); n++)
+			output(n) = (output(n) * normFact - settings.dynMin) / (settings.dynMax - settings.dynMin);
+	}
+
+	namespace internals
+	{
+		/**
+		Reads a block of an image file of given pixel data type and converts it to float32_t.
+		*/
+		template<typename pixel_t> void readProjectionBlock(Image<float32_t>& chunk, const string& filename, coord_t firstAngle)
+		{
+			Image<pixel_t> block(chunk.dimensions());
+			io::readBlock(block, filename, Vec3c(0, 0, firstAngle));
+			for (coord_t n = 0; n < block.pixelCount(); n++)
+				chunk(n) = (float32_t)block(n);
+		}
+	}
+
+	void fbpStreaming(const string& transmissionProjectionsFile, Image<float32_t>& output, const RecSettings& settings, coord_t chunkSize)
+	{
+		Vec3c dimensions;
+		ImageDataType dt;
+		string reason;
+		if (!io::getInfo(transmissionProjectionsFile, dimensions, dt, reason))
+			throw ITLException(string("Unable to read transmission projections from ") + transmissionProjectionsFile + ". " + reason);
+
+		function<void(Image<float32_t>&, coord_t)> reader;
+		switch (dt)
+		{
+		case ImageDataType::Float32:
+			reader = [&](Image<float32_t>& chunk, coord_t firstAngle) { io::readBlock(chunk, transmissionProjectionsFile, Vec3c(0, 0, firstAngle)); };
+			break;
+		case ImageDataType::UInt8:
+			reader = [&](Image<float32_t>& chunk, coord_t firstAngle) { internals::readProjectionBlock<uint8_t>(chunk, transmissionProjectionsFile, firstAngle); };
+			break;
+		case ImageDataType::UInt16:
+			reader = [&](Image<float32_t>& chunk, coord_t firstAngle) { internals::readProjectionBlock<uint16_t>(chunk, transmissionProjectionsFile, firstAngle); };
+			break;
+		case ImageDataType::UInt32:
+			reader = [&](Image<float32_t>& chunk, coord_t firstAngle) { internals::readProjectionBlock<uint32_t>(chunk, transmissionProjectionsFile, firstAngle); };
+			break;
+		default:
+			throw ITLException(string("Unsupported pixel data type in transmission projections: ") + toString(dt));
+		}
+
+		fbpStreaming(reader, dimensions, output, settings, chunkSize);
+	}
+
+
 
 
 #if defined(USE_OPENCL)
@@ -1675,6 +2026,160 @@ kernel void backproject(read_only image3d_t transmissionProjections,
 			raw::writed(slice, "./fbp/after_paganin");
 		}
 
+		/**
+		Creates reconstruction settings for testing the backprojection with synthetic data.
+		*/
+		RecSettings backprojectionTestSettings(coord_t angleCount)
+		{
+			RecSettings settings;
+			settings.sourceToRA = 500;
+			settings.reconstructAs180degScan = false;
+			settings.centerShift = 1.5f;
+			settings.cameraZShift = 2.0f;
+			settings.csAngleSlope = 0.001f;
+			settings.csZSlope = 0.002f;
+			settings.rotation = 10;
+			for (coord_t n = 0; n < angleCount; n++)
+			{
+				settings.angles.push_back(360.0f * n / angleCount);
+				settings.objectShifts.push_back(Vec2f(2.0f * sin((float32_t)n), 1.5f * cos((float32_t)n)));
+			}
+			return settings;
+		}
+
+		void cpuBackProjection(const Image<float32_t>& projections, const RecSettings& settings, const string& name)
+		{
+			Image<float32_t> reference;
+			backproject(projections, settings, reference);
+
+			for (coord_t angleBlockSize : { 1, 7, 1000 })
+			{
+				Image<float32_t> output;
+				backprojectBlocks(projections, settings, output, angleBlockSize);
+
+				// The values are sums of hundreds of terms, so allow for rounding errors relative to the magnitude of the values.
+				double tolerance = 1e-5 * std::max(1.0, (double)max(reference));
+				checkDifference(output, reference, "CPU backprojection in blocks, " + name + ", angle block size " + toString(angleBlockSize), tolerance);
+			}
+		}
+
+		void cpuBackProjection()
+		{
+			Image<float32_t> projections(71, 23, 90);
+			noise(projections, 0, 1, 1);
+
+			RecSettings settings = backprojectionTestSettings(projections.depth());
+			cpuBackProjection(projections, settings, "full ROI");
+
+			settings.roiSize = Vec3c(40, 35, 5);
+			settings.roiCenter = Vec3c(-7, 3, 4);
+			settings.rotationDirection = RotationDirection::Counterclockwise;
+			cpuBackProjection(projections, settings, "ROI");
+
+			settings = backprojectionTestSettings(projections.depth());
+			settings.sourceToRA = 1e6f;
+			settings.useShifts = false;
+			cpuBackProjection(projections, settings, "parallel beam");
+
+			// Integer output
+			settings = backprojectionTestSettings(projections.depth());
+			settings.dynMin = -10;
+			settings.dynMax = 10;
+			Image<uint16_t> reference, output;
+			backproject(projections, settings, reference);
+			backprojectBlocks(projections, settings, output);
+			checkDifference(output, reference, "CPU backprojection in blocks, uint16 output", 1.01);
+		}
+
+		void cpuBackProjectionSpeed()
+		{
+			Image<float32_t> projections(256, 64, 360);
+			noise(projections, 0, 1, 1);
+
+			RecSettings settings = backprojectionTestSettings(projections.depth());
+
+			Timer timer;
+			Image<float32_t> reference;
+			timer.start();
+			backproject(projections, settings, reference);
+			timer.stop();
+			cout << "Voxel-driven backprojection takes " << timer.getSeconds() << " s" << endl;
+
+			Image<float32_t> output;
+			timer.start();
+			backprojectBlocks(projections, settings, output);
+			timer.stop();
+			cout << "Backprojection in blocks takes " << timer.getSeconds() << " s" << endl;
+
+			checkDifference(output, reference, "CPU backprojection in blocks", 1e-5 * std::max(1.0, (double)max(reference)));
+		}
+
+		/**
+		Tolerance for comparison of reconstructions whose values are sums of hundreds of terms.
+		*/
+		double reconstructionTolerance(const Image<float32_t>& reference)
+		{
+			return 1e-5 * std::max({ 1.0, (double)max(reference), -(double)min(reference) });
+		}
+
+		void fbpStreaming(const Image<float32_t>& projections, const RecSettings& settings, const string& name)
+		{
+			Image<float32_t> preprocessed, reference;
+			fbpPreprocess(projections, preprocessed, settings);
+			backprojectBlocks(preprocessed, settings, reference);
+
+			for (coord_t chunkSize : { 1, 7, 1000 })
+			{
+				Image<float32_t> output;
+				fbpStreaming([&](Image<float32_t>& chunk, coord_t firstAngle)
+					{
+						crop(projections, chunk, Vec3c(0, 0, firstAngle));
+					},
+					projections.dimensions(), output, settings, chunkSize);
+
+				checkDifference(output, reference, "streaming reconstruction, " + name + ", chunk size " + toString(chunkSize), reconstructionTolerance(reference));
+			}
+		}
+
+		void fbpStreaming()
+		{
+			Image<float32_t> projections(100, 30, 90);
+			noise(projections, 0.5, 0.1, 1);
+
+			RecSettings settings = backprojectionTestSettings(projections.depth());
+			fbpStreaming(projections, settings, "full ROI");
+
+			RecSettings settings180 = settings;
+			settings180.reconstructAs180degScan = true;
+			settings180.centralAngleFor180degScan = 135;
+			settings180.removeDeadPixels = true;
+			fbpStreaming(projections, settings180, "180 degree scan");
+
+			RecSettings binned = settings;
+			binned.binning = 2;
+			binned.cropSize = Vec2c(5, 3);
+			binned.roiSize = Vec3c(40, 30, 10);
+			binned.roiCenter = Vec3c(5, -3, 2);
+			fbpStreaming(projections, binned, "crop and binning");
+
+			// Read from file
+			Image<uint16_t> projections16(projections.dimensions());
+			for (coord_t n = 0; n < projections.pixelCount(); n++)
+				projections16(n) = pixelRound<uint16_t>(projections(n) * 10000);
+			raw::writed(projections16, "./fbp/streaming_projections");
+
+			Image<float32_t> projectionsFromFile;
+			convert(projections16, projectionsFromFile);
+
+			Image<float32_t> preprocessed, reference;
+			fbpPreprocess(projectionsFromFile, preprocessed, settings);
+			backprojectBlocks(preprocessed, settings, reference);
+
+			Image<float32_t> output;
+			fbpStreaming("./fbp/streaming_projections_100x30x90.raw", output, settings, 16);
+			checkDifference(output, reference, "streaming reconstruction from file", reconstructionTolerance(reference));
+		}
+
 		void fbp()
 		{
 			// TODO: Test data is not available.
@@ -8,6 +8,8 @@
 #endif
 
 #include <vector>
+#include <algorithm>
+#include <functional>
 
 #include "image.h"
 #include "math/vec2.h"
@@ -471,6 +473,8 @@ namespace itl2
 	{
 		void sanityCheck(const Image<float32_t>& transmissionProjections, RecSettings& settings, bool projectionsAreBinned);
 
+		void sanityCheck(const Vec3c& projectionSize, RecSettings& settings, bool projectionsAreBinned);
+
 		float32_t calculateTrueCentralAngle(float32_t centralAngleFor180degScan, const std::vector<float32_t>& angles, float32_t gammamax0);
 
 		float32_t calculateGammaMax0(float32_t projectionWidth, float32_t d);
@@ -575,18 +579,25 @@ namespace itl2
 		// TODO: Should subtraction be done for all the components?
 		Vec3f center = Vec3f(settings.roiSize) / 2.0f - Vec3f(settings.roiCenter) - Vec3f(0, 0, 0.5);
 
+		// Backproject one row of the output image at a time.
+		coord_t rowCount = settings.roiSize.y * settings.roiSize.z;
 		size_t counter = 0;
-		#pragma omp parallel for if(!omp_in_parallel() && settings.roiSize.z > 1)
-		for(coord_t z = 0; z < settings.roiSize.z; z++)
+		#pragma omp parallel if(!omp_in_parallel() && rowCount > 1)
 		{
-			#pragma omp parallel for if(!omp_in_parallel() && settings.roiSize.y > 1)
-			for(coord_t y = 0; y < settings.roiSize.y; y++)
+			// Buffers for positions, weights and values of the current voxel in all projections.
+			std::vector<Vec3f> positions(transmissionProjections.depth());
+			std::vector<float32_t> weights(transmissionProjections.depth());
+			std::vector<float32_t> values(transmissionProjections.depth());
+
+			#pragma omp for
+			for (coord_t row = 0; row < rowCount; row++)
 			{
-				#pragma omp parallel for if(!omp_in_parallel() && settings.roiSize.x > 1)
-				for(coord_t x = 0; x < settings.roiSize.x; x++)
+				coord_t y = row % settings.roiSize.y;
+				coord_t z = row / settings.roiSize.y;
+
+				for (coord_t x = 0; x < settings.roiSize.x; x++)
 				{
-					// Sum contributions from all projections
-					float32_t sum = 0;
+					// Calculate positions in all projections and interpolate them at once
 					for (coord_t anglei = 0; anglei < transmissionProjections.depth(); anglei++)
 					{
 						Vec3f rho = Vec3f((float32_t)x, (float32_t)y, (float32_t)z) - center;
@@ -614,9 +625,17 @@ namespace itl2
 
 						// TODO: Handle camera rotation here
 
-						sum += w * interpolator(transmissionProjections, ix, iy, (float32_t)anglei);
+						positions[anglei] = Vec3f(ix, iy, (float32_t)anglei);
+						weights[anglei] = w;
 					}
 
+					interpolator.interpolateRow(transmissionProjections, positions.data(), transmissionProjections.depth(), values.data());
+
+					// Sum contributions from all projections
+					float32_t sum = 0;
+					for (coord_t anglei = 0; anglei < transmissionProjections.depth(); anglei++)
+						sum += weights[anglei] * values[anglei];
+
 					sum *= normFact;
 
 					// Scaling
@@ -624,12 +643,156 @@ namespace itl2
 					//output(x, y, zi) = pixelRound<out_t>(sum);
 					output(x, y, z) = pixelRound<out_t>(sum);
 				}
+
+				showThreadProgress(counter, rowCount);
 			}
+		}
+	}
+
+	namespace internals
+	{
+		/**
+		Geometry of one projection, pre-calculated for backprojection.
+		*/
+		struct BackprojectionGeometry
+		{
+			/**
+			Cosine and sine of the projection angle.
+			*/
+			float32_t c, s;
+
+			/**
+			Offset added to the ideal horizontal detector position, including center shift, its angular perturbation and object shift.
+			*/
+			float32_t ix0;
+
+			/**
+			Offset added to the ideal vertical detector position, including camera z shift and object shift.
+			*/
+			float32_t iy0;
+		};
+
+		/**
+		Calculates geometry of each projection for backprojection.
+		@param settings Reconstruction settings where binning has been applied.
+		*/
+		std::vector<BackprojectionGeometry> calculateBackprojectionGeometry(const RecSettings& settings, coord_t projectionWidth, coord_t projectionHeight);
+
+		/**
+		Calculates location of the center of the reconstruction in the output image.
+		*/
+		inline Vec3f backprojectionCenter(const RecSettings& settings)
+		{
+			// NOTE: -0.5 ensures that if roiSize.z == 1, roiCenter.z = 1 / 2 - roiCenter.z - 0.5 = roiCenter.z
+			return Vec3f(settings.roiSize) / 2.0f - Vec3f(settings.roiCenter) - Vec3f(0, 0, 0.5);
+		}
+
+		/**
+		Count of consecutive output rows in the y-direction in a tile processed by backprojectTile.
+		*/
+		constexpr coord_t BACKPROJECTION_TILE_ROWS = 8;
+
+		/**
+		Adds contribution of given projections to a tile of output rows [yStart, yEnd[ on slice z.
+		The projections are processed in blocks of angleBlockSize angles so that the projection rows
+		needed for the tile stay in the cache while all the rows of the tile are processed.
+		@param projections Preprocessed projections.
+		@param firstAngle Index of the first projection in projections in the list of all angles.
+		@param geometry Geometry of all projections.
+		@param settings Reconstruction settings where binning has been applied.
+		@param sums Pointer to the accumulator of the first pixel of row yStart. The rows must be stored consecutively.
+		*/
+		void backprojectTile(const Image<float32_t>& projections, coord_t firstAngle, const std::vector<BackprojectionGeometry>& geometry, const RecSettings& settings,
+			const Vec3f& center, coord_t z, coord_t yStart, coord_t yEnd, float32_t* sums, coord_t angleBlockSize);
+	}
 
-			showThreadProgress(counter, settings.roiSize.z);
+	/**
+	Backprojection step of filtered backprojection algorithm, optimized for CPU.
+	Gives the same result than backproject function within floating point accuracy.
+	The geometry of each projection is calculated only once, and the output is processed in tiles of a few rows.
+	The projections are processed in blocks of given count of angles so that the projection rows needed
+	for a tile stay in the cache while the tile is processed.
+	The innermost loops run along the x-direction of the output, and the geometry calculations in them are vectorized.
+	@param angleBlockSize Count of projections in each block.
+	*/
+	template<typename out_t> void backprojectBlocks(const Image<float32_t>& transmissionProjections, RecSettings settings, Image<out_t>& output, coord_t angleBlockSize = 32)
+	{
+		internals::sanityCheck(transmissionProjections, settings, true);
+		output.mustNotBe(transmissionProjections);
+
+		internals::applyBinningToParameters(settings);
+
+		output.ensureSize(settings.roiSize);
+
+		if (transmissionProjections.width() > std::numeric_limits<int32_t>::max() / std::max<coord_t>(transmissionProjections.height(), 1))
+			throw ITLException("The projections are too large for backprojection.");
+
+		if (angleBlockSize < 1)
+			angleBlockSize = 1;
+
+		float32_t normFact = normFactor(settings);
+
+		std::vector<internals::BackprojectionGeometry> geometry = internals::calculateBackprojectionGeometry(settings, transmissionProjections.width(), transmissionProjections.height());
+		Vec3f center = internals::backprojectionCenter(settings);
+
+		constexpr coord_t TILE_ROWS = internals::BACKPROJECTION_TILE_ROWS;
+		coord_t tilesPerSlice = (settings.roiSize.y + TILE_ROWS - 1) / TILE_ROWS;
+		coord_t tileCount = tilesPerSlice * settings.roiSize.z;
+
+		size_t counter = 0;
+		#pragma omp parallel if(!omp_in_parallel() && tileCount > 1)
+		{
+			std::vector<float32_t> sums(TILE_ROWS * settings.roiSize.x);
+
+			#pragma omp for schedule(dynamic)
+			for (coord_t tile = 0; tile < tileCount; tile++)
+			{
+				coord_t z = tile / tilesPerSlice;
+				coord_t yStart = (tile % tilesPerSlice) * TILE_ROWS;
+				coord_t yEnd = std::min(yStart + TILE_ROWS, settings.roiSize.y);
+
+				std::fill(sums.begin(), sums.end(), 0.0f);
+
+				internals::backprojectTile(transmissionProjections, 0, geometry, settings, center, z, yStart, yEnd, &sums[0], angleBlockSize);
+
+				for (coord_t y = yStart; y < yEnd; y++)
+				{
+					const float32_t* rowSums = &sums[(y - yStart) * settings.roiSize.x];
+					for (coord_t x = 0; x < settings.roiSize.x; x++)
+					{
+						float32_t sum = rowSums[x] * normFact;
+
+						// Scaling
+						sum = (sum - settings.dynMin) / (settings.dynMax - settings.dynMin) * NumberUtils<out_t>::scale();
+						output(x, y, z) = pixelRound<out_t>(sum);
+					}
+				}
+
+				showThreadProgress(counter, tileCount);
+			}
 		}
 	}
 
+	/**
+	Filtered backprojection where the transmission projections are read, preprocessed and backprojected in chunks of consecutive angles.
+	The next chunk is read while the current chunk is preprocessed and backprojected, and the backprojected chunk is accumulated
+	to the output image. Only a few chunks of projections are in memory at any time.
+	Gives the same result than fbpPreprocess followed by backprojectBlocks within floating point accuracy.
+	@param readProjections Function that reads transmission projections of angles [firstAngle, firstAngle + chunk.depth()[ to the given image. The size of the image has been set.
+	This function is called from a thread that is not the calling thread.
+	@param projectionSize Dimensions of the whole transmission projection stack.
+	@param output Output image. Its size is set automatically.
+	@param chunkSize Count of projections in each chunk.
+	*/
+	void fbpStreaming(const std::function<void(Image<float32_t>& chunk, coord_t firstAngle)>& readProjections, const Vec3c& projectionSize, Image<float32_t>& output, RecSettings settings, coord_t chunkSize = 16);
+
+	/**
+	Filtered backprojection where the transmission projections are read from a file in chunks.
+	See the other overload for details.
+	Supported pixel data types of the file are uint8, uint16, uint32 and float32.
+	*/
+	void fbpStreaming(const std::string& transmissionProjectionsFile, Image<float32_t>& output, const RecSettings& settings, coord_t chunkSize = 16);
+
 #if defined(USE_OPENCL)
 	void backprojectOpenCLProjectionOutputBlocks(const Image<float32_t>& transmissionProjections, RecSettings settings, Image<float32_t>& output, coord_t maxOutputBlockSizeZ = 8, coord_t maxProjectionBlockSizeZ = std::numeric_limits<coord_t>::max());
 #endif
@@ -640,6 +803,9 @@ namespace itl2
 		void recSettings();
 		void fbp();
 		void paganin();
+		void cpuBackProjection();
+		void cpuBackProjectionSpeed();
+		void fbpStreaming();
 
 		void openCLBackProjection();
 		void openCLBackProjectionRealBin2();
@@ -6,6 +6,9 @@
 #include "pointprocess.h"
 #include "testutils.h"
 #include "generation.h"
+#include "timer.h"
+
+#include <random>
 
 
 using namespace std;
@@ -257,5 +260,144 @@ namespace itl2
 			singleCropTest(Vec3c(110, 90, 0));
 			singleCropTest(Vec3c(-50, 90, 0));
 		}
+
+		/**
+		Tests that interpolateRow gives the same results than interpolating each location separately.
+		*/
+		template<typename out_t, typename in_t> void checkInterpolateRow(const Image<in_t>& img, const Interpolator<out_t, in_t>& interpolate, const string& name)
+		{
+			using real_t = typename NumberUtils<out_t>::RealFloatType;
+
+			mt19937 gen(2);
+			uniform_real_distribution<real_t> dist(-3, 3);
+
+			// Random locations, also outside of the image and near its edges.
+			// In 2D images, every other location is in the plane z = 0, like in 2D transformations.
+			coord_t count = 1000;
+			vector<Vec3<real_t> > positions;
+			for (coord_t i = 0; i < count; i++)
+			{
+				Vec3<real_t> d(dist(gen), dist(gen), dist(gen));
+				if (img.depth() == 1 && i % 2 == 0)
+					d.z = 0;
+				positions.push_back(Vec3<real_t>((real_t)(img.width() / 2) + d.x * img.width() / 4, (real_t)(img.height() / 2) + d.y * img.height() / 4, (real_t)(img.depth() / 2) + d.z * img.depth() / 4));
+			}
+
+			vector<out_t> result(count);
+			interpolate.interpolateRow(img, positions.data(), count, result.data());
+			size_t errors = 0;
+			for (coord_t i = 0; i < count; i++)
+			{
+				if (!(result[i] == interpolate(img, positions[i])))
+					errors++;
+			}
+			testAssert(errors == 0, string("interpolateRow with positions, ") + name);
+
+			// Affine rows in all directions.
+			errors = 0;
+			for (coord_t i = 0; i < 100; i++)
+			{
+				Vec3<real_t> start = positions[i];
+				Vec3<real_t> step(dist(gen) / 2, dist(gen) / 2, dist(gen) / 2);
+				if (img.depth() == 1 && i % 2 == 0)
+					step.z = 0;
+				interpolate.interpolateRow(img, start, step, count, result.data());
+				for (coord_t n = 0; n < count; n++)
+				{
+					if (!(result[n] == interpolate(img, start.x + (real_t)n * step.x, start.y + (real_t)n * step.y, start.z + (real_t)n * step.z)))
+						errors++;
+				}
+			}
+			testAssert(errors == 0, string("interpolateRow with start and step, ") + name);
+		}
+
+		template<typename out_t, typename in_t> void checkInterpolateRow(const Image<in_t>& img)
+		{
+			for (BoundaryCondition bc : { BoundaryCondition::Zero, BoundaryCondition::Nearest })
+			{
+				string bcName = bc == BoundaryCondition::Zero ? "zero" : "nearest";
+				checkInterpolateRow(img, NearestNeighbourInterpolator<out_t, in_t>(bc), "nearest neighbour, " + bcName);
+				checkInterpolateRow(img, LinearInterpolator<out_t, in_t>(bc), "linear, " + bcName);
+				checkInterpolateRow(img, LinearInvalidValueInterpolator<out_t, in_t>(bc, 0, 0), "linear with invalid value, " + bcName);
+				checkInterpolateRow(img, CubicInterpolator<out_t, in_t>(bc), "cubic, " + bcName);
+				checkInterpolateRow(img, CubicInvalidValueInterpolator<out_t, in_t>(bc, 0, 0), "cubic with invalid value, " + bcName);
+			}
+		}
+
+		/**
+		Compares speed and results of translating the given image pixel by pixel and row by row.
+		*/
+		void compareRowInterpolation(const Image<float32_t>& big, const Vec3d& shift, const string& name)
+		{
+			Image<float32_t> outPixels(big.dimensions());
+			Image<float32_t> outRows(big.dimensions());
+
+			for (InterpolationMode mode : { InterpolationMode::Nearest, InterpolationMode::Linear, InterpolationMode::Cubic })
+			{
+				shared_ptr<Interpolator<float32_t, float32_t> > interpolate = createInterpolator<float32_t, float32_t>(mode, BoundaryCondition::Zero);
+
+				Timer timer;
+				timer.start();
+				#pragma omp parallel for
+				for (coord_t z = 0; z < big.depth(); z++)
+				{
+					for (coord_t y = 0; y < big.height(); y++)
+					{
+						for (coord_t x = 0; x < big.width(); x++)
+							outPixels(x, y, z) = (*interpolate)(big, (float32_t)(x - shift.x), (float32_t)(y - shift.y), (float32_t)(z - shift.z));
+					}
+				}
+				timer.stop();
+				cout << name << ", " << toString(mode) << " interpolation pixel by pixel took " << timer.getSeconds() << " s" << endl;
+
+				timer.start();
+				itl2::translate(big, outRows, shift, *interpolate);
+				timer.stop();
+				cout << name << ", " << toString(mode) << " interpolation row by row took " << timer.getSeconds() << " s" << endl;
+
+				checkDifference(outPixels, outRows, "translation row by row and pixel by pixel, " + name);
+			}
+		}
+
+		void interpolateRow()
+		{
+			Image<uint16_t> img16(40, 30, 20);
+			Image<float32_t> img32(40, 30, 20);
+			mt19937 gen(1);
+			uniform_int_distribution<int> dist(0, 1000);
+			for (coord_t n = 0; n < img16.pixelCount(); n++)
+			{
+				// Some zeroes for the invalid value interpolators.
+				int v = dist(gen);
+				img16(n) = (uint16_t)(v < 100 ? 0 : v);
+				img32(n) = (float32_t)img16(n) / 7;
+			}
+
+			checkInterpolateRow<uint16_t, uint16_t>(img16);
+			checkInterpolateRow<float32_t, float32_t>(img32);
+			checkInterpolateRow<float32_t, uint16_t>(img16);
+
+			Image<float32_t> img2D(50, 40);
+			Image<uint16_t> img2D16(50, 40);
+			for (coord_t n = 0; n < img2D.pixelCount(); n++)
+			{
+				int v = dist(gen);
+				img2D16(n) = (uint16_t)(v < 100 ? 0 : v);
+				img2D(n) = (float32_t)img2D16(n);
+			}
+			checkInterpolateRow<float32_t, float32_t>(img2D);
+			checkInterpolateRow<uint16_t, uint16_t>(img2D16);
+
+			// Compare speed of interpolating pixel by pixel and row by row.
+			Image<float32_t> big(200, 200, 200);
+			for (coord_t n = 0; n < big.pixelCount(); n++)
+				big(n) = (float32_t)dist(gen);
+			compareRowInterpolation(big, Vec3d(2.25, -1.625, 0.375), "3D");
+
+			Image<float32_t> big2D(3000, 3000);
+			for (coord_t n = 0; n < big2D.pixelCount(); n++)
+				big2D(n) = (float32_t)dist(gen);
+			compareRowInterpolation(big2D, Vec3d(2.25, -1.625, 0), "2D");
+		}
 	}
 }
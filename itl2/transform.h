@@ -241,15 +241,32 @@ namespace itl2
 		out.mustNotBe(in);
 
 		using real_t = double;
+		using interp_real_t = typename NumberUtils<out_t>::RealFloatType;
 		Matrix3x3<real_t> R = Matrix3x3<real_t>::rotationMatrix(angle, axis);
 		R.transpose();
 
-		forAllPixels(out, [&](coord_t x, coord_t y, coord_t z)
+		// Interpolate one row of the output image at a time.
+		coord_t rowCount = out.height() * out.depth();
+		#pragma omp parallel if(out.pixelCount() > PARALLELIZATION_THRESHOLD && !omp_in_parallel())
 		{
-			Vec3d outPos((real_t)x, (real_t)y, (real_t)z);
-			Vec3d inPos = R * (outPos - outCenter) + inCenter;
-			out(x, y, z) = interpolate(in, Vec3<typename NumberUtils<out_t>::RealFloatType>(inPos));
-		});
+			std::vector<Vec3<interp_real_t> > positions(out.width());
+
+			#pragma omp for
+			for (coord_t row = 0; row < rowCount; row++)
+			{
+				coord_t y = row % out.height();
+				coord_t z = row / out.height();
+
+				for (coord_t x = 0; x < out.width(); x++)
+				{
+					Vec3d outPos((real_t)x, (real_t)y, (real_t)z);
+					Vec3d inPos = R * (outPos - outCenter) + inCenter;
+					positions[x] = Vec3<interp_real_t>(inPos);
+				}
+
+				interpolate.interpolateRow(in, positions.data(), out.width(), &out(0, y, z));
+			}
+		}
 	}
 
 	/**
@@ -282,13 +299,17 @@ namespace itl2
 		if(out.dimensions().max() <= 1)
 			out.ensureSize(in);
 
-		forAllPixels(out, [&](coord_t x, coord_t y, coord_t z)
+		// Interpolate one row of the output image at a time.
+		coord_t rowCount = out.height() * out.depth();
+		#pragma omp parallel for if(out.pixelCount() > PARALLELIZATION_THRESHOLD && !omp_in_parallel())
+		for (coord_t row = 0; row < rowCount; row++)
 		{
-			real_t xs = (real_t)(x - shift.x);
-			real_t ys = (real_t)(y - shift.y);
-			real_t zs = (real_t)(z - shift.z);
-			out(x, y, z) = interpolate(in, xs, ys, zs);
-		});
+			coord_t y = row % out.height();
+			coord_t z = row / out.height();
+
+			Vec3<real_t> start((real_t)(0 - shift.x), (real_t)(y - shift.y), (real_t)(z - shift.z));
+			interpolate.interpolateRow(in, start, Vec3<real_t>(1, 0, 0), out.width(), &out(0, y, z));
+		}
 	}
 
 	/**
@@ -554,15 +575,21 @@ namespace itl2
 			#pragma omp parallel for if(out.pixelCount() > PARALLELIZATION_THRESHOLD && !omp_in_parallel())
 			for (coord_t z = 0; z < out.depth(); z++)
 			{
+				std::vector<Vec3<real_t> > positions(out.width());
+				for (coord_t x = 0; x < out.width(); x++)
+					positions[x].x = (real_t)(x / factor.x) + (real_t)delta.x;
+
 				real_t sz = (real_t)(z / factor.z) + (real_t)delta.z;
 				for (coord_t y = 0; y < out.height(); y++)
 				{
 					real_t sy = (real_t)(y / factor.y) + (real_t)delta.y;
 					for (coord_t x = 0; x < out.width(); x++)
 					{
-						real_t sx = (real_t)(x / factor.x) + (real_t)delta.x;
-						out(x, y, z) = interpolate(in, sx, sy, sz);
+						positions[x].y = sy;
+						positions[x].z = sz;
 					}
+
+					interpolate.interpolateRow(in, positions.data(), out.width(), &out(0, y, z));
 				}
 
 				showThreadProgress(counter, out.depth(), indicateProgress);
@@ -888,6 +915,7 @@ namespace itl2
 		void rotate();
 		void reslice();
 		void crop();
+		void interpolateRow();
 	}
 
 }
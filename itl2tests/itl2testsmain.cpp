@@ -10,6 +10,9 @@
 #include "io/itltiff.h"
 #include "io/nrrd.h"
 #include "io/pcr.h"
+#include "io/parallelread.h"
+#include "io/writebehind.h"
+#include "io/nn5.h"
 #include "sphere.h"
 #include "testutils.h"
 #include "io/itlpng.h"
@@ -24,9 +27,11 @@
 #include "lineskeleton.h"
 #include "surfaceskeleton.h"
 #include "surfaceskeleton2.h"
+#include "thinninglut.h"
 #include "traceskeleton.h"
 #include "structure.h"
 #include "particleanalysis.h"
+#include "connectedcomponents.h"
 #include "regionremoval.h"
 #include "fastbilateralfilter.h"
 #include "minhash.h"
@@ -49,6 +54,7 @@
 #include "csa.h"
 #include "pathopening.h"
 #include "eval.h"
+#include "evalplan.h"
 #include "sdmap.h"
 
 
@@ -74,6 +80,7 @@ int main()
 	//test(itl2::tests::conjugateGradient, "Conjugate gradient");
 	//test(itl2::tests::cgne, "CGNE");
 	//test(itl2::tests::image, "Image");
+	//test(itl2::tests::externalBuffer, "Image with external buffer");
 
 	//test(raw::tests::parseDimensions, "Parse raw dimensions from file name");
 	//test(raw::tests::expandFilename, "Raw filename expansion");
@@ -81,6 +88,11 @@ int main()
 	//test(io::tests::readWrite, "IO read");
 	//test(raw::tests::writeBlock, "Block based raw reader & writer");
 	//test(raw::tests::writeBlockFast, "Optimized block based raw reader & writer");
+	//test(itl2::tests::parallelRead, "Parallel file reader");
+	//test(itl2::tests::writeBehind, "Write-behind");
+	//test(itl2::nn5::tests::lz4, "LZ4 compression");
+	//test(itl2::nn5::tests::nn5io, "NN5 read and write");
+	//test(itl2::nn5::tests::nn5ConcurrentWrite, "NN5 concurrent block writes");
 	//test(vol::tests::volio, ".vol input/output");
 	//test(itl2::png::tests::png, "Png read and write");
 	//test(itl2::tiff::tests::readWrite, "Tiff read and write");
@@ -108,6 +120,8 @@ int main()
 	//test(itl2::tests::bandpass, "Bandpass filtering");
 	//test(itl2::tests::projections2, "projections 2");
 	//test(itl2::tests::filters, "filtering");
+	//test(itl2::tests::neighbourhoodViewFiltering, "filtering through neighbourhood views");
+	//test(itl2::tests::histogramPercentileFilter, "sliding histogram median and percentile filters");
 
 	//test(itl2::tests::broadcast, "Broadcasted point process");
 	//test(itl2::tests::bilateral, "bilateral filter");
@@ -118,6 +132,7 @@ int main()
 	//test(itl2::tests::rotate, "rotations around general axes");
 	//test(itl2::tests::reslice, "reslice");
 	//test(itl2::tests::crop, "crop and reverse crop");
+	//test(itl2::tests::interpolateRow, "row-by-row interpolation");
 
 	//test(itl2::tests::pointProcess, "point processes");
 	//test(itl2::tests::pointProcessComplex, "point processes on complex numbers");
@@ -126,6 +141,7 @@ int main()
 
 	//test(itl2::tests::phaseCorrelation, "phase correlation");
 	//test(itl2::tests::modulo, "modulo function");
+	//test(itl2::tests::fftPlanCache, "FFT plan cache");
 
 	//test(itl2::tests::phaseCorrelation2, "phase correlation 2 (rotation)");
 
@@ -137,11 +153,14 @@ int main()
 	//test(itl2::tests::inpaintGarcia, "Inpainting (Garcia)");
 	//test(itl2::tests::inpaintGarcia2, "Inpainting 2 (Garcia)");
 	//test(itl2::tests::dmap1, "Distance map");
+	//test(itl2::tests::dmapTiled, "Tiled distance map");
+	//test(itl2::tests::dmapTiledSpeed, "Tiled distance map speed"); // This is a long test
 
 	//test(itl2::tests::buffers, "Disk mapped buffer");
 	//test(itl2::tests::histogramIntermediateType, "Intermediate types in histogram");
 	//test(itl2::tests::histogram, "Histogram");
 	//test(itl2::tests::histogram2d, "Bivariate histogram");
+	//test(itl2::tests::histogramIntegerTypes, "Histogram of integer images");
 
 	//test(itl2::tests::binning, "Binning");
 	//test(itl2::tests::genericTransform, "Generic geometric transform");
@@ -150,6 +169,7 @@ int main()
 	//test(itl2::tests::floodfillSanityChecks, "sanity checks of flood fill implementations");
 	//test(itl2::tests::floodfillLeaks, "Flood fill leak tests");
 	//test(itl2::tests::floodfillThreading, "Flood fill multithreading");
+	//test(itl2::tests::floodfillWavefront, "Wavefront flood fill");
 
 	//test(itl2::tests::mipMatch, "MIP Match");
 
@@ -160,6 +180,9 @@ int main()
 	//test(itl2::tests::surfaceSkeleton, "Surface skeleton");
 	//test(itl2::experimental::tests::surfaceSkeleton2, "Hybrid skeleton 2");
 	//test(itl2::tests::lineSkeleton, "Line skeleton");
+	//test(itl2::tests::surfaceSkeletonBorderPoints, "Surface skeleton with border point list");
+	//test(itl2::tests::lineSkeletonBorderPoints, "Line skeleton with border point list");
+	//test(itl2::tests::thinningLUT, "Thinning lookup tables");
 
 	//test(itl2::tests::traceSkeleton, "trace skeleton");
 	//test(itl2::tests::traceSkeletonRealData, "trace skeleton (real data)");
@@ -179,8 +202,11 @@ int main()
 	//test(itl2::tests::analyzeParticlesSanity, "Analyze particles sanity checks");
 	//test(itl2::tests::analyzeParticlesSanity2, "Analyze particles sanity checks 2");
 	//test(itl2::tests::analyzeParticlesVolumeLimit, "Analyze particles volume limit");
+	//test(itl2::tests::particleRunAnalyzers, "Particle analyzers on run-length encoded particles");
 	//test(itl2::tests::analyzeParticlesThreading, "Analyze particles threading");
+	//test(itl2::tests::analyzeParticlesMergeable, "Analyze particles with mergeable analyzers");
 	//test(itl2::tests::analyzeParticlesThreadingBig, "Analyze particles threading, big volumes"); // This is a long test
+	//test(itl2::tests::labelConnectedComponents, "Parallel connected component labelling");
 
 	//test(itl2::tests::regionRemoval, "Region removal");
 
@@ -207,6 +233,9 @@ int main()
 
 	//test(itl2::tests::recSettings, "Rec settings");
 	//test(itl2::tests::paganin, "Paganin method");
+	//test(itl2::tests::cpuBackProjection, "CPU backprojection in blocks");
+	//test(itl2::tests::cpuBackProjectionSpeed, "CPU backprojection in blocks speed"); // This is a long test
+	//test(itl2::tests::fbpStreaming, "Streaming reconstruction");
 	//// NOTE: Data for these tests is not publicly available (yet)
 	////test(itl2::tests::fbp, "Filtered backprojection");
 	////test(itl2::tests::openCLBackProjection, "OpenCL filtered backprojection");
@@ -240,9 +269,11 @@ int main()
 	//test(itl2::tests::imagemetadata, "image metadata");
 
 	//test(itl2::tests::pointsToDeformed, "points to deformed");
+	//test(itl2::tests::stitchBlockwise, "block-wise stitching");
 	
 
 	//test(itl2::tests::eval, "evaluation of string expressions");
+	//test(itl2::tests::evalPlan, "vectorized evaluation of string expressions");
 
 	test(itl2::tests::seededDMap, "seeded distance map");
 
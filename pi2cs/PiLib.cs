@@ -161,6 +161,37 @@ namespace pi2cs
         [DllImport("pi", EntryPoint = "getImage")]
         public static extern IntPtr GetImage(IntPtr pi, string imgName, out Int64 width, out Int64 height, out Int64 depth, out ImageDataType dataType);
 
+        /**
+        Same than GetImage, but pins the image so that the returned pointer stays valid until ReleaseImage is called with it,
+        even if the image is removed from the system. Commands that would re-allocate the pixel data of a pinned image fail.
+        */
+        [DllImport("pi", EntryPoint = "pinImage")]
+        public static extern IntPtr PinImage(IntPtr pi, string imgName, out Int64 width, out Int64 height, out Int64 depth, out ImageDataType dataType);
+
+        /**
+        Releases a pin made with PinImage.
+        @param data Pointer returned by PinImage.
+        */
+        [DllImport("pi", EntryPoint = "releaseImage")]
+        [return: MarshalAs(UnmanagedType.U1)]
+        public static extern bool ReleaseImage(IntPtr pi, IntPtr data);
+
+        /**
+        Function that is called when the Pi2 system does not need a buffer given to CreateImageFromBuffer anymore.
+        */
+        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+        public delegate void ReleaseBufferCallback(IntPtr context);
+
+        /**
+        Creates image that uses pixel data owned by the caller without copying the data.
+        The data must stay valid and at the same address (e.g. pinned using GCHandle) until the release callback is called,
+        and the delegate must be kept alive until then, too.
+        If false is returned, the release callback is not called.
+        */
+        [DllImport("pi", EntryPoint = "createImageFromBuffer")]
+        [return: MarshalAs(UnmanagedType.U1)]
+        public static extern bool CreateImageFromBuffer(IntPtr pi, string imgName, IntPtr data, Int64 width, Int64 height, Int64 depth, ImageDataType dataType, ReleaseBufferCallback release, IntPtr context);
+
         /**
         Gets a string value from the Pi2 system.
         */
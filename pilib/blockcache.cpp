@@ -0,0 +1,197 @@
+
+#include "blockcache.h"
+#include "io/fileutils.h"
+
+#include <sstream>
+#include <algorithm>
+
+using namespace itl2;
+using namespace std;
+
+namespace pilib
+{
+	string BlockCache::key(const string& imageName, size_t version, const Vec3c& pos, const Vec3c& size)
+	{
+		stringstream s;
+		s << imageName << ":" << version << ":" << pos << ":" << size;
+		return s.str();
+	}
+
+	void BlockCache::write(Entry& e)
+	{
+		if (e.writer)
+		{
+			// The file of an old version of a temporary image may have been deleted. Its blocks are not needed anymore.
+			if (fileExists(e.file))
+				e.writer();
+			e.writer = nullptr;
+		}
+	}
+
+	void BlockCache::remove(list<Entry>::iterator it, bool write)
+	{
+		if (write)
+			BlockCache::write(*it);
+
+		index.erase(key(it->imageName, it->version, it->pos, it->size));
+		usedBytes -= it->bytes;
+		entries.erase(it);
+	}
+
+	bool BlockCache::evict(size_t bytesNeeded)
+	{
+		while (usedBytes + bytesNeeded > maxBytes && entries.size() > 0)
+			remove(std::prev(entries.end()));
+
+		return usedBytes + bytesNeeded <= maxBytes;
+	}
+
+	void BlockCache::capacity(size_t bytes)
+	{
+		unique_lock<std::mutex> lock(cacheMutex);
+		maxBytes = bytes;
+		evict(0);
+	}
+
+	size_t BlockCache::capacity() const
+	{
+		unique_lock<std::mutex> lock(cacheMutex);
+		return maxBytes;
+	}
+
+	size_t BlockCache::size() const
+	{
+		unique_lock<std::mutex> lock(cacheMutex);
+		return usedBytes;
+	}
+
+	shared_ptr<ImageBase> BlockCache::get(const string& imageName, size_t version, const Vec3c& pos, const Vec3c& size)
+	{
+		unique_lock<std::mutex> lock(cacheMutex);
+
+		auto it = index.find(key(imageName, version, pos, size));
+		if (it == index.end())
+		{
+			missCount++;
+			return nullptr;
+		}
+
+		hitCount++;
+
+		// Move to front of the LRU list.
+		entries.splice(entries.begin(), entries, it->second);
+		return it->second->block;
+	}
+
+	shared_ptr<ImageBase> BlockCache::take(const string& imageName, size_t version, const Vec3c& pos, const Vec3c& size)
+	{
+		unique_lock<std::mutex> lock(cacheMutex);
+
+		auto it = index.find(key(imageName, version, pos, size));
+		if (it == index.end())
+		{
+			missCount++;
+			return nullptr;
+		}
+
+		hitCount++;
+
+		shared_ptr<ImageBase> block = it->second->block;
+		remove(it->second, false);
+		return block;
+	}
+
+	bool BlockCache::stage(const string& imageName, const string& file, const Vec3c& pos, const Vec3c& size, shared_ptr<ImageBase> block, size_t bytes, std::function<void()> writer)
+	{
+		unique_lock<std::mutex> lock(cacheMutex);
+
+		if (!evict(bytes))
+			return false;
+
+		staged.push_back(Entry{ imageName, 0, pos, size, block, bytes, file, writer });
+		usedBytes += bytes;
+		return true;
+	}
+
+	void BlockCache::commit(const string& imageName, size_t version)
+	{
+		unique_lock<std::mutex> lock(cacheMutex);
+
+		// Old versions will not be requested anymore.
+		for (auto it = entries.begin(); it != entries.end();)
+		{
+			auto next = std::next(it);
+			if (it->imageName == imageName && it->version != version)
+				remove(it);
+			it = next;
+		}
+
+		vector<Entry> otherImages;
+		for (Entry& e : staged)
+		{
+			if (e.imageName == imageName)
+			{
+				e.version = version;
+				string k = key(e.imageName, e.version, e.pos, e.size);
+				auto old = index.find(k);
+				if (old != index.end())
+					remove(old->second);
+
+				entries.push_front(e);
+				index[k] = entries.begin();
+			}
+			else
+			{
+				otherImages.push_back(e);
+			}
+		}
+		staged = otherImages;
+	}
+
+	void BlockCache::discardStaged()
+	{
+		unique_lock<std::mutex> lock(cacheMutex);
+
+		for (const Entry& e : staged)
+			usedBytes -= e.bytes;
+		staged.clear();
+	}
+
+	void BlockCache::writeBack(const string& imageName, const vector<tuple<Vec3c, Vec3c> >& keep)
+	{
+		unique_lock<std::mutex> lock(cacheMutex);
+
+		for (Entry& e : entries)
+		{
+			if (e.imageName == imageName && std::find(keep.begin(), keep.end(), make_tuple(e.pos, e.size)) == keep.end())
+				write(e);
+		}
+	}
+
+	void BlockCache::writeBack()
+	{
+		unique_lock<std::mutex> lock(cacheMutex);
+
+		for (Entry& e : entries)
+			write(e);
+	}
+
+	size_t BlockCache::hits() const
+	{
+		unique_lock<std::mutex> lock(cacheMutex);
+		return hitCount;
+	}
+
+	size_t BlockCache::misses() const
+	{
+		unique_lock<std::mutex> lock(cacheMutex);
+		return missCount;
+	}
+
+	void BlockCache::resetStatistics()
+	{
+		unique_lock<std::mutex> lock(cacheMutex);
+		hitCount = 0;
+		missCount = 0;
+	}
+}
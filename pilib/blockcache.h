@@ -0,0 +1,179 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <tuple>
+
+#include "image.h"
+#include "math/vec3.h"
+
+namespace pilib
+{
+	/**
+	Least recently used cache of image blocks produced by distributed jobs that are run in the current process.
+	Blocks are identified by the unique name and data version of the distributed image, and the position and size of the block.
+	Blocks written by jobs are first staged, and they become available only after the jobs have finished successfully and
+	the new version of the image is known.
+	Staged blocks may be dirty, i.e. not written to their file yet. A dirty block is written to its file when it is removed
+	from the cache or when writeBack is called, unless the file has been deleted in the meantime.
+	*/
+	class BlockCache
+	{
+	private:
+		/**
+		One block stored in the cache.
+		*/
+		struct Entry
+		{
+			std::string imageName;
+			size_t version;
+			itl2::Vec3c pos;
+			itl2::Vec3c size;
+			std::shared_ptr<itl2::ImageBase> block;
+			size_t bytes;
+
+			/**
+			File where the block belongs to.
+			*/
+			std::string file;
+
+			/**
+			Writes the block to the file, or empty function if the block has been written already.
+			*/
+			std::function<void()> writer;
+		};
+
+		/**
+		Committed blocks, most recently used first.
+		*/
+		std::list<Entry> entries;
+
+		/**
+		Maps keys to committed blocks.
+		*/
+		std::unordered_map<std::string, std::list<Entry>::iterator> index;
+
+		/**
+		Blocks that have been written but not committed yet.
+		*/
+		std::vector<Entry> staged;
+
+		/**
+		Maximum amount of memory in bytes the blocks may use.
+		*/
+		size_t maxBytes = 0;
+
+		/**
+		Amount of memory in bytes used by committed and staged blocks.
+		*/
+		size_t usedBytes = 0;
+
+		/**
+		Count of successful and unsuccessful lookups since last call to resetStatistics.
+		*/
+		size_t hitCount = 0, missCount = 0;
+
+		mutable std::mutex cacheMutex;
+
+		static std::string key(const std::string& imageName, size_t version, const itl2::Vec3c& pos, const itl2::Vec3c& size);
+
+		/**
+		Removes least recently used committed blocks until the given amount of memory is available.
+		@return false if not enough memory could be freed.
+		*/
+		bool evict(size_t bytesNeeded);
+
+		/**
+		Removes the given committed block.
+		@param write Set to true to write the block to its file first if it is dirty.
+		*/
+		void remove(std::list<Entry>::iterator it, bool write = true);
+
+		/**
+		Writes the given block to its file if it is dirty and the file still exists, and marks the block clean.
+		The writes are made while the cache is locked so that a block that is not found from the cache can be read from the file.
+		*/
+		static void write(Entry& e);
+
+	public:
+		/**
+		Sets the maximum amount of memory in bytes that the cached blocks may use. Set to zero to disable the cache.
+		Blocks are evicted if necessary.
+		*/
+		void capacity(size_t bytes);
+
+		/**
+		Gets the maximum amount of memory in bytes that the cached blocks may use.
+		*/
+		size_t capacity() const;
+
+		/**
+		Gets the amount of memory in bytes used by the cached blocks.
+		*/
+		size_t size() const;
+
+		/**
+		Finds a block from the cache.
+		@return The cached block, or nullptr if the block is not in the cache. The returned block must not be modified.
+		*/
+		std::shared_ptr<itl2::ImageBase> get(const std::string& imageName, size_t version, const itl2::Vec3c& pos, const itl2::Vec3c& size);
+
+		/**
+		Finds a block from the cache and removes it from the cache.
+		Use for blocks that are going to be overwritten, e.g. blocks of images that are processed in-place.
+		A dirty block is not written to its file, so the caller must write the same block of the file.
+		@return The block, or nullptr if the block is not in the cache. The returned block may be modified.
+		*/
+		std::shared_ptr<itl2::ImageBase> take(const std::string& imageName, size_t version, const itl2::Vec3c& pos, const itl2::Vec3c& size);
+
+		/**
+		Stages a block that will be written to the given position of the given image. The block is not modified afterwards.
+		@param file File where the block belongs to.
+		@param writer Function that writes the block to the file. Pass empty function if the caller writes the block itself.
+		@return false if there is not enough space in the cache. In that case the block is not staged, and the caller must write it.
+		*/
+		bool stage(const std::string& imageName, const std::string& file, const itl2::Vec3c& pos, const itl2::Vec3c& size, std::shared_ptr<itl2::ImageBase> block, size_t bytes, std::function<void()> writer);
+
+		/**
+		Makes staged blocks of the given image available, and removes blocks of older versions of the image.
+		@param version New version of the image, i.e. version after all the staged blocks have been written.
+		*/
+		void commit(const std::string& imageName, size_t version);
+
+		/**
+		Removes all staged blocks. Call if the jobs that staged the blocks failed.
+		*/
+		void discardStaged();
+
+		/**
+		Writes the dirty committed blocks of the given image to their files.
+		@param keep Position and size of blocks that are not written. Use for blocks that are going to be taken and overwritten.
+		*/
+		void writeBack(const std::string& imageName, const std::vector<std::tuple<itl2::Vec3c, itl2::Vec3c> >& keep = std::vector<std::tuple<itl2::Vec3c, itl2::Vec3c> >());
+
+		/**
+		Writes all dirty committed blocks to their files.
+		*/
+		void writeBack();
+
+		/**
+		Gets count of successful lookups since last call to resetStatistics.
+		*/
+		size_t hits() const;
+
+		/**
+		Gets count of unsuccessful lookups since last call to resetStatistics.
+		*/
+		size_t misses() const;
+
+		/**
+		Sets hit and miss counts to zero.
+		*/
+		void resetStatistics();
+	};
+}
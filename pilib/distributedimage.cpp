@@ -8,6 +8,7 @@
 #include "utilities.h"
 
 #include "filesystem.h"
+#include <atomic>
 
 using namespace itl2;
 using namespace std;
@@ -37,15 +38,22 @@ namespace pilib
 		distributor->flush();
 	}
 
+	void DistributedImageBase::writeCachedBlocks() const
+	{
+		distributor->writeCachedBlocks(uniqueName());
+	}
+
 	void DistributedImageBase::newWriteTarget()
 	{
 		// If input is raw, output should be raw, too.
 		// If input is sequence, output should be sequence, too.
-		// If temp file names are not .raw, convert them to .raw
+		// If NN5 temporary files are used, output is always NN5.
+		// If temp file names are not of correct type, convert them.
 		// NOTE that if temps are not the same type than input file, the temps cannot be
 		// the input file and we can get rid of them.
-		if ((isRaw() && !endsWith(tempFilename1, ".raw")) ||
-			(!isRaw() && endsWith(tempFilename1, ".raw")))
+		string ext = tempFileExtension();
+		bool tempsOk = ext.length() > 0 ? endsWith(tempFilename1, ext) : (!endsWith(tempFilename1, ".raw") && !endsWith(tempFilename1, ".nn5"));
+		if (!tempsOk)
 		{
 			fs::remove_all(tempFilename1);
 			fs::remove_all(tempFilename2);
@@ -63,6 +71,17 @@ namespace pilib
 		}
 	}
 
+	string DistributedImageBase::tempFileExtension() const
+	{
+		if (distributor->useNN5Temps() || isNN5())
+			return ".nn5";
+
+		if (!fileExists(readSource) || isRaw())
+			return ".raw";
+
+		return "";
+	}
+
 	void DistributedImageBase::createTempFilenames()
 	{
 		stringstream s1, s2;
@@ -72,12 +91,17 @@ namespace pilib
 		// TODO: Name generated like this is not necessarily 100 % unique.
 		uniqName = name + "_" + itl2::toString(randc(10000));
 
-		//if (readSource == "" || isRaw())
-		if(!fileExists(readSource) || isRaw())
+		string ext = tempFileExtension();
+		if (ext == ".raw")
 		{
 			s1 << path << uniqueName() << "-1_" << dims.x << "x" << dims.y << "x" << dims.z << ".raw";
 			s2 << path << uniqueName() << "-2_" << dims.x << "x" << dims.y << "x" << dims.z << ".raw";
 		}
+		else if (ext == ".nn5")
+		{
+			s1 << path << uniqueName() << "-1.nn5";
+			s2 << path << uniqueName() << "-2.nn5";
+		}
 		else
 		{
 			s1 << path << uniqueName() << "-1/";
@@ -97,12 +121,20 @@ namespace pilib
 			fs::remove_all(tempFilename2);
 			dims = newDimensions;
 			createTempFilenames();
+			newVersion();
 		}
 	}
 
+	void DistributedImageBase::newVersion()
+	{
+		static std::atomic<size_t> versionCounter(0);
+		version = ++versionCounter;
+	}
+
 	void DistributedImageBase::setReadSource(const string& filename, bool check)
 	{
 		readSource = filename;
+		newVersion();
 
         if(filename != "")
         {
@@ -148,6 +180,8 @@ namespace pilib
 		stringstream s;
 		if(isOutputRaw())
 			s << "writerawblock(\"" << uniqueName() << "\", \"" << currentWriteTarget() << "\", " << filePos.x << ", " << filePos.y << ", " << filePos.z << ", " << dims.x << ", " << dims.y << ", " << dims.z << ", " << imagePos.x << ", " << imagePos.y << ", " << imagePos.z << ", " << blockSize.x << ", " << blockSize.y << ", " << blockSize.z << ");" << endl;
+		else if(isOutputNN5())
+			s << "writenn5block(\"" << uniqueName() << "\", \"" << currentWriteTarget() << "\", " << toString(filePos) << ", " << toString(dims) << ", " << toString(imagePos) << ", " << toString(blockSize) << ");" << endl;
 		else
 			s << "writesequenceblock(\"" << uniqueName() << "\", \"" << currentWriteTarget() << "\", " << filePos.x << ", " << filePos.y << ", " << filePos.z << ", " << dims.x << ", " << dims.y << ", " << dims.z << ", " << imagePos.x << ", " << imagePos.y << ", " << imagePos.z << ", " << blockSize.x << ", " << blockSize.y << ", " << blockSize.z << ");" << endl;
 			
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <functional>
 
 #include "math/vec3.h"
 #include "io/imagedatatype.h"
@@ -8,6 +9,7 @@
 #include "image.h"
 #include "io/raw.h"
 #include "io/io.h"
+#include "transform.h"
 
 
 using itl2::Vec3;
@@ -73,13 +75,30 @@ namespace pilib
 		*/
 		ImageDataType pixelDataType;
 
+		/**
+		Version of the image data. A new version number is assigned whenever the data of the image may change.
+		Version numbers are unique among all distributed images.
+		*/
+		size_t version;
+
+		/**
+		Assigns a new version number to this image.
+		*/
+		void newVersion();
+
 		/**
 		Generate filename for temporary storage.
-		If source file is raw, the temp file is raw.
-		Otherwise, the temp file is folder containing an image sequence.
+		If NN5 temporary format is selected in the distributor or the source file is NN5 dataset, the temp file is NN5 dataset.
+		Otherwise, if source file is raw, the temp file is raw,
+		and in all other cases the temp file is folder containing an image sequence.
 		*/
 		void createTempFilenames();
 
+		/**
+		Gets file name extension (.raw, .nn5, or empty for image sequences) that the temporary files of this image should have.
+		*/
+		std::string tempFileExtension() const;
+
 		/**
 		Changes the location where the image is read from.
 		@param check Set to false if calling from a constructor to avoid pure virtual call.
@@ -97,6 +116,12 @@ namespace pilib
 		*/
 		void flush() const;
 
+		/**
+		Object that exists as long as this image exists.
+		Deferred block writes check it so that they do not write to the temporary files of a deleted image.
+		*/
+		std::shared_ptr<bool> lifetime = std::make_shared<bool>(true);
+
 	public:
 
         /**
@@ -210,6 +235,59 @@ namespace pilib
 		*/
 		std::string emitWriteBlock(const Vec3c& filePos, const Vec3c& imagePos, const Vec3c& blockSize) const;
 
+		/**
+		Gets the version number of the image data. The version changes whenever the read source of the image changes or
+		the image is written.
+		*/
+		size_t dataVersion() const
+		{
+			return version;
+		}
+
+		/**
+		Copies a block of the given normal image to a new normal image.
+		The given image must have the same data type than this image.
+		*/
+		virtual std::shared_ptr<ImageBase> copyBlock(const ImageBase& img, const Vec3c& pos, const Vec3c& blockSize) const = 0;
+
+		/**
+		Reads a block of this image to a new normal image.
+		This is the in-process equivalent of the code generated by emitReadBlock.
+		Blocks held in the block cache of the distributor are not considered. The distributor writes them to the file
+		before starting jobs that read the file.
+		@param dataNeeded Set to true if the image is used as input data. Otherwise an empty block is created.
+		*/
+		virtual std::shared_ptr<ImageBase> readBlock(const Vec3c& filePos, const Vec3c& blockSize, bool dataNeeded) const = 0;
+
+		/**
+		Writes a block of the given normal image to the current write target of this image.
+		This is the in-process equivalent of the code generated by emitWriteBlock.
+		Writes to .raw files and image sequences are made in the background. Use itl2::flushWrites to wait for them.
+		*/
+		virtual void writeBlock(const ImageBase& block, const Vec3c& filePos, const Vec3c& imagePos, const Vec3c& blockSize) const = 0;
+
+		/**
+		Creates a function that writes the given block to the current write target of this image later, e.g. when the block
+		is removed from the block cache. The write target must exist before the function is called.
+		Returns empty function if the writes to the current write target cannot be deferred. This is the case for image sequences,
+		as the files of the sequence must exist when the write is completed.
+		*/
+		virtual std::function<void()> blockWriter(std::shared_ptr<ImageBase> block, const Vec3c& filePos, const Vec3c& blockSize) const = 0;
+
+		/**
+		Writes the blocks of this image that are stored only in the block cache of the distributor to the read source file.
+		Call before reading the read source file directly.
+		*/
+		void writeCachedBlocks() const;
+
+		/**
+		Estimates the fraction of non-zero pixels in the given block of this image.
+		The estimate is made from a small sample of the data, or from the stored chunks of NN5 datasets, so it is cheap to calculate.
+		Blocks held in the block cache of the distributor are not considered.
+		Returns 1 if the image has not been saved to disk.
+		*/
+		virtual double foregroundFraction(const Vec3c& filePos, const Vec3c& blockSize) const = 0;
+
 		/**
 		Call when all blocks of this image have been written.
 		*/
@@ -334,12 +412,46 @@ namespace pilib
 		*/
 		bool isOutputRaw() const
 		{
-		    return endsWith(currentWriteTarget(), ".raw"); // The file does not need to exist, and write target is always .raw or sequence.
+		    return endsWith(currentWriteTarget(), ".raw"); // The file does not need to exist, and write target is always .raw, NN5 or sequence.
 			//Vec3c dims;
 			//ImageDataType dt;
 			//return raw::getInfo(currentWriteTarget(), dims, dt);
 		}
 
+		/**
+		Tests if output file is a temporary file.
+		*/
+		bool isOutputTemp() const
+		{
+			return currentWriteTarget() == tempFilename1 || currentWriteTarget() == tempFilename2;
+		}
+
+		/**
+		Tests if output file is NN5 dataset.
+		*/
+		bool isOutputNN5() const
+		{
+			// Temporary datasets are recognized by the extension as they do not need to exist.
+			if (endsWith(currentWriteTarget(), ".nn5"))
+				return true;
+
+			Vec3c dims;
+			ImageDataType dt;
+			std::string reason;
+			return itl2::nn5::getInfo(currentWriteTarget(), dims, dt, reason);
+		}
+
+		/**
+		Tests if input file is NN5 dataset.
+		*/
+		bool isNN5() const
+		{
+			Vec3c dims;
+			ImageDataType dt;
+			std::string reason;
+			return itl2::nn5::getInfo(currentReadSource(), dims, dt, reason);
+		}
+
         /**
         Tests if input file is raw.
         */
@@ -443,6 +555,7 @@ namespace pilib
 			if (!isSavedToDisk())
 				return (pixel_t)0;
 
+			writeCachedBlocks();
 			std::string infile = currentReadSource();
 
 			Image<pixel_t> tmp(1, 1, 1);
@@ -462,6 +575,98 @@ namespace pilib
 			setData(*pi);
 		}
 
+		virtual std::shared_ptr<ImageBase> readBlock(const Vec3c& filePos, const Vec3c& blockSize, bool dataNeeded) const override
+		{
+			std::shared_ptr<Image<pixel_t> > block = std::make_shared<Image<pixel_t> >(blockSize);
+			if (isSavedToDisk() && dataNeeded)
+				itl2::io::readBlock(*block, currentReadSource(), filePos);
+			return block;
+		}
+
+		virtual std::shared_ptr<ImageBase> copyBlock(const ImageBase& img, const Vec3c& pos, const Vec3c& blockSize) const override
+		{
+			const Image<pixel_t>* pi = dynamic_cast<const Image<pixel_t>*>(&img);
+			if (!pi)
+				throw ITLException("The data type of the block is not the same than the data type of the distributed image.");
+
+			std::shared_ptr<Image<pixel_t> > block = std::make_shared<Image<pixel_t> >(blockSize);
+			itl2::crop(*pi, *block, pos);
+			return block;
+		}
+
+		virtual void writeBlock(const ImageBase& block, const Vec3c& filePos, const Vec3c& imagePos, const Vec3c& blockSize) const override
+		{
+			const Image<pixel_t>* pi = dynamic_cast<const Image<pixel_t>*>(&block);
+			if (!pi)
+				throw ITLException("The data type of the block is not the same than the data type of the distributed image.");
+
+			if (isOutputRaw())
+				itl2::raw::writeBlockAsync(*pi, currentWriteTarget(), filePos, dimensions(), imagePos, blockSize);
+			else if (isOutputNN5())
+				itl2::nn5::writeBlock(*pi, currentWriteTarget(), filePos, dimensions(), imagePos, blockSize);
+			else
+				itl2::sequence::writeBlockAsync(*pi, currentWriteTarget(), filePos, dimensions(), imagePos, blockSize);
+		}
+
+		virtual std::function<void()> blockWriter(std::shared_ptr<ImageBase> block, const Vec3c& filePos, const Vec3c& blockSize) const override
+		{
+			std::shared_ptr<Image<pixel_t> > pi = std::dynamic_pointer_cast<Image<pixel_t> >(block);
+			if (!pi)
+				throw ITLException("The data type of the block is not the same than the data type of the distributed image.");
+
+			std::string target = currentWriteTarget();
+			Vec3c dims = dimensions();
+			std::weak_ptr<bool> alive = lifetime;
+			if (isOutputRaw())
+			{
+				return [pi, target, filePos, dims, blockSize, alive]()
+					{
+						if (!alive.expired())
+							itl2::raw::writeBlock(*pi, target, filePos, dims, Vec3c(0, 0, 0), blockSize);
+					};
+			}
+			else if (isOutputNN5())
+			{
+				return [pi, target, filePos, dims, blockSize, alive]()
+					{
+						if (!alive.expired())
+							itl2::nn5::writeBlock(*pi, target, filePos, dims, Vec3c(0, 0, 0), blockSize);
+					};
+			}
+
+			return std::function<void()>();
+		}
+
+		virtual double foregroundFraction(const Vec3c& filePos, const Vec3c& blockSize) const override
+		{
+			if (!isSavedToDisk() || blockSize.min() <= 0)
+				return 1;
+
+			if (isNN5())
+				return itl2::nn5::storedChunkFraction(currentReadSource(), filePos, blockSize);
+
+			// Sample the middle slice of the block.
+			// Only some rows of .raw files are read, but image files in sequences must be read as a whole anyway.
+			bool raw = isRaw();
+			coord_t rowCount = raw ? std::min<coord_t>(blockSize.y, 64) : 1;
+			Image<pixel_t> sample(blockSize.x, raw ? 1 : blockSize.y, 1);
+			size_t count = 0;
+			size_t total = 0;
+			for (coord_t n = 0; n < rowCount; n++)
+			{
+				Vec3c pos(filePos.x, filePos.y + n * blockSize.y / rowCount, filePos.z + blockSize.z / 2);
+				itl2::io::readBlock(sample, currentReadSource(), pos);
+				for (coord_t i = 0; i < sample.pixelCount(); i++)
+				{
+					if (sample(i) != pixel_t())
+						count++;
+				}
+				total += sample.pixelCount();
+			}
+
+			return (double)count / (double)total;
+		}
+
 		/**
 		Reads the data of this distributed image to the given normal image, but does not trigger execution of pending commands.
 		This method can be used internally when distributed commands are being processed, e.g. in GetCorrespondingBlock method.
@@ -472,6 +677,7 @@ namespace pilib
 
 			if (isSavedToDisk())
 			{
+				writeCachedBlocks();
 				itl2::io::read(img, currentReadSource());
 			}
 		}
@@ -501,6 +707,10 @@ namespace pilib
 			{
 				itl2::raw::write(img, currentWriteTarget());
 			}
+			else if (isOutputNN5())
+			{
+				itl2::nn5::write(img, currentWriteTarget());
+			}
 			else
 			{
 				itl2::sequence::write(img, currentWriteTarget());
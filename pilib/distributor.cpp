@@ -6,9 +6,11 @@
 #include "pisystem.h"
 #include "exeutils.h"
 #include "math/vectoroperations.h"
+#include "io/fileutils.h"
 #include "whereamicpp.h"
 
 #include <tuple>
+#include <algorithm>
 #include "filesystem.h"
 
 using namespace std;
@@ -58,6 +60,19 @@ namespace pilib
 	{
 		showSubmittedScripts = reader.get<bool>("show_submitted_scripts", false);
 		allowDelaying = reader.get<bool>("allow_delaying", true);
+		readThreads = reader.get<size_t>("read_threads", 0);
+		directIO = reader.get<bool>("direct_io", false);
+		blocksPerWorker = reader.get<size_t>("blocks_per_worker", 0);
+		orderJobsByCost = reader.get<bool>("order_jobs_by_cost", false);
+
+		string tempFormat = reader.get<string>("temp_format", "raw");
+		toLower(tempFormat);
+		if (tempFormat == "nn5")
+			nn5Temps = true;
+		else if (tempFormat == "raw")
+			nn5Temps = false;
+		else
+			throw ITLException(string("Invalid temp_format setting: ") + tempFormat + ". Supported values are raw and nn5.");
 	}
 
 
@@ -225,6 +240,21 @@ namespace pilib
 		return maxSize;
 	}
 
+	/**
+	Calculates size of largest written block in the given block list in pixels.
+	*/
+	size_t maxWriteSize(const vector<tuple<Vec3c, Vec3c, Vec3c, Vec3c, Vec3c> >& blocks)
+	{
+		size_t maxSize = 0;
+		for (size_t n = 0; n < blocks.size(); n++)
+		{
+			Vec3c writeSize = get<4>(blocks[n]);
+			if (writeSize.min() > 0)
+				maxSize = std::max(maxSize, (size_t)(writeSize.x * writeSize.y * writeSize.z));
+		}
+		return maxSize;
+	}
+
 	/**
 	Gets all input images in the given list of delayed commands.
 	*/
@@ -467,6 +497,12 @@ namespace pilib
 	void Distributor::flush()
 	{
 		runDelayedCommands();
+		cache.writeBack();
+	}
+
+	void Distributor::writeCachedBlocks(const string& imageName)
+	{
+		cache.writeBack(imageName);
 	}
 
 
@@ -495,14 +531,14 @@ namespace pilib
 		if (distributionDirection2 == distributionDirection1)
 			throw logic_error("Both distribution directions can't be the same.");
 
-		// If we need to distribute in two directions, check that all output images are (written to) .raw files.
+		// If we need to distribute in two directions, check that all output images are (written to) .raw files or NN5 datasets.
 		// Otherwise distribution is not allowed as sequences can't be written to in parallel.
 		bool distributionDirection2Allowed = true;
 		if (distributionDirection2 <= 2)
 		{
 			for (DistributedImageBase* img : outputImages)
 			{
-				if (!img->isOutputRaw())
+				if (!img->isOutputRaw() && !img->isOutputNN5())
 				{
 					distributionDirection2Allowed = false;
 					break;
@@ -512,6 +548,29 @@ namespace pilib
 
         size_t preferredSubdivisions = getPreferredSubdivisions(delayedCommands);
 
+		// Divide into many more blocks than there are workers so that the blocks can be handed out to the workers
+		// as they become free, and a few slow blocks do not determine the total run time.
+		// The block count is limited so that each block contains at least one slice of each image.
+		if (blocksPerWorker > 0)
+		{
+			coord_t maxSubdivisions = 0;
+			for (DistributedImageBase* img : inputImages)
+			{
+				coord_t dim = img->dimensions()[distributionDirection1];
+				if (dim > 1 && (maxSubdivisions <= 0 || dim < maxSubdivisions))
+					maxSubdivisions = dim;
+			}
+			for (DistributedImageBase* img : outputImages)
+			{
+				coord_t dim = img->dimensions()[distributionDirection1];
+				if (dim > 1 && (maxSubdivisions <= 0 || dim < maxSubdivisions))
+					maxSubdivisions = dim;
+			}
+
+			size_t targetSubdivisions = std::min(blocksPerWorker * workerCount(), (size_t)maxSubdivisions);
+			preferredSubdivisions = std::max(preferredSubdivisions, targetSubdivisions);
+		}
+
 		// Determine blocks that must be loaded, given amount of subdivisions in each direction.
 		// blocksPerImage[image pointer][block index] = tuple<block definition>
 		Vec3c subDivisions(1, 1, 1);
@@ -581,6 +640,13 @@ namespace pilib
 				memoryReq += maxBlockSize(item.second) * item.first->pixelSize();
 			}
 
+			// Blocks written to .raw files and image sequences are copied to a buffer that is written in the background.
+			for (DistributedImageBase* img : outputImages)
+			{
+				if (!img->isOutputNN5())
+					memoryReq += maxWriteSize(blocksPerImage[img]) * img->pixelSize();
+			}
+
 
 			if (memoryReq <= allowedMemory())
 				break;
@@ -631,7 +697,7 @@ namespace pilib
 			else
 			{
 				if (!distributionDirection2Allowed)
-					throw ITLException("The input images are so large that they must be distributed in two coordinate directions. Distribution in two directions is currently not supported for non-.raw image files. Consider saving all the input images as .raw before calling this command.");
+					throw ITLException("The input images are so large that they must be distributed in two coordinate directions. Distribution in two directions is currently supported only for .raw and NN5 image files. Consider saving all the input images as .raw or NN5 before calling this command, or set temp_format to nn5 in the distributed processing configuration file.");
 
 				// Subdivide in 2 directions
 				if (subDivisions[distributionDirection2] < subDivisions[distributionDirection1])
@@ -678,6 +744,198 @@ namespace pilib
 		}
 	}
 
+	/**
+	Converts command argument to the corresponding argument of a job that is run in the current process.
+	Arguments that are not distributed images are not changed.
+	*/
+	template<typename T> ParamVariant toInProcessArgument(T value, PISystem& system)
+	{
+		return value;
+	}
+
+	/**
+	Converts distributed image argument to the corresponding block image stored in the given system.
+	*/
+	template<typename pixel_t> ParamVariant toInProcessArgument(DistributedImage<pixel_t>* img, PISystem& system)
+	{
+		Image<pixel_t>* block = dynamic_cast<Image<pixel_t>*>(system.getImage(img->uniqueName()));
+		if (!block)
+			throw ITLException(string("Block of image ") + img->varName() + " has wrong data type.");
+		return block;
+	}
+
+	/**
+	Stores reads, commands and writes of a single job so that the job can be run in the current process
+	without generating and parsing pi2 code.
+	*/
+	struct InProcessJob
+	{
+		/**
+		Image, block start, block size and data needed flag for each image block to read.
+		*/
+		vector<tuple<DistributedImageBase*, Vec3c, Vec3c, bool> > reads;
+
+		/**
+		Command and its arguments for each command to run.
+		*/
+		vector<tuple<const Command*, vector<ParamVariant> > > commands;
+
+		/**
+		Image, file position, image position and block size for each image block to write.
+		*/
+		vector<tuple<DistributedImageBase*, Vec3c, Vec3c, Vec3c> > writes;
+
+		/**
+		Cache where written blocks are stored and where input blocks are searched from, or nullptr if the cache is not used.
+		*/
+		BlockCache* cache = nullptr;
+
+		/**
+		Tests if a block of the given image is written by this job.
+		*/
+		bool isWritten(const DistributedImageBase* img) const
+		{
+			for (const auto& write : writes)
+			{
+				if (get<0>(write) == img)
+					return true;
+			}
+			return false;
+		}
+
+		void run(PISystem& system) const
+		{
+			// Blocks given to the system. They are not referenced anywhere else after the job.
+			map<string, shared_ptr<ImageBase> > blocks;
+
+			try
+			{
+				for (const auto& read : reads)
+				{
+					DistributedImageBase* img = get<0>(read);
+					Vec3c pos = get<1>(read);
+					Vec3c size = get<2>(read);
+					bool dataNeeded = get<3>(read);
+
+					shared_ptr<ImageBase> block;
+					if (cache && dataNeeded && img->isSavedToDisk())
+					{
+						if (isWritten(img))
+						{
+							// The block of an in-place processed image is not needed after this job, so it can be
+							// removed from the cache and modified without copying.
+							block = cache->take(img->uniqueName(), img->dataVersion(), pos, size);
+						}
+						else
+						{
+							// The cached block is copied as the commands may modify the block.
+							shared_ptr<ImageBase> cached = cache->get(img->uniqueName(), img->dataVersion(), pos, size);
+							if (cached)
+								block = img->copyBlock(*cached, Vec3c(0, 0, 0), size);
+						}
+					}
+
+					if (!block)
+						block = img->readBlock(pos, size, dataNeeded);
+
+					system.replaceImage(img->uniqueName(), block);
+					blocks[img->uniqueName()] = block;
+				}
+
+				for (const auto& cmd : commands)
+				{
+					vector<ParamVariant> args;
+					for (const ParamVariant& arg : get<1>(cmd))
+						args.push_back(std::visit([&](auto item) { return toInProcessArgument(item, system); }, arg));
+
+					get<0>(cmd)->runInternal(&system, args);
+				}
+
+				for (const auto& write : writes)
+				{
+					DistributedImageBase* img = get<0>(write);
+					Vec3c filePos = get<1>(write);
+					Vec3c imagePos = get<2>(write);
+					Vec3c size = get<3>(write);
+					ImageBase* block = system.getImage(img->uniqueName());
+
+					if (cache)
+					{
+						size_t bytes = (size_t)(size.x * size.y * size.z) * img->pixelSize();
+
+						// The whole block can be stored without copying if the commands did not replace it.
+						shared_ptr<ImageBase> cached = blocks[img->uniqueName()];
+						if (cached.get() != block || imagePos != Vec3c(0, 0, 0) || block->dimensions() != size)
+							cached = img->copyBlock(*block, imagePos, size);
+
+						// Blocks of temporary images are kept only in the cache until they are evicted or needed from the file.
+						function<void()> writer;
+						if (img->isOutputTemp())
+							writer = img->blockWriter(cached, filePos, size);
+
+						if (writer && cache->stage(img->uniqueName(), img->currentWriteTarget(), filePos, size, cached, bytes, writer))
+							continue;
+
+						if (!writer)
+							cache->stage(img->uniqueName(), img->currentWriteTarget(), filePos, size, cached, bytes, nullptr);
+					}
+
+					img->writeBlock(*block, filePos, imagePos, size);
+				}
+			}
+			catch (...)
+			{
+				clear(system);
+				throw;
+			}
+
+			clear(system);
+		}
+
+	private:
+		/**
+		Removes the blocks of this job from the given system.
+		*/
+		void clear(PISystem& system) const
+		{
+			for (const auto& read : reads)
+				system.replaceImage(get<0>(read)->uniqueName(), nullptr);
+		}
+	};
+
+	/**
+	Applies the read settings of the distributor to the global settings of the parallel reader while the object exists.
+	Jobs that are run in the current process use the global settings, but the settings must not change the
+	reads made outside of the jobs.
+	*/
+	class ScopedReadSettings
+	{
+	private:
+		ParallelReadSettings original;
+		bool active;
+
+	public:
+		ScopedReadSettings(bool apply, size_t threadCount, bool directIO) : original(parallelReadSettings()), active(apply)
+		{
+			if (active)
+			{
+				parallelReadSettings().threadCount = threadCount;
+				parallelReadSettings().directIO = directIO;
+			}
+		}
+
+		~ScopedReadSettings()
+		{
+			if (active)
+				parallelReadSettings() = original;
+		}
+	};
+
+	void Distributor::submitInProcessJob(std::function<void(PISystem&)>&& job)
+	{
+		throw ITLException("This distributor cannot run jobs in the current process.");
+	}
+
 	void Distributor::runDelayedCommands()
 	{
 		if (delayedCommands.size() <= 0)
@@ -711,6 +969,46 @@ namespace pilib
 		}
 
 
+		// Create NN5 output datasets before the jobs are started so that the jobs do not race to create them.
+		for (DistributedImageBase* img : outputImages)
+		{
+			if (img->isOutputNN5())
+			{
+				Vec3c chunkSize = nn5::DEFAULT_CHUNK_SIZE;
+				NN5Compression compression = NN5Compression::LZ4;
+				nn5::internals::prepareDataset(img->currentWriteTarget(), img->dimensions(), img->dataType(), chunkSize, compression);
+			}
+		}
+
+		if (cache.capacity() > 0)
+		{
+			// Blocks of temporary .raw files may be written only after the jobs have finished, but the file must exist
+			// when writeComplete() is called.
+			for (DistributedImageBase* img : outputImages)
+			{
+				if (img->isOutputRaw() && img->isOutputTemp())
+				{
+					createFoldersFor(img->currentWriteTarget());
+					setFileSize(img->currentWriteTarget(), (size_t)img->pixelCount() * img->pixelSize());
+				}
+			}
+
+			// The jobs read blocks from the files unless the blocks are found from the cache, and the writes of the jobs
+			// must not be overwritten by cached blocks of the old data. Therefore, the cached blocks must be written now,
+			// except those that the jobs find from the cache.
+			set<DistributedImageBase*> images = inputImages;
+			images.insert(outputImages.begin(), outputImages.end());
+			for (DistributedImageBase* img : images)
+			{
+				vector<tuple<Vec3c, Vec3c> > keep;
+				if (inputImages.find(img) != inputImages.end())
+				{
+					for (const auto& block : blocksPerImage[img])
+						keep.push_back(make_tuple(get<0>(block), get<1>(block)));
+				}
+				cache.writeBack(img->uniqueName(), keep);
+			}
+		}
 		
 		
 		//// No skipping jobs if there are InOut images for which
@@ -752,6 +1050,9 @@ namespace pilib
 		cout << "Submitting " << jobCount << " jobs, each estimated to require at most " << bytesToString((double)memoryReq) << " of RAM..." << endl;
 		vector<size_t> skippedJobs;
 		vector<tuple<string, JobType>> jobsToSubmit;
+		vector<InProcessJob> inProcessJobsToSubmit;
+		vector<double> jobCosts;
+		bool inProcess = runsInProcess();
 		for (size_t i = 0; i < jobCount; i++)
 		{
 			// Build job script:
@@ -771,16 +1072,29 @@ namespace pilib
 			// print("Everything done")
 
 			stringstream script;
+			InProcessJob inProcessJob;
+			if (cache.capacity() > 0)
+				inProcessJob.cache = &cache;
 
 			// Init so that we always print something (required at least in the SLURM distributor)
 			script << "echo(true, false);" << endl;
 
+			// Raw file read settings
+			if (readThreads != 0 || directIO)
+				script << "rawreadsettings(" << readThreads << ", " << itl2::toString(directIO) << ");" << endl;
+
 			// Image read commands
+			double cost = 0;
 			for(DistributedImageBase* img : inputImages)
 			{
 				Vec3c readStart = get<0>(blocksPerImage[img][i]);
 				Vec3c readSize = get<1>(blocksPerImage[img][i]);
 				script << img->emitReadBlock(readStart, readSize, true);
+				inProcessJob.reads.push_back(make_tuple(img, readStart, readSize, true));
+
+				// Run time of e.g. skeletonization and particle analysis depends mostly on the count of foreground pixels.
+				if (orderJobsByCost)
+					cost += img->foregroundFraction(readStart, readSize) * readSize.x * readSize.y * readSize.z;
 			}
 
 			// Output image creation commands
@@ -791,6 +1105,7 @@ namespace pilib
 					Vec3c readStart = get<0>(blocksPerImage[img][i]);
 					Vec3c readSize = get<1>(blocksPerImage[img][i]);
 					script << img->emitReadBlock(readStart, readSize, false);
+					inProcessJob.reads.push_back(make_tuple(img, readStart, readSize, false));
 				}
 			}
 
@@ -812,6 +1127,7 @@ namespace pilib
 				{
 					hasCommandsToRun = true;
 					script << command->name() << "(";
+					vector<ParamVariant> jobArgs;
 					for (size_t n = 0; n < args.size(); n++)
 					{
 						// Value of argument whose type is Vec3c and name is "block origin" is replaced by the origin of current calculation block.
@@ -830,8 +1146,12 @@ namespace pilib
 						script << "\"" << argumentToString(argDef, argVal) << "\"";
 						if (n < args.size() - 1)
 							script << ", ";
+
+						jobArgs.push_back(argVal);
 					}
 					script << ");" << endl;
+
+					inProcessJob.commands.push_back(make_tuple(command, jobArgs));
 				}
 			}
 
@@ -846,14 +1166,23 @@ namespace pilib
 					Vec3c writeSize = get<4>(blocksPerImage[img][i]);
 
 					// Only write if writing is requested by the command.
-					if(writeSize.min() > 0)
+					if (writeSize.min() > 0)
+					{
 						script << img->emitWriteBlock(writeFilePos, writeImPos, writeSize);
+						inProcessJob.writes.push_back(make_tuple(img, writeFilePos, writeImPos, writeSize));
+					}
 				}
 			}
 
+			// Wait for the background writes and flush the output to the storage device before the job is marked as done.
+			script << "flushwrites();" << endl;
+
 			if (hasCommandsToRun || !jobSkippingAllowed)
 			{
 				jobsToSubmit.push_back(make_tuple(script.str(), jobType));
+				jobCosts.push_back(cost);
+				if (inProcess)
+					inProcessJobsToSubmit.push_back(inProcessJob);
 			}
 			else
 			{
@@ -919,19 +1248,47 @@ namespace pilib
 			//}
 		}
 
-		for (auto& tup : jobsToSubmit)
-		{
-			string& script = get<0>(tup);
-			JobType type = get<1>(tup);
+		// Submit the most expensive jobs first so that they are not left running alone at the end.
+		vector<size_t> submitOrder(jobsToSubmit.size());
+		for (size_t n = 0; n < submitOrder.size(); n++)
+			submitOrder[n] = n;
+		if (orderJobsByCost)
+			stable_sort(submitOrder.begin(), submitOrder.end(), [&](size_t a, size_t b) { return jobCosts[a] > jobCosts[b]; });
+
+		// Separate pi2 processes get the read settings in the rawreadsettings command of their script.
+		ScopedReadSettings readSettingsForJobs(inProcess && (readThreads != 0 || directIO), readThreads, directIO);
 
-			if (showSubmittedScripts)
+		jobMemoryEstimate = memoryReq;
+		try
+		{
+			for (size_t n : submitOrder)
 			{
-				cout << "Submitting pi2 script:" << endl;
-				cout << script << endl;
-			}
+				string& script = get<0>(jobsToSubmit[n]);
+				JobType type = get<1>(jobsToSubmit[n]);
 
-			submitJob(script, type);
+				if (showSubmittedScripts)
+				{
+					cout << "Submitting pi2 script:" << endl;
+					cout << script << endl;
+				}
+
+				if (inProcess)
+				{
+					InProcessJob& job = inProcessJobsToSubmit[n];
+					submitInProcessJob([job](PISystem& system) { job.run(system); });
+				}
+				else
+				{
+					submitJob(script, type);
+				}
+			}
+		}
+		catch (...)
+		{
+			jobMemoryEstimate = 0;
+			throw;
 		}
+		jobMemoryEstimate = 0;
 
 		
 		// Run jobs first and set writeComplete() only after the jobs have finished to make sure that
@@ -940,19 +1297,35 @@ namespace pilib
 		try
 		{
 			cout << "Waiting for jobs to finish..." << endl;
-			lastOutput = waitForJobs();
+			vector<string> output = waitForJobs();
+
+			// Return the outputs in block order.
+			lastOutput = output;
+			if (output.size() == submitOrder.size())
+			{
+				for (size_t n = 0; n < submitOrder.size(); n++)
+					lastOutput[submitOrder[n]] = output[n];
+			}
 
 			for (DistributedImageBase* img : outputImages)
 			{
 				img->writeComplete();
+				cache.commit(img->uniqueName(), img->dataVersion());
 			}
 		}
 		catch (...)
 		{
+			cache.discardStaged();
 			delayedCommands.clear();
 			throw;
 		}
 
+		if (cache.capacity() > 0)
+		{
+			cout << "Block cache: " << cache.hits() << " hits, " << cache.misses() << " misses, " << bytesToString((double)cache.size()) << " in use." << endl;
+			cache.resetStatistics();
+		}
+
 		// This may deallocate images that are not in PISystem anymore.
 		delayedCommands.clear();
 	}
@@ -3,10 +3,12 @@
 #include "argumentdatatype.h"
 #include "jobtype.h"
 #include "delayed.h"
+#include "blockcache.h"
 #include "io/inireader.h"
 #include <string>
 #include <vector>
 #include <set>
+#include <functional>
 
 namespace pilib
 {
@@ -30,6 +32,40 @@ namespace pilib
 		*/
 		bool allowDelaying = false;
 
+		/**
+		Count of concurrent read operations used when reading .raw files in the jobs. Zero corresponds to the default value.
+		*/
+		size_t readThreads = 0;
+
+		/**
+		Indicates if direct I/O should be used when reading .raw files in the jobs.
+		*/
+		bool directIO = false;
+
+		/**
+		Indicates if temporary images should be stored in NN5 format instead of .raw files and image sequences.
+		*/
+		bool nn5Temps = false;
+
+		/**
+		Minimum count of blocks per worker. Zero disables over-decomposition.
+		*/
+		size_t blocksPerWorker = 0;
+
+		/**
+		Indicates if jobs should be submitted in order of decreasing estimated cost.
+		*/
+		bool orderJobsByCost = false;
+
+		/**
+		Estimated memory requirement of the jobs that are being submitted, in bytes. Zero if not known.
+		*/
+		size_t jobMemoryEstimate = 0;
+
+		/**
+		Cache of image blocks written by jobs that are run in the current process.
+		*/
+		BlockCache cache;
 
 		/**
 		Pointer to the PI system object.
@@ -93,6 +129,51 @@ namespace pilib
 		*/
 		void readSettings(INIReader& reader);
 
+		/**
+		Returns estimated amount of memory in bytes that the job being submitted requires.
+		Returns zero if the estimate is not available, e.g. if submitJob is called directly from a command.
+		*/
+		size_t estimatedJobMemory() const
+		{
+			return jobMemoryEstimate;
+		}
+
+		/**
+		Gets the cache of image blocks written by jobs that are run in the current process.
+		Blocks of temporary images are written to the image files only when they are evicted from the cache or
+		when the files are needed outside of the jobs.
+		The cache is disabled by default. Derived classes that run jobs in the current process may enable it by setting its capacity.
+		*/
+		BlockCache& blockCache()
+		{
+			return cache;
+		}
+
+		/**
+		Returns the count of jobs that can run concurrently.
+		This is used to divide the images into enough blocks so that the jobs can be balanced between the workers.
+		*/
+		virtual size_t workerCount() const
+		{
+			return 1;
+		}
+
+		/**
+		Returns true if jobs should be run in the current process using submitInProcessJob instead of
+		submitting pi2 scripts using submitJob.
+		*/
+		virtual bool runsInProcess() const
+		{
+			return false;
+		}
+
+		/**
+		Submits a job that is run in the current process.
+		The job function runs the job using the given PI system, and writes its output to std::cout.
+		May block until the job is finished.
+		The default implementation throws an exception.
+		*/
+		virtual void submitInProcessJob(std::function<void(PISystem&)>&& job);
 
 	public:
 
@@ -119,6 +200,14 @@ namespace pilib
 			allowDelaying = enable;
 		}
 
+		/**
+		Returns true if temporary images should be stored in NN5 format instead of .raw files and image sequences.
+		*/
+		bool useNN5Temps() const
+		{
+			return nn5Temps;
+		}
+
 		/**
 		Enables or disables printing of command scripts to console.
 		*/
@@ -128,10 +217,16 @@ namespace pilib
 		}
 
 		/**
-		Process all delayed commands (if any).
+		Process all delayed commands (if any), and write the blocks held in the block cache to the image files.
 		*/
 		void flush();
 
+		/**
+		Writes the blocks of the given image that are held in the block cache but not written to the image file yet.
+		@param imageName Unique name of the image.
+		*/
+		void writeCachedBlocks(const std::string& imageName);
+
 		/**
 		Gets pointer to PISystem object.
 		*/
@@ -121,7 +121,7 @@ namespace pilib
 	protected:
 		friend class CommandList;
 
-		MedianFilterCommand() : NeighbourhoodFilterCommand<pixel_t>("medianfilter", "Median filtering. Replaces pixel by median of pixels in its neighbourhood. Removes noise from the image while preserving sharp edges.")
+		MedianFilterCommand() : NeighbourhoodFilterCommand<pixel_t>("medianfilter", "Median filtering. Replaces pixel by median of pixels in its neighbourhood. Removes noise from the image while preserving sharp edges. Uses sliding histogram algorithm for uint8 and uint16 images.")
 		{
 		}
 
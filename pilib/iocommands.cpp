@@ -21,5 +21,7 @@ namespace pilib
 		ADD_ALL(WriteSequenceCommand);
 		ADD_ALL(WriteSequenceBlockCommand);
 		ADD_ALL(WriteSequenceBlock2Command);
+		ADD_ALL(WriteNN5Command);
+		ADD_ALL(WriteNN5BlockCommand);
 	}
 }
\ No newline at end of file
@@ -533,7 +533,7 @@ namespace pilib
 				d = dims.z;
 			}
 
-			raw::writeBlock(img, fname, Vec3c(x, y, z), Vec3c(w, h, d), Vec3c(ix, iy, iz), Vec3c(iw, ih, id), true);
+			raw::writeBlockAsync(img, fname, Vec3c(x, y, z), Vec3c(w, h, d), Vec3c(ix, iy, iz), Vec3c(iw, ih, id));
 		}
 	};
 
@@ -578,7 +578,7 @@ namespace pilib
 				fileSize = dims;
 			}
 
-			raw::writeBlock(img, fname, position, fileSize, blockPosition, blockSize, true);
+			raw::writeBlockAsync(img, fname, position, fileSize, blockPosition, blockSize);
 		}
 	};
 
@@ -649,7 +649,7 @@ namespace pilib
 				d = dims.z;
 			}
 
-			sequence::writeBlock(img, fname, Vec3c(x, y, z), Vec3c(w, h, d), Vec3c(ix, iy, iz), Vec3c(iw, ih, id), true);
+			sequence::writeBlockAsync(img, fname, Vec3c(x, y, z), Vec3c(w, h, d), Vec3c(ix, iy, iz), Vec3c(iw, ih, id));
 		}
 	};
 
@@ -695,7 +695,123 @@ namespace pilib
 				fileSize = dims;
 			}
 
-			sequence::writeBlock(img, fname, position, fileSize, blockPosition, blockSize, true);
+			sequence::writeBlockAsync(img, fname, position, fileSize, blockPosition, blockSize);
+		}
+	};
+
+	template<typename pixel_t> class WriteNN5Command : public Command, public Distributable
+	{
+	protected:
+		friend class CommandList;
+
+		WriteNN5Command() : Command("writenn5", "Write an image to a NN5 dataset. NN5 is a chunked image format similar to N5 and Zarr. The image is stored in a directory that contains a metadata file and one file for each chunk of the image. Each chunk is compressed separately, and chunks that contain only zeroes are not stored. In distributed mode, blocks of NN5 datasets can be read and written without reading or writing the rest of the image.",
+			{
+				CommandArgument<Image<pixel_t> >(ParameterDirection::In, "input image", "Image to save."),
+				CommandArgument<std::string>(ParameterDirection::In, "filename", "Name (and path) of the dataset to write. If the dataset exists, it is replaced."),
+				CommandArgument<Vec3c>(ParameterDirection::In, "chunk size", "Size of the chunks of the dataset.", nn5::DEFAULT_CHUNK_SIZE)
+			})
+		{
+		}
+
+	public:
+		virtual void run(std::vector<ParamVariant>& args) const override
+		{
+			Image<pixel_t>& in = *pop<Image<pixel_t>* >(args);
+			std::string fname = pop<std::string>(args);
+			Vec3c chunkSize = pop<Vec3c>(args);
+
+			nn5::write(in, fname, chunkSize, NN5Compression::LZ4, true);
+		}
+
+		virtual std::vector<std::string> runDistributed(Distributor& distributor, std::vector<ParamVariant>& args) const override
+		{
+			distributor.flush();
+
+			DistributedImage<pixel_t>& in = *pop<DistributedImage<pixel_t>* >(args);
+			std::string fname = pop<std::string>(args);
+			Vec3c chunkSize = pop<Vec3c>(args);
+
+			// The image is already stored in the given dataset.
+			if (in.isSavedToDisk() && in.currentReadSource() == fname)
+				return std::vector<std::string>();
+
+			Vec3c tempDims, tempChunkSize;
+			ImageDataType tempDataType;
+			NN5Compression tempCompression;
+			std::string reason;
+			if (in.isSavedToDisk() && in.isSavedToTemp() &&
+				nn5::internals::readHeader(in.currentReadSource(), tempDims, tempDataType, tempChunkSize, tempCompression, reason) &&
+				tempChunkSize == min(chunkSize, in.dimensions()))
+			{
+				// The image has been saved to a temporary dataset with the correct chunk size.
+				// Just move the dataset to new location and set read source to that dataset.
+				nn5::internals::removeDataset(fname);
+				moveFile(in.currentReadSource(), fname);
+				in.setReadSource(fname);
+				return std::vector<std::string>();
+			}
+
+			// Create an empty dataset with the requested chunk size so that the jobs write to it.
+			nn5::internals::removeDataset(fname);
+			NN5Compression compression = NN5Compression::LZ4;
+			nn5::internals::prepareDataset(fname, in.dimensions(), imageDataType<pixel_t>(), chunkSize, compression);
+
+			in.setWriteTarget(fname);
+
+			std::vector<ParamVariant> args2;
+			ParamVariant p;
+			p = &in;
+			args2.push_back(p);
+			auto& cmd = CommandList::get<NopSingleImageCommand<pixel_t> >();
+			return cmd.runDistributed(distributor, args2);
+		}
+	};
+
+	template<typename pixel_t> class WriteNN5BlockCommand : public Command
+	{
+	protected:
+		friend class CommandList;
+
+		WriteNN5BlockCommand() : Command("writenn5block", "Write an image to a specified position in a NN5 dataset. Optionally can write only a block of the source image. If the dataset does not exist, it is created. Multiple processes may write non-overlapping blocks of the same dataset simultaneously.",
+			{
+				CommandArgument<Image<pixel_t> >(ParameterDirection::In, "input image", "Image to save."),
+				CommandArgument<std::string>(ParameterDirection::In, "filename", "Name (and path) of the dataset to write."),
+				CommandArgument<Vec3c>(ParameterDirection::In, "position", "Position of the image in the target dataset."),
+				CommandArgument<Vec3c>(ParameterDirection::In, "file dimensions", "Dimensions of the output dataset. Specify zero to read dimensions from the dataset. In this case it must exist.", Vec3c(0, 0, 0)),
+				CommandArgument<Vec3c>(ParameterDirection::In, "source position", "Position of the block of the source image to write.", Vec3c(0, 0, 0)),
+				CommandArgument<Vec3c>(ParameterDirection::In, "source block size", "Size of the block to write. Specify zero to write the whole source image.", Vec3c(0, 0, 0)),
+				CommandArgument<Vec3c>(ParameterDirection::In, "chunk size", "Size of the chunks of the dataset, if a new dataset is created.", nn5::DEFAULT_CHUNK_SIZE)
+			})
+		{
+		}
+
+	public:
+		virtual void run(std::vector<ParamVariant>& args) const override
+		{
+			Image<pixel_t>& img = *pop<Image<pixel_t>* >(args);
+			std::string fname = pop<std::string>(args);
+
+			Vec3c position = pop<Vec3c>(args);
+			Vec3c fileSize = pop<Vec3c>(args);
+			Vec3c blockPosition = pop<Vec3c>(args);
+			Vec3c blockSize = pop<Vec3c>(args);
+			Vec3c chunkSize = pop<Vec3c>(args);
+
+			if (blockSize.x <= 0 || blockSize.y <= 0 || blockSize.z <= 0)
+				blockSize = img.dimensions();
+
+			// Read dimensions from the dataset if no dimensions are provided
+			if (fileSize.x <= 0 || fileSize.y <= 0 || fileSize.z <= 0)
+			{
+				Vec3c dims;
+				itl2::ImageDataType dt2;
+				std::string reason;
+				if (!nn5::getInfo(fname, dims, dt2, reason))
+					throw ParseException(std::string("Unable to find metadata from NN5 dataset: ") + fname + ". " + reason);
+				fileSize = dims;
+			}
+
+			nn5::writeBlock(img, fname, position, fileSize, blockPosition, blockSize, chunkSize, NN5Compression::LZ4, true);
 		}
 	};
 }
@@ -3,16 +3,135 @@
 
 #include "stringutils.h"
 #include "exeutils.h"
+#include "pisystem.h"
+#include "io/writebehind.h"
 
 #include <algorithm>
+#include <map>
+#include <atomic>
 #include "filesystem.h"
+#include <omp.h>
 
 using namespace itl2;
 using namespace std;
 
 namespace pilib
 {
-	LocalDistributor::LocalDistributor(PISystem* piSystem) : Distributor(piSystem), allowedMem(0)
+	/**
+	Stream buffer that captures everything written to std::cout by the in-process tasks.
+	If a task runs alone, output from all threads is captured. Otherwise, output of a task is captured from the thread
+	that runs the task and from the OpenMP threads of that thread. Output from other threads, e.g. threads started
+	by the commands of the task, cannot be attributed to any task and it is passed to the original buffer.
+	*/
+	class JobOutputBuffer : public std::streambuf
+	{
+	private:
+		std::streambuf* original;
+
+		/**
+		Output buffer and echo flag of each running task, by capture identifier.
+		*/
+		map<size_t, tuple<string*, bool> > captures;
+
+		/**
+		Identifier of the task that captures output from all threads, or zero.
+		*/
+		size_t processCapture = 0;
+
+		std::mutex captureMutex;
+
+		/**
+		Identifier of the task whose output is written by the current thread.
+		*/
+		static thread_local size_t currentCapture;
+
+	public:
+		JobOutputBuffer() : original(cout.rdbuf())
+		{
+			cout.rdbuf(this);
+		}
+
+		~JobOutputBuffer()
+		{
+			cout.rdbuf(original);
+		}
+
+		/**
+		Starts capturing output of a task that is run in the current thread.
+		@param target The output is appended to this string.
+		@param echo Set to true to show the output in the console, too.
+		@param allThreads Set to true to capture output from all threads. Use only if no other tasks are running.
+		@return Identifier that must be passed to end.
+		*/
+		size_t begin(string* target, bool echo, bool allThreads)
+		{
+			// The identifiers are never reused so that the stale identifiers of threads of old tasks do not match any task.
+			static std::atomic<size_t> idCounter(0);
+			size_t id = ++idCounter;
+
+			{
+				unique_lock<mutex> lock(captureMutex);
+				captures[id] = make_tuple(target, echo);
+				if (allThreads)
+					processCapture = id;
+			}
+
+			// OpenMP threads of the current thread are reused in the parallel regions of the task.
+			#pragma omp parallel
+			{
+				currentCapture = id;
+			}
+
+			return id;
+		}
+
+		/**
+		Stops capturing output of the given task.
+		*/
+		void end(size_t id)
+		{
+			unique_lock<mutex> lock(captureMutex);
+			captures.erase(id);
+			if (processCapture == id)
+				processCapture = 0;
+		}
+
+	protected:
+		virtual int overflow(int c) override
+		{
+			if (c != traits_type::eof())
+			{
+				char ch = (char)c;
+				xsputn(&ch, 1);
+			}
+			return traits_type::not_eof(c);
+		}
+
+		virtual std::streamsize xsputn(const char* s, std::streamsize n) override
+		{
+			{
+				unique_lock<mutex> lock(captureMutex);
+				auto it = captures.find(processCapture != 0 ? processCapture : currentCapture);
+				if (it != captures.end())
+				{
+					get<0>(it->second)->append(s, (size_t)n);
+					if (!get<1>(it->second))
+						return n;
+				}
+			}
+			return original->sputn(s, n);
+		}
+
+		virtual int sync() override
+		{
+			return original->pubsync();
+		}
+	};
+
+	thread_local size_t JobOutputBuffer::currentCapture = 0;
+
+
+	LocalDistributor::LocalDistributor(PISystem* piSystem) : Distributor(piSystem), allowedMem(0), cacheMem(0), cacheMemSetting(0), threadsPerJob(0), maxJobs(1), inProcess(false), runningJobs(0), stopWorkers(false)
 	{
 		fs::path configPath = getPiCommand();
 		size_t mem = 0;
@@ -23,13 +142,33 @@ namespace pilib
 			INIReader reader(configPath.string());
 
 			mem = (size_t)(reader.get<double>("max_memory", 0) * 1024 * 1024);
+			threadsPerJob = reader.get<size_t>("threads_per_job", 0);
+			inProcess = reader.get<bool>("in_process", false);
+			cacheMemSetting = (size_t)(reader.get<double>("block_cache", 0) * 1024 * 1024);
 			
 			readSettings(reader);
 		}
 
+		size_t threadCount = (size_t)omp_get_max_threads();
+		if (threadsPerJob > 0 && threadsPerJob < threadCount)
+			maxJobs = threadCount / threadsPerJob;
+
 		allowedMemory(mem);
 	}
 
+	LocalDistributor::~LocalDistributor()
+	{
+		joinJobs();
+
+		{
+			unique_lock<mutex> lock(jobMutex);
+			stopWorkers = true;
+		}
+		jobQueued.notify_all();
+		for (std::thread& t : workers)
+			t.join();
+	}
+
 	void LocalDistributor::allowedMemory(size_t maxMem)
 	{
 		allowedMem = maxMem;
@@ -37,26 +176,224 @@ namespace pilib
 		if (allowedMem <= 0)
 			allowedMem = (size_t)(0.85 * itl2::memorySize());
 
-		cout << "Using " << bytesToString((double)allowedMem) << " RAM per task." << endl;
+		// The block cache is useful only if the tasks are run in this process.
+		// Leave at least half of the memory for the tasks.
+		cacheMem = inProcess ? std::min(cacheMemSetting, allowedMem / 2) : 0;
+		blockCache().capacity(cacheMem);
+
+		if (maxJobs > 1)
+			cout << "Running at most " << maxJobs << " tasks concurrently, " << threadsPerJob << " threads and " << bytesToString((double)allowedMemory()) << " RAM per task." << endl;
+		else
+			cout << "Using " << bytesToString((double)allowedMemory()) << " RAM per task." << endl;
+
+		if (cacheMem > 0)
+			cout << "Using " << bytesToString((double)cacheMem) << " RAM for block cache." << endl;
+	}
+
+	size_t LocalDistributor::concurrentJobs() const
+	{
+		size_t jobMem = estimatedJobMemory();
+		if (jobMem <= 0)
+			jobMem = allowedMemory();
+
+		return std::max<size_t>(1, std::min(maxJobs, (allowedMem - cacheMem) / std::max<size_t>(1, jobMem)));
+	}
+
+	void LocalDistributor::joinJobs()
+	{
+		for (std::thread& t : jobThreads)
+			t.join();
+		jobThreads.clear();
 	}
 
 	void LocalDistributor::submitJob(const string& piCode, JobType jobType)
 	{
-		// Write the code to (temporary) file
+		if (maxJobs <= 1)
 		{
-			ofstream f("pi2_local_job.txt");
+			// Write the code to (temporary) file
+			{
+				ofstream f("pi2_local_job.txt");
+				f << piCode << endl;
+				f << "print(Everything done.)" << endl;
+			}
+
+			string output = execute("\"" + getPiCommand() + "\"", "pi2_local_job.txt", true);
+
+			outputs.push_back(output);
+			return;
+		}
+
+		// Each concurrent job gets its own job file, and the output of the job is not echoed as
+		// the outputs of the jobs would be interleaved.
+		size_t jobIndex;
+		{
+			unique_lock<mutex> lock(jobMutex);
+			size_t limit = concurrentJobs();
+			jobFinished.wait(lock, [&] { return runningJobs < limit; });
+			runningJobs++;
+			jobIndex = outputs.size();
+			outputs.push_back("");
+		}
+
+		string jobFile = string("pi2_local_job_") + itl2::toString(jobIndex) + ".txt";
+		{
+			ofstream f(jobFile);
 			f << piCode << endl;
 			f << "print(Everything done.)" << endl;
 		}
 
-		string output = execute("\"" + getPiCommand() + "\"", "pi2_local_job.txt", true);
+		// Limit the thread count of the subprocess through the OpenMP environment variable.
+#if defined(__linux__)
+		string cmd = string("OMP_NUM_THREADS=") + itl2::toString(threadsPerJob) + " \"" + getPiCommand() + "\" " + jobFile;
+#elif defined(_WIN32)
+		string cmd = string("cmd /s /c \"set OMP_NUM_THREADS=") + itl2::toString(threadsPerJob) + "&& \"" + getPiCommand() + "\" " + jobFile + "\"";
+#else
+#error LocalDistributor::submitJob not implemented on this platform.
+#endif
 
-		outputs.push_back(output);
+		jobThreads.push_back(std::thread([this, jobIndex, jobFile, cmd]()
+			{
+				string output;
+				try
+				{
+					output = execute(cmd, false);
+				}
+				catch (ITLException& e)
+				{
+					output = string("Error: ") + e.message();
+				}
+
+				// Keep job files of failed jobs for debugging.
+				if (lastLine(output) == "Everything done.")
+				{
+					std::error_code ec;
+					fs::remove(jobFile, ec);
+				}
+
+				{
+					unique_lock<mutex> lock(jobMutex);
+					outputs[jobIndex] = output;
+					runningJobs--;
+					cout << "Job " << jobIndex << " finished." << endl;
+				}
+				jobFinished.notify_all();
+			}));
+	}
+
+	void LocalDistributor::runInProcessJob(size_t jobIndex, const std::function<void(PISystem&)>& job, PISystem& system, bool alone)
+	{
+		// The output is formatted like the output of a pi2 process so that waitForJobs can check it in the same way.
+		string output;
+		WriteOwnerScope writeOwner(this);
+		size_t captureId = outputBuffer->begin(&output, alone, alone);
+		try
+		{
+			job(system);
+			cout << "Everything done." << endl;
+		}
+		catch (ITLException& e)
+		{
+			cout << "Error: " << e.message() << endl;
+		}
+		catch (std::exception& e)
+		{
+			cout << "Error: " << e.what() << endl;
+		}
+		outputBuffer->end(captureId);
+
+		unique_lock<mutex> lock(jobMutex);
+		outputs[jobIndex] = output;
+	}
+
+	void LocalDistributor::inProcessWorker()
+	{
+		PISystem system;
+
+		if (threadsPerJob > 0)
+			omp_set_num_threads((int)threadsPerJob);
+
+		while (true)
+		{
+			tuple<size_t, std::function<void(PISystem&)> > item;
+			{
+				unique_lock<mutex> lock(jobMutex);
+				jobQueued.wait(lock, [&] { return stopWorkers || !jobQueue.empty(); });
+				if (jobQueue.empty())
+					return;
+				item = std::move(jobQueue.front());
+				jobQueue.pop_front();
+			}
+
+			runInProcessJob(get<0>(item), get<1>(item), system, false);
+
+			{
+				unique_lock<mutex> lock(jobMutex);
+				runningJobs--;
+				cout << "Job " << get<0>(item) << " finished." << endl;
+			}
+			jobFinished.notify_all();
+		}
+	}
+
+	void LocalDistributor::submitInProcessJob(std::function<void(PISystem&)>&& job)
+	{
+		if (!outputBuffer)
+			outputBuffer = make_unique<JobOutputBuffer>();
+
+		if (maxJobs <= 1)
+		{
+			// Run in the calling thread.
+			if (!jobSystem)
+				jobSystem = make_unique<PISystem>();
+
+			size_t jobIndex = outputs.size();
+			outputs.push_back("");
+			runInProcessJob(jobIndex, job, *jobSystem, true);
+			return;
+		}
+
+		if (workers.size() <= 0)
+		{
+			for (size_t n = 0; n < maxJobs; n++)
+				workers.push_back(std::thread([this]() { inProcessWorker(); }));
+		}
+
+		{
+			unique_lock<mutex> lock(jobMutex);
+			size_t limit = concurrentJobs();
+			jobFinished.wait(lock, [&] { return runningJobs < limit; });
+			runningJobs++;
+			size_t jobIndex = outputs.size();
+			outputs.push_back("");
+			jobQueue.push_back(make_tuple(jobIndex, std::move(job)));
+		}
+		jobQueued.notify_one();
 	}
 
 	vector<string> LocalDistributor::waitForJobs()
 	{
-		// Do not wait as the jobs have already finished (they are run sequentially on submit).
+		// Sequentially run jobs have already finished on submit, wait for the concurrently running jobs.
+		{
+			unique_lock<mutex> lock(jobMutex);
+			jobFinished.wait(lock, [&] { return runningJobs <= 0; });
+		}
+		joinJobs();
+
+		if (outputBuffer)
+		{
+			outputBuffer.reset();
+
+			// In-process jobs write .raw files and image sequences in the background.
+			try
+			{
+				flushWrites(this, true);
+			}
+			catch (...)
+			{
+				outputs.clear();
+				throw;
+			}
+		}
 
 		ostringstream msg;
 		for(size_t n = 0; n < outputs.size(); n++)
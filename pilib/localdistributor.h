@@ -2,31 +2,161 @@
 
 #include "distributor.h"
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+
 namespace pilib
 {
+	class JobOutputBuffer;
+
 	/**
-	Runs tasks sequentially on the local computer.
+	Runs tasks on the local computer.
+	Multiple tasks are run concurrently if the thread budget of a single task (threads_per_job setting) is smaller than the count of
+	available threads, and there is enough memory for multiple tasks.
 	*/
 	class LocalDistributor : public Distributor
 	{
 	private:
+		/**
+		Amount of memory that all the concurrently running tasks and the block cache may use.
+		*/
 		size_t allowedMem;
 
+		/**
+		Amount of memory reserved for the block cache, taken from allowedMem.
+		The cache is used only if the tasks are run in this process.
+		*/
+		size_t cacheMem;
+
+		/**
+		Amount of memory requested for the block cache in the configuration file.
+		*/
+		size_t cacheMemSetting;
+
+		/**
+		Count of computation threads each task is allowed to use. Zero corresponds to all the threads available on the computer.
+		*/
+		size_t threadsPerJob;
+
+		/**
+		Maximum count of tasks that are run concurrently, as determined by the thread budget.
+		*/
+		size_t maxJobs;
+
+		/**
+		Indicates if the tasks are run in this process instead of separate pi2 processes.
+		*/
+		bool inProcess;
+
 		/**
 		Stores output of each subprocess that has been run since last call to waitForJobs.
 		*/
 		std::vector<std::string> outputs;
 
+		/**
+		Threads that monitor the subprocesses that are running concurrently.
+		*/
+		std::vector<std::thread> jobThreads;
+
+		/**
+		Count of subprocesses that are currently running.
+		*/
+		size_t runningJobs;
+
+		/**
+		Protects outputs and runningJobs.
+		*/
+		std::mutex jobMutex;
+
+		/**
+		Signaled when a subprocess finishes.
+		*/
+		std::condition_variable jobFinished;
+
+		/**
+		Tasks waiting to be run in this process, and their indices in the outputs list.
+		*/
+		std::deque<std::tuple<size_t, std::function<void(PISystem&)> > > jobQueue;
+
+		/**
+		Signaled when a task is added to the job queue or the workers should stop.
+		*/
+		std::condition_variable jobQueued;
+
+		/**
+		Threads that run the tasks in this process. Each thread has its own PI system.
+		*/
+		std::vector<std::thread> workers;
+
+		/**
+		Set to true to stop the worker threads.
+		*/
+		bool stopWorkers;
+
+		/**
+		PI system used to run the tasks in this process when there are no worker threads.
+		*/
+		std::unique_ptr<PISystem> jobSystem;
+
+		/**
+		Captures the output of the tasks that are run in this process.
+		*/
+		std::unique_ptr<JobOutputBuffer> outputBuffer;
+
+		/**
+		Runs a task in this process and stores its output to the outputs list.
+		@param alone Set to true if no other tasks are running. The output of the task is then captured from all threads,
+		and it is shown also in the console.
+		*/
+		void runInProcessJob(size_t jobIndex, const std::function<void(PISystem&)>& job, PISystem& system, bool alone);
+
+		/**
+		Main function of the worker threads.
+		*/
+		void inProcessWorker();
+
+		/**
+		Calculates count of tasks that can be run concurrently, based on the thread budget and
+		the estimated memory requirement of the tasks being submitted.
+		*/
+		size_t concurrentJobs() const;
+
+		/**
+		Waits until all the concurrently running subprocesses have finished.
+		*/
+		void joinJobs();
+
 	public:
 		LocalDistributor(PISystem* system);
 
+		virtual ~LocalDistributor();
+
 		virtual void submitJob(const std::string& piCode, JobType jobType) override;
 
+		virtual size_t workerCount() const override
+		{
+			return maxJobs;
+		}
+
+		virtual bool runsInProcess() const override
+		{
+			return inProcess;
+		}
+
+		virtual void submitInProcessJob(std::function<void(PISystem&)>&& job) override;
+
 		virtual std::vector<std::string> waitForJobs() override;
 
+		/**
+		Returns the amount of memory a single task may use, i.e. the total amount of memory, excluding the block cache,
+		divided by the count of tasks that may run concurrently.
+		*/
 		virtual size_t allowedMemory() const override
 		{
-			return allowedMem;
+			return (allowedMem - cacheMem) / maxJobs;
 		}
 
 		virtual void allowedMemory(size_t maxMem) override;
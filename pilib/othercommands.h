@@ -598,7 +598,8 @@ namespace pilib
 				CommandArgument<coord_t>(ParameterDirection::In, "width", "Width of the output region."),
 				CommandArgument<coord_t>(ParameterDirection::In, "height", "Height of the output region."),
 				CommandArgument<coord_t>(ParameterDirection::In, "depth", "Depth of the output region."),
-				CommandArgument<bool>(ParameterDirection::In, "normalize", "Set to true to make mean gray value of images the same in the overlapping region.", true)
+				CommandArgument<bool>(ParameterDirection::In, "normalize", "Set to true to make mean gray value of images the same in the overlapping region.", true),
+				CommandArgument<double>(ParameterDirection::In, "max source block size", "Maximum size of the block of a source image that is read into memory at once, in megabytes. If the source block required for the output region is larger than this, the output region is processed in smaller pieces. Specify zero to use one fourth of the system memory.", 0.0)
 			},
 			blockMatchSeeAlso())
 		{
@@ -623,12 +624,14 @@ namespace pilib
 			coord_t h = pop<coord_t>(args);
 			coord_t d = pop<coord_t>(args);
 			bool normalize = pop<bool>(args);
+			double maxSourceBlockSize = pop<double>(args);
 
 			Vec3c pos(x, y, z);
 			Vec3c size(w, h, d);
+			size_t maxSourceBlockBytes = (size_t)std::max(0.0, maxSourceBlockSize * 1024 * 1024);
 
 			//stitchVer2<pixel_t>(indexFile, pos, size, output, normalize);
-			stitchVer3<pixel_t>(indexFile, pos, size, output, nullptr, normalize);
+			stitchVer3<pixel_t>(indexFile, pos, size, output, nullptr, normalize, maxSourceBlockBytes);
 		}
 	};
 
@@ -648,7 +651,8 @@ namespace pilib
 				CommandArgument<coord_t>(ParameterDirection::In, "width", "Width of the output region."),
 				CommandArgument<coord_t>(ParameterDirection::In, "height", "Height of the output region."),
 				CommandArgument<coord_t>(ParameterDirection::In, "depth", "Depth of the output region."),
-				CommandArgument<bool>(ParameterDirection::In, "normalize", "Set to true to make mean gray value of images the same in the overlapping region.", true)
+				CommandArgument<bool>(ParameterDirection::In, "normalize", "Set to true to make mean gray value of images the same in the overlapping region.", true),
+				CommandArgument<double>(ParameterDirection::In, "max source block size", "Maximum size of the block of a source image that is read into memory at once, in megabytes. If the source block required for the output region is larger than this, the output region is processed in smaller pieces. Specify zero to use one fourth of the system memory.", 0.0)
 			},
 			blockMatchSeeAlso())
 		{
@@ -673,11 +677,13 @@ namespace pilib
 			coord_t h = pop<coord_t>(args);
 			coord_t d = pop<coord_t>(args);
 			bool normalize = pop<bool>(args);
+			double maxSourceBlockSize = pop<double>(args);
 
 			Vec3c pos(x, y, z);
 			Vec3c size(w, h, d);
+			size_t maxSourceBlockBytes = (size_t)std::max(0.0, maxSourceBlockSize * 1024 * 1024);
 
-			stitchVer3<pixel_t>(indexFile, pos, size, output, &goodness, normalize);
+			stitchVer3<pixel_t>(indexFile, pos, size, output, &goodness, normalize, maxSourceBlockBytes);
 		}
 	};
 
@@ -191,6 +191,16 @@ namespace pilib
 		{
 			itl2::writeListFile(filename, v, [=](std::ofstream& out, const std::vector<Vec3sc>& v) { itl2::writeList<Vec3sc>(out, v); });
 		}
+
+		static void writeList(const string& filename, const vector<itl2::internals::IncompleteParticle>& v)
+		{
+			itl2::writeListFile(filename, v, [=](std::ofstream& out, const itl2::internals::IncompleteParticle& p)
+				{
+					itl2::writeList<ParticleRun>(out, p.runs.getRuns());
+					itl2::writeList(out, p.state, [=](std::ofstream& out, const std::vector<double>& s) { itl2::writeList<double>(out, s); });
+					itl2::writeItem(out, p.volume);
+				});
+		}
 		
 	protected:
 		friend class CommandList;
@@ -234,7 +244,7 @@ namespace pilib
 			auto analyzers = createAnalyzers<pixel_t>(analyzerNames, originalDimensions);
 
 			Results results;
-			vector<vector<Vec3sc> > incompleteParticles;
+			vector<itl2::internals::IncompleteParticle> incompleteParticles;
 			vector<vector<Vec3sc> > largeEdgePoints;
 			vector<coord_t> edgeZ;
 
@@ -369,6 +379,19 @@ namespace pilib
 			itl2::readListFile(filename, v, [=](std::ifstream& in, std::vector<Vec3sc>& v) { itl2::readList<Vec3sc>(in, v); });
 		}
 
+		static void readList(const string& filename, vector<itl2::internals::IncompleteParticle>& v)
+		{
+			itl2::readListFile(filename, v, [=](std::ifstream& in, itl2::internals::IncompleteParticle& p)
+				{
+					std::vector<ParticleRun> runs;
+					itl2::readList<ParticleRun>(in, runs);
+					for (const ParticleRun& run : runs)
+						p.runs.push_back(run);
+					itl2::readList(in, p.state, [=](std::ifstream& in, std::vector<double>& s) { itl2::readList<double>(in, s); });
+					itl2::readItem(in, p.volume);
+				});
+		}
+
 	protected:
 		friend class CommandList;
 
@@ -442,7 +465,7 @@ namespace pilib
 			std::cout << "Loading data..." << std::endl;
 
 			// Load data files and combine results (local processing, loads files one at a time)
-			vector<vector<Vec3sc> > incompleteParticles;
+			vector<itl2::internals::IncompleteParticle> incompleteParticles;
 			vector<vector<Vec3sc> > largeEdgePoints;
 			vector<coord_t> edgeZ;
 			for (size_t n = 0; n < output.size(); n++)
@@ -80,6 +80,44 @@ void* getImage(void* pi, const char* imgName, int64_t* width, int64_t* height, i
 	return img->getRawData();
 }
 
+void* pinImage(void* pi, const char* imgName, int64_t* width, int64_t* height, int64_t* depth, int32_t* dataType)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	PISystem* sys = (PISystem*)pi;
+	ImageBase* img = sys->pinImageNoThrow(imgName);
+
+	if (!img)
+	{
+		*width = 0;
+		*height = 0;
+		*depth = 0;
+		*dataType = (int32_t)ImageDataType::Unknown;
+		return 0;
+	}
+
+	*width = img->width();
+	*height = img->height();
+	*depth = img->depth();
+	*dataType = (int)img->dataType();
+
+	return img->getRawData();
+}
+
+uint8_t releaseImage(void* pi, void* data)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return ((PISystem*)pi)->releaseImageNoThrow(data) ? 1 : 0;
+}
+
+uint8_t createImageFromBuffer(void* pi, const char* imgName, void* data, int64_t width, int64_t height, int64_t depth, int32_t dataType, ReleaseBufferCallback release, void* context)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::function<void()> releaseFunc;
+	if (release)
+		releaseFunc = [release, context]() { release(context); };
+	return ((PISystem*)pi)->createImageFromBufferNoThrow(imgName, data, Vec3c(width, height, depth), (ImageDataType)dataType, releaseFunc) ? 1 : 0;
+}
+
 uint8_t finishUpdate(void* pi, const char* imgName)
 {
 	std::lock_guard<std::mutex> lock(mutex);
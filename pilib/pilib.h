@@ -106,6 +106,52 @@ extern "C"
 	*/
 	PILIB_API void* getImage(void* pi, const char* imgName, int64_t* width, int64_t* height, int64_t* depth, int32_t* dataType);
 
+	/**
+	Same than getImage, but additionally pins the image so that the returned pointer stays valid until releaseImage is called with it,
+	even if the image is removed from the system or replaced by another image.
+	Commands that would re-allocate the pixel data of a pinned image fail.
+	Each successful call must be paired with a call to releaseImage.
+	@param pi Pi object created using createPI() function.
+	@param imgName Name of image.
+	@param width, height, depth Dimensions of the image will be filled into these values.
+	@param dataType The system sets this to a value describing pixel data type. See ImageDataType.
+	@return Pointer to the pixel data, or zero if an error occurs.
+	*/
+	PILIB_API void* pinImage(void* pi, const char* imgName, int64_t* width, int64_t* height, int64_t* depth, int32_t* dataType);
+
+	/**
+	Releases a pin made with pinImage.
+	The pointer must not be used after the call.
+	@param pi Pi object created using createPI() function.
+	@param data Pointer returned by pinImage.
+	@return True if the release was successful; false otherwise.
+	*/
+	PILIB_API uint8_t releaseImage(void* pi, void* data);
+
+	/**
+	Function that is called when the system does not need an external pixel buffer anymore.
+	@param context The context value that was given when the buffer was handed to the system.
+	*/
+	typedef void (*ReleaseBufferCallback)(void* context);
+
+	/**
+	Creates image that uses pixel data owned by the caller, e.g. NumPy array, without copying the data.
+	Replaces image with the given name if it exists.
+	The data must stay valid until release callback is called. The callback is called from within some pilib call,
+	e.g. when the image is removed from the system, replaced, or re-allocated by a command that changes its size,
+	and it must not call pilib functions.
+	In distributed mode the data is copied to the distributed image and the callback is called before this function returns.
+	@param pi Pi object created using createPI() function.
+	@param imgName Name of the image.
+	@param data Pointer to the pixel data, stored in the same order than in images returned by getImage.
+	@param width, height, depth Dimensions of the image.
+	@param dataType Pixel data type. See ImageDataType.
+	@param release Function that is called when the system does not need the data anymore, or zero.
+	@param context Value that is passed to the release function.
+	@return True if the image was created; false otherwise. If false is returned, the release function is not called.
+	*/
+	PILIB_API uint8_t createImageFromBuffer(void* pi, const char* imgName, void* data, int64_t width, int64_t height, int64_t depth, int32_t dataType, ReleaseBufferCallback release, void* context);
+
 	/**
 	Gets value of a string object.
 	The returned pointer is valid until the object is destroyed.
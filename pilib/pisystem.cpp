@@ -1,9 +1,16 @@
 
 #include "pisystem.h"
+
+#include <mutex>
+
 #include "commandmacros.h"
 #include "io/io.h"
+#include "io/writebehind.h"
 #include "commandlist.h"
 #include "pilibutilities.h"
+#include "whereamicpp.h"
+#include "io/inireader.h"
+#include "fft.h"
 
 using namespace std;
 
@@ -878,13 +885,49 @@ namespace pilib
 
 
 
+	/**
+	Reads FFT planning settings from fft_config.txt in the folder of the pi2 module.
+	Relative wisdom file name is interpreted relative to that folder.
+	*/
+	void readFFTSettings()
+	{
+		fs::path configPath = getModulePath();
+		if (!configPath.has_filename())
+			return;
+
+		configPath = configPath.replace_filename("fft_config.txt");
+		INIReader reader(configPath.string());
+
+		setFFTPlanning(reader.get<FFTPlanning>("planning", FFTPlanning::Estimate));
+
+		string wisdomFile = reader.get<string>("wisdom_file", "");
+		if (wisdomFile.length() > 0)
+		{
+			fs::path wisdomPath = wisdomFile;
+			if (wisdomPath.is_relative())
+				wisdomPath = configPath.parent_path() / wisdomPath;
+			setFFTWisdomFile(wisdomPath.string());
+		}
+	}
+
 	PISystem::PISystem()
 	{
 		clearLastError();
+
+		static std::once_flag fftSettingsRead;
+		std::call_once(fftSettingsRead, readFFTSettings);
 	}
 
 	PISystem::~PISystem()
 	{
+		// Finish pending background writes. Errors cannot be reported anymore.
+		try
+		{
+			flushWrites(this, false);
+		}
+		catch (ITLException&)
+		{
+		}
 	}
 
 	/**
@@ -1062,6 +1105,106 @@ namespace pilib
 		//}
 	}
 
+	/**
+	Functor that creates image that uses pixel data owned by someone else.
+	*/
+	template<typename pixel_t> struct CreateExternalImage
+	{
+		static void run(void* data, const Vec3c& dimensions, std::function<void()>& release, shared_ptr<ImageBase>& result)
+		{
+			result = std::make_shared<Image<pixel_t> >((pixel_t*)data, dimensions, std::move(release));
+		}
+	};
+
+	void PISystem::createImageFromBuffer(const string& name, void* data, const Vec3c& dimensions, ImageDataType dt, std::function<void()> release)
+	{
+		string reason;
+		if (!isValidImageName(name, reason))
+			throw ITLException(reason);
+
+		if (!data)
+			throw ITLException("Pixel data pointer must not be null.");
+
+		if (dimensions.min() <= 0)
+			throw ITLException("Image dimensions must be positive.");
+
+		if (!isDistributed())
+		{
+			shared_ptr<ImageBase> img;
+			pick<CreateExternalImage>(dt, data, dimensions, release, img);
+			replaceImage(name, img);
+		}
+		else
+		{
+			// Distributed images live in files, so the data must be written there.
+			// The caller keeps the ownership of the data until the write has succeeded.
+			shared_ptr<ImageBase> img;
+			std::function<void()> noRelease;
+			pick<CreateExternalImage>(dt, data, dimensions, noRelease, img);
+			pick<CreateEmptyDistributedImage>(dt, name, dimensions, this);
+			distributedImgs.at(name)->setData(img.get());
+			img.reset();
+
+			if (release)
+				release();
+		}
+	}
+
+	bool PISystem::createImageFromBufferNoThrow(const string& name, void* data, const Vec3c& dimensions, ImageDataType dt, std::function<void()> release)
+	{
+		return noThrow([&]
+			{
+				createImageFromBuffer(name, data, dimensions, dt, std::move(release));
+				return true;
+			});
+	}
+
+	ImageBase* PISystem::pinImage(const string& name)
+	{
+		bool exists = isDistributed() ? distributedImgs.find(name) != distributedImgs.end() : images.find(name) != images.end();
+		if (!exists)
+			throw ITLException("Image not found.");
+
+		ImageBase* img = getImage(name);
+
+		// The image is the same than the one stored with the same data pointer, if any,
+		// as the data of pinned images is not freed before they are released.
+		void* data = img->getRawData();
+		if (pinnedImages.find(data) == pinnedImages.end())
+			pinnedImages[data] = images.at(name);
+
+		img->pin();
+		return img;
+	}
+
+	ImageBase* PISystem::pinImageNoThrow(const string& name)
+	{
+		return noThrow([&]
+			{
+				return pinImage(name);
+			});
+	}
+
+	void PISystem::releaseImage(void* data)
+	{
+		auto it = pinnedImages.find(data);
+		if (it == pinnedImages.end())
+			throw ITLException("No pinned image uses the given pixel data.");
+
+		it->second->unpin();
+		if (!it->second->isPinned())
+			pinnedImages.erase(it);
+	}
+
+	bool PISystem::releaseImageNoThrow(void* data)
+	{
+		return noThrow([&]
+			{
+				releaseImage(data);
+				return true;
+			});
+	}
+
 	void PISystem::replaceString(const std::string& name, std::shared_ptr<string> newValue)
 	{
 		if (strings.find(name) != strings.end())
@@ -1181,6 +1324,9 @@ namespace pilib
 	*/
 	bool PISystem::run(const string& commands)
 	{
+		// Background writes started by the commands belong to this system.
+		WriteOwnerScope writeOwner(this);
+
 		try
 		{
 			string rest = commands;
@@ -1196,6 +1342,11 @@ namespace pilib
 					lastExceptionLine++;
 			}
 
+			// Wait until background writes started by the commands are finished so that
+			// the caller sees the output files and write errors are reported.
+			// Writes of other systems (e.g. jobs running in this process) are not waited for.
+			flushWrites(this, false);
+
 			lastExceptionLine = 0;
 			return true;
 		}
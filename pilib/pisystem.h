@@ -7,6 +7,7 @@
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <functional>
 
 #include "command.h"
 #include "parseexception.h"
@@ -65,6 +66,12 @@ namespace pilib
 		*/
 		std::vector<std::shared_ptr<DistributedImageBase> > distributedImageStore;
 
+		/**
+		Images whose pixel data is in use outside of the system, keyed by pointer to the pixel data.
+		The images are kept alive and pinned until they are released, even if they are removed from the system.
+		*/
+		std::map<void*, std::shared_ptr<ImageBase> > pinnedImages;
+
 		/**
 		Last exception that has occured.
 		*/
@@ -263,6 +270,44 @@ namespace pilib
 		*/
 		void replaceImage(const std::string& name, std::shared_ptr<ImageBase> img);
 
+		/**
+		Creates image that uses pixel data owned by someone else, e.g. a NumPy array, and replaces image with given name by it.
+		The data is not copied, except in distributed mode where it is written to the storage of the distributed image.
+		If this method throws, release is not called and the caller keeps the ownership of the data.
+		@param data Pointer to the pixel data.
+		@param release Function that is called when the system does not need the data anymore. In distributed mode, this happens before the method returns.
+		*/
+		void createImageFromBuffer(const std::string& name, void* data, const Vec3c& dimensions, ImageDataType dt, std::function<void()> release);
+
+		/**
+		Same than createImageFromBuffer but sets lastException instead of throwing it.
+		@return false if an error occurs.
+		*/
+		bool createImageFromBufferNoThrow(const std::string& name, void* data, const Vec3c& dimensions, ImageDataType dt, std::function<void()> release);
+
+		/**
+		Retrieves image having given name, and pins it so that its pixel data stays valid until releaseImage is called with pointer to the pixel data.
+		Causes reading of image data to RAM in the case of distributed processing.
+		*/
+		ImageBase* pinImage(const std::string& name);
+
+		/**
+		Same than pinImage but sets lastException instead of throwing it, and returns 0 if an error occurs.
+		*/
+		ImageBase* pinImageNoThrow(const std::string& name);
+
+		/**
+		Releases pin made with pinImage.
+		@param data Pointer to the pixel data of the pinned image.
+		*/
+		void releaseImage(void* data);
+
+		/**
+		Same than releaseImage but sets lastException instead of throwing it.
+		@return false if an error occurs.
+		*/
+		bool releaseImageNoThrow(void* data);
+
 		/**
 		Replace a value with a new one.
 		Replace a value by null pointer to remove it from the system.
@@ -15,6 +15,7 @@
 #include "filesystem.h"
 
 #include <random>
+#include <cctype>
 
 using namespace itl2;
 using namespace std;
@@ -23,7 +24,7 @@ namespace pilib
 {
 	
 
-	SLURMDistributor::SLURMDistributor(PISystem* system) : Distributor(system), allowedMem(0)
+	SLURMDistributor::SLURMDistributor(PISystem* system) : Distributor(system), allowedMem(0), maxParallelJobs(0), useJobArrays(false), maxArraySize(1000)
 	{
 		// Create unique name for this distributor
 		std::random_device dev;
@@ -51,6 +52,9 @@ namespace pilib
 			jobInitCommands = reader.get<string>("job_init_commands", "");
 			mem = (size_t)(reader.get<double>("max_memory", 0) * 1024 * 1024);
 			maxSubmissions = reader.get<size_t>("max_resubmit_count", 5) + 1;
+			maxParallelJobs = reader.get<size_t>("max_parallel_jobs", 0);
+			useJobArrays = reader.get<bool>("use_job_arrays", false);
+			maxArraySize = std::max<size_t>(1, reader.get<size_t>("max_array_size", 1000));
 			sbatchCommand = reader.get<string>("sbatch_command", "sbatch");
 			squeueCommand = reader.get<string>("squeue_command", "squeue");
 			scancelCommand = reader.get<string>("scancel_command", "scancel");
@@ -102,6 +106,11 @@ namespace pilib
 		cout << "Per node memory in the SLURM cluster: " << bytesToString((double)allowedMem) << endl;
 	}
 
+	string SLURMDistributor::makeFileName(const string& jobIndex, const string& suffix) const
+	{
+		return "./slurm-io-files/pi2-" + jobIndex + "-" + myName + suffix;
+	}
+
 	string SLURMDistributor::makeJobName(size_t jobIndex) const
 	{
 		return "pi2-" + itl2::toString<size_t>(jobIndex) + "-" + myName;
@@ -109,42 +118,47 @@ namespace pilib
 	
 	string SLURMDistributor::makeInputName(size_t jobIndex) const
 	{
-	    return "./slurm-io-files/" + makeJobName(jobIndex) + "-in.txt";
+	    return makeFileName(itl2::toString(jobIndex), "-in.txt");
+	}
+
+	string SLURMDistributor::makeLogFileIndex(size_t jobIndex) const
+	{
+		const string& slurmId = get<0>(submittedJobs[jobIndex]);
+		if (slurmId.find('_') != string::npos)
+			return slurmId;
+		return itl2::toString(jobIndex);
 	}
 
 	string SLURMDistributor::makeOutputName(size_t jobIndex) const
 	{
-		return "./slurm-io-files/" + makeJobName(jobIndex) + "-out.txt";
+		return makeFileName(makeLogFileIndex(jobIndex), "-out.txt");
 	}
 	
 	string SLURMDistributor::makeErrorName(size_t jobIndex) const
 	{
-		return "./slurm-io-files/" + makeJobName(jobIndex) + "-err.txt";
+		return makeFileName(makeLogFileIndex(jobIndex), "-err.txt");
 	}
 
-	void SLURMDistributor::resubmit(size_t jobIndex)
+	string SLURMDistributor::makeDoneName(size_t jobIndex) const
 	{
-		string jobName = makeJobName(jobIndex);
-		string inputName = makeInputName(jobIndex);
-		string outputName = makeOutputName(jobIndex);
-		string errorName = makeErrorName(jobIndex);
-		JobType jobType = get<1>(submittedJobs[jobIndex]);
-
-		fs::remove(outputName);
-		fs::remove(errorName);
+		return makeFileName(itl2::toString(jobIndex), "-done.txt");
+	}
 
+	string SLURMDistributor::makeJobCommandLine(const string& jobIndex) const
+	{
+		// The job writes exit code of pi2 to the done marker file.
+		// $ characters are escaped as the command line is placed inside double quotes in sbatch command line.
 		string jobCmdLine;
 		if (jobInitCommands.length() > 0)
 			jobCmdLine = jobInitCommands + "; ";
-		jobCmdLine += "'" + getPiCommand() + "' " + inputName;
-
-		string sbatchArgs = string("--no-requeue") + " --job-name=" + jobName + " --output=" + outputName + " --error=" + errorName + " " + extraArgsSBatch(jobType) + " --wrap=\"" + jobCmdLine + "\"";
-
-	//cout << "sbatch input: " << sbatchArgs << endl;
-
-		string result = execute("sbatch", sbatchArgs);
+		jobCmdLine += "'" + getPiCommand() + "' " + makeFileName(jobIndex, "-in.txt");
+		jobCmdLine += "; echo \\$? > " + makeFileName(jobIndex, "-done.txt");
+		return jobCmdLine;
+	}
 
-	//cout << "sbatch output: " << result << endl;
+	string SLURMDistributor::sbatch(const string& sbatchArgs) const
+	{
+		string result = execute(sbatchCommand, sbatchArgs);
 
 		vector<string> lines = split(result);
 		if (lines.size() == 1)
@@ -157,26 +171,25 @@ namespace pilib
 			    if (parts.size() < 1)
 				    throw ITLException("SLURM returned no batch job id.");
 			    
-			    slurmId = fromString<int>(parts[parts.size() - 1]);
+			    slurmId = fromString<size_t>(parts[parts.size() - 1]);
 			}
 			catch(ITLException e)
 			{
 			    cout << "Command" << endl;
-				cout << "sbatch " << sbatchArgs << endl;
+				cout << sbatchCommand << " " << sbatchArgs << endl;
 				cout << "returned" << endl;
 				cout << result << endl;
 				throw ITLException("Command sbatch did not return job id. The received output has been printed to standard output.");
 			}
 			
-			get<0>(submittedJobs[jobIndex]) = slurmId;
-			get<2>(submittedJobs[jobIndex])++;
+			return itl2::toString(slurmId);
 		}
 		else
 		{
 			if (result.length() > 0)
 			{
 				cout << "Command" << endl;
-				cout << "sbatch " << sbatchArgs << endl;
+				cout << sbatchCommand << " " << sbatchArgs << endl;
 				cout << "returned" << endl;
 				cout << result << endl;
 				throw ITLException("Unexpected sbatch output. The output has been printed to standard output.");
@@ -188,6 +201,111 @@ namespace pilib
 		}
 	}
 
+	void SLURMDistributor::resubmit(size_t jobIndex)
+	{
+		string jobName = makeJobName(jobIndex);
+		JobType jobType = get<1>(submittedJobs[jobIndex]);
+
+		// Remove logs of the previous submission. They are named differently if the job was an array task.
+		fs::remove(makeOutputName(jobIndex));
+		fs::remove(makeErrorName(jobIndex));
+		fs::remove(makeDoneName(jobIndex));
+
+		get<0>(submittedJobs[jobIndex]) = "";
+		string outputName = makeOutputName(jobIndex);
+		string errorName = makeErrorName(jobIndex);
+		fs::remove(outputName);
+		fs::remove(errorName);
+
+		string sbatchArgs = string("--no-requeue") + " --job-name=" + jobName + " --output=" + outputName + " --error=" + errorName + " " + extraArgsSBatch(jobType) + " --wrap=\"" + makeJobCommandLine(itl2::toString(jobIndex)) + "\"";
+
+		get<0>(submittedJobs[jobIndex]) = sbatch(sbatchArgs);
+		get<2>(submittedJobs[jobIndex])++;
+	}
+
+	/**
+	Converts list of increasing job indices to SLURM array index specification, e.g. 0-3,5,7-9.
+	@param offset Value that is subtracted from each index.
+	*/
+	string toArraySpec(const vector<size_t>& indices, size_t offset)
+	{
+		stringstream s;
+		for (size_t n = 0; n < indices.size();)
+		{
+			size_t m = n;
+			while (m + 1 < indices.size() && indices[m + 1] == indices[m] + 1)
+				m++;
+
+			if (n > 0)
+				s << ",";
+			s << indices[n] - offset;
+			if (m > n)
+				s << "-" << indices[m] - offset;
+
+			n = m + 1;
+		}
+		return s.str();
+	}
+
+	void SLURMDistributor::submitArrays()
+	{
+		// The %-limit of an array applies only to the tasks of that array. If the count of parallel jobs is limited,
+		// each array is made to wait until the previous one has finished so that the limit holds for all the jobs.
+		string previousArrayId = "";
+
+		// Jobs of different type must be submitted in separate arrays as they need different sbatch arguments.
+		for (JobType jobType : { JobType::Fast, JobType::Normal, JobType::Slow })
+		{
+			vector<size_t> indices;
+			for (size_t n = 0; n < submittedJobs.size(); n++)
+			{
+				if (get<2>(submittedJobs[n]) <= 0 && get<1>(submittedJobs[n]) == jobType)
+				{
+					indices.push_back(n);
+					fs::remove(makeOutputName(n));
+					fs::remove(makeErrorName(n));
+					fs::remove(makeDoneName(n));
+				}
+			}
+
+			// Array task ids must be less than MaxArraySize of the cluster, so submit the jobs in chunks
+			// where the task id is the job index minus the index of the first job in the chunk.
+			for (size_t start = 0; start < indices.size();)
+			{
+				size_t offset = indices[start];
+				size_t end = start;
+				while (end < indices.size() && indices[end] - offset < maxArraySize)
+					end++;
+
+				vector<size_t> chunk(indices.begin() + start, indices.begin() + end);
+				start = end;
+
+				string arraySpec = toArraySpec(chunk, offset);
+				string dependency = "";
+				if (maxParallelJobs > 0)
+				{
+					arraySpec += "%" + itl2::toString(maxParallelJobs);
+					if (previousArrayId.length() > 0)
+						dependency = " --dependency=afterany:" + previousArrayId;
+				}
+
+				// %A and %a are replaced by array job id and array task id in the log file names, see makeLogFileIndex.
+				// The job finds its input file using SLURM_ARRAY_TASK_ID environment variable.
+				string jobIndex = "\\$((\\${SLURM_ARRAY_TASK_ID}+" + itl2::toString(offset) + "))";
+				string sbatchArgs = string("--no-requeue") + " --array=" + arraySpec + dependency + " --job-name=pi2-" + myName + " --output=" + makeFileName("%A_%a", "-out.txt") + " --error=" + makeFileName("%A_%a", "-err.txt") + " " + extraArgsSBatch(jobType) + " --wrap=\"" + makeJobCommandLine(jobIndex) + "\"";
+
+				string arrayId = sbatch(sbatchArgs);
+				previousArrayId = arrayId;
+
+				for (size_t n : chunk)
+				{
+					get<0>(submittedJobs[n]) = arrayId + "_" + itl2::toString(n - offset);
+					get<2>(submittedJobs[n])++;
+				}
+			}
+		}
+	}
+
 	void SLURMDistributor::submitJob(const string& piCode, JobType jobType)
 	{
 		// Add job completion marker
@@ -195,45 +313,90 @@ namespace pilib
 
 		// Create slot for the job
 		size_t jobIndex = submittedJobs.size();
-		submittedJobs.push_back(make_tuple(0, jobType, 0));
+		submittedJobs.push_back(make_tuple("", jobType, 0));
 
 		// Write input file
 		string inputName = makeInputName(jobIndex);
 		fs::remove(inputName);
 		writeText(inputName, piCode2);
 
-		// Submit "again"
-		resubmit(jobIndex);
+		// Submit "again", unless the jobs are submitted as job arrays or the count of jobs in the cluster is limited.
+		// In those cases the jobs are submitted in waitForJobs.
+		if (!useJobArrays && (maxParallelJobs <= 0 || jobIndex < maxParallelJobs))
+			resubmit(jobIndex);
 	}
 
-	bool SLURMDistributor::isJobDone(size_t jobIndex) const
+	/**
+	Tests if the given string is a SLURM job id or job array task id, e.g. 1234 or 1234_5.
+	*/
+	bool isJobId(const string& s)
 	{
-		string slurmId = itl2::toString(get<0>(submittedJobs[jobIndex]));
+		if (s.length() <= 0 || !isdigit(s[0]))
+			return false;
 
-		string result = execute(squeueCommand, string("--noheader --jobs=") + slurmId);
-		trim(result);
-		
-		// Empty result means the job is done
-		if(result.length() <= 0)
-		    return true;
+		for (char c : s)
+		{
+			if (!isdigit(c) && c != '_')
+				return false;
+		}
+		return true;
+	}
 
-        // If the message starts with job id, the job is running or in queue.
-		bool running = startsWith(result, slurmId);
-		
-		// If the message contains "invalid job id...", the job data has been already erased.
-		bool notRunning = contains(result, "Invalid job id specified");
+	set<string> SLURMDistributor::getQueuedJobs(const vector<size_t>& jobIndices) const
+	{
+		set<string> queued;
 
-        // Check that the job is running or its data has been erased.
-        // Otherwise we don't know what is going on, and assume this is a temporary error message.
-		if ((running && notRunning) ||
-			(!running && !notRunning))
+		// Query the jobs in batches to keep the command line short.
+		constexpr size_t BATCH_SIZE = 200;
+		for (size_t start = 0; start < jobIndices.size(); start += BATCH_SIZE)
 		{
-			// Erroneous squeue output. Assume that the job is not done.
-			cout << "Warning: Unexpected squeue output '" << result << "' for job " << jobIndex << " (SLURM id " << slurmId << "). Assuming the job is still running." << endl;
-			return false;
+			size_t end = std::min(start + BATCH_SIZE, jobIndices.size());
+
+			// All tasks of a job array are queried using the array job id.
+			set<string> ids;
+			for (size_t n = start; n < end; n++)
+			{
+				const string& slurmId = get<0>(submittedJobs[jobIndices[n]]);
+				ids.insert(slurmId.substr(0, slurmId.find('_')));
+			}
+
+			string idList;
+			for (const string& id : ids)
+			{
+				if (idList.length() > 0)
+					idList += ",";
+				idList += id;
+			}
+
+			string result = execute(squeueCommand, string("--noheader --array --format=%i --jobs=") + idList);
+
+			// Each line contains id of a job that is running or in queue.
+			// If the message contains "invalid job id...", the job data has been already erased.
+			// Otherwise we don't know what is going on, and assume this is a temporary error message.
+			bool unexpected = false;
+			vector<string> lines = split(result);
+			for (string& line : lines)
+			{
+				trim(line);
+				if (line.length() <= 0)
+					continue;
+
+				if (isJobId(line))
+					queued.insert(line);
+				else if (!contains(line, "Invalid job id specified"))
+					unexpected = true;
+			}
+
+			if (unexpected)
+			{
+				// Erroneous squeue output. Assume that the jobs are not done.
+				cout << "Warning: Unexpected squeue output '" << result << "'. Assuming the jobs are still running." << endl;
+				for (size_t n = start; n < end; n++)
+					queued.insert(get<0>(submittedJobs[jobIndices[n]]));
+			}
 		}
 
-		return !running;
+		return queued;
 	}
 	
 	void flushCache(const string& filename)
@@ -254,16 +417,29 @@ namespace pilib
 	string SLURMDistributor::getLog(size_t jobIndex, bool flush) const
 	{
 	    string outputName = makeOutputName(jobIndex);
-	    flushCache(outputName);
+		if (flush)
+			flushCache(outputName);
 		return readText(outputName);
 	}
 
 	string SLURMDistributor::getSlurmErrorLog(size_t jobIndex, bool flush) const
 	{
 		string outputName = makeErrorName(jobIndex);
-		flushCache(outputName);
+		if (flush)
+			flushCache(outputName);
 		return readText(outputName);
 	}
+
+	string SLURMDistributor::getExitCode(size_t jobIndex) const
+	{
+		string doneName = makeDoneName(jobIndex);
+		if (!fs::exists(doneName))
+			return "";
+
+		string code = readText(doneName);
+		trim(code);
+		return code;
+	}
 	
 	constexpr int JOB_FAILED = -2;
 	constexpr int JOB_WAITING = -1;
@@ -288,14 +464,50 @@ namespace pilib
 		return (int)std::count(line.begin(), line.end(), '=') * 10;
 	}
 
-	vector<int> SLURMDistributor::getJobProgress() const
+	int SLURMDistributor::getFinishedJobState(size_t jobIndex, const string& exitCode) const
 	{
-		vector<int> progress;
-		progress.reserve(submittedJobs.size());
+		if (exitCode != "0")
+			return JOB_FAILED;
+
+		// Check that the job log ends with success message, if not set job to failed state.
+		string last = lastLine(getLog(jobIndex, true));
+		if (last != "Everything done.")
+			return JOB_FAILED;
+
+		return 100;
+	}
+
+	vector<int> SLURMDistributor::getJobProgress(const vector<int>& previousProgress) const
+	{
+		vector<int> progress(submittedJobs.size(), JOB_WAITING);
+
+		// Jobs that have not been submitted yet are waiting, and jobs that have finished stay finished.
+		// Jobs that have written the done marker file have finished. State of the other jobs is queried from SLURM.
+		vector<size_t> activeJobs;
 		for (size_t n = 0; n < submittedJobs.size(); n++)
+		{
+			if (get<2>(submittedJobs[n]) <= 0)
+				continue;
+
+			if (n < previousProgress.size() && previousProgress[n] >= 100)
+			{
+				progress[n] = previousProgress[n];
+				continue;
+			}
+
+			string exitCode = getExitCode(n);
+			if (exitCode.length() > 0)
+				progress[n] = getFinishedJobState(n, exitCode);
+			else
+				activeJobs.push_back(n);
+		}
+
+		set<string> queuedJobs = getQueuedJobs(activeJobs);
+
+		for (size_t n : activeJobs)
 		{
 			int state;
-			if (!isJobDone(n))
+			if (queuedJobs.find(get<0>(submittedJobs[n])) != queuedJobs.end())
 			{
 				// Read progress from log file or -1 if it does not exist.
 				state = getJobProgressFromLog(n);
@@ -306,29 +518,40 @@ namespace pilib
 			}
 			else
 			{
-       			// The job is not in squeue anymore
-				// Job is ready or failed
-				state = getJobProgressFromLog(n);
-				
-				// If the job is in waiting state something is wrong!
-				if (state == JOB_WAITING)
+				// The job is not in squeue anymore.
+				// It might have finished after the done marker was checked.
+				string exitCode = getExitCode(n);
+				if (exitCode.length() > 0)
 				{
-					state = JOB_FAILED;
+					state = getFinishedJobState(n, exitCode);
 				}
 				else
 				{
-					// Check that the job log ends with success message, if not set job to failed state.
-					string last = lastLine(getLog(n));
-					if (last != "Everything done.")
+					// The job ended without writing the done marker, e.g. it has been cancelled or the node failed.
+					// Job is ready or failed
+					state = getJobProgressFromLog(n);
+
+					// If the job is in waiting state something is wrong!
+					if (state == JOB_WAITING)
+					{
 						state = JOB_FAILED;
+					}
+					else
+					{
+						// Check that the job log ends with success message, if not set job to failed state.
+						string last = lastLine(getLog(n, true));
+						if (last != "Everything done.")
+							state = JOB_FAILED;
+					}
+
+					if (state != JOB_FAILED)
+						state = 100;
 				}
-				    
-				if(state != JOB_FAILED)
-					state = 100;
 			}
 
-			progress.push_back(state);
+			progress[n] = state;
 		}
+
 		return progress;
 	}
 
@@ -466,16 +689,18 @@ namespace pilib
 		return msg.str();
 	}
 
-	void SLURMDistributor::cancelJob(size_t slurmId) const
+	void SLURMDistributor::cancelJob(const string& slurmId) const
 	{
-		execute(scancelCommand, itl2::toString(slurmId));
+		execute(scancelCommand, slurmId);
 	}
 
 	void SLURMDistributor::cancelAll() const
 	{
+		// Tasks of job arrays are cancelled one by one as some of them may have been re-submitted as separate jobs.
 		for (size_t n = 0; n < submittedJobs.size(); n++)
 		{
-			cancelJob(get<0>(submittedJobs[n]));
+			if (get<2>(submittedJobs[n]) > 0)
+				cancelJob(get<0>(submittedJobs[n]));
 		}
 	}
 
@@ -486,15 +711,19 @@ namespace pilib
 			return result;
 
 		size_t barLength = 0;
+		vector<int> progress;
 		try
 		{
+			if (useJobArrays)
+				submitArrays();
+
 			// Wait until jobs are done
 			bool done = false;
 			do
 			{
 				itl2::sleep(500);
 
-				vector<int> progress = getJobProgress();
+				progress = getJobProgress(progress);
 
 				// Re-submit failed jobs
 				for (size_t n = 0; n < progress.size(); n++)
@@ -562,6 +791,26 @@ namespace pilib
 					}
 				}
 
+				// Submit jobs that wait for a free slot in the cluster
+				if (maxParallelJobs > 0)
+				{
+					size_t activeCount = 0;
+					for (size_t n = 0; n < progress.size(); n++)
+					{
+						if (get<2>(submittedJobs[n]) > 0 && progress[n] < 100)
+							activeCount++;
+					}
+
+					for (size_t n = 0; n < progress.size() && activeCount < maxParallelJobs; n++)
+					{
+						if (get<2>(submittedJobs[n]) <= 0)
+						{
+							resubmit(n);
+							activeCount++;
+						}
+					}
+				}
+
 				// Show progress bar
 				string bar = createProgressBar(progress);
 				showProgressBar(bar, barLength);
@@ -595,7 +844,6 @@ namespace pilib
 		showProgressBar("", barLength);
 
 		// Read logs and generate error if something went wrong.
-		vector<int> progress = getJobProgress();
 		result.reserve(submittedJobs.size());
 		ostringstream msg;
 		for (size_t n = 0; n < submittedJobs.size(); n++)
@@ -3,6 +3,8 @@
 #include "distributor.h"
 #include "argumentdatatype.h"
 
+#include <set>
+
 namespace pilib
 {
 	/**
@@ -17,8 +19,9 @@ namespace pilib
 
 		/**
 		Stores (job slurm id, queue type, submission count) of all submitted jobs since last call to waitForJobs.
+		The SLURM id is either job id or job array task id (e.g. 1234_5), and it is empty if the job has not been submitted yet.
 		*/
-		std::vector<std::tuple<size_t, JobType, size_t> > submittedJobs;
+		std::vector<std::tuple<std::string, JobType, size_t> > submittedJobs;
 
 		/**
 		Extra arguments for sbatch and sinfo, for fast jobs
@@ -60,6 +63,24 @@ namespace pilib
 		*/
 		size_t maxSubmissions;
 
+		/**
+		Maximum count of jobs that are submitted to the cluster at the same time. Zero corresponds to no limit.
+		The rest of the jobs are submitted as earlier jobs finish.
+		*/
+		size_t maxParallelJobs;
+
+		/**
+		Indicates if jobs are submitted as job arrays instead of separate jobs.
+		*/
+		bool useJobArrays;
+
+		/**
+		Maximum count of tasks in one job array.
+		SLURM limits array task ids to [0, MaxArraySize[, so the jobs are submitted in chunks whose task ids are 0, 1, ..., and
+		the task id is converted to job index by adding the index of the first job of the chunk.
+		*/
+		size_t maxArraySize;
+
 		/**
 		Commands run on each node before pi.
 		*/
@@ -73,7 +94,7 @@ namespace pilib
 		/**
 		Cancels job with given SLURM id.
 		*/
-		void cancelJob(size_t slurmId) const;
+		void cancelJob(const std::string& slurmId) const;
 
 		/**
 		Cancel all jobs submitted by this object.
@@ -82,13 +103,25 @@ namespace pilib
 
 		/**
 		Calculate progress of all jobs in submittedJobs array.
+		@param previousProgress Progress returned by the previous call. State of jobs that had finished is not checked again.
 		*/
-		std::vector<int> getJobProgress() const;
+		std::vector<int> getJobProgress(const std::vector<int>& previousProgress) const;
 
 		/**
-		Checks if the given job has finished.
+		Finds out which of the given jobs are running or waiting in the queue, using as few squeue calls as possible.
+		@return SLURM ids of the jobs that are in the queue.
 		*/
-		bool isJobDone(size_t jobIndex) const;
+		std::set<std::string> getQueuedJobs(const std::vector<size_t>& jobIndices) const;
+
+		/**
+		Gets exit code of pi2 from the done marker file of the given job, or empty string if the job has not written the file yet.
+		*/
+		std::string getExitCode(size_t jobIndex) const;
+
+		/**
+		Determines if a job that has written the done marker file succeeded.
+		*/
+		int getFinishedJobState(size_t jobIndex, const std::string& exitCode) const;
 
 		/**
 		Gets log of given job.
@@ -115,16 +148,47 @@ namespace pilib
 		*/
 		std::string createProgressBar(const std::vector<int>& progress);
 
+		/**
+		Runs sbatch with the given arguments.
+		@return SLURM job id of the submitted job or job array.
+		*/
+		std::string sbatch(const std::string& sbatchArgs) const;
+
 		/**
 		Submits job with given index again.
 		*/
 		void resubmit(size_t jobIndex);
 
+		/**
+		Submits all jobs that have not been submitted yet as job arrays, one or more arrays for each job type.
+		If the count of parallel jobs is limited, the arrays run one after another.
+		*/
+		void submitArrays();
+
+		/**
+		Creates command line that is run in a job.
+		@param jobIndex Index of the job, or an expression that evaluates to the index in the shell.
+		*/
+		std::string makeJobCommandLine(const std::string& jobIndex) const;
+
+		/**
+		Creates name of a file related to a job.
+		@param jobIndex Index of the job, or a placeholder that is replaced by the index.
+		*/
+		std::string makeFileName(const std::string& jobIndex, const std::string& suffix) const;
+
 		/**
 		Creates unique name for a job.
 		*/
 		std::string makeJobName(size_t jobIndex) const;
 
+		/**
+		Gets string that identifies the SLURM log files of a job.
+		For job array tasks this is the SLURM id of the task, as SLURM names the log files using the array task id, and that is not the job index.
+		For other jobs this is the job index.
+		*/
+		std::string makeLogFileIndex(size_t jobIndex) const;
+
 		/**
 		Creates input file name.
 		*/
@@ -140,6 +204,11 @@ namespace pilib
 		*/
 		std::string makeErrorName(size_t jobIndex) const;
 
+		/**
+		Creates name of the file where the job writes exit code of pi2 when it finishes.
+		*/
+		std::string makeDoneName(size_t jobIndex) const;
+
 	public:
 		SLURMDistributor(PISystem* system);
 
@@ -147,6 +216,11 @@ namespace pilib
 
 		virtual std::vector<std::string> waitForJobs() override;
 
+		virtual size_t workerCount() const override
+		{
+			return std::max<size_t>(maxParallelJobs, 1);
+		}
+
 		virtual size_t allowedMemory() const override
 		{
 			return allowedMem;
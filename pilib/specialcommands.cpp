@@ -23,6 +23,8 @@ namespace pilib
 		CommandList::add<MaxMemoryCommand>();
 		CommandList::add<DelayingCommand>();
 		CommandList::add<PrintTaskScriptsCommand>();
+		CommandList::add<RawReadSettingsCommand>();
+		CommandList::add<FlushWritesCommand>();
 		CommandList::add<EchoCommandsCommand>();
 		CommandList::add<HelloCommand>();
 		CommandList::add<PrintCommand>();
@@ -709,7 +711,7 @@ the FAQ for more information on the distribution of modified source versions.)EN
 		static void run(const Vec3c& dimensions, const string& imgName, PISystem* system, const string& filename)
 		{
 			Image<pixel_t>& img = *CreateImage<pixel_t>::run(dimensions, imgName, system);
-			io::read<pixel_t>(img, filename);
+			io::read<pixel_t>(img, filename, true);
 		}
 	};
 
@@ -824,7 +826,7 @@ the FAQ for more information on the distribution of modified source versions.)EN
 		static void run(const Vec3c& dimensions, const string& imgName, PISystem* system, const string& filename)
 		{
 			Image<pixel_t>& img = *CreateImage<pixel_t>::run(dimensions, imgName, system);
-			raw::readNoParse<pixel_t>(img, filename);
+			raw::readNoParse<pixel_t>(img, filename, 0, raw::readPixel<pixel_t>, true);
 		}
 	};
 
@@ -1372,6 +1374,20 @@ the FAQ for more information on the distribution of modified source versions.)EN
 			system->getDistributor()->allowedMemory(itl2::round(maxMem * 1024.0 * 1024.0));
 	}
 
+	void RawReadSettingsCommand::runInternal(PISystem* system, vector<ParamVariant>& args) const
+	{
+		size_t threadCount = pop<size_t>(args);
+		bool directIO = pop<bool>(args);
+		parallelReadSettings().threadCount = threadCount;
+		parallelReadSettings().directIO = directIO;
+	}
+
+	void FlushWritesCommand::runInternal(PISystem* system, vector<ParamVariant>& args) const
+	{
+		bool sync = pop<bool>(args);
+		flushWrites(sync);
+	}
+
 	void DistributeCommand::runInternal(PISystem* system, vector<ParamVariant>& args) const
 	{
 		string provider = pop<string>(args);
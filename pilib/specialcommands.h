@@ -790,6 +790,49 @@ namespace pilib
 	};
 
 
+	class RawReadSettingsCommand : virtual public Command, public TrivialDistributable
+	{
+	protected:
+		friend class CommandList;
+
+		RawReadSettingsCommand() : Command("rawreadsettings", "Sets options used when reading .raw files and blocks of .raw files. The data is read using multiple concurrent read operations, and adjacent scan lines are combined into large read requests. In distributed processing, the corresponding settings can be given in the configuration file using keys read_threads and direct_io.",
+			{
+				CommandArgument<size_t>(ParameterDirection::In, "thread count", "Count of concurrent read operations. Specify zero to use the same count than there are computation threads.", 0),
+				CommandArgument<bool>(ParameterDirection::In, "direct io", "Set to true to bypass the file system cache of the operating system. This may improve read speed on parallel file systems. If the file system does not support direct I/O, normal reads are made.", false)
+			})
+		{
+		}
+
+	public:
+		virtual void runInternal(PISystem* system, vector<ParamVariant>& args) const override;
+
+		virtual void run(vector<ParamVariant>& args) const override
+		{
+		}
+	};
+
+
+	class FlushWritesCommand : virtual public Command, public TrivialDistributable
+	{
+	protected:
+		friend class CommandList;
+
+		FlushWritesCommand() : Command("flushwrites", "Waits until all pending background writes to .raw files and image sequences are finished. Commands writerawblock and writesequenceblock write the data in the background, and the writes are finished automatically at the end of each script or command. Use this command to make sure that the data has been saved to the storage device, and to report write errors at a specific point.",
+			{
+				CommandArgument<bool>(ParameterDirection::In, "sync", "Set to true to flush the written .raw files from the cache of the operating system to the storage device.", true)
+			})
+		{
+		}
+
+	public:
+		virtual void runInternal(PISystem* system, vector<ParamVariant>& args) const override;
+
+		virtual void run(vector<ParamVariant>& args) const override
+		{
+		}
+	};
+
+
 	template<typename pixel_t> class EnsureSizeCommand : public OneImageInPlaceCommand<pixel_t>, public Distributable
 	{
 	protected:
@@ -8,6 +8,7 @@ namespace pilib
 	{
 		CommandList::add<FBPPreprocessCommand>();
 		CommandList::add<FBPCommand>();
+		CommandList::add<FBPStreamingCommand>();
 		CommandList::add<CreateFBPFilterCommand>();
 	}
 
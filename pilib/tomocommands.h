@@ -69,16 +69,52 @@ namespace pilib
 #if defined(USE_OPENCL)
 				backprojectOpenCLProjectionOutputBlocks(in, sets, out);
 #else
-				backproject(in, sets, out);
+				backprojectBlocks(in, sets, out);
 #endif
 			}
 			else
 			{
-				backproject(in, sets, out);
+				backprojectBlocks(in, sets, out);
 			}
 		}
 	};
 
+	class FBPStreamingCommand : public Command
+	{
+	protected:
+		friend class CommandList;
+
+		FBPStreamingCommand() :
+			Command("fbpstreaming", "Performs preprocessing and filtered backprojection of transmission projection data that is read from a file in chunks of consecutive projections. The next chunk is read while the current chunk is processed, and only a few chunks are kept in memory at any time. This command is experimental and may change in the near future.",
+				{
+					CommandArgument<std::string>(ParameterDirection::In, "projections file", "Name of file containing the transmission projections. Supported pixel data types are uint8, uint16, uint32 and float32."),
+					CommandArgument<Image<float32_t> >(ParameterDirection::Out, "output image", "Image where the reconstruction is placed."),
+					CommandArgument<std::string>(ParameterDirection::In, "reconstruction settings", "Settings for the reconstruction. If this string contains only a name of an existing file, the settings are read from that file. Otherwise, the string is treated as contents of the settings file.", ""),
+					CommandArgument<coord_t>(ParameterDirection::In, "chunk size", "Count of projections read and processed at once.", 16)
+				},
+				"fbppreprocess, fbp")
+		{
+		}
+
+	public:
+		virtual void run(std::vector<ParamVariant>& args) const override
+		{
+			std::string filename = pop<std::string>(args);
+			Image<float32_t>& out = *pop<Image<float32_t>* >(args);
+			std::string settings = pop<std::string>(args);
+			coord_t chunkSize = pop<coord_t>(args);
+
+			if (fileExists(settings))
+			{
+				settings = readText(settings, true);
+			}
+
+			RecSettings sets = fromString<RecSettings>(settings);
+
+			fbpStreaming(filename, out, sets, chunkSize);
+		}
+	};
+
 	class CreateFBPFilterCommand : public Command
 	{
 	protected:
@@ -27,6 +27,13 @@ cluster_job_init_commands = ""
 # Maximum image dimension to use while stitching. 2500 corresponds to ~120 GB memory requirement.
 max_block_size = 2500
 
+# Maximum size of source image block that a stitching job reads into memory at once, in megabytes.
+# Zero means that the value is determined from stitch_job_memory, or by pi2 if that is not set either.
+max_source_block_size = 0
+
+# Memory to request for each stitching job from the cluster, in megabytes. Zero means no explicit request.
+stitch_job_memory = 0
+
 # Should the script wait until all cluster jobs are finished?
 wait_for_jobs = True
 
@@ -70,6 +77,8 @@ def read_global_settings(config):
     global cluster_partition
     global cluster_job_init_commands
     global max_block_size
+    global max_source_block_size
+    global stitch_job_memory
     global wait_for_jobs
     global sbatch_extra_params
 
@@ -92,6 +101,10 @@ def read_global_settings(config):
     # Maximum stitching block size
     max_block_size = get(config, 'max_block_size', max_block_size)
 
+    # Maximum source block size and memory request of stitching jobs
+    max_source_block_size = float(get(config, 'max_source_block_size', max_source_block_size))
+    stitch_job_memory = float(get(config, 'stitch_job_memory', stitch_job_memory))
+
 	# Extra parameters for sbatch command
     sbatch_extra_params = get(config, 'cluster_extra_params', sbatch_extra_params)
 
@@ -120,10 +133,11 @@ def run_pi2_locally(pi_script):
 
 
 
-def run_pi2(pi_script, output_prefix):
+def run_pi2(pi_script, output_prefix, memory=0):
     """
     Runs pi2 job either locally or on cluster.
     output_prefix is a prefix for error and output log files.
+    memory is the amount of memory to request for a cluster job, in megabytes. Zero means no explicit request.
     """
 
     global submitted_jobs
@@ -135,7 +149,11 @@ def run_pi2(pi_script, output_prefix):
             job_cmdline = cluster_job_init_commands + ";"
         job_cmdline = job_cmdline + f"{pi_path}/pi2 '{pi_script}'"
 
-        sbatch_params = f"--job-name=stitch --partition={cluster_partition} --output={output_prefix}-out.txt --error={output_prefix}-err.txt {sbatch_extra_params} --wrap=\"{job_cmdline}\""
+        mem_param = ""
+        if memory > 0:
+            mem_param = f"--mem={int(math.ceil(memory))}M "
+
+        sbatch_params = f"--job-name=stitch --partition={cluster_partition} --output={output_prefix}-out.txt --error={output_prefix}-err.txt {mem_param}{sbatch_extra_params} --wrap=\"{job_cmdline}\""
 
         # For testing
         #cmd = "echo"
@@ -270,6 +288,26 @@ def get_image_size(filename):
 
 
 
+def get_pixel_size(filename):
+    """
+    Finds out size of one pixel of given image in bytes.
+    """
+
+    pi_script = f"fileinfo({filename});"
+    s = run_pi2_locally(pi_script)
+    s = s.decode('ASCII')
+    lines = s.splitlines()
+    if len(lines) == 3:
+        sizes = {'uint8': 1, 'uint16': 2, 'uint32': 4, 'uint64': 8, 'float32': 4, 'complex32': 8, 'int8': 1, 'int16': 2, 'int32': 4, 'int64': 8}
+        data_type = lines[2].strip().lower()
+        if data_type in sizes:
+            return sizes[data_type]
+
+    raise RuntimeError("Unable to read data type from image file " + filename)
+
+
+
+
 def raw_exists(prefix):
     """
     Tests if a .raw file with given prefix exists.
@@ -1627,6 +1665,19 @@ def run_stitching(comp, sample_name, normalize, global_optimization, allow_rotat
     # Cut big sample to small regions and process them separately to save memory
     block_size = int(max_block_size)
 
+    # Determine how large blocks of the source images can be read at once.
+    # If the job memory is given, whatever is not needed for the output block is used for the source blocks.
+    source_block_size = max_source_block_size
+    if source_block_size <= 0 and stitch_job_memory > 0:
+        pixel_size = get_pixel_size(first_file_name)
+        bytes_per_output_pixel = 2 * pixel_size + 4
+        if create_goodness_file:
+            bytes_per_output_pixel = bytes_per_output_pixel + 4
+        output_block_size = bytes_per_output_pixel * block_size ** 3 / (1024 * 1024)
+        source_block_size = stitch_job_memory - output_block_size
+        if source_block_size <= 0:
+            raise RuntimeError(f"stitch_job_memory = {stitch_job_memory} MB is not enough for output blocks of size {block_size}^3 that require {output_block_size:.0f} MB. Increase stitch_job_memory or decrease max_block_size.")
+
     jobs_started = 0
     for zstart in range(minz, out_depth + minz, block_size):
         for ystart in range(miny, out_height + miny, block_size):
@@ -1639,7 +1690,7 @@ def run_stitching(comp, sample_name, normalize, global_optimization, allow_rotat
                 if not create_goodness_file:
                     pi_script = (f"echo;"
                                  f"newlikefile(outimg, {first_file_name}, Unknown, 1, 1, 1);"
-                                 f"stitch_ver2(outimg, {index_file}, {xstart}, {ystart}, {zstart}, {curr_width}, {curr_height}, {curr_depth}, {normalize});"
+                                 f"stitch_ver2(outimg, {index_file}, {xstart}, {ystart}, {zstart}, {curr_width}, {curr_height}, {curr_depth}, {normalize}, {source_block_size});"
                                  f"writerawblock(outimg, {out_file}, {xstart - minx}, {ystart - miny}, {zstart - minz}, {out_width}, {out_height}, {out_depth});"
                                 )
                 else:
@@ -1647,12 +1698,12 @@ def run_stitching(comp, sample_name, normalize, global_optimization, allow_rotat
                     pi_script = (f"echo;"
                              f"newlikefile(outimg, {first_file_name}, Unknown, 1, 1, 1);"
                              f"newlikefile(goodnessimg, {first_file_name}, Unknown, 1, 1, 1);"
-                             f"stitch_ver3(outimg, goodnessimg, {index_file}, {xstart}, {ystart}, {zstart}, {curr_width}, {curr_height}, {curr_depth}, {normalize});"
+                             f"stitch_ver3(outimg, goodnessimg, {index_file}, {xstart}, {ystart}, {zstart}, {curr_width}, {curr_height}, {curr_depth}, {normalize}, {source_block_size});"
                              f"writerawblock(outimg, {out_file}, {xstart - minx}, {ystart - miny}, {zstart - minz}, {out_width}, {out_height}, {out_depth});"
                              f"writerawblock(goodnessimg, {out_goodness_file}, {xstart - minx}, {ystart - miny}, {zstart - minz}, {out_width}, {out_height}, {out_depth});"
                             )
 
-                run_pi2(pi_script, f"{out_template}_{jobs_started}")
+                run_pi2(pi_script, f"{out_template}_{jobs_started}", stitch_job_memory)
                 jobs_started = jobs_started + 1
 
     return jobs_started
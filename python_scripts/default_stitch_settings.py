@@ -114,6 +114,19 @@ wait_for_jobs = True
 max_block_size = 2500
 
 
+# Maximum size of the block of a source image that is read into memory at once in a stitching job, in megabytes.
+# Larger blocks are split so that this limit is not exceeded.
+# Zero means that the value is calculated from stitch_job_memory, or if that is zero, one fourth of
+# the memory of the computer running the job is used.
+max_source_block_size = 0
+
+
+# Memory to request for each stitching job from the cluster, in megabytes.
+# Set to the memory available for one job so that max_source_block_size can be determined automatically.
+# Zero means that no memory request is made and the cluster defaults apply.
+stitch_job_memory = 0
+
+
 # Partition of cluster that should be used
 cluster_partition = day
 
@@ -5,6 +5,7 @@ import os
 import atexit
 import string
 import random
+import weakref
 import numpy as np
 from enum import Enum
 
@@ -294,14 +295,13 @@ class Pi2Image(Pi2Object):
         return w, h, d, dt
 
 
-    def get_data_pointer(self):
+    @staticmethod
+    def pointer_to_array(ptr, w, h, d, dt):
         """
-        Gets pointer to the image data stored in the Pi2 system as NumPy array.
-        The data is not copied so it might become unavailable when next Pi2 calls are made.
+        Converts raw pointer to image data, image dimensions, and data type to NumPy array.
+        The data is not copied.
         """
 
-        ptr, w, h, d, dt = self.get_raw_pointer()
-
         if dt == 0:
             raise RuntimeError("Unable to retrieve image data because pixel data type is not supported.")
         elif dt == 1:
@@ -340,6 +340,50 @@ class Pi2Image(Pi2Object):
         return np.reshape(arr, (1))
 
 
+    def get_data_pointer(self):
+        """
+        Gets pointer to the image data stored in the Pi2 system as NumPy array.
+        The data is not copied so it might become unavailable when next Pi2 calls are made.
+        Use get_data_view to get an array that stays valid.
+        """
+
+        ptr, w, h, d, dt = self.get_raw_pointer()
+        return Pi2Image.pointer_to_array(ptr, w, h, d, dt)
+
+
+    def get_data_view(self):
+        """
+        Gets the image data stored in the Pi2 system as NumPy array without copying it.
+        The image is pinned until the returned array and all views of it have been garbage collected.
+        While the image is pinned, the array stays valid even if the image is cleared from the Pi2 system,
+        but commands that would re-allocate the image (e.g. change its size) fail.
+        """
+
+        w = c_longlong(0)
+        h = c_longlong(0)
+        d = c_longlong(0)
+        dt = c_int(0)
+        ptr = self.pi2.pilib.pinImage(self.pi2.piobj, self.name.encode('UTF-8'), byref(w), byref(h), byref(d), byref(dt))
+
+        if ptr is None:
+            self.pi2.raise_last_error()
+
+        try:
+            arr = Pi2Image.pointer_to_array(ptr, w.value, h.value, d.value, dt.value)
+        except:
+            self.pi2.release_pinned(ptr)
+            raise
+
+        # Release the pin when the array that wraps the pointer is collected.
+        # All views returned by pointer_to_array refer to that array.
+        base = arr
+        while isinstance(base.base, np.ndarray):
+            base = base.base
+        weakref.finalize(base, self.pi2.release_pinned, ptr)
+
+        return arr
+
+
     def flush_pointer(self):
         """
         In distributed computing mode, flushes local changes to image data to disk.
@@ -368,12 +412,18 @@ class Pi2Image(Pi2Object):
         return float(M[0])
 
 
-    def set_data(self, numpy_array):
+    def set_data(self, numpy_array, share=False):
         """
         Sets pixels, size and pixel data type of this image from a NumPy array.
         The image will be in the same format than the NumPy array.
         Not all data types supported in NumPy work.
         Only 1-, 2-, and 3-dimensional NumPy arrays are supported.
+        By default the pixel data is copied.
+        If share is True and the data type and memory layout of the array allow it, the image and the array share
+        the same memory instead, and changes made to one are visible in the other, including changes made by
+        commands that process the image in-place.
+        The image keeps the array alive as long as the memory is shared.
+        Sharing ends if the image is cleared or re-allocated, e.g. its size is changed.
         """
 
         w = 1
@@ -388,6 +438,9 @@ class Pi2Image(Pi2Object):
         if len(numpy_array.shape) >= 4:
             raise RuntimeError("Maximum 3-dimensional arrays can be transferred to pi2.")
 
+        if share and self.pi2.share_array(self.name, numpy_array):
+            return
+
         dtype = numpy_array.dtype
         if numpy_array.dtype == np.float64:
             dtype = ImageDataType.FLOAT32
@@ -535,6 +588,20 @@ class Pi2:
         self.pilib.getImage.argtypes = [c_void_p, c_char_p, POINTER(c_int64), POINTER(c_int64), POINTER(c_int64), POINTER(c_int32)]
         self.pilib.getImage.paramflags = [1, 1, 2, 2, 2, 2]
 
+        self.pilib.pinImage.restype = c_void_p
+        self.pilib.pinImage.argtypes = [c_void_p, c_char_p, POINTER(c_int64), POINTER(c_int64), POINTER(c_int64), POINTER(c_int32)]
+
+        self.pilib.releaseImage.restype = c_uint8
+        self.pilib.releaseImage.argtypes = [c_void_p, c_void_p]
+
+        self.pilib.createImageFromBuffer.restype = c_uint8
+        self.pilib.createImageFromBuffer.argtypes = [c_void_p, c_char_p, c_void_p, c_int64, c_int64, c_int64, c_int32, Pi2.RELEASE_BUFFER_CALLBACK, c_void_p]
+
+        # NumPy arrays whose memory is shared with images in the Pi2 system, see share_array.
+        self.shared_arrays = {}
+        self.next_shared_array_id = 1
+        self.release_buffer_callback = Pi2.RELEASE_BUFFER_CALLBACK(self.release_shared_array)
+
         self.pilib.getImageInfo.argtypes = [c_void_p, c_char_p, POINTER(c_int64), POINTER(c_int64), POINTER(c_int64), POINTER(c_int32)]
         self.pilib.getImageInfo.paramflags = [1, 1, 2, 2, 2, 2]
 
@@ -565,6 +632,87 @@ class Pi2:
             self.add_method(cmd_name)
 
 
+    # Type of callback that pilib calls when it does not need a shared buffer anymore.
+    RELEASE_BUFFER_CALLBACK = CFUNCTYPE(None, c_void_p)
+
+    # Maps NumPy data types to values of pilib ImageDataType enumeration.
+    NUMPY_DATA_TYPES = {
+        np.dtype(np.uint8): 1,
+        np.dtype(np.uint16): 2,
+        np.dtype(np.uint32): 3,
+        np.dtype(np.uint64): 4,
+        np.dtype(np.float32): 5,
+        np.dtype(np.complex64): 6,
+        np.dtype(np.int8): 7,
+        np.dtype(np.int16): 8,
+        np.dtype(np.int32): 9,
+        np.dtype(np.int64): 10,
+    }
+
+
+    def share_array(self, name, numpy_array):
+        """
+        Creates image with given name that shares memory with the given NumPy array.
+        Dimensions of the image are the same than in Pi2Image.set_data.
+        The array is kept alive until pilib releases the memory.
+        Returns False if the memory of the array cannot be shared, e.g. because its data type is not
+        supported or because its pixels are not stored in the order required by pilib.
+        """
+
+        if self.piobj is None:
+            return False
+
+        dt = Pi2.NUMPY_DATA_TYPES.get(numpy_array.dtype)
+        if dt is None or numpy_array.size <= 0 or numpy_array.ndim < 1 or numpy_array.ndim > 3:
+            return False
+
+        if not numpy_array.flags.writeable or not numpy_array.flags.aligned:
+            return False
+
+        # Image x-coordinate corresponds to the second axis of the array, y to the first and z to the third.
+        # Pixels are stored in x, y, z order, so the (z, y, x) view of the array must be C-contiguous.
+        if numpy_array.ndim == 3:
+            if not np.moveaxis(numpy_array, 2, 0).flags.c_contiguous:
+                return False
+        elif not numpy_array.flags.c_contiguous:
+            return False
+
+        w = 1
+        h = numpy_array.shape[0]
+        d = 1
+        if numpy_array.ndim >= 2:
+            w = numpy_array.shape[1]
+        if numpy_array.ndim >= 3:
+            d = numpy_array.shape[2]
+
+        array_id = self.next_shared_array_id
+        self.next_shared_array_id += 1
+        self.shared_arrays[array_id] = numpy_array
+
+        if not self.pilib.createImageFromBuffer(self.piobj, name.encode('UTF-8'), numpy_array.ctypes.data, w, h, d, dt, self.release_buffer_callback, array_id):
+            del self.shared_arrays[array_id]
+            self.raise_last_error()
+
+        return True
+
+
+    def release_shared_array(self, array_id):
+        """
+        Called by pilib when it does not need memory of an array shared with share_array anymore.
+        """
+
+        self.shared_arrays.pop(array_id, None)
+
+
+    def release_pinned(self, ptr):
+        """
+        Releases pin made on an image by Pi2Image.get_data_view.
+        """
+
+        if not self.piobj is None:
+            self.pilib.releaseImage(self.piobj, ptr)
+
+
     def closepi(self):
         """
         Closes the PI system if it was initialized.
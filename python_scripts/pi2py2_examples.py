@@ -64,6 +64,15 @@ def create_and_access_images():
     data = np.eye(100, 100)
     img1.set_data(data)
 
+    # Pass share=True to make the image use the memory of the NumPy array instead of a copy,
+    # if the data type and memory layout of the array allow it.
+    # Changes made to the image, e.g. by in-place commands, are then visible in the array, too.
+    shared_data = np.zeros((100, 100), dtype=np.float32)
+    img4 = pi.newimage()
+    img4.set_data(shared_data, share=True)
+    pi.add(img4, 1)
+    print(f"After adding one to the shared image, the first element of the array is {shared_data[0, 0]}.")
+
     # This writes img1 to disk as a .raw file.
     # The dimensions of the image and the .raw suffix are automatically appended to
     # the image name given as second argument.
@@ -6,7 +6,10 @@ This file contains some of the tests of the pi2py2 library.
 
 
 from pi2py2 import *
+import pi2py2
 import numpy as np
+import os
+import shutil
 pi2 = Pi2()
 
 # Some utilities. Examples can be found after heading 'Examples begin here'
@@ -694,6 +697,66 @@ def dimension_broadcast():
     check_result(output_file('broadcasted_distributed_divide'), output_file('normal_divide'), "Invalid broadcasted distributed division result.")
 
 
+def slurm_array_limit():
+    """
+    Tests that max_parallel_jobs limits the count of simultaneously running jobs also when the jobs are
+    submitted in more than one SLURM job array.
+    SLURM is replaced by example_config/fake-slurm.sh, so this test does not need a cluster.
+    """
+
+    print("Testing SLURM job array limit...")
+
+    # The SLURM distributor reads its settings from the folder of the pi2 program.
+    config_file = os.path.join(os.path.dirname(os.path.abspath(pi2py2.__file__)), 'slurm_config.txt')
+    backup_file = config_file + '.backup'
+    if os.path.exists(config_file):
+        shutil.copyfile(config_file, backup_file)
+
+    fake_slurm = os.path.abspath('../example_config/fake-slurm.sh')
+    state_dir = os.path.abspath(output_file('fake-slurm'))
+    shutil.rmtree(state_dir, ignore_errors=True)
+    os.environ['FAKE_SLURM_DIR'] = state_dir
+
+    max_parallel_jobs = 2
+    with open(config_file, 'w') as f:
+        f.write(f"max_parallel_jobs = {max_parallel_jobs}\n")
+        f.write("use_job_arrays = true\n")
+        f.write("max_array_size = 2\n")
+        for cmd in ['sbatch', 'squeue', 'scancel', 'sinfo']:
+            f.write(f"{cmd}_command = {fake_slurm} {cmd}\n")
+
+    try:
+        pi2.distribute(Distributor.SLURM)
+        pi2.maxmemory(5)
+
+        img = pi2.read(input_file())
+        result = pi2.newimage(ImageDataType.FLOAT32)
+        pi2.gaussfilter(img, result, 2)
+        pi2.writeraw(result, output_file('slurm_array_limit_distributed'))
+
+        pi2.distribute(Distributor.NONE)
+    finally:
+        if os.path.exists(backup_file):
+            shutil.move(backup_file, config_file)
+        else:
+            os.remove(config_file)
+
+    img = pi2.read(input_file())
+    result = pi2.newimage(ImageDataType.FLOAT32)
+    pi2.gaussfilter(img, result, 2)
+    pi2.writeraw(result, output_file('slurm_array_limit_normal'))
+
+    check_distribution_test_result(output_file('slurm_array_limit_normal'), output_file('slurm_array_limit_distributed'), 'gaussfilter', 'SLURM distributed and local')
+
+    with open(os.path.join(state_dir, 'next-id')) as f:
+        array_count = int(f.read()) - 1000
+    with open(os.path.join(state_dir, 'max-running')) as f:
+        max_running = int(f.read())
+
+    check_result(array_count > 1, f"The jobs were submitted in {array_count} job array(s), but more than one array was expected.")
+    check_result(max_running <= max_parallel_jobs, f"{max_running} jobs were running at the same time, but max_parallel_jobs = {max_parallel_jobs}.")
+
+
 def rotate():
 
     img = pi2.read(input_file())
@@ -1121,6 +1184,7 @@ generate_particles()
 analyze_particles()
 #analyze_labels()
 #dimension_broadcast()
+#slurm_array_limit()
 #rotate()
 #twoimage_distribution()
 #histogram()